@@ -2,18 +2,25 @@
 # define ZSTD_STATIC_LINKING_ONLY
 #endif
 #include <zstd.h>
+#ifndef ZDICT_STATIC_LINKING_ONLY
+# define ZDICT_STATIC_LINKING_ONLY
+#endif
+#include <zdict.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <thread>
 #include <mutex>
 #include <fc/log/logger.hpp>
 #include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/fstream.hpp>
 #include <hive/chain/block_compression_dictionaries.hpp>
 #include <hive/chain/raw_compression_dictionaries.hpp>
 
 namespace hive { namespace chain {
 
-#ifdef HAS_COMPRESSION_DICTIONARIES
-
 // we store our dictionaries in compressed form, this is the maximum size
 // one will be when decompressed.  At the time of writing, we've decided
 // to use 220K dictionaries
@@ -37,12 +44,25 @@ std::map<uint8_t, ZSTD_DDict*> decompression_dictionaries;
 // maps a (dictionary_number, compression_level) pair to a ready-to-use compression dictionary
 std::map<std::pair<uint8_t, int>, ZSTD_CDict*> compression_dictionaries;
 
+// dictionary registered at runtime that should be used for all newly compressed blocks
+fc::optional<uint8_t> dictionary_for_new_blocks;
+
+bool is_builtin_dictionary(uint8_t dictionary_number)
+{
+#ifdef HAS_COMPRESSION_DICTIONARIES
+  return raw_dictionaries.find(dictionary_number) != raw_dictionaries.end();
+#else
+  return false;
+#endif
+}
+
 // helper function, assumes the upper level function holds the mutex on our maps
 const decompressed_raw_dictionary_info& get_decompressed_raw_dictionary(uint8_t dictionary_number)
 {
   auto decompressed_dictionary_iter = decompressed_raw_dictionaries.find(dictionary_number);
   if (decompressed_dictionary_iter == decompressed_raw_dictionaries.end())
   {
+#ifdef HAS_COMPRESSION_DICTIONARIES
     // we don't.  do we have the raw, compressed dictionary?
     auto raw_iter = raw_dictionaries.find(dictionary_number);
     if (raw_iter == raw_dictionaries.end())
@@ -68,14 +88,26 @@ const decompressed_raw_dictionary_info& get_decompressed_raw_dictionary(uint8_t
                                                                                                                    decompressed_raw_dictionary_info{std::move(resized_buffer), uncompressed_dictionary_size}));
     if (!insert_succeeded)
       FC_THROW("Error storing decompressing dictionary ${dictionary_number}", (dictionary_number));
+#else
+    FC_THROW_EXCEPTION(fc::key_not_found_exception, "No dictionary ${dictionary_number} available -- hived was not built with compression dictionaries and none was registered under that number", (dictionary_number));
+#endif
   }
   return decompressed_dictionary_iter->second;
 }
 
 fc::optional<uint8_t> get_best_available_zstd_compression_dictionary_number_for_block(uint32_t block_number)
 {
+  {
+    std::lock_guard<std::mutex> guard(dictionaries_mutex);
+    if (dictionary_for_new_blocks)
+      return dictionary_for_new_blocks;
+  }
+#ifdef HAS_COMPRESSION_DICTIONARIES
   uint8_t last_available_dictionary = raw_dictionaries.rbegin()->first;
   return std::min<uint8_t>(block_number / 1000000, last_available_dictionary);
+#else
+  return fc::optional<uint8_t>();
+#endif
 }
 
 ZSTD_DDict* get_zstd_decompression_dictionary(uint8_t dictionary_number)
@@ -111,21 +143,67 @@ ZSTD_CDict* get_zstd_compression_dictionary(uint8_t dictionary_number, int compr
   return dictionary;
 }
 
-#else // !defined(HAS_COMPRESSION_DICTIONARIES)
-fc::optional<uint8_t> get_best_available_zstd_compression_dictionary_number_for_block(uint32_t block_number)
+void register_zstd_compression_dictionary(uint8_t dictionary_number, const char* dictionary_data, size_t dictionary_size)
 {
-  return fc::optional<uint8_t>();
+  FC_ASSERT(!is_builtin_dictionary(dictionary_number), "Dictionary number ${dictionary_number} is already used by a built-in dictionary", (dictionary_number));
+  FC_ASSERT(dictionary_size > 0 && dictionary_size <= MAX_DICTIONARY_LENGTH, "Invalid size of dictionary ${dictionary_number}: ${dictionary_size}", (dictionary_number)(dictionary_size));
+
+  std::lock_guard<std::mutex> guard(dictionaries_mutex);
+  auto iter = decompressed_raw_dictionaries.find(dictionary_number);
+  if (iter != decompressed_raw_dictionaries.end())
+  {
+    // ready-to-use dictionaries reference the buffer and may be in use by other threads, so the content can't change
+    FC_ASSERT(iter->second.size == dictionary_size && memcmp(iter->second.buffer.get(), dictionary_data, dictionary_size) == 0,
+              "Different dictionary was already registered as number ${dictionary_number}", (dictionary_number));
+    return;
+  }
+
+  std::unique_ptr<char[]> buffer(new char[dictionary_size]);
+  memcpy(buffer.get(), dictionary_data, dictionary_size);
+  decompressed_raw_dictionaries.insert(std::make_pair(dictionary_number, decompressed_raw_dictionary_info{std::move(buffer), dictionary_size}));
 }
 
-ZSTD_DDict* get_zstd_decompression_dictionary(uint8_t dictionary_number)
+void set_zstd_compression_dictionary_for_new_blocks(fc::optional<uint8_t> dictionary_number)
 {
-  FC_THROW_EXCEPTION(fc::key_not_found_exception, "No dictionary ${dictionary_number} available -- hived was not built with compression dictionaries", (dictionary_number));
+  std::lock_guard<std::mutex> guard(dictionaries_mutex);
+  if (dictionary_number)
+    get_decompressed_raw_dictionary(*dictionary_number); // throws when there is no such dictionary
+  dictionary_for_new_blocks = dictionary_number;
 }
 
-ZSTD_CDict* get_zstd_compression_dictionary(uint8_t dictionary_number, int compression_level)
+uint8_t register_zstd_compression_dictionary_from_file(const std::string& number_and_file)
 {
-  FC_THROW_EXCEPTION(fc::key_not_found_exception, "No dictionary ${dictionary_number} available -- hived was not built with compression dictionaries", (dictionary_number));
+  auto separator = number_and_file.find(':');
+  FC_ASSERT(separator != std::string::npos && separator > 0 && separator + 1 < number_and_file.size(),
+            "Invalid compression dictionary ${entry}, expected NUMBER:FILE", ("entry", number_and_file));
+  const std::string number = number_and_file.substr(0, separator);
+  FC_ASSERT(number.size() <= 3 && std::all_of(number.begin(), number.end(), [](char c) { return std::isdigit((unsigned char)c); }),
+            "Invalid compression dictionary number ${number} in ${entry}, expected 0 - 255", (number)("entry", number_and_file));
+  const uint32_t dictionary_number = std::stoul(number);
+  FC_ASSERT(dictionary_number <= 255, "Compression dictionary number ${dictionary_number} out of range, expected 0 - 255", (dictionary_number));
+
+  const fc::path dictionary_file(number_and_file.substr(separator + 1));
+  FC_ASSERT(fc::is_regular_file(dictionary_file), "Compression dictionary file ${dictionary_file} does not exist", (dictionary_file));
+  std::string dictionary;
+  fc::read_file_contents(dictionary_file, dictionary);
+  register_zstd_compression_dictionary((uint8_t)dictionary_number, dictionary.data(), dictionary.size());
+  return (uint8_t)dictionary_number;
+}
+
+std::string train_zstd_compression_dictionary(const std::vector<char>& samples, const std::vector<size_t>& sample_sizes,
+                                              size_t dictionary_size, int compression_level, unsigned threads)
+{
+  // fastCover is the fastest trainer and the only one that can use multiple threads
+  std::string dictionary(dictionary_size, '\0');
+  ZDICT_fastCover_params_t parameters;
+  memset(&parameters, 0, sizeof(parameters));
+  parameters.nbThreads = threads;
+  parameters.zParams.compressionLevel = compression_level;
+  size_t trained_size = ZDICT_optimizeTrainFromBuffer_fastCover(&dictionary[0], dictionary_size, samples.data(), sample_sizes.data(),
+                                                                sample_sizes.size(), &parameters);
+  FC_ASSERT(!ZDICT_isError(trained_size), "Error training compression dictionary: ${error}", ("error", ZDICT_getErrorName(trained_size)));
+  dictionary.resize(trained_size);
+  return dictionary;
 }
-#endif // HAS_COMPRESSION_DICTIONARIES
  
 } } // end namespace hive::chain
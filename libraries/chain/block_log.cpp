@@ -15,6 +15,14 @@
 #include <boost/smart_ptr/atomic_shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #ifndef ZSTD_STATIC_LINKING_ONLY
 # define ZSTD_STATIC_LINKING_ONLY
 #endif
@@ -64,6 +72,48 @@ namespace hive { namespace chain {
         // dictionaries are optimized for level 15
         int zstd_level = 15; 
 
+        // see block_log::set_index_reconstruction_threads()
+        uint32_t index_reconstruction_threads = 0;
+        uint64_t index_reconstruction_min_segment_size = 64 * 1024 * 1024;
+
+        // background compression, see block_log::set_compression_threads()
+        struct pending_block
+        {
+          boost::shared_ptr<signed_block> block;
+          std::vector<char>               serialized_block;
+          std::unique_ptr<char[]>         compressed_block;
+          size_t                          compressed_block_size = 0;
+          block_log::block_attributes_t   attributes;
+          bool                            compression_started = false;
+          bool                            compression_finished = false;
+        };
+
+        uint32_t compression_thread_count = 0;
+        std::atomic<bool> background_compression_active = { false };
+        // number of the last block completely written to the log file, see block_log::get_durable_head_block_num();
+        // changed under pending_mutex when blocks are written in background
+        std::atomic<uint32_t> durable_head_block_num = { 0 };
+        std::vector<std::thread> compression_threads;
+
+        // everything below is guarded by the pending_mutex
+        std::mutex pending_mutex;
+        std::condition_variable pending_condition; // signalled when block is queued or written
+        std::deque<std::shared_ptr<pending_block>> pending_blocks; // in block number order
+        // last block written by background threads; it can't be read through the index until its successor is written
+        boost::shared_ptr<signed_block> last_written_block;
+        bool writing_pending_blocks = false;
+        bool stop_compression_threads = false;
+        fc::optional<fc::exception> background_write_error;
+
+        void start_background_compression();
+        void stop_background_compression();
+        void queue_block(const boost::shared_ptr<signed_block>& b);
+        void compress_pending_blocks();
+        void write_compressed_blocks(std::unique_lock<std::mutex>& lock);
+        boost::shared_ptr<signed_block> find_block_in_memory(uint32_t block_num, const boost::shared_ptr<signed_block>& head_block);
+        std::vector<boost::shared_ptr<signed_block>> get_unindexed_blocks(const boost::shared_ptr<signed_block>& head_block);
+
+        uint64_t write_raw_block(const char* raw_block_data, size_t raw_block_size, block_log::block_attributes_t attributes);
         signed_block read_block_from_offset_and_size(uint64_t offset, uint64_t size);
         signed_block_header read_block_header_from_offset_and_size(uint64_t offset, uint64_t size);
         void truncate_block_index_to_head_block();
@@ -159,6 +209,213 @@ namespace hive { namespace chain {
         FC_THROW("Error truncating block index file: ${error}", ("error", strerror(errno)));
     }
 
+    uint64_t combine_block_start_pos_with_flags(uint64_t block_start_pos, block_log::block_attributes_t attributes);
+
+    uint64_t block_log_impl::write_raw_block(const char* raw_block_data, size_t raw_block_size, block_log::block_attributes_t attributes)
+    {
+      uint64_t block_start_pos = block_log_size;
+      uint64_t block_start_pos_with_flags = combine_block_start_pos_with_flags(block_start_pos, attributes);
+
+      // what we write to the file is the serialized data, followed by the index of the start of the
+      // serialized data.  Append that index so we can do it in a single write.
+      size_t block_size_including_start_pos = raw_block_size + sizeof(uint64_t);
+      std::unique_ptr<char[]> block_with_start_pos(new char[block_size_including_start_pos]);
+      memcpy(block_with_start_pos.get(), raw_block_data, raw_block_size);
+      *(uint64_t*)(block_with_start_pos.get() + raw_block_size) = block_start_pos_with_flags;
+
+      write_with_retry(block_log_fd, block_with_start_pos.get(), block_size_including_start_pos);
+      block_log_size += block_size_including_start_pos;
+
+      // add it to the index
+      write_with_retry(block_index_fd, &block_start_pos_with_flags, sizeof(block_start_pos_with_flags));
+
+      return block_start_pos;
+    }
+
+    void block_log_impl::start_background_compression()
+    {
+      FC_ASSERT(compression_threads.empty());
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        stop_compression_threads = false;
+        // current head was written synchronously, but it still can't be read through the index
+        last_written_block = head.load();
+      }
+      background_compression_active.store(true);
+      for (uint32_t i = 0; i < compression_thread_count; ++i)
+        compression_threads.emplace_back([this]() { compress_pending_blocks(); });
+    }
+
+    void block_log_impl::stop_background_compression()
+    {
+      if (compression_threads.empty())
+        return;
+
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        stop_compression_threads = true;
+      }
+      pending_condition.notify_all();
+      // threads exit only after all queued blocks are compressed and written
+      for (std::thread& thread : compression_threads)
+        thread.join();
+      compression_threads.clear();
+
+      std::lock_guard<std::mutex> guard(pending_mutex);
+      last_written_block.reset();
+      background_compression_active.store(false);
+      if (background_write_error)
+        elog("Block log is incomplete, background write failed: ${e}", ("e", background_write_error->to_detail_string()));
+    }
+
+    void block_log_impl::queue_block(const boost::shared_ptr<signed_block>& b)
+    {
+      std::shared_ptr<pending_block> queued_block = std::make_shared<pending_block>();
+      queued_block->block = b;
+
+      {
+        std::unique_lock<std::mutex> lock(pending_mutex);
+        if (background_write_error)
+          background_write_error->dynamic_rethrow_exception();
+        // don't let the compression fall behind indefinitely; when it does, the caller slows down to its pace
+        pending_condition.wait(lock, [this]() { return pending_blocks.size() < 4 * compression_thread_count; });
+        pending_blocks.push_back(queued_block);
+      }
+      pending_condition.notify_all();
+
+      head.exchange(queued_block->block);
+    }
+
+    void block_log_impl::compress_pending_blocks()
+    {
+      // each compression thread gets its own context
+      ZSTD_CCtx* compression_context = ZSTD_createCCtx();
+      BOOST_SCOPE_EXIT(&compression_context) {
+        ZSTD_freeCCtx(compression_context);
+      } BOOST_SCOPE_EXIT_END
+
+      std::unique_lock<std::mutex> lock(pending_mutex);
+      while (true)
+      {
+        auto it = std::find_if(pending_blocks.begin(), pending_blocks.end(),
+                               [](const std::shared_ptr<pending_block>& pb) { return !pb->compression_started; });
+        if (it == pending_blocks.end())
+        {
+          if (stop_compression_threads)
+            return;
+          pending_condition.wait(lock);
+          continue;
+        }
+
+        std::shared_ptr<pending_block> job = *it;
+        job->compression_started = true;
+        lock.unlock();
+
+        job->serialized_block = fc::raw::pack_to_vector(*job->block);
+        if (compression_enabled)
+        {
+          try
+          {
+            job->attributes.flags = block_log::block_flags::zstd;
+            job->attributes.dictionary_number = get_best_available_zstd_compression_dictionary_number_for_block(job->block->block_num());
+            std::tie(job->compressed_block, job->compressed_block_size) =
+              block_log::compress_block_zstd(job->serialized_block.data(), job->serialized_block.size(), job->attributes.dictionary_number,
+                                             zstd_level, compression_context);
+          }
+          catch (const fc::exception&)
+          {
+            // compression failed for some unknown reason, store the block uncompressed
+            job->attributes = block_log::block_attributes_t();
+            job->compressed_block.reset();
+          }
+        }
+
+        lock.lock();
+        job->compression_finished = true;
+        write_compressed_blocks(lock);
+      }
+    }
+
+    // writes out all compressed blocks from the front of the queue; only one thread writes at a time,
+    // the others just leave their blocks for it
+    void block_log_impl::write_compressed_blocks(std::unique_lock<std::mutex>& lock)
+    {
+      if (writing_pending_blocks)
+        return;
+      writing_pending_blocks = true;
+
+      while (!pending_blocks.empty() && pending_blocks.front()->compression_finished)
+      {
+        std::shared_ptr<pending_block> job = pending_blocks.front();
+        bool skip_write = background_write_error.valid();
+        lock.unlock();
+
+        fc::optional<fc::exception> write_error;
+        if (!skip_write)
+        {
+          try
+          {
+            if (job->compressed_block)
+              write_raw_block(job->compressed_block.get(), job->compressed_block_size, job->attributes);
+            else
+              write_raw_block(job->serialized_block.data(), job->serialized_block.size(), {block_log::block_flags::uncompressed});
+          }
+          catch (const fc::exception& e)
+          {
+            elog("Error writing block ${block_num} to block log: ${e}", ("block_num", job->block->block_num())("e", e.to_detail_string()));
+            write_error = e;
+          }
+        }
+
+        lock.lock();
+        if (write_error)
+          background_write_error = write_error;
+        else if (!skip_write)
+          durable_head_block_num.store(job->block->block_num());
+        pending_blocks.pop_front();
+        last_written_block = job->block;
+        pending_condition.notify_all();
+      }
+
+      writing_pending_blocks = false;
+    }
+
+    boost::shared_ptr<signed_block> block_log_impl::find_block_in_memory(uint32_t block_num, const boost::shared_ptr<signed_block>& head_block)
+    {
+      if (block_num == head_block->block_num())
+        return head_block;
+      if (!background_compression_active.load())
+        return boost::shared_ptr<signed_block>();
+
+      std::lock_guard<std::mutex> guard(pending_mutex);
+      if (last_written_block && block_num == last_written_block->block_num())
+        return last_written_block;
+      if (!pending_blocks.empty() && block_num >= pending_blocks.front()->block->block_num())
+      {
+        uint32_t position = block_num - pending_blocks.front()->block->block_num();
+        if (position < pending_blocks.size())
+          return pending_blocks[position]->block;
+      }
+      return boost::shared_ptr<signed_block>();
+    }
+
+    // returns consecutive blocks from the end of the log that can't be read through the index (yet)
+    std::vector<boost::shared_ptr<signed_block>> block_log_impl::get_unindexed_blocks(const boost::shared_ptr<signed_block>& head_block)
+    {
+      std::vector<boost::shared_ptr<signed_block>> blocks;
+      if (background_compression_active.load())
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        if (last_written_block)
+          blocks.push_back(last_written_block);
+        for (const auto& pb : pending_blocks)
+          blocks.push_back(pb->block);
+      }
+      if (blocks.empty())
+        blocks.push_back(head_block);
+      return blocks;
+    }
+
     std::pair<uint64_t, block_log::block_attributes_t> split_block_start_pos_with_flags(uint64_t block_start_pos_with_flags)
     {
       block_log::block_attributes_t attributes;
@@ -176,6 +433,64 @@ namespace hive { namespace chain {
         block_start_pos;
     }
 
+    // checks whether given offset looks like a start of a block, that is the 8 bytes preceding it
+    // hold a well formed start position of the previous block, and the same holds for a few blocks
+    // further back; used to pick starting points of parallel index reconstruction - the result is
+    // only a hint, every start point is verified when the backward chains are joined
+    bool is_plausible_block_boundary(const char* block_log_ptr, uint64_t lower_bound, uint64_t boundary)
+    {
+      for (int i = 0; i < 8 && boundary > lower_bound; ++i)
+      {
+        if (boundary < lower_bound + sizeof(uint64_t))
+          return false;
+        uint64_t block_pos_with_flags;
+        memcpy(&block_pos_with_flags, block_log_ptr + boundary - sizeof(uint64_t), sizeof(block_pos_with_flags));
+        if (block_pos_with_flags & 0x7e00000000000000ull) // unused bits
+          return false;
+        if (!(block_pos_with_flags & 0x0100000000000000ull) && (block_pos_with_flags & 0x00ff000000000000ull)) // dictionary number without its flag
+          return false;
+        const uint64_t block_pos = block_pos_with_flags & 0x0000ffffffffffffull;
+        const uint64_t block_end = boundary - sizeof(uint64_t);
+        if (block_pos < lower_bound || block_pos >= block_end || block_end - block_pos > HIVE_MAX_BLOCK_SIZE)
+          return false;
+        boundary = block_pos;
+      }
+      return true;
+    }
+
+    // follows the chain of start positions stored after each block, from upper_bound (start of a block
+    // or end of file) down to lower_bound, collecting them (with flags) in order of decreasing block number;
+    // returns false if the chain breaks or jumps over lower_bound (which means one of the bounds was not
+    // really a start of a block) or when interrupted
+    bool collect_block_start_positions(const char* block_log_ptr, uint64_t lower_bound, uint64_t upper_bound,
+                                       std::vector<uint64_t>& positions, std::atomic<uint64_t>& bytes_done)
+    {
+      uint64_t boundary = upper_bound;
+      uint64_t reported_boundary = upper_bound;
+      while (boundary > lower_bound)
+      {
+        if (boundary < sizeof(uint64_t))
+          return false;
+        uint64_t block_pos_with_flags;
+        memcpy(&block_pos_with_flags, block_log_ptr + boundary - sizeof(uint64_t), sizeof(block_pos_with_flags));
+        const uint64_t block_pos = split_block_start_pos_with_flags(block_pos_with_flags).first;
+        if (block_pos >= boundary - sizeof(uint64_t))
+          return false;
+        positions.push_back(block_pos_with_flags);
+        boundary = block_pos;
+
+        if (positions.size() % 65536 == 0)
+        {
+          bytes_done += reported_boundary - boundary;
+          reported_boundary = boundary;
+          if (appbase::app().is_interrupt_request())
+            return false;
+        }
+      }
+      bytes_done += reported_boundary - boundary;
+      return boundary == lower_bound;
+    }
+
   } // end namespace detail
 
   block_log::block_log() : my( new detail::block_log_impl() )
@@ -186,6 +501,7 @@ namespace hive { namespace chain {
 
   block_log::~block_log()
   {
+    my->stop_background_compression();
     if (my->block_log_fd != -1)
       ::close(my->block_log_fd);
     if (my->block_index_fd != -1)
@@ -256,6 +572,7 @@ namespace hive { namespace chain {
       {
         idump((block_log_size));
         my->head.exchange(boost::make_shared<signed_block>(read_head()));
+        my->durable_head_block_num.store(my->head.load()->block_num());
 
         if (index_size)
         {
@@ -321,6 +638,7 @@ namespace hive { namespace chain {
 
   void block_log::close()
   {
+    my->stop_background_compression();
     if (my->block_log_fd != -1) {
       ::close(my->block_log_fd);
       my->block_log_fd = -1;
@@ -330,6 +648,7 @@ namespace hive { namespace chain {
       my->block_log_fd = -1;
     }
     my->head.store(boost::shared_ptr<signed_block>());
+    my->durable_head_block_num.store(0);
   }
 
   bool block_log::is_open()const
@@ -341,23 +660,8 @@ namespace hive { namespace chain {
   {
     try
     {
-      uint64_t block_start_pos = my->block_log_size;
-      uint64_t block_start_pos_with_flags = detail::combine_block_start_pos_with_flags(block_start_pos, attributes);
-
-      // what we write to the file is the serialized data, followed by the index of the start of the
-      // serialized data.  Append that index so we can do it in a single write.
-      size_t block_size_including_start_pos = raw_block_size + sizeof(uint64_t);
-      std::unique_ptr<char[]> block_with_start_pos(new char[block_size_including_start_pos]);
-      memcpy(block_with_start_pos.get(), raw_block_data, raw_block_size);
-      *(uint64_t*)(block_with_start_pos.get() + raw_block_size) = block_start_pos_with_flags;
-
-      detail::block_log_impl::write_with_retry(my->block_log_fd, block_with_start_pos.get(), block_size_including_start_pos);
-      my->block_log_size += block_size_including_start_pos;
-
-      // add it to the index
-      detail::block_log_impl::write_with_retry(my->block_index_fd, &block_start_pos_with_flags, sizeof(block_start_pos_with_flags));
-
-      return block_start_pos;
+      FC_ASSERT(!my->background_compression_active.load(), "Raw blocks can't be appended while background compression is running");
+      return my->write_raw_block(raw_block_data, raw_block_size, attributes);
     }
     FC_LOG_AND_RETHROW()
   }
@@ -396,7 +700,12 @@ namespace hive { namespace chain {
     try
     {
       uint64_t block_start_pos;
-      std::vector<char> serialized_block = fc::raw::pack_to_vector(b);
+
+      if (my->compression_thread_count > 0)
+        return append(boost::make_shared<signed_block>(b));
+
+      // written synchronously, so the block can stay in the reused per-thread buffer
+      const fc::raw::packed_view serialized_block = fc::raw::pack_to_thread_buffer(b);
 
       if (my->compression_enabled)
       {
@@ -420,12 +729,54 @@ namespace hive { namespace chain {
       // update our cached head block
       boost::shared_ptr<signed_block> new_head = boost::make_shared<signed_block>(b);
       my->head.exchange(new_head);
+      my->durable_head_block_num.store(b.block_num());
 
       return block_start_pos;
     }
     FC_LOG_AND_RETHROW()
   }
 
+  // threading guarantees: same as `append` above
+  uint64_t block_log::append( const boost::shared_ptr<signed_block>& b )
+  {
+    try
+    {
+      if (my->compression_thread_count == 0)
+        return append(*b);
+
+      if (my->compression_threads.empty())
+        my->start_background_compression();
+      my->queue_block(b);
+      return 0;
+    }
+    FC_LOG_AND_RETHROW()
+  }
+
+  // threading guarantees:
+  // no restrictions
+  uint32_t block_log::get_durable_head_block_num() const
+  {
+    return my->durable_head_block_num.load();
+  }
+
+  // threading guarantees:
+  // no restrictions
+  bool block_log::wait_for_durable_head(uint32_t block_num, const fc::microseconds& timeout) const
+  {
+    if (my->durable_head_block_num.load() >= block_num)
+      return true;
+    if (!my->background_compression_active.load())
+      return false;
+
+    std::unique_lock<std::mutex> lock(my->pending_mutex);
+    my->pending_condition.wait_for(lock, std::chrono::microseconds(timeout.count()), [&]() {
+      return my->durable_head_block_num.load() >= block_num || my->background_write_error.valid() ||
+             std::none_of(my->pending_blocks.begin(), my->pending_blocks.end(),
+                          [&](const auto& pb) { return pb->block->block_num() <= block_num; });
+    });
+    return my->durable_head_block_num.load() >= block_num;
+  }
+
   // threading guarantees:
   // no restrictions
   void block_log::flush()
@@ -482,8 +833,9 @@ namespace hive { namespace chain {
       /// \warning ignore block 0 which is invalid, but old API also returned empty result for it (instead of assert).
       if (block_num == 0 || !head_block || block_num > head_block->block_num())
         return optional<signed_block>();
-      if (block_num == head_block->block_num())
-        return *head_block;
+      boost::shared_ptr<signed_block> block_in_memory = my->find_block_in_memory(block_num, head_block);
+      if (block_in_memory)
+        return *block_in_memory;
 
       // if we're still here, we know that it's in the block log, and the block after it is also
       // in the block log (which means we can determine its size)
@@ -506,8 +858,9 @@ namespace hive { namespace chain {
       /// \warning ignore block 0 which is invalid, but old API also returned empty result for it (instead of assert).
       if (block_num == 0 || !head_block || block_num > head_block->block_num())
         return optional<signed_block>();
-      if (block_num == head_block->block_num())
-        return *head_block;
+      boost::shared_ptr<signed_block> block_in_memory = my->find_block_in_memory(block_num, head_block);
+      if (block_in_memory)
+        return *block_in_memory;
       // if we're still here, we know that it's in the block log, and the block after it is also
       // in the block log (which means we can determine its size)
 
@@ -528,16 +881,19 @@ namespace hive { namespace chain {
 
       uint32_t last_block_num = first_block_num + count - 1;
 
-      // first, check if the last block we want is the current head block; if so, we can 
-      // will use it and then load the previous blocks from the block log
+      // first, check if the last blocks we want are the ones still held in memory (the head block and
+      // blocks waiting for background compression); if so, we will use them and then load the previous
+      // blocks from the block log
       boost::shared_ptr<signed_block> head_block = my->head.load();
       if (!head_block || first_block_num > head_block->block_num())
         return result; // the caller is asking for blocks after the head block, we don't have them
+      last_block_num = std::min(last_block_num, head_block->block_num());
 
-      // if that head block will be our last block, we want it at the end of our vector,
-      // so we'll tack it on at the bottom of this function
-      bool last_block_is_head_block = last_block_num == head_block->block_num();
-      uint32_t last_block_num_from_disk = last_block_is_head_block ? last_block_num - 1 : last_block_num;
+      // if those blocks will be our last blocks, we want them at the end of our vector,
+      // so we'll tack them on at the bottom of this function
+      std::vector<boost::shared_ptr<signed_block>> unindexed_blocks = my->get_unindexed_blocks(head_block);
+      const uint32_t first_unindexed_block_num = unindexed_blocks.front()->block_num();
+      uint32_t last_block_num_from_disk = std::min(last_block_num, first_unindexed_block_num - 1);
 
       if (first_block_num <= last_block_num_from_disk)
       {
@@ -574,13 +930,72 @@ namespace hive { namespace chain {
         }
       }
 
-      if (last_block_is_head_block)
-        result.push_back(*head_block);
+      for (const boost::shared_ptr<signed_block>& block : unindexed_blocks)
+      {
+        uint32_t block_num = block->block_num();
+        if (block_num >= first_block_num && block_num <= last_block_num)
+          result.push_back(*block);
+      }
       return result;
     }
     FC_CAPTURE_LOG_AND_RETHROW((first_block_num)(count))
   }
 
+  void block_log::for_each_block_in_range( uint32_t first_block_num, uint32_t count, const std::function<void(signed_block&&)>& processor )const
+  {
+    try
+    {
+      boost::shared_ptr<signed_block> head_block = my->head.load();
+      if (!head_block || count == 0 || first_block_num > head_block->block_num())
+        return;
+      const uint32_t last_block_num = std::min(first_block_num + count - 1, head_block->block_num());
+
+      // blocks held in memory have to be taken before reading from disk, otherwise background compression
+      // could write them out (and drop them from memory) in the meantime, leaving a gap
+      std::vector<boost::shared_ptr<signed_block>> unindexed_blocks = my->get_unindexed_blocks(head_block);
+      const uint32_t first_unindexed_block_num = unindexed_blocks.front()->block_num();
+      const uint32_t last_block_num_from_disk = std::min(last_block_num, first_unindexed_block_num - 1);
+
+      if (first_block_num <= last_block_num_from_disk)
+      {
+        // all offsets in one go (one more than blocks, since the end of a block is given by the start of the next one)
+        const uint32_t number_of_blocks_to_read = last_block_num_from_disk - first_block_num + 1;
+        std::unique_ptr<uint64_t[]> offsets_with_flags(new uint64_t[number_of_blocks_to_read + 1]);
+        detail::block_log_impl::pread_with_retry(my->block_index_fd, offsets_with_flags.get(), sizeof(uint64_t) * (number_of_blocks_to_read + 1),
+                                                 sizeof(uint64_t) * (first_block_num - 1));
+
+        std::unique_ptr<char[]> block_data;
+        size_t block_data_capacity = 0;
+        for (uint32_t i = 0; i < number_of_blocks_to_read; ++i)
+        {
+          uint64_t offset;
+          block_attributes_t attributes;
+          std::tie(offset, attributes) = detail::split_block_start_pos_with_flags(offsets_with_flags[i]);
+          const uint64_t size = detail::split_block_start_pos_with_flags(offsets_with_flags[i + 1]).first - offset - sizeof(uint64_t);
+          if (size > block_data_capacity)
+          {
+            block_data.reset(new char[size]);
+            block_data_capacity = size;
+          }
+          detail::block_log_impl::pread_with_retry(my->block_log_fd, block_data.get(), size, offset);
+
+          std::tuple<std::unique_ptr<char[]>, size_t> decompressed_raw_block = decompress_raw_block(block_data.get(), size, attributes);
+          signed_block block;
+          fc::raw::unpack_from_char_array(std::get<0>(decompressed_raw_block).get(), std::get<1>(decompressed_raw_block), block);
+          processor(std::move(block));
+        }
+      }
+
+      for (const boost::shared_ptr<signed_block>& block : unindexed_blocks)
+      {
+        uint32_t block_num = block->block_num();
+        if (block_num >= first_block_num && block_num <= last_block_num)
+          processor(signed_block(*block));
+      }
+    }
+    FC_CAPTURE_LOG_AND_RETHROW((first_block_num)(count))
+  }
+
   std::tuple<std::unique_ptr<char[]>, size_t, block_log::block_attributes_t> block_log::read_raw_head_block() const
   {
     ssize_t block_log_size = get_file_size(my->block_log_fd);
@@ -675,6 +1090,7 @@ namespace hive { namespace chain {
 
       // if we're adding entries to an existing index, copy the original index entries over
       uint32_t reindex_through_block_number = 1;
+      uint64_t reindex_through_block_pos = 0;
       if (resume)
       {
         //memory map for the old index file
@@ -684,6 +1100,8 @@ namespace hive { namespace chain {
 
         // copy all the data we're preserving from the old index
         memcpy(block_index_ptr, old_block_index_ptr, old_index_size);
+        if (old_index_block_count)
+          reindex_through_block_pos = detail::split_block_start_pos_with_flags(((const uint64_t*)old_block_index_ptr)[old_index_block_count - 1]).first;
 
         if (munmap(old_block_index_ptr, old_index_size) == -1)
           elog("error unmapping old block log index: ${error}", ("error", strerror(errno)));
@@ -693,33 +1111,132 @@ namespace hive { namespace chain {
       ::close(my->block_index_fd);
 
 
-      // now walk backwards through the block log reading the starting positions of the blocks
-      // and writing them to the index
-      uint32_t block_index = head_block_num;
-      uint64_t block_log_offset_of_block_pos = my->block_log_size - sizeof(uint64_t);
+      // The walk backwards is inherently sequential, so for a big log it is split by file offset into
+      // segments, each walked by its own thread from a start of a block found near the segment end.
+      // Chains of neighbouring segments have to meet exactly, otherwise (a start point was not a real
+      // block boundary) we fall back to a single walk through the whole log.
+      const uint32_t first_block_to_index = std::max(reindex_through_block_number, 1u);
+      const uint64_t first_block_pos = reindex_through_block_pos;
+
+      const uint64_t min_segment_size = std::max<uint64_t>(1, my->index_reconstruction_min_segment_size);
+      const uint64_t bytes_to_index = my->block_log_size - first_block_pos;
+      const uint32_t max_thread_count = my->index_reconstruction_threads ? my->index_reconstruction_threads : std::max(1u, std::thread::hardware_concurrency());
+      const uint64_t thread_count = std::min<uint64_t>(max_thread_count, bytes_to_index / min_segment_size);
 
-      while (!appbase::app().is_interrupt_request() && block_index >= reindex_through_block_number)
+      // segment i covers [segment_bounds[i], segment_bounds[i + 1])
+      std::vector<uint64_t> segment_bounds(1, first_block_pos);
+      for (uint64_t i = 1; i < thread_count; ++i)
       {
-        // read the file offset of the start of the block from the block log
-        uint64_t higher_block_pos = block_log_offset_of_block_pos;
-        //read next block pos offset from the block log
-        uint64_t block_pos_with_flags;
-        memcpy(&block_pos_with_flags, block_log_ptr + block_log_offset_of_block_pos, sizeof(block_pos_with_flags));
-
-        // write it to the right location in the new index file
-        memcpy(block_index_ptr + sizeof(block_pos_with_flags) * (block_index - 1), &block_pos_with_flags, sizeof(block_pos_with_flags));
-        uint64_t block_pos = detail::split_block_start_pos_with_flags(block_pos_with_flags).first;
-        if (higher_block_pos <= block_pos) //this is a sanity check on index values stored in the block log
-          FC_THROW("bad block index at block ${block_index} because ${higher_block_pos} <= ${block_pos}",
-                   ("block_index",block_index)("higher_block_pos",higher_block_pos)("block_pos",block_pos));
-
-        --block_index;
-        block_log_offset_of_block_pos = block_pos - sizeof(uint64_t);
-      } //while writing block index
-      if (appbase::app().is_interrupt_request())
+        const uint64_t search_end = first_block_pos + bytes_to_index / thread_count * (i + 1);
+        for (uint64_t boundary = first_block_pos + bytes_to_index / thread_count * i; boundary < search_end; ++boundary)
+          if (detail::is_plausible_block_boundary(block_log_ptr, segment_bounds.back(), boundary))
+          {
+            segment_bounds.push_back(boundary);
+            break;
+          }
+      }
+      segment_bounds.push_back(my->block_log_size);
+
+      bool parallel_walk_succeeded = false;
+      if (segment_bounds.size() > 2)
       {
-        ilog("Creating Block Log Index was interrupted on user request and can't be resumed. Last applied: (block number: ${head_block_num})", (head_block_num));
-        return;
+        const size_t segment_count = segment_bounds.size() - 1;
+        ilog("Reconstructing Block Log Index using ${segment_count} threads", (segment_count));
+        std::vector<std::vector<uint64_t>> segment_positions(segment_count);
+        std::unique_ptr<bool[]> segment_succeeded(new bool[segment_count]());
+        std::atomic<uint64_t> bytes_done(0);
+        std::atomic<size_t> segments_done(0);
+
+        std::vector<std::thread> walkers;
+        for (size_t i = 0; i < segment_count; ++i)
+          walkers.emplace_back([&, i]() {
+            segment_succeeded[i] = detail::collect_block_start_positions(block_log_ptr, segment_bounds[i], segment_bounds[i + 1],
+                                                                         segment_positions[i], bytes_done);
+            ++segments_done;
+          });
+
+        fc::time_point next_report = fc::time_point::now() + fc::seconds(10);
+        while (segments_done.load() < segment_count)
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+          if (fc::time_point::now() >= next_report)
+          {
+            ilog("Reconstructing Block Log Index: ${percent}% done", ("percent", bytes_done.load() * 100 / bytes_to_index));
+            next_report += fc::seconds(10);
+          }
+        }
+        for (std::thread& walker : walkers)
+          walker.join();
+
+        // each segment fills a contiguous range of the index, starting right after the one below it
+        uint32_t block_number = first_block_to_index;
+        size_t complete_segments = 0;
+        while (complete_segments < segment_count && segment_succeeded[complete_segments])
+        {
+          const std::vector<uint64_t>& positions = segment_positions[complete_segments];
+          if (block_number + positions.size() - 1 > head_block_num)
+            break;
+          std::reverse_copy(positions.begin(), positions.end(), (uint64_t*)block_index_ptr + (block_number - 1));
+          block_number += positions.size();
+          ++complete_segments;
+        }
+
+        if (appbase::app().is_interrupt_request())
+        {
+          // keep the part of the index that is already complete, so the next start can resume from there
+          const uint32_t indexed_block_count = block_number - 1;
+          if (munmap(block_log_ptr, my->block_log_size) == -1)
+            elog("error unmapping block_log: ${error}", ("error", strerror(errno)));
+          if (munmap(block_index_ptr, block_index_size) == -1)
+            elog("error unmapping block_index: ${error}", ("error", strerror(errno)));
+          if (ftruncate(new_index_fd, indexed_block_count * sizeof(uint64_t)) == -1)
+            FC_THROW("Error resizing rebuilt block index file: ${error}", ("error", strerror(errno)));
+          ::close(new_index_fd);
+          fc::remove_all(my->index_file);
+          fc::rename(new_index_file, my->index_file);
+          my->block_index_fd = ::open(my->index_file.generic_string().c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+          if (my->block_index_fd == -1)
+            FC_THROW("Error opening block index file ${filename}: ${error}", ("filename", my->index_file)("error", strerror(errno)));
+          ilog("Creating Block Log Index was interrupted on user request, it will resume from block ${indexed_block_count} on next start", (indexed_block_count));
+          return;
+        }
+
+        parallel_walk_succeeded = complete_segments == segment_count && block_number == head_block_num + 1;
+        if (!parallel_walk_succeeded)
+          wlog("Parallel reconstruction of Block Log Index failed to join segments, falling back to a single thread");
+      }
+
+      if (!parallel_walk_succeeded)
+      {
+        // now walk backwards through the block log reading the starting positions of the blocks
+        // and writing them to the index
+        uint32_t block_index = head_block_num;
+        uint64_t block_log_offset_of_block_pos = my->block_log_size - sizeof(uint64_t);
+
+        while (!appbase::app().is_interrupt_request() && block_index >= reindex_through_block_number)
+        {
+          // read the file offset of the start of the block from the block log
+          uint64_t higher_block_pos = block_log_offset_of_block_pos;
+          //read next block pos offset from the block log
+          uint64_t block_pos_with_flags;
+          memcpy(&block_pos_with_flags, block_log_ptr + block_log_offset_of_block_pos, sizeof(block_pos_with_flags));
+
+          // write it to the right location in the new index file
+          memcpy(block_index_ptr + sizeof(block_pos_with_flags) * (block_index - 1), &block_pos_with_flags, sizeof(block_pos_with_flags));
+          uint64_t block_pos = detail::split_block_start_pos_with_flags(block_pos_with_flags).first;
+          if (higher_block_pos <= block_pos) //this is a sanity check on index values stored in the block log
+            FC_THROW("bad block index at block ${block_index} because ${higher_block_pos} <= ${block_pos}",
+                     ("block_index",block_index)("higher_block_pos",higher_block_pos)("block_pos",block_pos));
+
+          --block_index;
+          block_log_offset_of_block_pos = block_pos - sizeof(uint64_t);
+        } //while writing block index
+        if (appbase::app().is_interrupt_request())
+        {
+          ilog("Creating Block Log Index was interrupted on user request and can't be resumed. Last applied: (block number: ${head_block_num})", (head_block_num));
+          return;
+        }
+
       }
 
       if (munmap(block_log_ptr, my->block_log_size) == -1)
@@ -753,6 +1270,18 @@ namespace hive { namespace chain {
     my->zstd_level = level;
   }
 
+  void block_log::set_compression_threads(uint32_t threads)
+  {
+    my->stop_background_compression();
+    my->compression_thread_count = threads;
+  }
+
+  void block_log::set_index_reconstruction_threads(uint32_t threads, uint64_t min_segment_size /* = 64 * 1024 * 1024 */)
+  {
+    my->index_reconstruction_threads = threads;
+    my->index_reconstruction_min_segment_size = min_segment_size;
+  }
+
   std::tuple<std::unique_ptr<char[]>, size_t> compress_block_zstd_helper(const char* uncompressed_block_data, 
                                                                          size_t uncompressed_block_size,
                                                                          fc::optional<uint8_t> dictionary_number,
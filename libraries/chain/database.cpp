@@ -34,12 +34,16 @@
 #include <hive/chain/util/sps_processor.hpp>
 #include <hive/chain/util/delayed_voting.hpp>
 
+#include <hive/utilities/performance_trace.hpp>
+
 #include <fc/smart_ref_impl.hpp>
 #include <fc/uint128.hpp>
+#include <fc/crypto/city.hpp>
 
 #include <fc/container/deque.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
 
 #include <boost/scope_exit.hpp>
 #include <boost/range/adaptor/reversed.hpp>
@@ -142,8 +146,10 @@ void database::open( const open_args& args )
     helpers::environment_extension_resources environment_extension(
                                                 appbase::app().get_version_string(),
                                                 appbase::app().get_plugins_names(),
+                                                HIVE_STATE_VERSION,
                                                 []( const std::string& message ){ wlog( message.c_str() ); }
                                               );
+    set_max_shared_file_size( args.shared_file_max_size );
     chainbase::database::open( args.shared_mem_dir, args.chainbase_flags, args.shared_file_size, args.database_cfg, &environment_extension, args.force_replay );
 
     initialize_state_independent_data(args);
@@ -179,6 +185,8 @@ void database::initialize_state_independent_data(const open_args& args)
     _block_log.open(args.data_dir / "block_log");
     _block_log.set_compression(args.enable_block_log_compression);
     _block_log.set_compression_level(args.block_log_compression_level);
+    _block_log.set_compression_threads(args.block_log_compression_threads);
+    _block_log_written_in_background = args.block_log_compression_threads > 0;
   });
 
   _shared_file_full_threshold = args.shared_file_full_threshold;
@@ -304,6 +312,33 @@ uint32_t database::reindex_internal( const open_args& args, signed_block& block
   BOOST_SCOPE_EXIT( this_ ) { this_->clear_tx_status(); } BOOST_SCOPE_EXIT_END
   set_tx_status( TX_STATUS_BLOCK );
 
+  // Between checkpoints all changes are covered by single undo session (kept in shared memory),
+  // so after crash the state is rewound to last checkpoint on open and replay can resume from there.
+  const bool use_checkpoints = args.replay_checkpoint_interval != 0 || args.replay_checkpoint_minutes != 0;
+  std::unique_ptr< chainbase::database::session > checkpoint_session;
+  uint32_t last_checkpoint_block = block.block_num() - 1;
+  fc::time_point last_checkpoint_time = fc::time_point::now();
+
+  auto start_checkpoint_session = [&]()
+  {
+    set_revision( head_block_num() );
+    checkpoint_session = std::make_unique< chainbase::database::session >( start_undo_session() );
+    _replay_checkpoint_session_active = true;
+  };
+  auto finish_checkpoint_session = [&]()
+  {
+    if( !checkpoint_session )
+      return;
+    checkpoint_session->push();
+    checkpoint_session.reset();
+    commit( revision() );
+    _replay_checkpoint_session_active = false;
+  };
+  BOOST_SCOPE_EXIT( this_ ) { this_->_replay_checkpoint_session_active = false; } BOOST_SCOPE_EXIT_END
+
+  if( use_checkpoints )
+    start_checkpoint_session();
+
   while( !appbase::app().is_interrupt_request() && block.block_num() != last_block_num )
   {
     uint32_t cur_block_num = block.block_num();
@@ -320,6 +355,21 @@ uint32_t database::reindex_internal( const open_args& args, signed_block& block
 
     apply_block( block, skip_flags );
 
+    if( use_checkpoints &&
+      ( ( args.replay_checkpoint_interval != 0 && cur_block_num - last_checkpoint_block >= args.replay_checkpoint_interval ) ||
+        ( args.replay_checkpoint_minutes != 0 && fc::time_point::now() - last_checkpoint_time >= fc::minutes( args.replay_checkpoint_minutes ) ) ) )
+    {
+      // plugins persist their external data before the state is committed, so after crash their storage can only
+      // be ahead of the state (which they have to detect on resume), never behind it
+      replay_checkpoint_notification note( head_block_num() );
+      HIVE_TRY_NOTIFY( _replay_checkpoint_signal, note );
+      finish_checkpoint_session();
+      write_replay_checkpoint( args, note );
+      start_checkpoint_session();
+      last_checkpoint_block = cur_block_num;
+      last_checkpoint_time = fc::time_point::now();
+    }
+
     if( !appbase::app().is_interrupt_request() )
     {
       optional<signed_block> next_block = _block_log.read_block_by_num(cur_block_num + 1);
@@ -341,9 +391,62 @@ uint32_t database::reindex_internal( const open_args& args, signed_block& block
     apply_block( block, skip_flags );
   }
 
+  finish_checkpoint_session();
+
   return block.block_num();
 }
 
+namespace {
+  fc::path replay_checkpoint_path( const open_args& args )
+  {
+    return args.shared_mem_dir / "replay_checkpoint.json";
+  }
+}
+
+void database::write_replay_checkpoint( const open_args& args, const replay_checkpoint_notification& note )
+{
+  chainbase::database::flush();
+
+  fc::mutable_variant_object record;
+  record[ "block_num" ] = head_block_num();
+  record[ "block_id" ] = head_block_id();
+  record[ "revision" ] = revision();
+  record[ "state_checksum" ] = fc::sha256::hash( fc::raw::pack_to_vector( get_dynamic_global_properties() ) );
+  record[ "created" ] = fc::time_point::now();
+  record[ "plugin_positions" ] = note.plugin_positions;
+
+  // write and rename, so the record is never seen partially written
+  const auto path = replay_checkpoint_path( args );
+  fc::path tmp_path = path;
+  tmp_path.replace_extension( ".tmp" );
+  fc::json::save_to_file( fc::variant( record ), tmp_path );
+  fc::rename( tmp_path, path );
+
+  ilog( "Replay checkpoint saved at block ${b}", ( "b", head_block_num() ) );
+}
+
+void database::verify_replay_checkpoint( const open_args& args ) const
+{
+  const auto path = replay_checkpoint_path( args );
+  if( !fc::exists( path ) )
+    return;
+
+  const auto record = fc::json::from_file( path ).get_object();
+  const uint32_t block_num = record[ "block_num" ].as< uint32_t >();
+  if( block_num != head_block_num() )
+  {
+    // state was saved later, e.g. by regular interruption of replay
+    ilog( "Replay checkpoint at block ${b} is older than state at block ${h}", ( "b", block_num )( "h", head_block_num() ) );
+    return;
+  }
+
+  FC_ASSERT( record[ "block_id" ].as< block_id_type >() == head_block_id() &&
+    record[ "state_checksum" ].as< fc::sha256 >() == fc::sha256::hash( fc::raw::pack_to_vector( get_dynamic_global_properties() ) ),
+    "State does not match replay checkpoint at block ${b}, replay has to be forced", ( "b", block_num ) );
+
+  ilog( "Resuming replay from checkpoint at block ${b}, plugin positions: ${p}", ( "b", block_num )( "p", record[ "plugin_positions" ] ) );
+}
+
 bool database::is_reindex_complete( uint64_t* head_block_num_origin, uint64_t* head_block_num_state ) const
 {
   boost::shared_ptr<signed_block> _head = _block_log.head();
@@ -432,7 +535,10 @@ uint32_t database::reindex( const open_args& args )
       {
         auto _last_block_number = start_block->block_num();
         if( _last_block_number && !args.force_replay )
+        {
           ilog("Resume of replaying. Last applied block: ${n}", ( "n", _last_block_number - 1 ) );
+          verify_replay_checkpoint( args );
+        }
 
         note.last_block_number = reindex_internal( args, *start_block );
       }
@@ -446,6 +552,9 @@ uint32_t database::reindex( const open_args& args )
       //get_index< account_index >().indices().print_stats();
     });
 
+    if( note.last_block_number == note.max_block_number )
+      fc::remove_all( args.shared_mem_dir / "replay_checkpoint.json" );
+
     if ( _block_log.head()->block_num() )
       _fork_db.start_block( *_block_log.head() );
 
@@ -487,6 +596,23 @@ void database::close(bool rewind)
     // DB state (issue #336).
     clear_pending();
 
+    if( get_is_open() && _block_log_written_in_background && !_replay_checkpoint_session_active &&
+        !( get_node_properties().skip_flags & skip_block_log ) )
+    {
+      // blocks queued for background writing are written out now, so the state can catch up with them
+      // and won't need to apply them again after restart
+      with_write_lock( [&]()
+      {
+        uint32_t new_last_irreversible = update_last_irreversible_block();
+        if( new_last_irreversible > get_last_irreversible_block_num() &&
+            _block_log.wait_for_durable_head( new_last_irreversible, fc::seconds( 60 ) ) )
+        {
+          set_last_irreversible_block_num( new_last_irreversible );
+          commit( new_last_irreversible );
+        }
+      } );
+    }
+
     chainbase::database::flush();
 
     auto lib = this->get_last_irreversible_block_num();
@@ -504,6 +630,12 @@ void database::close(bool rewind)
   FC_CAPTURE_AND_RETHROW()
 }
 
+//no chainbase lock required
+uint32_t database::get_durable_block_log_head_num()const
+{
+  return _block_log.get_durable_head_block_num();
+}
+
 //no chainbase lock required
 bool database::is_known_block(const block_id_type& id)const
 { try {
@@ -633,15 +765,15 @@ std::vector<signed_block> database::fetch_block_range( const uint32_t starting_b
   FC_ASSERT(count <= 1000, "You can only ask for 1000 blocks at a time");
   idump((starting_block_num)(count));
 
-  vector<fork_item> fork_items = _fork_db.fetch_block_range_on_main_branch_by_number( starting_block_num, count, wait_for_microseconds );
+  vector<item_ptr> fork_items = _fork_db.fetch_block_range_on_main_branch_by_number( starting_block_num, count, wait_for_microseconds );
   idump((fork_items.size()));
   if (!fork_items.empty())
-    idump((fork_items.front().num));
+    idump((fork_items.front()->num));
 
   // if the fork database returns some blocks, it means:
   // - that the last block in the range [starting_block_num, starting_block_num + count - 1]
   // - any block before the first block it returned should be in the block log
-  uint32_t remaining_count = fork_items.empty() ? count : fork_items.front().num - starting_block_num;
+  uint32_t remaining_count = fork_items.empty() ? count : fork_items.front()->num - starting_block_num;
   idump((remaining_count));
   vector<signed_block> result;
 
@@ -652,12 +784,41 @@ std::vector<signed_block> database::fetch_block_range( const uint32_t starting_b
   if (!result.empty())
     idump((result.front().block_num())(result.back().block_num()));
   result.reserve(result.size() + fork_items.size());
-  for (fork_item& item : fork_items)
-    result.push_back(std::move(item.data));
+  for (const item_ptr& item : fork_items)
+    result.push_back(item->data);
 
   return result;
 } FC_LOG_AND_RETHROW() }
 
+void database::for_each_block_in_range( const uint32_t starting_block_num, const uint32_t count,
+                                        const std::function< void( const signed_block&, const block_id_type& ) >& processor,
+                                        fc::microseconds wait_for_microseconds )
+{ try {
+  FC_ASSERT(starting_block_num > 0, "Invalid starting block number");
+  FC_ASSERT(count > 0, "Why ask for zero blocks?");
+  FC_ASSERT(count <= 1000, "You can only ask for 1000 blocks at a time");
+
+  // see fetch_block_range
+  vector<item_ptr> fork_items = _fork_db.fetch_block_range_on_main_branch_by_number( starting_block_num, count, wait_for_microseconds );
+  uint32_t remaining_count = fork_items.empty() ? count : fork_items.front()->num - starting_block_num;
+
+  // id of a block from block log is taken from the next block (its previous), so each block is
+  // passed on only when the next one is read; fork database items already know their ids
+  optional<signed_block> waiting_block;
+  if (remaining_count)
+    _block_log.for_each_block_in_range(starting_block_num, remaining_count, [&](signed_block&& block) {
+      if (waiting_block)
+        processor(*waiting_block, block.previous);
+      waiting_block = std::move(block);
+    });
+
+  if (waiting_block)
+    processor(*waiting_block, fork_items.empty() ? waiting_block->id() : fork_items.front()->data.previous);
+
+  for (const item_ptr& item : fork_items)
+    processor(item->data, item->id);
+} FC_LOG_AND_RETHROW() }
+
 const signed_transaction database::get_recent_transaction( const transaction_id_type& trx_id ) const
 { try {
   const auto& index = get_index<transaction_index>().indices().get<by_trx_id>();
@@ -1113,11 +1274,14 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
   bool result;
   detail::with_skip_flags( *this, skip, [&]()
   {
-    detail::without_pending_transactions( *this, std::move(_pending_tx), [&]()
+    const signed_block* applied_block = nullptr;
+    detail::without_pending_transactions( *this, std::move(_pending_tx), applied_block, [&]()
     {
       try
       {
         result = _push_block(new_block);
+        if( !result && head_block_id() == new_block.id() )
+          applied_block = &new_block;
       }
       FC_CAPTURE_AND_RETHROW( (new_block) )
 
@@ -1279,6 +1443,9 @@ void database::push_transaction( const signed_transaction_transporter& trx, uint
     FC_ASSERT( trx_size <= trx_size_limit, "Transaction too large - size = ${s}, limit ${l}",
       ( "s", trx_size )( "l", trx_size_limit ) );
 
+    if( !_postponed_tx.empty() )
+      apply_postponed_dependencies( trx.trx );
+
     detail::with_skip_flags( *this, skip, [&]()
     {
       BOOST_SCOPE_EXIT( this_ ) { this_->clear_tx_status(); } BOOST_SCOPE_EXIT_END
@@ -1305,6 +1472,17 @@ void database::_push_transaction( const signed_transaction_transporter& trx )
   _apply_transaction( trx );
   _pending_tx.push_back( trx );
 
+  if( is_validating_one_tx() )
+  {
+    ++_pending_tx_validated_tail;
+    _pending_tx_validated_skip |= get_node_properties().skip_flags;
+  }
+  else
+  {
+    // reapplied with less checks (see pending_transactions_restorer)
+    _pending_tx_validated_tail = 0;
+  }
+
   notify_changed_objects();
   // The transaction applied successfully. Merge its changes into the pending block session.
   temp_session.squash();
@@ -1319,6 +1497,11 @@ void database::pop_block()
   try
   {
     _pending_tx_session.reset();
+    if( !_pending_tx.empty() )
+    {
+      _pending_tx_validated_tail = 0;
+      _pending_tx_validated_skip = ~0u;
+    }
     auto head_id = head_block_id();
 
     /// save the head block so we can recover its transactions
@@ -1341,11 +1524,152 @@ void database::clear_pending()
   {
     assert( _pending_tx.empty() || _pending_tx_session.valid() );
     _pending_tx.clear();
+    _postponed_tx.clear();
+    _postponed_tx_accounts.clear();
+    _pending_tx_validated_tail = 0;
+    _pending_tx_validated_skip = 0;
     _pending_tx_session.reset();
   }
   FC_CAPTURE_AND_RETHROW()
 }
 
+size_t database::apply_postponed_transactions( const fc::microseconds& time_limit )
+{
+  if( _postponed_tx.empty() )
+    return 0;
+
+  const auto start = fc::time_point::now();
+  const auto head_block_time = this->head_block_time();
+  uint32_t applied_txs = 0;
+  uint32_t expired_txs = 0;
+
+  // same conditions as when pending transactions are reapplied after block (see pending_transactions_restorer)
+  uint32_t skip = node_properties().skip_flags | skip_validate | skip_transaction_signatures;
+  detail::with_skip_flags( *this, skip, [&]()
+  {
+    BOOST_SCOPE_EXIT( this_ ) { this_->clear_tx_status(); } BOOST_SCOPE_EXIT_END
+    set_tx_status( TX_STATUS_PENDING );
+
+    while( !_postponed_tx.empty() && fc::time_point::now() - start < time_limit )
+    {
+      signed_transaction_transporter tx = std::move( _postponed_tx.front() );
+      _postponed_tx.pop_front();
+      release_postponed_accounts( tx.trx );
+
+      if( tx.trx.expiration < head_block_time )
+        ++expired_txs;
+      else if( reapply_postponed_transaction( tx ) )
+        ++applied_txs;
+    }
+  } );
+
+  dlog( "Applied ${a} postponed transactions, ${e} expired, ${r} remain.",
+    ( "a", applied_txs )( "e", expired_txs )( "r", _postponed_tx.size() ) );
+  return _postponed_tx.size();
+}
+
+void database::postpone_transaction( signed_transaction_transporter&& trx, const flat_set< account_name_type >* impacted_accounts )
+{
+  flat_set< account_name_type > accounts;
+  if( impacted_accounts == nullptr )
+  {
+    hive::app::transaction_get_impacted_accounts( trx.trx, accounts );
+    impacted_accounts = &accounts;
+  }
+  for( const auto& account : *impacted_accounts )
+    ++_postponed_tx_accounts[ account ];
+  _postponed_tx.emplace_back( std::move( trx ) );
+}
+
+void database::release_postponed_accounts( const signed_transaction& trx )
+{
+  flat_set< account_name_type > accounts;
+  hive::app::transaction_get_impacted_accounts( trx, accounts );
+  for( const auto& account : accounts )
+  {
+    auto itr = _postponed_tx_accounts.find( account );
+    if( itr != _postponed_tx_accounts.end() && --( itr->second ) == 0 )
+      _postponed_tx_accounts.erase( itr );
+  }
+}
+
+bool database::reapply_postponed_transaction( const signed_transaction_transporter& trx )
+{
+  if( is_known_transaction( trx.trx.id() ) )
+    return false;
+
+  try
+  {
+    _push_transaction( trx );
+    return true;
+  }
+  catch( const fc::exception& e )
+  {
+    dlog( "Postponed transaction became invalid: ${e}", ( "e", e.to_detail_string() ) );
+    return false;
+  }
+}
+
+void database::apply_postponed_dependencies( const signed_transaction& trx )
+{
+  flat_set< account_name_type > needed;
+  hive::app::transaction_get_impacted_accounts( trx, needed );
+  auto is_needed = [&]( const flat_set< account_name_type >& accounts )
+  {
+    return std::any_of( accounts.begin(), accounts.end(),
+      [&]( const account_name_type& a ) { return needed.count( a ) != 0; } );
+  };
+  if( std::none_of( needed.begin(), needed.end(),
+    [&]( const account_name_type& a ) { return _postponed_tx_accounts.count( a ) != 0; } ) )
+    return; // common case - new transaction is unrelated to postponed ones
+
+  // going from the newest postponed transaction, select those sharing accounts with new transaction or with
+  // transactions already selected; unselected ones are independent of selected ones that follow them, so
+  // they can stay postponed
+  std::vector< bool > selected( _postponed_tx.size(), false );
+  flat_set< account_name_type > accounts;
+  for( size_t i = _postponed_tx.size(); i-- > 0; )
+  {
+    accounts.clear();
+    hive::app::transaction_get_impacted_accounts( _postponed_tx[i].trx, accounts );
+    if( is_needed( accounts ) )
+    {
+      selected[i] = true;
+      needed.insert( accounts.begin(), accounts.end() );
+    }
+  }
+
+  const auto head_block_time = this->head_block_time();
+  uint32_t applied_txs = 0;
+  std::deque< signed_transaction_transporter > remaining;
+  uint32_t skip = node_properties().skip_flags | skip_validate | skip_transaction_signatures;
+  detail::with_skip_flags( *this, skip, [&]()
+  {
+    BOOST_SCOPE_EXIT( this_ ) { this_->clear_tx_status(); } BOOST_SCOPE_EXIT_END
+    set_tx_status( TX_STATUS_PENDING );
+
+    for( size_t i = 0; i < _postponed_tx.size(); ++i )
+    {
+      if( !selected[i] )
+      {
+        remaining.emplace_back( std::move( _postponed_tx[i] ) );
+        continue;
+      }
+      release_postponed_accounts( _postponed_tx[i].trx );
+      if( _postponed_tx[i].trx.expiration >= head_block_time && reapply_postponed_transaction( _postponed_tx[i] ) )
+        ++applied_txs;
+    }
+  } );
+  _postponed_tx = std::move( remaining );
+
+  dlog( "Applied ${a} postponed transactions before new one, ${r} remain.", ( "a", applied_txs )( "r", _postponed_tx.size() ) );
+}
+
+void database::set_pending_tx_deferral_threshold( size_t threshold )
+{
+  _pending_tx_deferral_threshold = threshold;
+}
+
 void database::push_virtual_operation( const operation& op )
 {
   FC_ASSERT( is_virtual_operation( op ) );
@@ -2821,17 +3145,6 @@ void database::process_vesting_withdrawals()
   */
 share_type database::pay_curators( const comment_object& comment, const comment_cashout_object& comment_cashout, share_type& max_rewards )
 {
-  struct cmp
-  {
-    bool operator()( const comment_vote_object* obj, const comment_vote_object* obj2 ) const
-    {
-      if( obj->get_weight() == obj2->get_weight() )
-        return obj->get_voter() < obj2->get_voter();
-      else
-        return obj->get_weight() > obj2->get_weight();
-    }
-  };
-
   try
   {
     share_type unclaimed_rewards = max_rewards;
@@ -2845,27 +3158,42 @@ share_type database::pay_curators( const comment_object& comment, const comment_
     {
       uint128_t total_weight( comment_cashout.get_total_vote_weight() );
 
+      // votes are collected into buffer reused by all cashouts (popular comments have thousands of them);
+      // sort keys are copied next to the pointer so sorting does not touch the objects
+      auto& votes = _curation_votes_buffer;
+      votes.clear();
+
       const auto& cvidx = get_index<comment_vote_index, by_comment_voter>();
       auto itr = cvidx.lower_bound( comment.get_id() );
-
-      std::set< const comment_vote_object*, cmp > proxy_set;
       while( itr != cvidx.end() && itr->get_comment() == comment.get_id() )
       {
-        proxy_set.insert( &( *itr ) );
+        votes.push_back( { itr->get_weight(), itr->get_voter(), &( *itr ) } );
         ++itr;
       }
 
+      // highest weight first, ties by voter - the order curators were always paid in (each payment
+      // moves vesting share price, so the order is part of consensus)
+      std::sort( votes.begin(), votes.end(), []( const curation_vote& a, const curation_vote& b )
+      {
+        if( a.weight == b.weight )
+          return a.voter < b.voter;
+        else
+          return a.weight > b.weight;
+      } );
+
       const auto& comment_author_name = get_account( comment_cashout.get_author_id() ).name;
-      for( auto& item : proxy_set )
+      const std::string permlink = to_string( comment_cashout.get_permlink() );
+      const bool payout_must_be_claimed = has_hardfork( HIVE_HARDFORK_0_17__659 );
+      for( const auto& item : votes )
       { try {
-        uint128_t weight( item->get_weight() );
+        uint128_t weight( item.weight );
         auto claim = ( ( max_rewards.value * weight ) / total_weight ).to_uint64();
         if( claim > 0 ) // min_amt is non-zero satoshis
         {
           unclaimed_rewards -= claim;
-          const auto& voter = get( item->get_voter() );
-          operation vop = curation_reward_operation( voter.name, asset(0, VESTS_SYMBOL), comment_author_name, to_string( comment_cashout.get_permlink() ), has_hardfork( HIVE_HARDFORK_0_17__659 ) );
-          create_vesting2( *this, voter, asset( claim, HIVE_SYMBOL ), has_hardfork( HIVE_HARDFORK_0_17__659 ),
+          const auto& voter = get( item.voter );
+          operation vop = curation_reward_operation( voter.name, asset(0, VESTS_SYMBOL), comment_author_name, permlink, payout_must_be_claimed );
+          create_vesting2( *this, voter, asset( claim, HIVE_SYMBOL ), payout_must_be_claimed,
             [&]( const asset& reward )
             {
               vop.get< curation_reward_operation >().reward = reward;
@@ -2878,7 +3206,7 @@ share_type database::pay_curators( const comment_object& comment, const comment_
             });
           post_push_virtual_operation( vop );
         }
-      } FC_CAPTURE_AND_RETHROW( (*item) ) }
+      } FC_CAPTURE_AND_RETHROW( (*item.vote) ) }
     }
     max_rewards -= unclaimed_rewards;
 
@@ -3862,9 +4190,12 @@ void database::initialize_evaluators()
 void database::register_custom_operation_interpreter( std::shared_ptr< custom_operation_interpreter > interpreter )
 {
   FC_ASSERT( interpreter );
-  bool inserted = _custom_operation_interpreters.emplace( interpreter->get_custom_id(), interpreter ).second;
+  const custom_id_type id = interpreter->get_custom_id();
+  bool inserted = _custom_operation_interpreters.emplace( id, interpreter ).second;
   // This assert triggering means we're mis-configured (multiple registrations of custom JSON evaluator for same ID)
   FC_ASSERT( inserted );
+  _custom_operation_interpreter_lookup.emplace( id, interpreter.get() );
+  _custom_operation_id_filter |= uint64_t( 1 ) << ( custom_id_hash()( id ) % 64 );
 }
 
 std::shared_ptr< custom_operation_interpreter > database::get_custom_json_evaluator( const custom_id_type& id )
@@ -3875,6 +4206,21 @@ std::shared_ptr< custom_operation_interpreter > database::get_custom_json_evalua
   return std::shared_ptr< custom_operation_interpreter >();
 }
 
+size_t database::custom_id_hash::operator()( const custom_id_type& id )const
+{
+  // fixed_string storage is zero padded, so equal ids have equal bytes
+  return fc::city_hash_size_t( (const char*)&id, sizeof( id ) );
+}
+
+custom_operation_interpreter* database::find_custom_json_evaluator( const custom_id_type& id )const
+{
+  const size_t hash = custom_id_hash()( id );
+  if( ( _custom_operation_id_filter & ( uint64_t( 1 ) << ( hash % 64 ) ) ) == 0 )
+    return nullptr;
+  auto it = _custom_operation_interpreter_lookup.find( id );
+  return it != _custom_operation_interpreter_lookup.end() ? it->second : nullptr;
+}
+
 void initialize_core_indexes( database& db );
 
 void database::initialize_indexes()
@@ -4204,7 +4550,8 @@ void database::check_free_memory( bool force_print, uint32_t current_block_num )
     resize( new_max );
 
     uint32_t free_mb = uint32_t( get_free_memory() / (1024*1024) );
-    wlog( "Free memory is now ${free}M", ("free", free_mb) );
+    wlog( "Free memory is now ${free}M, address space reserved for shared memory: ${reserved}M",
+      ("free", free_mb)("reserved", get_reserved_memory() / (1024*1024)) );
     _last_free_gb_printed = free_mb / 1024;
   }
   else
@@ -4232,9 +4579,10 @@ void database::check_free_memory( bool force_print, uint32_t current_block_num )
 void database::_apply_block( const signed_block& next_block )
 {
   block_notification note( next_block );
+  HIVE_TRACE_SCOPE( "block", "apply_block", note.block_num );
 
   try {
-  notify_pre_apply_block( note );
+  HIVE_TRACE_CALL( "block", notify_pre_apply_block( note ) );
 
   const uint32_t next_block_num = note.block_num;
 
@@ -4292,6 +4640,7 @@ void database::_apply_block( const signed_block& next_block )
   {
     if( _benchmark_dumper.is_enabled() )
       _benchmark_dumper.begin();
+    HIVE_TRACE_SCOPE( "block", "merkle check" );
 
     auto merkle_root = next_block.calculate_merkle_root();
 
@@ -4349,7 +4698,16 @@ void database::_apply_block( const signed_block& next_block )
     );
   }
 
-  for( const auto& trx : next_block.transactions )
+  if( !( skip & ( skip_transaction_signatures | skip_authority_check ) ) )
+  {
+    // keys of transactions seen before are already in the cache, the rest is recovered here in parallel
+    HIVE_TRACE_SCOPE( "block", "recover signature keys" );
+    _signature_key_cache.prefetch( next_block.transactions, get_chain_id(),
+      has_hardfork( HIVE_HARDFORK_0_20__1944 ) ? fc::ecc::bip_0062 : fc::ecc::fc_canonical );
+  }
+
+  const auto trx_ids = next_block.calculate_transaction_ids();
+  for( size_t i = 0; i < next_block.transactions.size(); ++i )
   {
     /* We do not need to push the undo state for each transaction
       * because they either all apply and are valid or the
@@ -4357,66 +4715,68 @@ void database::_apply_block( const signed_block& next_block )
       * for transactions when validating broadcast transactions or
       * when building a block.
       */
-    apply_transaction( trx, skip );
+    HIVE_TRACE_SCOPE( "transaction", "apply_transaction", _current_trx_in_block );
+    detail::with_skip_flags( *this, skip, [&]() { _apply_transaction( next_block.transactions[i], trx_ids[i] ); } );
     ++_current_trx_in_block;
   }
 
   _current_trx_in_block = -1;
   _current_op_in_trx = 0;
 
-  update_global_dynamic_data(next_block);
-  update_signing_witness(signing_witness, next_block);
+  HIVE_TRACE_CALL( "block", update_global_dynamic_data(next_block) );
+  HIVE_TRACE_CALL( "block", update_signing_witness(signing_witness, next_block) );
 
-  uint32_t old_last_irreversible = update_last_irreversible_block();
+  uint32_t old_last_irreversible = get_last_irreversible_block_num();
+  uint32_t new_last_irreversible = update_last_irreversible_block();
 
-  create_block_summary(next_block);
-  clear_expired_transactions();
-  clear_expired_orders();
-  clear_expired_delegations();
+  HIVE_TRACE_CALL( "block", create_block_summary(next_block) );
+  HIVE_TRACE_CALL( "block", clear_expired_transactions() );
+  HIVE_TRACE_CALL( "block", clear_expired_orders() );
+  HIVE_TRACE_CALL( "block", clear_expired_delegations() );
 
-  update_witness_schedule(*this);
+  HIVE_TRACE_CALL( "block", update_witness_schedule(*this) );
 
-  update_median_feed();
-  update_virtual_supply(); //accommodate potentially new price
+  HIVE_TRACE_CALL( "block", update_median_feed() );
+  HIVE_TRACE_CALL( "block", update_virtual_supply() ); //accommodate potentially new price
 
-  clear_null_account_balance();
-  consolidate_treasury_balance();
-  process_funds();
-  process_conversions();
-  process_comment_cashout();
-  process_vesting_withdrawals();
-  process_savings_withdraws();
-  process_subsidized_accounts();
-  pay_liquidity_reward();
-  update_virtual_supply(); //cover changes in HBD supply from above processes
+  HIVE_TRACE_CALL( "block", clear_null_account_balance() );
+  HIVE_TRACE_CALL( "block", consolidate_treasury_balance() );
+  HIVE_TRACE_CALL( "block", process_funds() );
+  HIVE_TRACE_CALL( "block", process_conversions() );
+  HIVE_TRACE_CALL( "block", process_comment_cashout() );
+  HIVE_TRACE_CALL( "block", process_vesting_withdrawals() );
+  HIVE_TRACE_CALL( "block", process_savings_withdraws() );
+  HIVE_TRACE_CALL( "block", process_subsidized_accounts() );
+  HIVE_TRACE_CALL( "block", pay_liquidity_reward() );
+  HIVE_TRACE_CALL( "block", update_virtual_supply() ); //cover changes in HBD supply from above processes
 
-  account_recovery_processing();
-  expire_escrow_ratification();
-  process_decline_voting_rights();
-  process_proposals( note ); //new HBD converted here does not count towards limit
-  process_delayed_voting( note );
-  remove_expired_governance_votes();
+  HIVE_TRACE_CALL( "block", account_recovery_processing() );
+  HIVE_TRACE_CALL( "block", expire_escrow_ratification() );
+  HIVE_TRACE_CALL( "block", process_decline_voting_rights() );
+  HIVE_TRACE_CALL( "block", process_proposals( note ) ); //new HBD converted here does not count towards limit
+  HIVE_TRACE_CALL( "block", process_delayed_voting( note ) );
+  HIVE_TRACE_CALL( "block", remove_expired_governance_votes() );
 
-  process_recurrent_transfers();
+  HIVE_TRACE_CALL( "block", process_recurrent_transfers() );
 
-  generate_required_actions();
-  generate_optional_actions();
+  HIVE_TRACE_CALL( "block", generate_required_actions() );
+  HIVE_TRACE_CALL( "block", generate_optional_actions() );
 
-  process_required_actions( req_actions );
-  process_optional_actions( opt_actions );
+  HIVE_TRACE_CALL( "block", process_required_actions( req_actions ) );
+  HIVE_TRACE_CALL( "block", process_optional_actions( opt_actions ) );
 
-  process_hardforks();
+  HIVE_TRACE_CALL( "block", process_hardforks() );
 
   // notify observers that the block has been applied
-  notify_post_apply_block( note );
+  HIVE_TRACE_CALL( "block", notify_post_apply_block( note ) );
 
-  notify_changed_objects();
+  HIVE_TRACE_CALL( "block", notify_changed_objects() );
 
   // This moves newly irreversible blocks from the fork db to the block log
   // and commits irreversible state to the database. This should always be the
   // last call of applying a block because it is the only thing that is not
   // reversible.
-  migrate_irreversible_state(old_last_irreversible);
+  HIVE_TRACE_CALL( "block", migrate_irreversible_state(old_last_irreversible, new_last_irreversible) );
 
 } FC_CAPTURE_CALL_LOG_AND_RETHROW( std::bind( &database::notify_fail_apply_block, this, note ), (next_block.block_num()) ) }
 
@@ -4653,6 +5013,11 @@ void database::apply_transaction(const signed_transaction_transporter& trx, uint
 }
 
 void database::_apply_transaction(const signed_transaction_transporter& trx)
+{
+  _apply_transaction( trx, trx.trx.id() );
+}
+
+void database::_apply_transaction(const signed_transaction_transporter& trx, const transaction_id_type& known_trx_id)
 { try {
   if( _current_tx_status == TX_STATUS_NONE )
   {
@@ -4660,7 +5025,7 @@ void database::_apply_transaction(const signed_transaction_transporter& trx)
     // make sure to call set_tx_status() with proper status when your call can lead here
   }
 
-  transaction_notification note(trx.trx);
+  transaction_notification note( trx.trx, known_trx_id );
   _current_trx_id = note.transaction_id;
   const transaction_id_type& trx_id = note.transaction_id;
 
@@ -4739,12 +5104,12 @@ void database::_apply_transaction(const signed_transaction_transporter& trx)
         _benchmark_dumper.begin();
 
       const chain_id_type& chain_id = get_chain_id();
-      trx.trx.verify_authority( chain_id, get_active, get_owner, get_posting,
-        trx.get_pack(),
+      auto signature_keys = _signature_key_cache.get_signature_keys( trx, chain_id,
+        has_hardfork( HIVE_HARDFORK_0_20__1944 ) ? fc::ecc::bip_0062 : fc::ecc::fc_canonical );
+      trx.trx.verify_authority( signature_keys, get_active, get_owner, get_posting,
         HIVE_MAX_SIG_CHECK_DEPTH,
         has_hardfork( HIVE_HARDFORK_0_20 ) ? HIVE_MAX_AUTHORITY_MEMBERSHIP : 0,
-        has_hardfork( HIVE_HARDFORK_0_20 ) ? HIVE_MAX_SIG_CHECK_ACCOUNTS : 0,
-        has_hardfork( HIVE_HARDFORK_0_20__1944 ) ? fc::ecc::bip_0062 : fc::ecc::fc_canonical );
+        has_hardfork( HIVE_HARDFORK_0_20 ) ? HIVE_MAX_SIG_CHECK_ACCOUNTS : 0 );
 
       if( _benchmark_dumper.is_enabled() )
         _benchmark_dumper.end( "transaction", "verify_authority", trx.trx.signatures.size() );
@@ -5133,6 +5498,12 @@ boost::signals2::connection database::add_post_reindex_handler(const reindex_han
   return connect_impl<false>(_post_reindex_signal, func, plugin, group, "reindex");
 }
 
+boost::signals2::connection database::add_replay_checkpoint_handler(const replay_checkpoint_handler_t& func,
+  const abstract_plugin& plugin, int32_t group )
+{
+  return connect_impl<false>(_replay_checkpoint_signal, func, plugin, group, "replay_checkpoint");
+}
+
 boost::signals2::connection database::add_generate_optional_actions_handler(const generate_optional_actions_handler_t& func,
   const abstract_plugin& plugin, int32_t group )
 {
@@ -5321,7 +5692,7 @@ void database::update_signing_witness(const witness_object& signing_witness, con
 
 uint32_t database::update_last_irreversible_block()
 { try {
-  uint32_t old_last_irreversible = get_last_irreversible_block_num();
+  uint32_t new_last_irreversible_block_num = get_last_irreversible_block_num();
 
   /**
     * Prior to voting taking over, we must be more conservative...
@@ -5329,12 +5700,8 @@ uint32_t database::update_last_irreversible_block()
     */
   if( head_block_num() < HIVE_START_MINER_VOTING_BLOCK )
   {
-    if ( head_block_num() > HIVE_MAX_WITNESSES ) {
-      uint32_t new_last_irreversible_block_num = head_block_num() - HIVE_MAX_WITNESSES;
-
-      if( new_last_irreversible_block_num > get_last_irreversible_block_num() )
-        set_last_irreversible_block_num(new_last_irreversible_block_num);
-    }
+    if ( head_block_num() > HIVE_MAX_WITNESSES )
+      new_last_irreversible_block_num = std::max( new_last_irreversible_block_num, head_block_num() - HIVE_MAX_WITNESSES );
   }
   else
   {
@@ -5359,18 +5726,19 @@ uint32_t database::update_last_irreversible_block()
         return a->last_confirmed_block_num < b->last_confirmed_block_num;
       } );
 
-    uint32_t new_last_irreversible_block_num = wit_objs[offset]->last_confirmed_block_num;
-
-    if( new_last_irreversible_block_num > get_last_irreversible_block_num() )
-    {
-      //ilog("Last irreversible block changed to ${b}. Got from witness: ${w}", ("b", new_last_irreversible_block_num)("w", wit_objs[offset]->owner));
-      set_last_irreversible_block_num(new_last_irreversible_block_num);
-    }
+    //ilog("Last irreversible block changed to ${b}. Got from witness: ${w}", ("b", wit_objs[offset]->last_confirmed_block_num)("w", wit_objs[offset]->owner));
+    new_last_irreversible_block_num = std::max< uint32_t >( new_last_irreversible_block_num, wit_objs[offset]->last_confirmed_block_num );
   }
-  return old_last_irreversible;
+
+  // when irreversible blocks are written to the block log in background, the state must not get ahead of the
+  // blocks that are already in the file, see migrate_irreversible_state
+  if( new_last_irreversible_block_num > get_last_irreversible_block_num() &&
+      ( !_block_log_written_in_background || ( get_node_properties().skip_flags & skip_block_log ) ) )
+    set_last_irreversible_block_num(new_last_irreversible_block_num);
+  return new_last_irreversible_block_num;
 } FC_CAPTURE_AND_RETHROW() }
 
-void database::migrate_irreversible_state(uint32_t old_last_irreversible)
+void database::migrate_irreversible_state(uint32_t old_last_irreversible, uint32_t new_last_irreversible)
 {
   // This method should happen atomically. We cannot prevent unclean shutdown in the middle
   // of the call, but all side effects happen at the end to minize the chance that state
@@ -5395,11 +5763,11 @@ void database::migrate_irreversible_state(uint32_t old_last_irreversible)
       if( tmp_head )
         log_head_num = tmp_head->block_num();
 
-      if( log_head_num < get_last_irreversible_block_num() )
+      if( log_head_num < new_last_irreversible )
       {
         // Check for all blocks that we want to write out to the block log but don't write any
         // unless we are certain they all exist in the fork db
-        while( log_head_num < get_last_irreversible_block_num() )
+        while( log_head_num < new_last_irreversible )
         {
           item_ptr block_ptr = _fork_db.fetch_block_on_main_branch_by_number( log_head_num+1 );
           FC_ASSERT( block_ptr, "Current fork in the fork database does not contain the last_irreversible_block" );
@@ -5409,19 +5777,31 @@ void database::migrate_irreversible_state(uint32_t old_last_irreversible)
 
         for( auto block_itr = blocks_to_write.begin(); block_itr != blocks_to_write.end(); ++block_itr )
         {
-          _block_log.append( block_itr->get()->data );
+          // fork item is kept alive until block log is done with the block, so it does not need to be copied;
+          // with background threads serialization, compression and writing are all done outside of write lock
+          const item_ptr& item = *block_itr;
+          _block_log.append( boost::shared_ptr< signed_block >( &item->data, [ item ]( signed_block* ) {} ) );
         }
 
         _block_log.flush();
       }
+
+      // Blocks queued for background writing would be lost if the node was killed now, so the state
+      // (its last irreversible block and committed revision) only follows blocks that are already in the file.
+      // Otherwise after restart the state would be ahead of the block log; this way the missing blocks are
+      // just applied again.
+      uint32_t durable_last_irreversible = std::min( new_last_irreversible, _block_log.get_durable_head_block_num() );
+      if( durable_last_irreversible > get_last_irreversible_block_num() )
+        set_last_irreversible_block_num( durable_last_irreversible );
     }
 
-    // This deletes blocks from the fork db
-    //edump((dpo.head_block_number)(get_last_irreversible_block_num()));
-    _fork_db.set_max_size( dpo.head_block_number - get_last_irreversible_block_num() + 1 );
+    // This deletes blocks from the fork db (blocks that are still queued for writing are kept alive by block log)
+    //edump((dpo.head_block_number)(new_last_irreversible));
+    _fork_db.set_max_size( dpo.head_block_number - new_last_irreversible + 1 );
 
-    // This deletes undo state
-    commit( get_last_irreversible_block_num() );
+    // This deletes undo state (but not the one that allows replay to return to last checkpoint)
+    if( !_replay_checkpoint_session_active )
+      commit( get_last_irreversible_block_num() );
 
     if(old_last_irreversible < get_last_irreversible_block_num() )
     {
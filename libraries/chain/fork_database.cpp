@@ -327,10 +327,10 @@ shared_ptr<fork_item> fork_database::fetch_block_on_main_branch_by_number_unlock
   return walk_main_branch_to_num_unlocked(block_num);
 }
 
-vector<fork_item> fork_database::fetch_block_range_on_main_branch_by_number( const uint32_t first_block_num, const uint32_t count, fc::microseconds wait_for_microseconds )const
+vector<item_ptr> fork_database::fetch_block_range_on_main_branch_by_number( const uint32_t first_block_num, const uint32_t count, fc::microseconds wait_for_microseconds )const
 {
   return with_read_lock( [&]() {
-    vector<fork_item> results;
+    vector<item_ptr> results;
 
     if (!_head ||
         _head->num < first_block_num)
@@ -358,7 +358,7 @@ vector<fork_item> fork_database::fetch_block_range_on_main_branch_by_number( con
       item = walk_main_branch_to_num_unlocked(last_block_num);
   
     for (; item && item->num >= first_block_num; item = item->prev.lock())
-      results.push_back(*item);
+      results.push_back(item);
   
     // we collected the blocks in descending order, reverse that order
     boost::reverse(results);
@@ -9,4 +9,38 @@ std::string legacy_custom_name_from_type( const std::string& type_name )
   return type_name.substr( start, end-start );
 }
 
+bool is_tape_compatible_json( const std::string& json )
+{
+  if( memchr( json.data(), '\\', json.size() ) != nullptr )
+    return false;
+
+  // without escapes every quote starts or ends a string
+  bool in_string = false;
+  char previous = '\0';
+  // same count as check_string_depth of legacy parser (brackets inside strings included), so text
+  // it rejects as too deep is left for it to reject
+  int32_t open_object = 0;
+  int32_t open_array = 0;
+  for( char c : json )
+  {
+    switch( c )
+    {
+      case '{': ++open_object; break;
+      case '}': --open_object; break;
+      case '[': ++open_array; break;
+      case ']': --open_array; break;
+      default: break;
+    }
+    if( open_object >= 100 || open_array >= 100 )
+      return false;
+
+    if( c == '"' )
+      in_string = !in_string;
+    else if( !in_string && ( c == '.' || ( ( c == 'e' || c == 'E' ) && previous >= '0' && previous <= '9' ) ) )
+      return false;
+    previous = c;
+  }
+  return true;
+}
+
 } } // hive::chain
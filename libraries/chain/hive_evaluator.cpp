@@ -2003,8 +2003,8 @@ void custom_json_evaluator::do_apply( const custom_json_operation& o )
       "Authority membership exceeded. Max: ${max} Current: ${n}", ("max", HIVE_MAX_AUTHORITY_MEMBERSHIP)("n", num_auths) );
   }
 
-  std::shared_ptr< custom_operation_interpreter > eval = _db.get_custom_json_evaluator( o.id );
-  if( !eval )
+  custom_operation_interpreter* eval = _db.find_custom_json_evaluator( o.id );
+  if( eval == nullptr )
     return;
 
   try
@@ -2047,8 +2047,8 @@ void custom_binary_evaluator::do_apply( const custom_binary_operation& o )
       "Authority membership exceeded. Max: ${max} Current: ${n}", ("max", HIVE_MAX_AUTHORITY_MEMBERSHIP)("n", num_auths) );
   }
 
-  std::shared_ptr< custom_operation_interpreter > eval = _db.get_custom_json_evaluator( o.id );
-  if( !eval )
+  custom_operation_interpreter* eval = _db.find_custom_json_evaluator( o.id );
+  if( eval == nullptr )
     return;
 
   try
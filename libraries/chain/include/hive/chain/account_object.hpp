@@ -31,8 +31,8 @@ namespace hive { namespace chain {
         const time_point_sec& _creation_time, bool _mined,
         const account_name_type& _recovery_account,
         bool _fill_mana, const asset& incoming_delegation )
-        : id( _id ), name( _name ), recovery_account( _recovery_account ), created( _creation_time ),
-        mined( _mined ), memo_key( _memo_key ), delayed_votes( a )
+        : id( _id ), name( _name ), mined( _mined ), memo_key( _memo_key ), created( _creation_time ),
+        recovery_account( _recovery_account ), delayed_votes( a )
       {
         received_vesting_shares += incoming_delegation;
         voting_manabar.last_update_time = _creation_time.sec_since_epoch();
@@ -101,56 +101,31 @@ namespace hive { namespace chain {
       }
 
       //members are organized in such a way that the object takes up as little space as possible (note that object starts with 4byte id).
+      //Within that constraint members used by most frequent operations (transfers, votes, claims of mana) come first, so
+      //evaluation of such operation touches only first two or three cache lines of the object; rarely used members follow.
+      //Order of members has no influence on serialization (snapshots, API) which follows FC_REFLECT, but it is part of
+      //layout of shared memory file - HIVE_STATE_VERSION has to be increased when it changes.
 
     private:
       account_id_type   proxy;
     public:
       account_name_type name;
-    private:
-      account_name_type recovery_account; //cannot be changed to id because there are plenty of accounts with "steem" recovery created before it was created in b.1097
-                                          //ABW: actually we could create "steem" account at genesis, just fake some of its properties to keep history intact
-
-    public:
-      uint128_t         hbd_seconds; ///< total HBD * how long it has been held
-      uint128_t         savings_hbd_seconds; ///< total HBD * how long it has been held
-
-      util::manabar     voting_manabar;
-      util::manabar     downvote_manabar;
 
-      /**
-        *  HBD Deposits pay interest based upon the interest rate set by witnesses. The purpose of these
-        *  fields is to track the total (time * hbd_balance) that it is held. Then at the appointed time
-        *  interest can be paid using the following equation:
-        *
-        *  interest = interest_rate * hbd_seconds / seconds_per_year
-        *
-        *  Every time the hbd_balance is updated the hbd_seconds is also updated. If at least
-        *  HIVE_HBD_INTEREST_COMPOUND_INTERVAL_SEC has passed since hbd_last_interest_payment then
-        *  interest is added to hbd_balance.
-        *
-        *  @defgroup hbd_data HBD Balance Data
-        */
+      // hot members - balances, vesting and mana
 
-      HBD_asset         hbd_balance = asset( 0, HBD_SYMBOL ); /// total HBD balance
-      HBD_asset         savings_hbd_balance = asset( 0, HBD_SYMBOL ); /// total HBD balance
-      HBD_asset         reward_hbd_balance = asset( 0, HBD_SYMBOL );
-
-      HIVE_asset        reward_hive_balance = asset( 0, HIVE_SYMBOL );
-      HIVE_asset        reward_vesting_hive = asset( 0, HIVE_SYMBOL );
       HIVE_asset        balance = asset( 0, HIVE_SYMBOL );  ///< total liquid shares held by this account
-      HIVE_asset        savings_balance = asset( 0, HIVE_SYMBOL );  ///< total liquid shares held by this account
+      HBD_asset         hbd_balance = asset( 0, HBD_SYMBOL ); /// total HBD balance
 
-      VEST_asset        reward_vesting_balance = asset( 0, VESTS_SYMBOL );
       VEST_asset        vesting_shares = asset( 0, VESTS_SYMBOL ); ///< total vesting shares held by this account, controls its voting power
       VEST_asset        delegated_vesting_shares = asset( 0, VESTS_SYMBOL );
       VEST_asset        received_vesting_shares = asset( 0, VESTS_SYMBOL );
-      VEST_asset        vesting_withdraw_rate = asset( 0, VESTS_SYMBOL ); ///< at the time this is updated it can be at most vesting_shares/104
 
-      share_type        curation_rewards = 0;
-      share_type        posting_rewards = 0;
-      share_type        withdrawn = 0; /// Track how many shares have been withdrawn
+      util::manabar     voting_manabar;
+      util::manabar     downvote_manabar;
+
+      VEST_asset        vesting_withdraw_rate = asset( 0, VESTS_SYMBOL ); ///< at the time this is updated it can be at most vesting_shares/104
       share_type        to_withdraw = 0; /// Might be able to look this up with operation history.
-      share_type        pending_claimed_accounts = 0;
+      share_type        withdrawn = 0; /// Track how many shares have been withdrawn
 
       /*
         Total sum of VESTS from `delayed_votes` collection.
@@ -158,6 +133,18 @@ namespace hive { namespace chain {
       */
       ushare_type       sum_delayed_votes = 0;
 
+      time_point_sec    next_vesting_withdrawal = fc::time_point_sec::maximum(); ///< after every withdrawal this is incremented by 1 week
+      time_point_sec    last_vote_time;
+
+      bool              can_vote = true;
+
+      // cold members - rarely used or used by rare operations
+
+      bool              mined = true;
+      uint8_t           savings_withdraw_requests = 0;
+
+      public_key_type   memo_key;   //public_key_type - 33 bytes; ABW: it belongs to metadata as it is not used by consensus, but witnesses need it here since they don't COLLECT_ACCOUNT_METADATA
+
       time_point_sec    hbd_seconds_last_update; ///< the last time the hbd_seconds was updated
       time_point_sec    hbd_last_interest_payment; ///< used to pay interest at most once per month
       time_point_sec    savings_hbd_seconds_last_update; ///< the last time the hbd_seconds was updated
@@ -168,8 +155,6 @@ namespace hive { namespace chain {
       time_point_sec    last_post;
       time_point_sec    last_root_post = fc::time_point_sec::min();
       time_point_sec    last_post_edit;
-      time_point_sec    last_vote_time;
-      time_point_sec    next_vesting_withdrawal = fc::time_point_sec::maximum(); ///< after every withdrawal this is incremented by 1 week
 
     private:
       time_point_sec    governance_vote_expiration_ts = fc::time_point_sec::maximum();
@@ -186,13 +171,40 @@ namespace hive { namespace chain {
       uint16_t          open_recurrent_transfers = 0; //for now max is 255, but it might change
       uint16_t          witnesses_voted_for = 0; //max 30, why is it 16bit?
 
-      uint8_t           savings_withdraw_requests = 0;
-      bool              can_vote = true;
-      bool              mined = true;
+      /**
+        *  HBD Deposits pay interest based upon the interest rate set by witnesses. The purpose of these
+        *  fields is to track the total (time * hbd_balance) that it is held. Then at the appointed time
+        *  interest can be paid using the following equation:
+        *
+        *  interest = interest_rate * hbd_seconds / seconds_per_year
+        *
+        *  Every time the hbd_balance is updated the hbd_seconds is also updated. If at least
+        *  HIVE_HBD_INTEREST_COMPOUND_INTERVAL_SEC has passed since hbd_last_interest_payment then
+        *  interest is added to hbd_balance.
+        *
+        *  @defgroup hbd_data HBD Balance Data
+        */
+
+      HIVE_asset        savings_balance = asset( 0, HIVE_SYMBOL );  ///< total liquid shares held by this account
+      HBD_asset         savings_hbd_balance = asset( 0, HBD_SYMBOL ); /// total HBD balance
+
+      HIVE_asset        reward_hive_balance = asset( 0, HIVE_SYMBOL );
+      HBD_asset         reward_hbd_balance = asset( 0, HBD_SYMBOL );
+      VEST_asset        reward_vesting_balance = asset( 0, VESTS_SYMBOL );
+      HIVE_asset        reward_vesting_hive = asset( 0, HIVE_SYMBOL );
+
+      share_type        curation_rewards = 0;
+      share_type        posting_rewards = 0;
+
+    private:
+      account_name_type recovery_account; //cannot be changed to id because there are plenty of accounts with "steem" recovery created before it was created in b.1097
+                                          //ABW: actually we could create "steem" account at genesis, just fake some of its properties to keep history intact
 
     public:
+      uint128_t         hbd_seconds; ///< total HBD * how long it has been held
+      uint128_t         savings_hbd_seconds; ///< total HBD * how long it has been held
 
-      public_key_type   memo_key;   //public_key_type - 33 bytes; ABW: it belongs to metadata as it is not used by consensus, but witnesses need it here since they don't COLLECT_ACCOUNT_METADATA
+      share_type        pending_claimed_accounts = 0;
 
       fc::array<share_type, HIVE_MAX_PROXY_RECURSION_DEPTH> proxied_vsf_votes;// = std::vector<share_type>( HIVE_MAX_PROXY_RECURSION_DEPTH, 0 ); ///< the total VFS votes proxied to this account
 
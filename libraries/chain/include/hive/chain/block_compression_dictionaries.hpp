@@ -1,4 +1,10 @@
+#pragma once
+#include <cstddef>
 #include <cstdint>
+#include <string>
+#include <vector>
+
+#include <fc/optional.hpp>
 
 extern "C"
 {
@@ -12,4 +18,15 @@ namespace hive { namespace chain {
   fc::optional<uint8_t> get_best_available_zstd_compression_dictionary_number_for_block(uint32_t block_number);
   ZSTD_CDict* get_zstd_compression_dictionary(uint8_t dictionary_number, int compression_level);
   ZSTD_DDict* get_zstd_decompression_dictionary(uint8_t dictionary_number);
+
+  // Dictionaries trained outside of hived (see `compress_block_log --train-dictionary`) have to be registered
+  // before any block that was compressed with them is read.  Numbers of built-in dictionaries can't be reused.
+  void register_zstd_compression_dictionary(uint8_t dictionary_number, const char* dictionary_data, size_t dictionary_size);
+  // Makes all newly appended blocks use given registered dictionary instead of the built-in one for their block number
+  void set_zstd_compression_dictionary_for_new_blocks(fc::optional<uint8_t> dictionary_number);
+  // Registers a dictionary given as NUMBER:FILE (the format of `block-log-compression-dictionary` option), returns its number
+  uint8_t register_zstd_compression_dictionary_from_file(const std::string& number_and_file);
+  // Trains a dictionary on concatenated samples (serialized blocks) of given sizes
+  std::string train_zstd_compression_dictionary(const std::vector<char>& samples, const std::vector<size_t>& sample_sizes,
+                                                size_t dictionary_size, int compression_level, unsigned threads);
 } }
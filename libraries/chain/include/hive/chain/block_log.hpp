@@ -2,6 +2,8 @@
 #include <fc/filesystem.hpp>
 #include <hive/protocol/block.hpp>
 
+#include <functional>
+
 extern "C"
 {
   struct ZSTD_CCtx_s;
@@ -69,7 +71,12 @@ namespace hive { namespace chain {
       void close();
       bool is_open()const;
 
+      // returns position of the block in the log, or 0 when the block was handed over to background compression
+      // (see set_compression_threads) and its position is not known yet
       uint64_t append(const signed_block& b);
+      // same as above, but in background mode the block is queued without making a copy (it must not be modified
+      // afterwards) and all its serialization happens on background threads
+      uint64_t append(const boost::shared_ptr<signed_block>& b);
       uint64_t append_raw(const char* raw_block_data, size_t raw_block_size, block_attributes_t flags);
 
       void flush();
@@ -79,12 +86,29 @@ namespace hive { namespace chain {
       optional<signed_block> read_block_by_num( uint32_t block_num )const;
       optional<signed_block_header> read_block_header_by_num( uint32_t block_num )const;
       vector<signed_block> read_block_range_by_num( uint32_t first_block_num, uint32_t count )const;
+      // like read_block_range_by_num, but reads and deserializes one block at a time and passes it to the processor
+      // (which can move from it), so memory use doesn't depend on the number of blocks
+      void for_each_block_in_range( uint32_t first_block_num, uint32_t count, const std::function<void(signed_block&&)>& processor )const;
 
       std::tuple<std::unique_ptr<char[]>, size_t, block_log::block_attributes_t> read_raw_head_block() const;
       signed_block read_head()const;
       const boost::shared_ptr<signed_block> head() const;
       void set_compression(bool enabled);
       void set_compression_level(int level);
+      // With threads > 0 `append` only queues the block; it is serialized and (when enabled) compressed by a pool of background threads and
+      // written to the log (in order) as soon as it and all preceding blocks are compressed, so the caller doesn't
+      // wait for zstd.  Queued blocks are served from memory by all read functions and written out by `close`.
+      // Must not be called while other threads use the block log.
+      void set_compression_threads(uint32_t threads);
+      // number of the last block that is completely written to the log file, so it survives a crash of the process;
+      // equal to the number of head() unless blocks are still queued for background compression
+      uint32_t get_durable_head_block_num() const;
+      // waits until given block is written to the log file; returns false on timeout, when the block was not queued
+      // or the background writer failed
+      bool wait_for_durable_head(uint32_t block_num, const fc::microseconds& timeout) const;
+      // Number of threads walking the log when `open` has to reconstruct the index (0 - one per core); each thread
+      // gets at least min_segment_size bytes of the log, so small logs are always indexed by a single thread
+      void set_index_reconstruction_threads(uint32_t threads, uint64_t min_segment_size = 64 * 1024 * 1024);
 
       static std::tuple<std::unique_ptr<char[]>, size_t> compress_block_zstd(const char* uncompressed_block_data, size_t uncompressed_block_size, fc::optional<uint8_t> dictionary_number, 
                                                                              fc::optional<int> compression_level = fc::optional<int>(), 
@@ -10,6 +10,7 @@
 #include <hive/chain/notifications.hpp>
 
 #include <hive/chain/util/advanced_benchmark_dumper.hpp>
+#include <hive/chain/util/signature_key_cache.hpp>
 #include <hive/chain/util/signal.hpp>
 
 #include <hive/protocol/protocol.hpp>
@@ -24,6 +25,7 @@
 
 #include <functional>
 #include <map>
+#include <unordered_map>
 
 namespace hive {
 
@@ -69,6 +71,7 @@ namespace chain {
   }
 
   struct reindex_notification;
+  struct replay_checkpoint_notification;
 
   struct generate_optional_actions_notification {};
 
@@ -82,6 +85,7 @@ namespace chain {
     uint64_t initial_supply = HIVE_INIT_SUPPLY;
     uint64_t hbd_initial_supply = HIVE_HBD_INIT_SUPPLY;
     uint64_t shared_file_size = 0;
+    uint64_t shared_file_max_size = 0;
     uint16_t shared_file_full_threshold = 0;
     uint16_t shared_file_scale_rate = 0;
     uint32_t chainbase_flags = 0;
@@ -92,12 +96,19 @@ namespace chain {
     std::vector< std::string > replay_memory_indices{};
     bool enable_block_log_compression = true;
     int block_log_compression_level = 15;
+    uint32_t block_log_compression_threads = 0;
 
     // The following fields are only used on reindexing
     uint32_t stop_replay_at = 0;
     bool exit_after_replay = false;
     bool force_replay = false;
     bool validate_during_replay = false;
+    // Blocks between replay checkpoints, 0 - disabled. All changes made since last checkpoint are kept in single undo
+    // session and plugins with external storage (account_history_rocksdb) keep their writes in memory until next
+    // checkpoint, so memory use grows with the interval (undo copies of every object modified in the interval);
+    // a few thousand blocks is a reasonable value.
+    uint32_t replay_checkpoint_interval = 0;
+    uint32_t replay_checkpoint_minutes = 0; // time between replay checkpoints, 0 - disabled
   };
 
   /**
@@ -190,6 +201,9 @@ namespace chain {
     private:
 
       uint32_t reindex_internal( const open_args& args, signed_block& block );
+      /// flushes state at current head block and saves record that allows interrupted replay to resume from it
+      void write_replay_checkpoint( const open_args& args, const replay_checkpoint_notification& note );
+      void verify_replay_checkpoint( const open_args& args ) const;
       void remove_expired_governance_votes();
 
       /// Allows to load all data being independent to the persistent storage held in shared memory file.
@@ -256,8 +270,14 @@ namespace chain {
       optional<signed_block_header> fetch_block_header_by_number( uint32_t num, fc::microseconds wait_for_microseconds = fc::microseconds() )const;
       optional<signed_block>     fetch_block_by_number( uint32_t num, fc::microseconds wait_for_microseconds = fc::microseconds() )const;
       std::vector<signed_block>  fetch_block_range( const uint32_t starting_block_num, const uint32_t count, fc::microseconds wait_for_microseconds = fc::microseconds() );
+      /// Same blocks as fetch_block_range, but passed to the processor one by one (with their ids) instead of collected
+      void                       for_each_block_in_range( const uint32_t starting_block_num, const uint32_t count,
+                                                          const std::function< void( const signed_block&, const block_id_type& ) >& processor,
+                                                          fc::microseconds wait_for_microseconds = fc::microseconds() );
       const signed_transaction   get_recent_transaction( const transaction_id_type& trx_id )const;
       std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
+      /// Number of the last block completely written to the block log (irreversible blocks may still wait for background writer)
+      uint32_t                   get_durable_block_log_head_num()const;
 
       /// Warning: to correctly process old blocks initially old chain-id should be set.
       chain_id_type hive_chain_id = OLD_CHAIN_ID;
@@ -417,6 +437,7 @@ namespace chain {
       using irreversible_block_handler_t = std::function< void(uint32_t) >;
       using switch_fork_handler_t = std::function< void(uint32_t) >;
       using reindex_handler_t = std::function< void(const reindex_notification&) >;
+      using replay_checkpoint_handler_t = std::function< void(const replay_checkpoint_notification&) >;
       using generate_optional_actions_handler_t = std::function< void(const generate_optional_actions_notification&) >;
       using prepare_snapshot_handler_t = std::function < void(const database&, const database::abstract_index_cntr_t&)>;
       using prepare_snapshot_data_supplement_handler_t = std::function < void(const prepare_snapshot_supplement_notification&) >;
@@ -456,6 +477,7 @@ namespace chain {
       boost::signals2::connection add_switch_fork_handler               ( const switch_fork_handler_t&        func, const abstract_plugin& plugin, int32_t group = -1 );
       boost::signals2::connection add_pre_reindex_handler               ( const reindex_handler_t&                   func, const abstract_plugin& plugin, int32_t group = -1 );
       boost::signals2::connection add_post_reindex_handler              ( const reindex_handler_t&                   func, const abstract_plugin& plugin, int32_t group = -1 );
+      boost::signals2::connection add_replay_checkpoint_handler         ( const replay_checkpoint_handler_t&         func, const abstract_plugin& plugin, int32_t group = -1 );
       boost::signals2::connection add_generate_optional_actions_handler ( const generate_optional_actions_handler_t& func, const abstract_plugin& plugin, int32_t group = -1 );
       boost::signals2::connection add_pre_apply_custom_operation_handler ( const apply_custom_operation_handler_t&    func, const abstract_plugin& plugin, int32_t group = -1 );
       boost::signals2::connection add_post_apply_custom_operation_handler( const apply_custom_operation_handler_t&    func, const abstract_plugin& plugin, int32_t group = -1 );
@@ -632,6 +654,8 @@ namespace chain {
       void initialize_evaluators();
       void register_custom_operation_interpreter( std::shared_ptr< custom_operation_interpreter > interpreter );
       std::shared_ptr< custom_operation_interpreter > get_custom_json_evaluator( const custom_id_type& id );
+      /// fast lookup used when applying custom operations; nullptr for ids without interpreter
+      custom_operation_interpreter* find_custom_json_evaluator( const custom_id_type& id )const;
 
       /// Reset the object graph in-memory
       void initialize_indexes();
@@ -654,6 +678,20 @@ namespace chain {
         * can be reapplied at the proper time */
       std::deque< signed_transaction_transporter >       _popped_tx;
       vector< signed_transaction_transporter >           _pending_tx;
+      /** pending transactions not applied to pending state yet (see apply_postponed_transactions); transactions
+        * in _pending_tx that touch the same accounts (approximation of dependency) are all older than them, so
+        * _pending_tx followed by _postponed_tx is a valid order of all pending transactions */
+      std::deque< signed_transaction_transporter >       _postponed_tx;
+      /// number of transactions in _postponed_tx that impact given account
+      std::map< account_name_type, uint32_t >            _postponed_tx_accounts;
+      /** number of transactions at the end of _pending_tx that were applied to pending state as new transactions
+        * (with all checks, see is_validating_one_tx()), in order, after transactions reapplied when pending state
+        * was rebuilt; block producer that reapplies all transactions before them with the same result does not need
+        * to apply them again */
+      size_t                                             _pending_tx_validated_tail = 0;
+      /// skip flags used when applying transactions counted in _pending_tx_validated_tail (all bits set when pending
+      /// state does not reflect _pending_tx, so none of them can be reused)
+      uint32_t                                           _pending_tx_validated_skip = 0;
 
       bool apply_order( const limit_order_object& new_order_object );
       bool fill_order( const limit_order_object& order, const asset& pays, const asset& receives );
@@ -683,6 +721,18 @@ namespace chain {
       const std::string& get_json_schema() const;
 
       void set_flush_interval( uint32_t flush_blocks );
+
+      /**
+        * When there are more pending transactions than given threshold after a block extends the chain,
+        * only transactions touching accounts affected by transactions of that block are reapplied right away,
+        * the rest is postponed to be reapplied with apply_postponed_transactions(). 0 means never postpone.
+        */
+      void set_pending_tx_deferral_threshold( size_t threshold );
+      size_t get_pending_tx_deferral_threshold()const { return _pending_tx_deferral_threshold; }
+      /// reapplies postponed transactions (in order) until all are processed or time limit passes; returns number of remaining ones
+      size_t apply_postponed_transactions( const fc::microseconds& time_limit );
+      /// puts transaction at the end of _postponed_tx (impacted accounts are calculated when not given)
+      void postpone_transaction( signed_transaction_transporter&& trx, const flat_set< account_name_type >* impacted_accounts = nullptr );
       void check_free_memory( bool force_print, uint32_t current_block_num );
 
       void apply_transaction( const signed_transaction_transporter& trx, uint32_t skip = skip_nothing );
@@ -724,8 +774,18 @@ namespace chain {
       void apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
       void _apply_block( const signed_block& next_block );
       void _apply_transaction( const signed_transaction_transporter& trx );
+      /// same as above, but with transaction id already calculated (f.e. in batch for whole block)
+      void _apply_transaction( const signed_transaction_transporter& trx, const transaction_id_type& known_trx_id );
       void apply_operation( const operation& op );
 
+      /// reapplies postponed transactions that new transaction might depend on (sharing accounts with it directly
+      /// or through other postponed transactions), so it is not applied before them
+      void apply_postponed_dependencies( const signed_transaction& trx );
+      /// removes accounts of transaction taken out of _postponed_tx from _postponed_tx_accounts
+      void release_postponed_accounts( const signed_transaction& trx );
+      /// reapplies transaction taken from _postponed_tx (unless it is already known); returns true when applied
+      bool reapply_postponed_transaction( const signed_transaction_transporter& trx );
+
       void process_required_actions( const required_automated_actions& actions );
       void process_optional_actions( const optional_automated_actions& actions );
 
@@ -754,8 +814,9 @@ namespace chain {
 
       void update_global_dynamic_data( const signed_block& b );
       void update_signing_witness(const witness_object& signing_witness, const signed_block& new_block);
+      // returns number of the new last irreversible block (it is stored in the state later when the block log is written in background)
       uint32_t update_last_irreversible_block();
-      void migrate_irreversible_state(uint32_t old_last_irreversible);
+      void migrate_irreversible_state(uint32_t old_last_irreversible, uint32_t new_last_irreversible);
       void clear_expired_transactions();
       void clear_expired_orders();
       void clear_expired_delegations();
@@ -860,7 +921,11 @@ namespace chain {
       node_property_object              _node_property_object;
 
       uint32_t                      _flush_blocks = 0;
+      size_t                        _pending_tx_deferral_threshold = 0;
       uint32_t                      _next_flush_block = 0;
+      /// set while replay keeps undo session open since last checkpoint - irreversible blocks must not commit it
+      bool                          _replay_checkpoint_session_active = false;
+      bool                          _block_log_written_in_background = false;
 
       uint32_t                      _last_free_gb_printed = 0;
 
@@ -870,9 +935,27 @@ namespace chain {
       bool                          snapshot_loaded = false;
 
       flat_map< custom_id_type, std::shared_ptr< custom_operation_interpreter > >   _custom_operation_interpreters;
+
+      struct custom_id_hash
+      {
+        size_t operator()( const custom_id_type& id )const;
+      };
+      /// lookup index of _custom_operation_interpreters, most custom operations have id that is not registered at all,
+      /// so there is also a 64 bit filter (bit of hash % 64 is set for every registered id) to reject them early
+      std::unordered_map< custom_id_type, custom_operation_interpreter*, custom_id_hash > _custom_operation_interpreter_lookup;
+      uint64_t                      _custom_operation_id_filter = 0;
       std::string                   _json_schema;
 
       util::advanced_benchmark_dumper  _benchmark_dumper;
+      util::signature_key_cache        _signature_key_cache; ///< keys of signatures recovered during transaction validation
+
+      struct curation_vote
+      {
+        uint64_t                    weight;
+        account_id_type             voter;
+        const comment_vote_object*  vote;
+      };
+      std::vector< curation_vote >     _curation_votes_buffer; ///< scratch space of pay_curators, keeps its capacity between cashouts
 
       fc::signal<void(const required_action_notification&)> _pre_apply_required_action_signal;
       fc::signal<void(const required_action_notification&)> _post_apply_required_action_signal;
@@ -939,6 +1022,11 @@ namespace chain {
         */
       fc::signal<void(const reindex_notification&)>         _post_reindex_signal;
 
+      /**
+        * Emitted during reindexing right before state is flushed as replay checkpoint
+        */
+      fc::signal<void(const replay_checkpoint_notification&)> _replay_checkpoint_signal;
+
       fc::signal<void(const generate_optional_actions_notification& )> _generate_optional_actions_signal;
 
       fc::signal<void(const database&, const database::abstract_index_cntr_t&)> _prepare_snapshot_signal;
@@ -976,6 +1064,15 @@ namespace chain {
       fc::signal<void()> _end_of_syncing_signal;
   };
 
+  struct replay_checkpoint_notification
+  {
+    replay_checkpoint_notification( uint32_t b ) : block_num( b ) {}
+
+    uint32_t block_num = 0;
+    /// plugins with external storage put their position here, it is saved in checkpoint record
+    mutable fc::mutable_variant_object plugin_positions;
+  };
+
   struct reindex_notification
   {
     reindex_notification( const open_args& a ) : args( a ) {}
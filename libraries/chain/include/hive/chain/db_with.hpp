@@ -1,8 +1,12 @@
 #pragma once
 
 #include <hive/chain/database.hpp>
+#include <hive/chain/util/impacted.hpp>
+
 #include <boost/scope_exit.hpp>
 
+#include <algorithm>
+
 /*
   * This file provides with() functions which modify the database
   * temporarily, then restore it.  These functions are mostly internal
@@ -64,9 +68,14 @@ void with_skip_flags(
   */
 struct pending_transactions_restorer
 {
-  pending_transactions_restorer( database& db, std::vector<signed_transaction_transporter>&& pending_transactions )
-    : _db(db), _pending_transactions( std::move(pending_transactions) )
+  pending_transactions_restorer( database& db, std::vector<signed_transaction_transporter>&& pending_transactions,
+    const signed_block* const* applied_block = nullptr )
+    : _db(db), _pending_transactions( std::move(pending_transactions) ), _applied_block( applied_block )
   {
+    // transactions postponed after previous block go after pending ones (see database::_postponed_tx)
+    _pending_transactions.reserve( _pending_transactions.size() + _db._postponed_tx.size() );
+    for( auto& tx : _db._postponed_tx )
+      _pending_transactions.emplace_back( std::move( tx ) );
     _db.clear_pending();
   }
 
@@ -82,8 +91,36 @@ struct pending_transactions_restorer
     bool apply_trxs = true;
     uint32_t applied_txs = 0;
     uint32_t postponed_txs = 0;
+    uint32_t deferred_txs = 0;
     uint32_t expired_txs = 0;
 
+    // When there are many pending transactions and the chain was extended by single block, only those
+    // that touch accounts affected by transactions of that block are reapplied right away, since they
+    // might have become invalid; the rest is reapplied later by database::apply_postponed_transactions.
+    // Transaction that touches account of already deferred one is deferred as well to keep their order
+    // (new transactions do the same - see database::apply_postponed_dependencies).
+    const size_t deferral_threshold = _db.get_pending_tx_deferral_threshold();
+    const bool defer_unrelated = _applied_block != nullptr && *_applied_block != nullptr && _db._popped_tx.empty() &&
+      deferral_threshold != 0 && _pending_transactions.size() > deferral_threshold;
+    flat_set< account_name_type > block_accounts;
+    flat_set< account_name_type > deferred_accounts;
+    flat_set< account_name_type > tx_accounts;
+    if( defer_unrelated )
+    {
+      for( const auto& tx : ( *_applied_block )->transactions )
+        hive::app::transaction_get_impacted_accounts( tx.trx, block_accounts );
+    }
+    auto is_related = [&]( const flat_set< account_name_type >& accounts )
+    {
+      return std::any_of( accounts.begin(), accounts.end(),
+        [&]( const account_name_type& a ) { return block_accounts.count( a ) != 0; } );
+    };
+    auto is_after_deferred = [&]( const flat_set< account_name_type >& accounts )
+    {
+      return std::any_of( accounts.begin(), accounts.end(),
+        [&]( const account_name_type& a ) { return deferred_accounts.count( a ) != 0; } );
+    };
+
     auto handle_tx = [&]( signed_transaction_transporter& tx )
     {
 #ifndef IS_TEST_NET //especially during debugging that limit is highly problematic
@@ -91,6 +128,27 @@ struct pending_transactions_restorer
         apply_trxs = false;
 #endif
 
+      if( apply_trxs && defer_unrelated )
+      {
+        if( tx.trx.expiration < head_block_time )
+        {
+          ++expired_txs;
+          return;
+        }
+        if( _db.is_known_transaction( tx.trx.id() ) )
+          return;
+
+        tx_accounts.clear();
+        hive::app::transaction_get_impacted_accounts( tx.trx, tx_accounts );
+        if( !is_related( tx_accounts ) || is_after_deferred( tx_accounts ) )
+        {
+          deferred_accounts.insert( tx_accounts.begin(), tx_accounts.end() );
+          _db.postpone_transaction( std::move( tx ), &tx_accounts );
+          ++deferred_txs;
+          return;
+        }
+      }
+
       if( apply_trxs )
       {
         try
@@ -126,7 +184,7 @@ struct pending_transactions_restorer
       }
       else
       {
-        _db._pending_tx.emplace_back( std::move( tx ) );
+        _db.postpone_transaction( std::move( tx ) );
         ++postponed_txs;
       }
     };
@@ -162,10 +220,15 @@ struct pending_transactions_restorer
       wlog( "Postponed ${p} pending transactions. ${a} were applied. ${e} expired.",
         ( "p", postponed_txs )( "a", applied_txs )( "e", expired_txs ) );
     }
+    if( deferred_txs )
+    {
+      dlog( "Deferred ${d} pending transactions unrelated to block ${b}.", ( "d", deferred_txs )( "b", _db.head_block_num() ) );
+    }
   }
 
   database& _db;
   std::vector< signed_transaction_transporter > _pending_transactions;
+  const signed_block* const* _applied_block;
 };
 
 /**
@@ -185,4 +248,21 @@ void without_pending_transactions(
     return;
 }
 
+/**
+  * Same as above, but when callback sets applied_block to the block that extended the chain
+  * (without switching forks), pending transactions unrelated to that block might be postponed
+  * instead of being reapplied (see database::set_pending_tx_deferral_threshold).
+  */
+template< typename Lambda >
+void without_pending_transactions(
+  database& db,
+  std::vector<signed_transaction_transporter>&& pending_transactions,
+  const signed_block*& applied_block,
+  Lambda callback )
+{
+    pending_transactions_restorer restorer( db, std::move(pending_transactions), &applied_block );
+    callback();
+    return;
+}
+
 } } } // hive::chain::detail
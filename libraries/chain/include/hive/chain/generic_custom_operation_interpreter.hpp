@@ -14,6 +14,7 @@
 #include <hive/chain/custom_operation_interpreter.hpp>
 
 #include <fc/variant.hpp>
+#include <fc/io/json_tape.hpp>
 
 #include <string>
 #include <vector>
@@ -56,49 +57,56 @@ struct get_custom_operation_name
   }
 };
 
+/// maps names of custom operations (both legacy and current ones) to their tags
 template< typename CustomOperationType >
-void custom_op_from_variant( const fc::variant& var, CustomOperationType& vo )
+struct custom_op_tags
 {
-  static std::map<string,int64_t> to_legacy_tag = []()
+  template< typename NameGetter >
+  static std::map< string, int64_t > build()
   {
-    std::map<string,int64_t> name_map;
+    std::map< string, int64_t > name_map;
     for( int i = 0; i < CustomOperationType::count(); ++i )
     {
       CustomOperationType tmp;
       tmp.set_which(i);
       string n;
-      tmp.visit( get_legacy_custom_operation_name(n) );
+      tmp.visit( NameGetter( n ) );
       name_map[n] = i;
     }
     return name_map;
-  }();
+  }
 
-  static std::map< string, int64_t > to_tag = []()
+  static int64_t from_legacy_tag( const fc::variant& tag )
   {
-    std::map< string, int64_t > name_map;
-    for( int i = 0; i < CustomOperationType::count(); ++i )
-    {
-      CustomOperationType tmp;
-      tmp.set_which(i);
-      string n;
-      tmp.visit( get_custom_operation_name( n ) );
-      name_map[n] = i;
-    }
-    return name_map;
-  }();
+    static std::map< string, int64_t > to_legacy_tag = build< get_legacy_custom_operation_name >();
 
+    if( tag.is_uint64() )
+      return tag.as_uint64();
+    auto itr = to_legacy_tag.find( tag.as_string() );
+    FC_ASSERT( itr != to_legacy_tag.end(), "Invalid operation name: ${n}", ("n", tag) );
+    return itr->second;
+  }
+
+  static int64_t from_tag( const fc::variant& tag )
+  {
+    static std::map< string, int64_t > to_tag = build< get_custom_operation_name >();
+
+    if( tag.is_integer() )
+      return tag.as_int64();
+    auto itr = to_tag.find( tag.as_string() );
+    FC_ASSERT( itr != to_tag.end(), "Invalid object name: ${n}", ("n", tag) );
+    return itr->second;
+  }
+};
+
+template< typename CustomOperationType >
+void custom_op_from_variant( const fc::variant& var, CustomOperationType& vo )
+{
   if( var.is_array() ) // legacy serialization
   {
     auto ar = var.get_array();
     if( ar.size() < 2 ) return;
-    if( ar[0].is_uint64() )
-      vo.set_which( ar[0].as_uint64() );
-    else
-    {
-      auto itr = to_legacy_tag.find(ar[0].as_string());
-      FC_ASSERT( itr != to_legacy_tag.end(), "Invalid operation name: ${n}", ("n", ar[0]) );
-      vo.set_which( itr->second );
-    }
+    vo.set_which( custom_op_tags< CustomOperationType >::from_legacy_tag( ar[0] ) );
     vo.visit( fc::to_static_variant( ar[1] ) );
   }
   else // new serialization
@@ -109,22 +117,179 @@ void custom_op_from_variant( const fc::variant& var, CustomOperationType& vo )
     FC_ASSERT( v_object.contains( "type" ), "Type field doesn't exist." );
     FC_ASSERT( v_object.contains( "value" ), "Value field doesn't exist." );
 
-    int64_t which = -1;
+    vo.set_which( custom_op_tags< CustomOperationType >::from_tag( v_object[ "type" ] ) );
+    vo.visit( fc::to_static_variant( v_object[ "value" ] ) );
+  }
+}
+
+/**
+  * True when legacy JSON parser and json_tape are known to give the same values for given text, which
+  * is when it has no escape sequences (legacy parser does not decode \\u and keeps unknown escapes as
+  * plain characters) and no numbers with fraction or exponent (legacy parser keeps 1e3 as a string).
+  * Also false when legacy parser would reject the text as too deep (counting brackets inside strings too).
+  */
+bool is_tape_compatible_json( const std::string& json );
+
+namespace detail {
+
+  /// reads alternative of static variant straight from the tape (reflected objects member by member)
+  struct tape_to_static_variant
+  {
+    const fc::json_tape& tape;
+    size_t&              i;
+    uint32_t             depth;
+
+    typedef void result_type;
+
+    template< typename T >
+    void operator()( T& v )const
+    {
+      read( v, typename fc::reflector< T >::is_defined(), typename fc::reflector< T >::is_enum() );
+    }
+
+    template< typename T >
+    void read( T& v, fc::true_type /*is_defined*/, fc::false_type /*is_enum*/ )const
+    {
+      if( tape.at( i ) == '{' )
+        tape.read_object( i, v, depth );
+      else
+        tape.read( i, v, depth );
+    }
+
+    template< typename T, typename IsDefined, typename IsEnum >
+    void read( T& v, IsDefined, IsEnum )const
+    {
+      tape.read( i, v, depth );
+    }
+  };
+
+} // detail
+
+/// same as custom_op_from_variant, but reads from position i of the tape
+template< typename CustomOperationType >
+void custom_op_from_tape( const fc::json_tape& tape, size_t& i, uint32_t depth, CustomOperationType& vo )
+{
+  if( tape.at( i ) == '[' ) // legacy serialization
+  {
+    size_t tag_pos = 0;
+    uint32_t element = 0;
+    tape.read_array( i, depth, [&]( size_t& j, uint32_t d )
+    {
+      if( element == 0 )
+      {
+        tag_pos = j;
+        tape.skip_value( j, d );
+      }
+      else if( element == 1 )
+      {
+        vo.set_which( custom_op_tags< CustomOperationType >::from_legacy_tag( tape.read_value( tag_pos, d ) ) );
+        vo.visit( detail::tape_to_static_variant{ tape, j, d } );
+      }
+      else
+      {
+        tape.skip_value( j, d );
+      }
+      ++element;
+    } );
+  }
+  else // new serialization
+  {
+    FC_ASSERT( tape.at( i ) == '{', "Input data have to treated as object." );
+
+    // first occurrence of a key wins, like in variant_object
+    size_t type_pos = 0, value_pos = 0;
+    bool has_type = false, has_value = false;
+    ++depth;
+    FC_ASSERT( depth <= JSON_MAX_RECURSION_DEPTH );
+    tape.expect( i, '{' );
+    if( tape.at( i ) == '}' )
+      ++i;
+    else
+    {
+      while( true )
+      {
+        string key = tape.read_string( i );
+        tape.expect( i, ':' );
+        if( key == "type" && !has_type )
+        {
+          has_type = true;
+          type_pos = i;
+        }
+        else if( key == "value" && !has_value )
+        {
+          has_value = true;
+          value_pos = i;
+        }
+        tape.skip_value( i, depth );
+        char c = tape.at( i++ );
+        if( c == '}' )
+          break;
+        FC_ASSERT( c == ',', "Expected ',' or '}'" );
+      }
+    }
+
+    FC_ASSERT( has_type, "Type field doesn't exist." );
+    FC_ASSERT( has_value, "Value field doesn't exist." );
+
+    vo.set_which( custom_op_tags< CustomOperationType >::from_tag( tape.read_value( type_pos, depth ) ) );
+    vo.visit( detail::tape_to_static_variant{ tape, value_pos, depth } );
+  }
+}
+
+/**
+  * Parses custom operations straight from JSON text, without intermediate variant. Returns false (and
+  * leaves result empty) when the text has to go through legacy parser instead - either because the
+  * parsers could disagree on it, or because it is not strictly valid JSON.
+  */
+template< typename CustomOperationType >
+bool custom_ops_from_json( const std::string& json, std::vector< CustomOperationType >& result )
+{
+  if( !is_tape_compatible_json( json ) )
+    return false;
 
-    if( v_object[ "type" ].is_integer() )
+  try
+  {
+    fc::json_tape tape( json );
+    size_t i = 0;
+    // it looks like a list when first element of top level array is an array
+    if( tape.at( 0 ) == '[' && tape.at( 1 ) == '[' )
     {
-      which = v_object[ "type" ].as_int64();
+      tape.read_array( i, 1, [&]( size_t& j, uint32_t d )
+      {
+        result.emplace_back();
+        custom_op_from_tape( tape, j, d, result.back() );
+      } );
     }
     else
     {
-      auto itr = to_tag.find( v_object[ "type" ].as_string() );
-      FC_ASSERT( itr != to_tag.end(), "Invalid object name: ${n}", ("n", v_object[ "type" ]) );
-      which = itr->second;
+      result.emplace_back();
+      custom_op_from_tape( tape, i, 1, result.back() );
     }
+    tape.check_end( i );
+    return true;
+  }
+  catch( const fc::exception& )
+  {
+    result.clear();
+    return false;
+  }
+}
 
-    vo.set_which( which );
-    vo.visit( fc::to_static_variant( v_object[ "value" ] ) );
+/// same as fc::json::from_string( json ).as< T >() (for reflected T), but without variant when possible
+template< typename T >
+T custom_json_as( const std::string& json )
+{
+  if( is_tape_compatible_json( json ) )
+  {
+    try
+    {
+      return fc::json::from_string_as< T >( json );
+    }
+    catch( const fc::exception& )
+    {
+    }
   }
+  return fc::json::from_string( json ).as< T >();
 }
 
 
@@ -211,23 +376,26 @@ class generic_custom_operation_interpreter
       try
       {
         FC_TODO( "Should we hardfork out old serialization?" )
-        fc::variant v = fc::json::from_string( outer_o.json );
-
         std::vector< CustomOperationType > custom_operations;
-        if( v.is_array() && v.size() > 0 && v.get_array()[0].is_array() )
+        if( !custom_ops_from_json( outer_o.json, custom_operations ) )
         {
-          // it looks like a list
-          for( auto& o : v.get_array() )
+          fc::variant v = fc::json::from_string( outer_o.json );
+
+          if( v.is_array() && v.size() > 0 && v.get_array()[0].is_array() )
+          {
+            // it looks like a list
+            for( auto& o : v.get_array() )
+            {
+              custom_operations.emplace_back();
+              custom_op_from_variant( o, custom_operations.back() );
+            }
+          }
+          else
           {
             custom_operations.emplace_back();
-            custom_op_from_variant( o, custom_operations.back() );
+            custom_op_from_variant( v, custom_operations[0] );
           }
         }
-        else
-        {
-          custom_operations.emplace_back();
-          custom_op_from_variant( v, custom_operations[0] );
-        }
 
         apply_operations( custom_operations, operation( outer_o ) );
       } FC_CAPTURE_AND_RETHROW( (outer_o) )
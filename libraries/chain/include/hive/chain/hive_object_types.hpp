@@ -12,6 +12,14 @@
 
 #include <hive/chain/multi_index_types.hpp>
 
+/**
+  * Version of layout of objects kept in shared memory file. It has to be increased whenever layout of any of them
+  * changes (also when members are only reordered), so node refuses to open state made by other version instead of
+  * reading it wrong - such state has to be replayed.
+  * 1 - account_object members reordered, hot ones first
+  */
+#define HIVE_STATE_VERSION 1
+
 namespace hive {
 
 namespace protocol {
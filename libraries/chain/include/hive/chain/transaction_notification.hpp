@@ -10,6 +10,8 @@ struct transaction_notification
   {
     transaction_id = tx.id();
   }
+  transaction_notification( const hive::protocol::signed_transaction& tx, const hive::protocol::transaction_id_type& id )
+    : transaction_id( id ), transaction(tx) {}
 
   hive::protocol::transaction_id_type          transaction_id;
   const hive::protocol::signed_transaction&    transaction;
@@ -101,6 +101,7 @@ class advanced_benchmark_dumper
     static std::string apply_context_name;
 
     bool enabled = false;
+    bool dump_to_file = true;
 
     uint32_t flush_cnt = 0;
     uint32_t flush_max = 500000;
@@ -132,12 +133,19 @@ class advanced_benchmark_dumper
 
     void set_enabled( bool val ) { enabled = val; }
     bool is_enabled() { return enabled; }
+    /// When turned off measurements are only collected (see get_info), files are never written (not even periodically)
+    void set_dump_to_file( bool val ) { dump_to_file = val; }
 
     void begin();
     void end( const std::string& str, uint64_t _count = 1 ) { end( apply_context_name, str, _count ); }
     void end( const std::string& context, const std::string& str, uint64_t _count = 1 );
 
     void dump();
+
+    /// Measurements collected so far (time in nanoseconds, time_per_count is only valid after dump)
+    const total_info< std::set< item > >& get_info() const { return info; }
+    /// Drops collected measurements, e.g. to skip warmup part of a benchmark
+    void reset() { info = total_info< std::set< item > >(); flush_cnt = 0; time_begin = 0; }
 };
 
 } } } // hive::chain::util
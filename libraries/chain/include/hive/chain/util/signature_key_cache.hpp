@@ -0,0 +1,82 @@
+#pragma once
+
+#include <hive/protocol/signed_transaction_transporter.hpp>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace hive { namespace chain { namespace util {
+
+using hive::protocol::chain_id_type;
+using hive::protocol::digest_type;
+using hive::protocol::public_key_type;
+using hive::protocol::signature_type;
+using hive::protocol::signed_transaction_transporter;
+using fc::ecc::canonical_signature_type;
+
+/**
+  * Remembers public keys recovered from recently seen transaction signatures.
+  *
+  * Transactions are usually validated when they arrive to the node (and keys are recovered then),
+  * and then once more when they are included in a block. With the cache the second recovery becomes
+  * a lookup. Keys of signatures not seen before can be recovered for the whole block at once, in
+  * parallel (see prefetch).
+  *
+  * Cache holds two generations of entries; when current one is full, previous one is dropped.
+  */
+class signature_key_cache
+{
+  public:
+    explicit signature_key_cache( size_t capacity = 50000 ) : _capacity( capacity ) {}
+
+    /// same as signed_transaction::get_signature_keys, but uses and fills the cache
+    flat_set< public_key_type > get_signature_keys( const signed_transaction_transporter& trx,
+      const chain_id_type& chain_id, canonical_signature_type canon_type );
+
+    /// recovers (in one batch) keys of all signatures of given transactions that are not in the cache yet
+    void prefetch( const vector< signed_transaction_transporter >& transactions,
+      const chain_id_type& chain_id, canonical_signature_type canon_type );
+
+    void clear();
+
+    /// number of signatures whose keys were found in the cache / were not there yet
+    uint64_t get_hit_count() const;
+    uint64_t get_miss_count() const;
+
+  private:
+    struct entry_key
+    {
+      digest_type     digest;
+      signature_type  signature;
+
+      bool operator==( const entry_key& other ) const
+      {
+        return digest == other.digest && signature == other.signature;
+      }
+    };
+
+    struct entry_key_hash
+    {
+      size_t operator()( const entry_key& k ) const
+      {
+        // digest is already a good hash, signature part distinguishes signatures of the same transaction
+        uint64_t sig_part;
+        memcpy( &sig_part, k.signature.begin() + 1, sizeof( sig_part ) );
+        return k.digest._hash[0] ^ sig_part;
+      }
+    };
+
+    typedef std::unordered_map< entry_key, public_key_type, entry_key_hash > entries_t;
+
+    fc::optional< public_key_type > find( const entry_key& key ) const;
+    void insert( const entry_key& key, const public_key_type& public_key );
+
+    const size_t        _capacity;
+    mutable std::mutex  _mutex;
+    entries_t           _current;
+    entries_t           _previous;
+    mutable uint64_t    _hits = 0;
+    mutable uint64_t    _misses = 0;
+};
+
+} } } // hive::chain::util
@@ -69,6 +69,9 @@ namespace hive { namespace chain { namespace util {
 
   void advanced_benchmark_dumper::dump()
   {
+    if( !dump_to_file )
+      return;
+
     total_info< std::multiset< ritem > > rinfo( info.total_time );
     std::for_each(info.items.begin(), info.items.end(), [&rinfo]( const item& obj )
     {
@@ -0,0 +1,110 @@
+#include <hive/chain/util/signature_key_cache.hpp>
+
+#include <hive/protocol/exceptions.hpp>
+
+namespace hive { namespace chain { namespace util {
+
+flat_set< public_key_type > signature_key_cache::get_signature_keys( const signed_transaction_transporter& trx,
+  const chain_id_type& chain_id, canonical_signature_type canon_type )
+{ try {
+  const digest_type digest = trx.trx.sig_digest( chain_id, trx.get_pack() );
+  flat_set< public_key_type > result;
+  for( const auto& sig : trx.trx.signatures )
+  {
+    entry_key key{ digest, sig };
+    fc::optional< public_key_type > public_key = find( key );
+    if( public_key.valid() )
+    {
+      // only recovery is cached, canonicity requirement could have changed since
+      FC_ASSERT( fc::ecc::public_key::is_canonical( sig, canon_type ), "signature is not canonical" );
+    }
+    else
+    {
+      public_key = public_key_type( fc::ecc::public_key( sig, digest, canon_type ) );
+      insert( key, *public_key );
+    }
+
+    HIVE_ASSERT(
+      result.insert( *public_key ).second,
+      hive::protocol::tx_duplicate_sig,
+      "Duplicate Signature detected" );
+  }
+  return result;
+} FC_CAPTURE_AND_RETHROW() }
+
+void signature_key_cache::prefetch( const vector< signed_transaction_transporter >& transactions,
+  const chain_id_type& chain_id, canonical_signature_type canon_type )
+{
+  std::vector< std::pair< fc::sha256, fc::ecc::compact_signature > > missing;
+  for( const auto& trx : transactions )
+  {
+    if( trx.trx.signatures.empty() )
+      continue;
+    const digest_type digest = trx.trx.sig_digest( chain_id, trx.get_pack() );
+    for( const auto& sig : trx.trx.signatures )
+    {
+      if( !find( entry_key{ digest, sig } ).valid() )
+        missing.emplace_back( digest, sig );
+    }
+  }
+
+  if( missing.empty() )
+    return;
+
+  // invalid signatures are skipped here, they will be reported when their transaction is verified
+  auto keys = fc::ecc::public_key::recover_many( missing, canon_type );
+  for( size_t i = 0; i < missing.size(); ++i )
+  {
+    if( keys[i].valid() )
+      insert( entry_key{ missing[i].first, missing[i].second }, public_key_type( *keys[i] ) );
+  }
+}
+
+void signature_key_cache::clear()
+{
+  std::lock_guard< std::mutex > guard( _mutex );
+  _current.clear();
+  _previous.clear();
+}
+
+uint64_t signature_key_cache::get_hit_count() const
+{
+  std::lock_guard< std::mutex > guard( _mutex );
+  return _hits;
+}
+
+uint64_t signature_key_cache::get_miss_count() const
+{
+  std::lock_guard< std::mutex > guard( _mutex );
+  return _misses;
+}
+
+fc::optional< public_key_type > signature_key_cache::find( const entry_key& key ) const
+{
+  std::lock_guard< std::mutex > guard( _mutex );
+  auto it = _current.find( key );
+  if( it == _current.end() )
+  {
+    it = _previous.find( key );
+    if( it == _previous.end() )
+    {
+      ++_misses;
+      return fc::optional< public_key_type >();
+    }
+  }
+  ++_hits;
+  return it->second;
+}
+
+void signature_key_cache::insert( const entry_key& key, const public_key_type& public_key )
+{
+  std::lock_guard< std::mutex > guard( _mutex );
+  if( _current.size() >= _capacity )
+  {
+    _previous.clear();
+    _previous.swap( _current );
+  }
+  _current.emplace( key, public_key );
+}
+
+} } } // hive::chain::util
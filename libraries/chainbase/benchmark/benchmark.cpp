@@ -0,0 +1,522 @@
+#include <chainbase/chainbase.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/program_options.hpp>
+
+#include <array>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+/*
+  Microbenchmarks of chainbase indexes and undo sessions. They don't need any chain data. The same
+  source is built twice: chainbase_benchmark keeps objects in managed_mapped_file, while
+  chainbase_benchmark_std_allocator is built with ENABLE_STD_ALLOCATOR (objects on the heap).
+  JSON output follows the format of Google Benchmark, so results of both builds (or of two versions
+  of the code) can be compared with its tools/compare.py script.
+*/
+
+using namespace chainbase;
+using namespace boost::multi_index;
+
+struct by_key;
+
+// object with payload of given size and an ordered unique secondary key, like typical chain object
+#define BENCH_OBJECT( NAME, TYPE_ID, PAYLOAD_SIZE, KEY_INDEX )                                   \
+class NAME : public chainbase::object< TYPE_ID, NAME >                                           \
+{                                                                                                \
+  CHAINBASE_OBJECT( NAME );                                                                      \
+public:                                                                                          \
+  CHAINBASE_DEFAULT_CONSTRUCTOR( NAME )                                                          \
+                                                                                                 \
+  uint64_t                          key = 0;                                                     \
+  std::array< char, PAYLOAD_SIZE >  payload;                                                     \
+};                                                                                               \
+typedef multi_index_container<                                                                   \
+  NAME,                                                                                          \
+  indexed_by<                                                                                    \
+    ordered_unique< tag< by_id >, const_mem_fun< NAME, NAME::id_type, &NAME::get_id > >,         \
+    KEY_INDEX< tag< by_key >, member< NAME, uint64_t, &NAME::key > >                             \
+  >,                                                                                             \
+  chainbase::allocator< NAME >                                                                   \
+> NAME##_index;                                                                                  \
+CHAINBASE_SET_INDEX_TYPE( NAME, NAME##_index )                                                   \
+FC_REFLECT( NAME, (id)(key) )                                                                    \
+namespace fc { namespace raw {                                                                   \
+template< typename Stream > inline void pack( Stream&, const NAME& ) {}                          \
+template< typename Stream > inline void unpack( Stream&, NAME&, uint32_t = 0 ) {}                \
+} }
+
+BENCH_OBJECT( object_16, 1, 16, ordered_unique )
+BENCH_OBJECT( object_64, 2, 64, ordered_unique )
+BENCH_OBJECT( object_256, 3, 256, ordered_unique )
+BENCH_OBJECT( object_1024, 4, 1024, ordered_unique )
+// same as object_64 but with hashed secondary index
+BENCH_OBJECT( hashed_object_64, 5, 64, hashed_unique )
+
+namespace {
+
+/// Controls measured loop of single benchmark run, similar to benchmark::State of Google Benchmark
+class bench_state
+{
+  public:
+    bench_state( uint64_t iterations, int64_t arg ) : _iterations( iterations ), _arg( arg ) {}
+
+    uint64_t iterations() const { return _iterations; }
+    int64_t arg() const { return _arg; }
+
+    /// Excludes preparation work from measured time
+    void pause_timing()
+    {
+      _elapsed += std::chrono::steady_clock::now() - _start;
+      _cpu_elapsed += std::clock() - _cpu_start;
+    }
+    void resume_timing()
+    {
+      _start = std::chrono::steady_clock::now();
+      _cpu_start = std::clock();
+    }
+
+    /// Number of processed items when it differs from number of iterations (e.g. elements visited)
+    void set_items_processed( uint64_t items ) { _items = items; }
+    uint64_t items_processed() const { return _items ? _items : _iterations; }
+
+    std::chrono::steady_clock::duration elapsed() const { return _elapsed; }
+    double cpu_seconds() const { return double( _cpu_elapsed ) / CLOCKS_PER_SEC; }
+
+  private:
+    uint64_t                                _iterations;
+    int64_t                                 _arg;
+    uint64_t                                _items = 0;
+    std::chrono::steady_clock::time_point   _start;
+    std::chrono::steady_clock::duration     _elapsed{ 0 };
+    std::clock_t                            _cpu_start = 0;
+    std::clock_t                            _cpu_elapsed = 0;
+};
+
+struct bench_definition
+{
+  std::string                           name;
+  std::function< void( bench_state& ) > body;
+  int64_t                               arg;
+};
+
+struct bench_result
+{
+  std::string name;
+  uint64_t    iterations = 0;
+  double      real_time_ns = 0; // per item
+  double      cpu_time_ns = 0; // per item
+  double      items_per_second = 0;
+};
+
+uint64_t population = 100000;
+uint64_t shared_file_size = uint64_t( 4 ) << 30;
+
+/// Fresh database in temporary directory with all benchmark indexes
+class bench_database
+{
+  public:
+    bench_database()
+      : _dir( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "chainbase-bench-%%%%-%%%%" ) )
+    {
+      _db.open( _dir, 0, shared_file_size );
+      _db.add_index< object_16_index >();
+      _db.add_index< object_64_index >();
+      _db.add_index< object_256_index >();
+      _db.add_index< object_1024_index >();
+      _db.add_index< hashed_object_64_index >();
+    }
+
+    ~bench_database()
+    {
+      _db.close();
+      boost::filesystem::remove_all( _dir );
+    }
+
+    database& db() { return _db; }
+
+    /// Creates objects with keys 0 .. count-1 in random order
+    template< typename Object >
+    void populate( uint64_t count )
+    {
+      std::vector< uint64_t > keys( count );
+      for( uint64_t i = 0; i < count; ++i )
+        keys[i] = i;
+      std::shuffle( keys.begin(), keys.end(), _random );
+
+      for( uint64_t key : keys )
+        _db.create< Object >( [&]( Object& o ) { o.key = key; } );
+    }
+
+    std::mt19937_64& random() { return _random; }
+
+  private:
+    boost::filesystem::path _dir;
+    database                _db;
+    std::mt19937_64         _random{ 42 }; // fixed seed, runs are repeatable
+};
+
+template< typename Object >
+void bench_create( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+
+  state.resume_timing();
+  for( uint64_t i = 0; i < state.iterations(); ++i )
+    db.create< Object >( [&]( Object& o ) { o.key = i; } );
+  state.pause_timing();
+}
+
+template< typename Object >
+void bench_modify( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< Object >( population );
+  std::vector< uint64_t > ids( state.iterations() );
+  for( auto& id : ids )
+    id = bdb.random()() % population;
+
+  state.resume_timing();
+  for( uint64_t id : ids )
+  {
+    db.modify( db.get< Object >( typename Object::id_type( id ) ), []( Object& o ) { ++o.payload[0]; } );
+  }
+  state.pause_timing();
+}
+
+template< typename Object >
+void bench_modify_key( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< Object >( population );
+  std::vector< uint64_t > ids( state.iterations() );
+  for( auto& id : ids )
+    id = bdb.random()() % population;
+  uint64_t next_key = population;
+
+  state.resume_timing();
+  for( uint64_t id : ids )
+  {
+    // changed key has to be reindexed in secondary index
+    db.modify( db.get< Object >( typename Object::id_type( id ) ), [&]( Object& o ) { o.key = next_key++; } );
+  }
+  state.pause_timing();
+}
+
+template< typename Object >
+void bench_remove( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< Object >( state.iterations() );
+  std::vector< uint64_t > ids( state.iterations() );
+  for( uint64_t i = 0; i < ids.size(); ++i )
+    ids[i] = i;
+  std::shuffle( ids.begin(), ids.end(), bdb.random() );
+
+  state.resume_timing();
+  for( uint64_t id : ids )
+    db.remove( db.get< Object >( typename Object::id_type( id ) ) );
+  state.pause_timing();
+}
+
+/// Opens given number of undo sessions, each with a few changes, and leaves them on the stack
+void push_sessions( bench_database& bdb, int64_t depth )
+{
+  auto& db = bdb.db();
+  for( int64_t i = 0; i < depth; ++i )
+  {
+    auto session = db.start_undo_session();
+    for( int j = 0; j < 10; ++j )
+      db.modify( db.get< object_64 >( object_64::id_type( bdb.random()() % population ) ), []( object_64& o ) { ++o.payload[0]; } );
+    session.push();
+  }
+}
+
+// start of empty session and its undo (destructor)
+void bench_session_start( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< object_64 >( population );
+  push_sessions( bdb, state.arg() );
+
+  state.resume_timing();
+  for( uint64_t i = 0; i < state.iterations(); ++i )
+  {
+    auto session = db.start_undo_session();
+  }
+  state.pause_timing();
+}
+
+// session with create, modify and remove reverted with undo
+void bench_session_undo( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< object_64 >( population );
+  push_sessions( bdb, state.arg() );
+
+  state.resume_timing();
+  for( uint64_t i = 0; i < state.iterations(); ++i )
+  {
+    auto session = db.start_undo_session();
+    db.create< object_64 >( [&]( object_64& o ) { o.key = population + i; } );
+    db.modify( db.get< object_64 >( object_64::id_type( i % population ) ), []( object_64& o ) { ++o.payload[0]; } );
+    db.remove( db.get< object_64 >( object_64::id_type( ( i + 1 ) % population ) ) );
+    session.undo();
+  }
+  state.pause_timing();
+}
+
+// session with create and modify merged into previous session (there is always at least one)
+void bench_session_squash( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< object_64 >( population );
+  push_sessions( bdb, std::max< int64_t >( state.arg(), 1 ) );
+
+  state.resume_timing();
+  for( uint64_t i = 0; i < state.iterations(); ++i )
+  {
+    auto session = db.start_undo_session();
+    db.create< object_64 >( [&]( object_64& o ) { o.key = population + i; } );
+    db.modify( db.get< object_64 >( object_64::id_type( i % population ) ), []( object_64& o ) { ++o.payload[0]; } );
+    session.squash();
+  }
+  state.pause_timing();
+}
+
+template< typename Object, typename Tag >
+void bench_iterate( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< Object >( population );
+  const auto& idx = db.get_index< typename get_index_type< Object >::type, Tag >();
+
+  uint64_t sum = 0;
+  state.resume_timing();
+  for( uint64_t i = 0; i < state.iterations(); ++i )
+  {
+    for( const auto& o : idx )
+      sum += o.key;
+  }
+  state.pause_timing();
+  state.set_items_processed( state.iterations() * population );
+  if( sum == 1 ) // prevents optimizing the loop away
+    std::cerr << sum;
+}
+
+template< typename Object >
+void bench_find_by_key( bench_state& state )
+{
+  bench_database bdb;
+  auto& db = bdb.db();
+  bdb.populate< Object >( population );
+  const auto& idx = db.get_index< typename get_index_type< Object >::type, by_key >();
+  std::vector< uint64_t > keys( state.iterations() );
+  for( auto& key : keys )
+    key = bdb.random()() % population;
+
+  uint64_t found = 0;
+  state.resume_timing();
+  for( uint64_t key : keys )
+    found += idx.find( key ) != idx.end();
+  state.pause_timing();
+  if( found != keys.size() )
+    std::cerr << "missing keys\n";
+}
+
+std::vector< bench_definition > all_benchmarks()
+{
+  std::vector< bench_definition > result;
+  auto add = [&]( const std::string& name, std::function< void( bench_state& ) > body, int64_t arg = 0 )
+  {
+    result.push_back( bench_definition{ name, body, arg } );
+  };
+
+  add( "create/16", bench_create< object_16 > );
+  add( "create/64", bench_create< object_64 > );
+  add( "create/256", bench_create< object_256 > );
+  add( "create/1024", bench_create< object_1024 > );
+  add( "create/hashed/64", bench_create< hashed_object_64 > );
+
+  add( "modify/16", bench_modify< object_16 > );
+  add( "modify/64", bench_modify< object_64 > );
+  add( "modify/256", bench_modify< object_256 > );
+  add( "modify/1024", bench_modify< object_1024 > );
+  add( "modify_key/64", bench_modify_key< object_64 > );
+  add( "modify_key/hashed/64", bench_modify_key< hashed_object_64 > );
+
+  add( "remove/16", bench_remove< object_16 > );
+  add( "remove/64", bench_remove< object_64 > );
+  add( "remove/256", bench_remove< object_256 > );
+  add( "remove/1024", bench_remove< object_1024 > );
+  add( "remove/hashed/64", bench_remove< hashed_object_64 > );
+
+  for( int64_t depth : { 0, 1, 16, 256 } )
+  {
+    add( "undo_session/start/depth:" + std::to_string( depth ), bench_session_start, depth );
+    add( "undo_session/undo/depth:" + std::to_string( depth ), bench_session_undo, depth );
+    if( depth > 0 )
+      add( "undo_session/squash/depth:" + std::to_string( depth ), bench_session_squash, depth );
+  }
+
+  add( "iterate/by_id/64", bench_iterate< object_64, by_id > );
+  add( "iterate/ordered_key/64", bench_iterate< object_64, by_key > );
+  add( "iterate/hashed_key/64", bench_iterate< hashed_object_64, by_key > );
+
+  add( "find/ordered_key/64", bench_find_by_key< object_64 > );
+  add( "find/hashed_key/64", bench_find_by_key< hashed_object_64 > );
+
+  return result;
+}
+
+class bench_runner
+{
+  public:
+    explicit bench_runner( double min_time ) : _min_time( min_time ) {}
+
+    /// Repeats the benchmark with growing number of iterations until it runs long enough
+    bench_result run( const bench_definition& bench ) const
+    {
+      uint64_t iterations = 1;
+      while( true )
+      {
+        bench_state state( iterations, bench.arg );
+        bench.body( state );
+        const double seconds = std::chrono::duration< double >( state.elapsed() ).count();
+
+        if( seconds >= _min_time || iterations >= max_iterations )
+        {
+          bench_result result;
+          result.name = bench.name;
+          result.iterations = iterations;
+          result.real_time_ns = seconds * 1e9 / state.items_processed();
+          result.cpu_time_ns = state.cpu_seconds() * 1e9 / state.items_processed();
+          result.items_per_second = seconds > 0 ? state.items_processed() / seconds : 0;
+          return result;
+        }
+
+        // aim a bit above minimal time, but grow at most 10 times in one step
+        const double factor = seconds > 0 ? std::min( 10.0, _min_time * 1.4 / seconds ) : 10.0;
+        iterations = std::min< uint64_t >( max_iterations, std::max< uint64_t >( iterations + 1, uint64_t( iterations * factor ) ) );
+      }
+    }
+
+  private:
+    static constexpr uint64_t max_iterations = 10000000;
+
+    double _min_time;
+};
+
+#ifdef ENABLE_STD_ALLOCATOR
+const char* const executable_name = "chainbase_benchmark_std_allocator";
+const char* const allocator_name = "std::allocator";
+#else
+const char* const executable_name = "chainbase_benchmark";
+const char* const allocator_name = "managed_mapped_file";
+#endif
+
+void print_json( std::ostream& out, const std::vector< bench_result >& results )
+{
+  out << "{\n  \"context\": {\n    \"executable\": \"" << executable_name << "\",\n    \"allocator\": \"" << allocator_name
+      << "\",\n    \"population\": " << population << "\n  },\n  \"benchmarks\": [";
+  for( size_t i = 0; i < results.size(); ++i )
+  {
+    const auto& r = results[i];
+    out << ( i ? ",\n" : "\n" ) << "    {\"name\": \"" << r.name << "\", \"run_name\": \"" << r.name
+        << "\", \"run_type\": \"iteration\", \"iterations\": " << r.iterations
+        << ", \"real_time\": " << r.real_time_ns << ", \"cpu_time\": " << r.cpu_time_ns
+        << ", \"time_unit\": \"ns\", \"items_per_second\": " << r.items_per_second << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+} // anonymous
+
+int main( int argc, char** argv )
+{
+  try
+  {
+    namespace po = boost::program_options;
+
+    po::options_description options( "Allowed options" );
+    options.add_options()
+      ( "filter", po::value< std::string >()->default_value( ".*" ), "Run only benchmarks with names matching this regular expression" )
+      ( "min-time", po::value< double >()->default_value( 0.5 ), "Minimal measured time of each benchmark in seconds" )
+      ( "population", po::value< uint64_t >()->default_value( population ), "Number of objects in index for modify, undo, iterate and find benchmarks" )
+      ( "shared-file-size", po::value< uint64_t >()->default_value( shared_file_size >> 20 ), "Size of shared memory file in MB" )
+      ( "json", po::bool_switch()->default_value( false ), "Print results as JSON (Google Benchmark format)" )
+      ( "list", po::bool_switch()->default_value( false ), "Only list benchmarks" )
+      ( "help,h", "Print usage instructions" );
+
+    po::variables_map options_map;
+    po::store( po::parse_command_line( argc, argv, options ), options_map );
+    if( options_map.count( "help" ) )
+    {
+      std::cout << options << "\n";
+      return 0;
+    }
+    po::notify( options_map );
+
+    population = options_map[ "population" ].as< uint64_t >();
+    shared_file_size = options_map[ "shared-file-size" ].as< uint64_t >() << 20;
+    const std::regex filter( options_map[ "filter" ].as< std::string >() );
+    const bool json = options_map[ "json" ].as< bool >();
+    const bench_runner runner( options_map[ "min-time" ].as< double >() );
+
+    if( !json )
+      std::cout << "allocator: " << allocator_name << ", population: " << population << "\n"
+                << std::left << std::setw( 36 ) << "benchmark" << std::right << std::setw( 14 ) << "ns/item"
+                << std::setw( 12 ) << "iterations" << std::setw( 16 ) << "items/s" << "\n";
+
+    std::vector< bench_result > results;
+    for( const auto& bench : all_benchmarks() )
+    {
+      if( !std::regex_search( bench.name, filter ) )
+        continue;
+      if( options_map[ "list" ].as< bool >() )
+      {
+        std::cout << bench.name << "\n";
+        continue;
+      }
+
+      results.push_back( runner.run( bench ) );
+      if( !json )
+      {
+        const auto& r = results.back();
+        std::cout << std::left << std::setw( 36 ) << r.name << std::right << std::fixed << std::setprecision( 1 )
+                  << std::setw( 14 ) << r.real_time_ns << std::setw( 12 ) << r.iterations
+                  << std::setprecision( 0 ) << std::setw( 16 ) << r.items_per_second << std::endl;
+      }
+    }
+
+    if( json )
+      print_json( std::cout, results );
+    return 0;
+  }
+  catch( const std::exception& e )
+  {
+    std::cerr << e.what() << "\n";
+  }
+  return 1;
+}
@@ -28,6 +28,7 @@
 #include <array>
 #include <atomic>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <stdexcept>
 #include <typeindex>
@@ -63,11 +64,13 @@ namespace helpers
 
     const std::string&   version_info;
     const t_plugins      plugins;
+    /// version of layout of objects kept in storage, storage made with different one is not opened (replay is required)
+    const uint32_t       state_version;
 
     logger_type          logger;
 
-    environment_extension_resources( const std::string& _version_info, t_plugins&& _plugins, logger_type&& _logger )
-                      : version_info( _version_info ), plugins( _plugins ), logger( _logger )
+    environment_extension_resources( const std::string& _version_info, t_plugins&& _plugins, uint32_t _state_version, logger_type&& _logger )
+                      : version_info( _version_info ), plugins( _plugins ), state_version( _state_version ), logger( _logger )
     {
     }
 
@@ -119,7 +122,9 @@ namespace chainbase {
   enum open_flags
   {
     skip_nothing               = 0,
-    skip_env_check             = 1 << 0 // Skip environment check on db open
+    skip_env_check             = 1 << 0, // Skip environment check on db open
+    huge_pages                 = 1 << 1, // Ask kernel to back shared memory with transparent huge pages
+    prefault                   = 1 << 2  // Read whole shared memory file in parallel right after opening
   };
 
   struct strcmp_less
@@ -851,13 +856,27 @@ namespace chainbase {
       };
 
       void wipe_indexes();
+      /// applies memory hints related to open flags to freshly mapped segment
+      void advise_segment( uint32_t flags );
+      void prefault_segment();
+      /// reserves address range for shared memory file, returns address the segment should be mapped at (or nullptr)
+      void* reserve_address_space( size_t file_size );
+      void release_address_space();
+      /// sets _segment to the result of map_at called with address inside reserved range (see implementation for retries)
+      void map_segment( size_t file_size, const std::function< bip::managed_mapped_file*( void* address ) >& map_at );
+      /// extends shared memory file inside reserved address range, so no pointers are invalidated
+      bool grow_in_place( size_t new_shared_file_size );
 
     public:
+      ~database();
+
       void open( const bfs::path& dir, uint32_t flags = 0, size_t shared_file_size = 0, const boost::any& database_cfg = nullptr, const helpers::environment_extension_resources* environment_extension = nullptr, const bool wipe_shared_file = false );
       void close();
       void flush();
       void wipe( const bfs::path& dir );
       void resize( size_t new_shared_file_size );
+      /// makes next open reserve address space for the shared memory file up to given size, so resize can grow it without remapping
+      void set_max_shared_file_size( size_t max_shared_file_size ) { _max_file_size = max_shared_file_size; }
       void set_require_locking( bool enable_require_locking );
 
 #ifdef CHAINBASE_CHECK_LOCKING
@@ -977,6 +996,11 @@ namespace chainbase {
         return _file_size;
       }
 
+      size_t get_reserved_memory()const
+      {
+        return _reserved_address != nullptr ? _reserved_size : _file_size;
+      }
+
       template<typename MultiIndexType>
       bool has_index()const
       {
@@ -1249,6 +1273,12 @@ namespace chainbase {
 
       int32_t                                                     _undo_session_count = 0;
       size_t                                                      _file_size = 0;
+      uint32_t                                                    _open_flags = 0;
+      size_t                                                      _max_file_size = 0;
+      char*                                                       _reserved_address = nullptr;
+      size_t                                                      _reserved_size = 0;
+      /// part of reserved range mapped by _segment itself, the rest was mapped when growing in place
+      size_t                                                      _segment_mapped_size = 0;
       boost::any                                                  _database_cfg = nullptr;
   };
 
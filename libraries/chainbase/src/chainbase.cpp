@@ -2,8 +2,15 @@
 #include <boost/array.hpp>
 #include <boost/any.hpp>
 #include <iostream>
+#include <thread>
 #include <fc/log/logger.hpp>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace chainbase {
 
 size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache_max_size() const
@@ -46,8 +53,8 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
       {
 #ifndef ENABLE_STD_ALLOCATOR
         plugins = other.plugins;
-#endif
         version_info = other.version_info;
+#endif
         compiler_version = other.compiler_version;
         debug = other.debug;
         apple = other.apple;
@@ -142,6 +149,12 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
       bool                    created_storage = true;
   };
 
+  database::~database()
+  {
+    _segment.reset();
+    release_address_space();
+  }
+
   void database::open( const bfs::path& dir, uint32_t flags, size_t shared_file_size, const boost::any& database_cfg, const helpers::environment_extension_resources* environment_extension, const bool wipe_shared_file )
   {
     assert( dir.is_absolute() );
@@ -153,7 +166,11 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
     _database_cfg = database_cfg;
 #ifndef ENABLE_STD_ALLOCATOR
     auto abs_path = bfs::absolute( dir / "shared_memory.bin" );
-    
+
+    // segment has to be unmapped before its address range can be reserved again
+    _segment.reset();
+    release_address_space();
+
     if( bfs::exists( abs_path ) )
     {
       _file_size = bfs::file_size( abs_path );
@@ -165,9 +182,19 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
         _file_size = shared_file_size;
       }
 
-      _segment.reset( new bip::managed_mapped_file( bip::open_only,
-                                      abs_path.generic_string().c_str()
-                                      ) );
+      map_segment( _file_size, [&]( void* address )
+      {
+        return new bip::managed_mapped_file( bip::open_only, abs_path.generic_string().c_str(), address );
+      } );
+
+      // unlike the environment, layout of objects cannot be forced past - state made by other version has to be replayed;
+      // storage made before the version was stored counts as version 0
+      const uint32_t state_version = environment_extension ? environment_extension->state_version : 0;
+      auto stored_state_version = _segment->find< uint32_t >( "state_version" );
+      const uint32_t persistent_state_version = stored_state_version.first ? *stored_state_version.first : 0;
+      if( persistent_state_version != state_version )
+        BOOST_THROW_EXCEPTION( std::runtime_error( "Persistent storage has state version " + std::to_string( persistent_state_version ) +
+          " but current node requires state version " + std::to_string( state_version ) + ". Layout of objects changed, replay is required." ) );
 
       auto env = _segment->find< environment_check >( "environment" );
 
@@ -204,10 +231,22 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
       }
     } else {
       _file_size = shared_file_size;
-      _segment.reset( new bip::managed_mapped_file( bip::create_only,
-                                      abs_path.generic_string().c_str(), shared_file_size
-                                      ) );
+      map_segment( shared_file_size, [&]( void* address )
+      {
+        try
+        {
+          return new bip::managed_mapped_file( bip::create_only, abs_path.generic_string().c_str(), shared_file_size, address );
+        }
+        catch( const bip::interprocess_exception& e )
+        {
+          // file was created, only mapping it at given address failed - it has to be created again
+          if( e.get_error_code() == bip::busy_error )
+            bfs::remove( abs_path );
+          throw;
+        }
+      } );
       _segment->find_or_construct< environment_check >( "environment" )( allocator< environment_check >( _segment->get_segment_manager() ) );
+      _segment->find_or_construct< uint32_t >( "state_version" )( environment_extension ? environment_extension->state_version : 0 );
     }
 
     auto env = _segment->find< environment_check >( "environment" );
@@ -217,14 +256,201 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
     _flock = bip::file_lock( abs_path.generic_string().c_str() );
     if( !_flock.try_lock() )
       BOOST_THROW_EXCEPTION( std::runtime_error( "could not gain write access to the shared memory file" ) );
+
+    // only after the lock is ours - prefaulting file used by other process would be just wasted I/O
+    _open_flags = flags;
+    advise_segment( flags );
 #endif
 
     _is_open = true;
   }
 
+  void database::advise_segment( uint32_t flags )
+  {
+#ifndef WIN32
+    if( flags & huge_pages )
+    {
+#ifdef MADV_HUGEPAGE
+      // file backed mappings only get huge pages when shared-file-dir is placed on tmpfs (shmem_enabled=advise)
+      if( madvise( _segment->get_address(), _segment->get_size(), MADV_HUGEPAGE ) != 0 )
+        wlog( "Unable to use huge pages for shared memory file: ${e}", ( "e", strerror( errno ) ) );
+#else
+      wlog( "Huge pages for shared memory file are not supported on this platform" );
+#endif
+    }
+    if( flags & prefault )
+      prefault_segment();
+#endif
+  }
+
+  void database::prefault_segment()
+  {
+#ifndef WIN32
+    const size_t chunk_size = 64 * 1024 * 1024;
+    const size_t page_size = sysconf( _SC_PAGE_SIZE );
+    char* const begin = static_cast< char* >( _segment->get_address() );
+    const size_t size = _segment->get_size();
+    const size_t chunk_count = ( size + chunk_size - 1 ) / chunk_size;
+    const size_t thread_count = std::max< size_t >( 1, std::min< size_t >( std::thread::hardware_concurrency(), chunk_count ) );
+
+    ilog( "Prefaulting ${s} bytes of shared memory file using ${t} threads", ( "s", size )( "t", thread_count ) );
+    const auto start = boost::chrono::steady_clock::now();
+
+    std::atomic< size_t > next_chunk = { 0 };
+    std::atomic< size_t > done_chunks = { 0 };
+    auto worker = [&]()
+    {
+      for( size_t chunk = next_chunk++; chunk < chunk_count; chunk = next_chunk++ )
+      {
+        char* const chunk_begin = begin + chunk * chunk_size;
+        const size_t length = std::min( chunk_size, size - chunk * chunk_size );
+#ifdef MADV_POPULATE_READ
+        if( madvise( chunk_begin, length, MADV_POPULATE_READ ) != 0 )
+#endif
+        {
+          // reading is enough to map pages without making them dirty
+          volatile char sink = 0;
+          for( size_t offset = 0; offset < length; offset += page_size )
+            sink = chunk_begin[ offset ];
+          (void)sink;
+        }
+
+        const size_t done = ++done_chunks;
+        if( done * 10 / chunk_count != ( done - 1 ) * 10 / chunk_count )
+          ilog( "Prefaulting shared memory file: ${p}%", ( "p", done * 100 / chunk_count ) );
+      }
+    };
+
+    std::vector< std::thread > threads;
+    for( size_t i = 1; i < thread_count; ++i )
+      threads.emplace_back( worker );
+    worker();
+    for( auto& t : threads )
+      t.join();
+
+    ilog( "Shared memory file prefaulted in ${ms} ms", ( "ms",
+      boost::chrono::duration_cast< boost::chrono::milliseconds >( boost::chrono::steady_clock::now() - start ).count() ) );
+#endif
+  }
+
+  void* database::reserve_address_space( size_t file_size )
+  {
+#ifdef __linux__
+    const size_t page_size = sysconf( _SC_PAGE_SIZE );
+    const size_t reserved_size = ( _max_file_size + page_size - 1 ) / page_size * page_size;
+    const size_t segment_size = ( file_size + page_size - 1 ) / page_size * page_size;
+    if( reserved_size <= segment_size )
+      return nullptr;
+
+    void* address = mmap( nullptr, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if( address == MAP_FAILED )
+    {
+      wlog( "Unable to reserve ${s} bytes of address space for shared memory file: ${e}", ( "s", reserved_size )( "e", strerror( errno ) ) );
+      return nullptr;
+    }
+
+    // segment is mapped at the start of reserved range, the rest stays reserved for growth
+    munmap( address, segment_size );
+    _reserved_address = static_cast< char* >( address );
+    _reserved_size = reserved_size;
+    _segment_mapped_size = segment_size;
+    return address;
+#else
+    return nullptr;
+#endif
+  }
+
+  void database::map_segment( size_t file_size, const std::function< bip::managed_mapped_file*( void* address ) >& map_at )
+  {
+    // boost passes the address to mmap only as a hint (no MAP_FIXED) and throws busy_error when the mapping lands
+    // elsewhere; since the head of reservation has to be released first, other thread could take it in the meantime,
+    // in which case whole reservation is made again, and as last resort segment is mapped without reservation
+    const int max_attempts = 3;
+    for( int attempt = 1; ; ++attempt )
+    {
+      void* address = reserve_address_space( file_size );
+      try
+      {
+        _segment.reset( map_at( address ) );
+        return;
+      }
+      catch( const bip::interprocess_exception& e )
+      {
+        release_address_space();
+        if( address == nullptr || e.get_error_code() != bip::busy_error )
+          throw;
+        wlog( "Unable to map shared memory file inside reserved address range (attempt ${a})", ( "a", attempt ) );
+        if( attempt == max_attempts )
+        {
+          _segment.reset( map_at( nullptr ) );
+          return;
+        }
+      }
+      catch( ... )
+      {
+        release_address_space();
+        throw;
+      }
+    }
+  }
+
+  void database::release_address_space()
+  {
+#ifdef __linux__
+    if( _reserved_address == nullptr )
+      return;
+    // covers both parts mapped when growing in place and still unused reservation
+    munmap( _reserved_address + _segment_mapped_size, _reserved_size - _segment_mapped_size );
+    _reserved_address = nullptr;
+    _reserved_size = 0;
+    _segment_mapped_size = 0;
+#endif
+  }
+
+  bool database::grow_in_place( size_t new_shared_file_size )
+  {
+#ifdef __linux__
+    const size_t page_size = sysconf( _SC_PAGE_SIZE );
+    new_shared_file_size = ( new_shared_file_size + page_size - 1 ) / page_size * page_size;
+    if( _reserved_address == nullptr || new_shared_file_size <= _file_size || new_shared_file_size > _reserved_size || _file_size % page_size != 0 )
+      return false;
+
+    const size_t extra_size = new_shared_file_size - _file_size;
+    const auto abs_path = bfs::absolute( _data_dir / "shared_memory.bin" );
+    int fd = ::open( abs_path.generic_string().c_str(), O_RDWR );
+    if( fd < 0 )
+      return false;
+
+    bool result = ftruncate( fd, new_shared_file_size ) == 0 &&
+      mmap( _reserved_address + _file_size, extra_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, _file_size ) != MAP_FAILED;
+    ::close( fd );
+    if( !result )
+    {
+      wlog( "Unable to grow shared memory file in place: ${e}", ( "e", strerror( errno ) ) );
+      return false;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if( _open_flags & huge_pages )
+      madvise( _reserved_address + _file_size, extra_size, MADV_HUGEPAGE );
+#endif
+
+    _segment->get_segment_manager()->grow( extra_size );
+    _file_size = new_shared_file_size;
+    return true;
+#else
+    return false;
+#endif
+  }
+
   void database::flush() {
     if( _segment )
       _segment->flush();
+#ifdef __linux__
+    // _segment only knows about the part of file it mapped itself
+    if( _reserved_address != nullptr && _file_size > _segment_mapped_size )
+      msync( _reserved_address + _segment_mapped_size, _file_size - _segment_mapped_size, MS_SYNC );
+#endif
     if( _meta )
       _meta->flush();
   }
@@ -234,6 +460,7 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
     if( _is_open )
     {
       _segment.reset();
+      release_address_space();
       _meta.reset();
       _data_dir = bfs::path();
 
@@ -253,6 +480,7 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
   {
     assert( !_is_open );
     _segment.reset();
+    release_address_space();
     _meta.reset();
     bfs::remove_all( dir / "shared_memory.bin" );
     bfs::remove_all( dir / "shared_memory.meta" );
@@ -264,13 +492,19 @@ size_t snapshot_base_serializer::worker_common_base::get_serialized_object_cache
 
   void database::resize( size_t new_shared_file_size )
   {
+    // growing inside reserved address range keeps all objects in place, so it is safe at any time
+    if( grow_in_place( new_shared_file_size ) )
+      return;
+
     if( _undo_session_count )
       BOOST_THROW_EXCEPTION( std::runtime_error( "Cannot resize shared memory file while undo session is active" ) );
 
     _segment.reset();
+    release_address_space();
     _meta.reset();
 
-    open( _data_dir, 0, new_shared_file_size );
+    // remapped segment needs hints again, but resize happens during normal work, so no prefaulting
+    open( _data_dir, _open_flags & huge_pages, new_shared_file_size );
 
     wipe_indexes();
 
@@ -153,4 +153,128 @@ BOOST_AUTO_TEST_CASE( open_and_create ) {
   }
 }
 
-// BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
+BOOST_AUTO_TEST_CASE( open_with_memory_hints ) {
+  boost::filesystem::path temp = boost::filesystem::absolute( boost::filesystem::unique_path() );
+  try {
+    {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+      db.create<book>( []( book& b ) {
+          b.a = 3;
+          b.b = 4;
+      } );
+    }
+
+    chainbase::database db;
+    db.open( temp, chainbase::huge_pages | chainbase::prefault, 1024*1024*16 );
+    db.add_index< book_index >();
+    BOOST_REQUIRE_EQUAL( db.get_max_memory(), 1024*1024*16 );
+
+    const auto& book = db.get( book::id_type(0) );
+    BOOST_REQUIRE_EQUAL( book.a, 3 );
+    BOOST_REQUIRE_EQUAL( book.b, 4 );
+
+    db.resize( 1024*1024*32 );
+    BOOST_REQUIRE_EQUAL( db.get( book::id_type(0) ).a, 3 );
+    db.close();
+    bfs::remove_all( temp );
+  } catch ( ... ) {
+    bfs::remove_all( temp );
+    throw;
+  }
+}
+
+BOOST_AUTO_TEST_CASE( grow_in_reserved_address_space ) {
+  boost::filesystem::path temp = boost::filesystem::absolute( boost::filesystem::unique_path() );
+  try {
+    chainbase::database db;
+    db.set_max_shared_file_size( 1024*1024*64 );
+    db.open( temp, 0, 1024*1024*8 );
+    db.add_index< book_index >();
+    BOOST_REQUIRE_EQUAL( db.get_reserved_memory(), 1024*1024*64 );
+
+    const auto& first_book = db.create<book>( []( book& b ) {
+        b.a = 3;
+        b.b = 4;
+    } );
+
+    {
+      // growing in place is allowed with active undo session and keeps references valid
+      auto session = db.start_undo_session();
+      db.resize( 1024*1024*16 );
+      BOOST_REQUIRE_EQUAL( db.get_max_memory(), 1024*1024*16 );
+      BOOST_REQUIRE( db.get_free_memory() > 1024*1024*8 );
+      BOOST_REQUIRE_EQUAL( first_book.a, 3 );
+
+      // fill memory past original size
+      for( int i = 0; db.get_free_memory() > 1024*1024*4; ++i )
+        db.create<book>( [&]( book& b ) { b.a = i; } );
+      session.push();
+    }
+    db.flush();
+    BOOST_REQUIRE_EQUAL( &db.get( book::id_type(0) ), &first_book );
+    db.close();
+
+    chainbase::database db2;
+    db2.set_max_shared_file_size( 1024*1024*64 );
+    db2.open( temp );
+    db2.add_index< book_index >();
+    BOOST_REQUIRE_EQUAL( db2.get_max_memory(), 1024*1024*16 );
+    BOOST_REQUIRE_EQUAL( db2.get( book::id_type(20000) ).a, 19999 );
+
+    // growing past reservation falls back to remapping
+    db2.resize( 1024*1024*80 );
+    BOOST_REQUIRE_EQUAL( db2.get_max_memory(), 1024*1024*80 );
+    BOOST_REQUIRE_EQUAL( db2.get( book::id_type(0) ).b, 4 );
+    db2.close();
+    bfs::remove_all( temp );
+  } catch ( ... ) {
+    bfs::remove_all( temp );
+    throw;
+  }
+}
+
+BOOST_AUTO_TEST_CASE( refuse_other_state_version ) {
+  boost::filesystem::path temp = boost::filesystem::absolute( boost::filesystem::unique_path() );
+  try {
+    const std::string version_info = "test";
+    auto extension = [&]( uint32_t state_version )
+    {
+      return helpers::environment_extension_resources( version_info, {}, state_version, []( const std::string& ){} );
+    };
+
+    {
+      // storage made without state version (like before it was stored) counts as version 0
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+    }
+    {
+      chainbase::database db;
+      auto v1 = extension( 1 );
+      BOOST_CHECK_THROW( db.open( temp, 0, 0, nullptr, &v1 ), std::runtime_error );
+      // environment check can be skipped, state version check cannot
+      BOOST_CHECK_THROW( db.open( temp, chainbase::skip_env_check, 0, nullptr, &v1 ), std::runtime_error );
+      // wiped storage is made again with given version
+      db.open( temp, 0, 1024*1024*8, nullptr, &v1, true );
+      db.add_index< book_index >();
+      db.create<book>( []( book& b ) { b.a = 5; } );
+      db.close();
+    }
+
+    chainbase::database db;
+    auto v2 = extension( 2 );
+    BOOST_CHECK_THROW( db.open( temp, 0, 0, nullptr, &v2 ), std::runtime_error );
+    auto v1 = extension( 1 );
+    db.open( temp, 0, 0, nullptr, &v1 );
+    db.add_index< book_index >();
+    BOOST_REQUIRE_EQUAL( db.get( book::id_type(0) ).a, 5 );
+    db.close();
+    bfs::remove_all( temp );
+  } catch ( ... ) {
+    bfs::remove_all( temp );
+    throw;
+  }
+}
+
+// BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include <fc/crypto/sha512.hpp>
 #include <fc/fwd.hpp>
 #include <fc/array.hpp>
+#include <fc/optional.hpp>
 #include <fc/io/raw_fwd.hpp>
 
 namespace fc {
@@ -87,6 +88,17 @@ namespace fc {
 
            static bool is_canonical( const compact_signature& c, canonical_signature_type canon_type );
 
+           /**
+            * Recovers keys for many (digest, signature) pairs at once, spreading the work over worker
+            * threads (see set_recovery_threads). Result is in order of input; signatures that cannot be
+            * recovered (or are not canonical) give empty optional instead of throwing.
+            */
+           static std::vector< fc::optional< public_key > > recover_many(
+              const std::vector< std::pair< fc::sha256, compact_signature > >& signatures,
+              canonical_signature_type canon_type = fc_canonical );
+           /// Number of extra threads used by recover_many (0 - calling thread only, default)
+           static void set_recovery_threads( uint32_t count );
+
         private:
           friend class private_key;
           static public_key from_key_data( const public_key_data& v );
@@ -24,6 +24,8 @@ class ripemd160
     static ripemd160 hash( const fc::sha256& h );
     static ripemd160 hash( const char* d, uint32_t dlen );
     static ripemd160 hash( const string& );
+    /// hashes count independent inputs, data[i] of sizes[i] bytes, into out[i]
+    static void hash_many( const char* const* data, const uint32_t* sizes, size_t count, ripemd160* out );
 
     template<typename T>
     static ripemd160 hash( const T& t ) 
@@ -24,6 +24,13 @@ class sha256
     static sha256 hash( const string& );
     static sha256 hash( const sha256& );
 
+    /**
+     * Hashes count independent inputs, data[i] of sizes[i] bytes, into out[i].
+     * On CPUs with AVX2 (but without SHA extensions, which OpenSSL uses on its own) 8 inputs
+     * are hashed at once by multi-buffer kernel, otherwise inputs are hashed one by one.
+     */
+    static void hash_many( const char* const* data, const uint32_t* sizes, size_t count, sha256* out );
+
     template<typename T>
     static sha256 hash( const T& t )
     {
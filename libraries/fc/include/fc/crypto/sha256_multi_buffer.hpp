@@ -0,0 +1,25 @@
+#pragma once
+#include <fc/crypto/sha256.hpp>
+
+#if defined(__x86_64__) && ( defined(__GNUC__) || defined(__clang__) )
+# define FC_SHA256_AVX2
+#endif
+
+namespace fc { namespace detail {
+
+#ifdef FC_SHA256_AVX2
+   /**
+    * Multi-buffer AVX2 kernel behind sha256::hash_many, hashes 8 inputs at once.
+    * Exposed so it can be tested regardless of which path hash_many picks on given CPU,
+    * must only be called when sha256_avx2_supported() is true.
+    */
+   void sha256_hash_many_avx2( const char* const* data, const uint32_t* sizes, size_t count, sha256* out );
+
+   /// true when CPU can run the AVX2 kernel
+   bool sha256_avx2_supported();
+
+   /// true when hash_many should use the AVX2 kernel
+   bool sha256_use_avx2();
+#endif
+
+} } // fc::detail
@@ -2,6 +2,7 @@
 #include <fc/utility.hpp>
 #include <string.h>
 #include <stdint.h>
+#include <vector>
 
 namespace fc {
 
@@ -89,6 +90,66 @@ class datastream<size_t> {
      size_t _size;
 };
 
+/**
+ *  Output datastream writing into std::vector<char> that grows as needed, so object can be packed
+ *  in a single pass, without "test run" calculating its size. Size of the vector is the capacity
+ *  of the stream, not the amount of written data (see tellp()); the vector is never shrunk, so the
+ *  same buffer can be reused for many objects without allocations.
+ */
+class growable_datastream {
+   public:
+      explicit growable_datastream( std::vector<char>& buffer )
+        : _buffer( buffer ), _begin( buffer.data() ), _pos( _begin ), _end( _begin + buffer.size() ) {}
+
+      inline bool write( const char* d, size_t s ) {
+        if( size_t( _end - _pos ) < s )
+          grow( s );
+        memcpy( _pos, d, s );
+        _pos += s;
+        return true;
+      }
+
+      inline bool put( char c ) {
+        if( _pos == _end )
+          grow( 1 );
+        *_pos++ = c;
+        return true;
+      }
+
+      inline bool skip( size_t s ) {
+        if( size_t( _end - _pos ) < s )
+          grow( s );
+        _pos += s;
+        return true;
+      }
+
+      const char*     data()const       { return _begin;         }
+      inline bool     valid()const      { return true;           }
+      inline bool     seekp(size_t p)   { _pos = _begin; if( size_t( _end - _begin ) < p ) grow( p ); _pos = _begin + p; return true; }
+      inline size_t   tellp()const      { return _pos - _begin;  }
+      inline size_t   remaining()const  { return _end - _pos;    }
+
+   private:
+      // pointers are cached in the stream, the vector is only touched when it has to grow
+      void grow( size_t s ) {
+        const size_t used = _pos - _begin;
+        size_t grown = _buffer.size() * 2;
+        if( grown < used + s )
+          grown = used + s;
+        if( grown < 256 )
+          grown = 256;
+        _buffer.resize( grown );
+        _begin = _buffer.data();
+        _pos = _begin + used;
+        _end = _begin + grown;
+      }
+
+      std::vector<char>& _buffer;
+      char*              _begin;
+      char*              _pos;
+      char*              _end;
+};
+
 template<typename ST>
 inline datastream<ST>& operator<<(datastream<ST>& ds, const int32_t& d) {
   ds.write( (const char*)&d, sizeof(d) );
@@ -22,7 +22,8 @@ namespace fc
             legacy_parser         = 0,
             strict_parser         = 1,
             relaxed_parser        = 2,
-            legacy_parser_with_string_doubles = 3
+            legacy_parser_with_string_doubles = 3,
+            fast_parser           = 4 ///< strict two-stage parser, see fc::json_tape
          };
          enum output_formatting
          {
@@ -38,6 +39,13 @@ namespace fc
          static variant  from_stream( buffered_istream& in, parse_type ptype = legacy_parser, uint32_t depth = 0 );
 
          static variant  from_string( const string& utf8_str, parse_type ptype = legacy_parser, uint32_t depth = 0 );
+         /**
+          *  Parses given string directly into object of reflected type T, without building
+          *  intermediate variant for it (always uses fast_parser rules).
+          *  Defined in fc/io/json_tape.hpp which needs to be included by the caller.
+          */
+         template<typename T>
+         static T        from_string_as( const string& utf8_str, uint32_t depth = 0 );
          static variants variants_from_string( const string& utf8_str, parse_type ptype = legacy_parser, uint32_t depth = 0 );
          static string   to_string( const variant& v, output_formatting format = stringify_large_ints_and_doubles );
          static string   to_pretty_string( const variant& v, output_formatting format = stringify_large_ints_and_doubles );
@@ -0,0 +1,272 @@
+#pragma once
+#include <fc/io/json.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/container/flat_fwd.hpp>
+#include <fc/optional.hpp>
+
+#include <bitset>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fc
+{
+   /**
+    *  Two-stage JSON parser used by json::fast_parser and json::from_string_as.
+    *
+    *  Stage 1 (constructor) scans the input 64 bytes at a time, validates UTF-8 and records
+    *  the offset of every structural character ( { } [ ] : , ) and of the first byte of every
+    *  scalar (string, number, literal) into a flat index. Quotes, backslashes and structural
+    *  characters are classified with SSE2 when available and in-string regions are computed
+    *  with bit arithmetic, so the input is never walked character by character.
+    *
+    *  Stage 2 walks the index and materializes values - either as fc::variant or, for
+    *  reflected types, directly into the target object without building an intermediate
+    *  variant tree for it.
+    *
+    *  The parser is strict: input must be valid UTF-8 holding a single RFC 8259 JSON value
+    *  surrounded by optional whitespace (raw control characters inside strings are tolerated,
+    *  like in legacy_parser). The tape refers to the input buffer, which has to outlive it.
+    */
+   class json_tape
+   {
+      public:
+         json_tape( const char* data, size_t size );
+         explicit json_tape( const string& utf8_str ) : json_tape( utf8_str.data(), utf8_str.size() ) {}
+
+         /// materializes whole document as variant
+         variant to_variant( uint32_t depth = 0 )const;
+
+         /// reads whole document into given object
+         template<typename T>
+         void read_document( T& v, uint32_t depth = 0 )const
+         {
+            size_t i = 0;
+            read_top_level( i, v, depth, typename fc::reflector<T>::is_defined(), typename fc::reflector<T>::is_enum() );
+            check_end( i );
+         }
+
+         /// number of entries in structural index (for diagnostics and tests)
+         size_t index_size()const { return _index.size() - 1; }
+
+         /**
+          *  False when materialized values used \b, \f or \u escapes or numbers with exponent.
+          *  legacy_parser keeps those as plain characters/strings, so callers that must stay
+          *  compatible with it should reparse such input with legacy_parser.
+          */
+         bool matches_legacy_parser()const { return !_legacy_divergent; }
+
+         /// @name element access used by typed readers; i is a position in structural index
+         ///@{
+         char     at( size_t i )const { return _index[i] < _size ? _data[ _index[i] ] : '\0'; }
+         void     expect( size_t& i, char c )const;
+         string   read_string( size_t& i )const;
+         variant  read_value( size_t& i, uint32_t depth )const;
+         void     skip_value( size_t& i, uint32_t depth )const;
+         void     check_end( size_t i )const;
+
+         /// generic member reader - goes through variant for given value only
+         template<typename T>
+         void read( size_t& i, T& v, uint32_t depth )const
+         {
+            variant var = read_value( i, depth );
+            from_variant( var, v );
+         }
+
+         void read( size_t& i, string& v, uint32_t depth )const;
+         void read( size_t& i, std::vector<char>& v, uint32_t depth )const;
+
+         template<typename T>
+         void read( size_t& i, std::vector<T>& v, uint32_t depth )const
+         {
+            if( at( i ) != '[' )
+               return read_fallback( i, v, depth );
+            v.clear();
+            read_array( i, depth, [&]( size_t& j, uint32_t d )
+            {
+               v.emplace_back();
+               read( j, v.back(), d );
+            } );
+         }
+
+         template<typename T>
+         void read( size_t& i, fc::flat_set<T>& v, uint32_t depth )const
+         {
+            if( at( i ) != '[' )
+               return read_fallback( i, v, depth );
+            v.clear();
+            read_array( i, depth, [&]( size_t& j, uint32_t d )
+            {
+               T item;
+               read( j, item, d );
+               v.insert( std::move( item ) );
+            } );
+         }
+
+         template<typename T>
+         void read( size_t& i, std::set<T>& v, uint32_t depth )const
+         {
+            if( at( i ) != '[' )
+               return read_fallback( i, v, depth );
+            v.clear();
+            read_array( i, depth, [&]( size_t& j, uint32_t d )
+            {
+               T item;
+               read( j, item, d );
+               v.insert( std::move( item ) );
+            } );
+         }
+
+         template<typename T>
+         void read( size_t& i, fc::optional<T>& v, uint32_t depth )const
+         {
+            if( at( i ) == 'n' )
+               return read_fallback( i, v, depth );
+            v = T();
+            read( i, *v, depth );
+         }
+
+         /// reads object of reflected type member by member (unknown keys are skipped, repeated ones too)
+         template<typename T>
+         void read_object( size_t& i, T& v, uint32_t depth )const;
+
+         /// calls f( i, depth ) for every element of array at i
+         template<typename F>
+         void read_array( size_t& i, uint32_t depth, F&& f )const
+         {
+            ++depth;
+            FC_ASSERT( depth <= JSON_MAX_RECURSION_DEPTH );
+            expect( i, '[' );
+            if( at( i ) == ']' )
+            {
+               ++i;
+               return;
+            }
+            while( true )
+            {
+               f( i, depth );
+               char c = at( i++ );
+               if( c == ']' )
+                  return;
+               if( c != ',' )
+                  FC_THROW_EXCEPTION( parse_error_exception, "Expected ',' or ']' at offset ${o}", ( "o", offset( i - 1 ) ) );
+            }
+         }
+         ///@}
+
+      private:
+         template<typename T>
+         void read_fallback( size_t& i, T& v, uint32_t depth )const
+         {
+            variant var = read_value( i, depth );
+            from_variant( var, v );
+         }
+
+         template<typename T>
+         void read_top_level( size_t& i, T& v, uint32_t depth, fc::true_type /*is_defined*/, fc::false_type /*is_enum*/ )const
+         {
+            if( at( i ) == '{' )
+               read_object( i, v, depth );
+            else
+               read( i, v, depth );
+         }
+
+         template<typename T, typename IsDefined, typename IsEnum>
+         void read_top_level( size_t& i, T& v, uint32_t depth, IsDefined, IsEnum )const
+         {
+            read( i, v, depth );
+         }
+
+         size_t  offset( size_t i )const { return _index[i]; }
+         variant read_scalar( size_t& i )const;
+         string  read_key( size_t& i )const;
+
+         const char*           _data;
+         size_t                _size;
+         std::vector<uint32_t> _index; // offsets of structural characters, ends with sentinel equal to _size
+         mutable bool          _legacy_divergent = false;
+   };
+
+   namespace detail
+   {
+      template<typename T>
+      class json_tape_member_visitor
+      {
+         public:
+            typedef std::bitset< fc::reflector<T>::total_member_count > assigned_members;
+
+            json_tape_member_visitor( const json_tape& tape, size_t& i, T& obj, const string& key, uint32_t depth, assigned_members& assigned )
+            : _tape( tape ), _i( i ), _obj( obj ), _key( key ), _depth( depth ), _assigned( assigned ) {}
+
+            template<typename Member, class Class, Member (Class::*member)>
+            void operator()( const char* name )const
+            {
+               const size_t member_index = _next_member++;
+               if( !found && std::strcmp( name, _key.c_str() ) == 0 )
+               {
+                  found = true;
+                  // repeated key - first occurrence wins, same as in conversion from variant
+                  if( _assigned[ member_index ] )
+                  {
+                     _tape.skip_value( _i, _depth );
+                     return;
+                  }
+                  _assigned[ member_index ] = true;
+                  _tape.read( _i, _obj.*member, _depth );
+               }
+            }
+
+            mutable bool found = false;
+
+         private:
+            const json_tape&   _tape;
+            size_t&            _i;
+            T&                 _obj;
+            const string&      _key;
+            uint32_t           _depth;
+            assigned_members&  _assigned;
+            mutable size_t     _next_member = 0;
+      };
+   }
+
+   template<typename T>
+   void json_tape::read_object( size_t& i, T& v, uint32_t depth )const
+   {
+      ++depth;
+      FC_ASSERT( depth <= JSON_MAX_RECURSION_DEPTH );
+      expect( i, '{' );
+      if( at( i ) == '}' )
+      {
+         ++i;
+         return;
+      }
+      typename detail::json_tape_member_visitor<T>::assigned_members assigned;
+      while( true )
+      {
+         string key = read_key( i );
+         detail::json_tape_member_visitor<T> visitor( *this, i, v, key, depth, assigned );
+         fc::reflector<T>::visit( visitor );
+         if( !visitor.found )
+            skip_value( i, depth );
+         char c = at( i++ );
+         if( c == '}' )
+            return;
+         if( c != ',' )
+            FC_THROW_EXCEPTION( parse_error_exception, "Expected ',' or '}' at offset ${o}", ( "o", offset( i - 1 ) ) );
+      }
+   }
+
+   template<typename T>
+   T json::from_string_as( const string& utf8_str, uint32_t depth )
+   { try {
+      depth++;
+      FC_ASSERT( depth <= JSON_MAX_RECURSION_DEPTH );
+      json_tape tape( utf8_str );
+      T result;
+      tape.read_document( result, depth );
+      return result;
+   } FC_RETHROW_EXCEPTIONS( warn, "", ("str",utf8_str) ) }
+
+} // fc
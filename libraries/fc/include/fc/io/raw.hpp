@@ -628,18 +628,71 @@ namespace fc {
       return ps.tellp();
     }
 
+    namespace detail {
+
+      /// per-thread buffers of pack_to_thread_buffer, one for every level of nested calls
+      struct thread_pack_buffers
+      {
+        static const uint32_t MAX_NESTING = 4;
+
+        std::vector<char> buffers[ MAX_NESTING ];
+        uint32_t          depth = 0;
+      };
+
+      inline thread_pack_buffers& get_thread_pack_buffers()
+      {
+        static thread_local thread_pack_buffers buffers;
+        return buffers;
+      }
+
+    } // detail
+
+    /// Packed bytes held by per-thread buffer
+    class packed_view
+    {
+      public:
+        packed_view( const char* data, size_t size ) : _data( data ), _size( size ) {}
+
+        const char* data()const { return _data; }
+        size_t      size()const { return _size; }
+        const char* begin()const { return _data; }
+        const char* end()const { return _data + _size; }
+
+      private:
+        const char* _data;
+        size_t      _size;
+    };
+
+    /**
+     *  Packs object in a single pass into per-thread buffer that is reused between calls, so
+     *  once the buffer grew large enough no allocation takes place. Returned view is valid until
+     *  next call on the same thread (calls made while packing, e.g. by pack_to_vector of a member,
+     *  use separate buffers and do not invalidate it).
+     */
     template<typename T>
-    inline std::vector<char> pack_to_vector( const T& v )
+    inline packed_view pack_to_thread_buffer( const T& v )
     {
-      datastream<size_t> ps;
-      fc::raw::pack(ps,v );
-      std::vector<char> vec(ps.tellp());
+      auto& buffers = detail::get_thread_pack_buffers();
+      FC_ASSERT( buffers.depth < detail::thread_pack_buffers::MAX_NESTING, "Too deeply nested pack_to_thread_buffer calls" );
+      struct depth_guard
+      {
+        uint32_t& depth;
+        explicit depth_guard( uint32_t& d ) : depth( d ) { ++depth; }
+        ~depth_guard() { --depth; }
+      } guard( buffers.depth );
 
-      if( vec.size() ) {
-        datastream<char*>  ds( vec.data(), size_t(vec.size()) );
-        fc::raw::pack(ds,v);
-      }
-      return vec;
+      std::vector<char>& buffer = buffers.buffers[ buffers.depth - 1 ];
+      growable_datastream ds( buffer );
+      fc::raw::pack( ds, v );
+      return packed_view( buffer.data(), ds.tellp() );
+    }
+
+    template<typename T>
+    inline std::vector<char> pack_to_vector( const T& v )
+    {
+      // single pass into reused buffer and a copy is cheaper than calculating size in separate pass
+      const packed_view packed = pack_to_thread_buffer( v );
+      return std::vector<char>( packed.begin(), packed.end() );
     }
 
    template< typename Stream, int Index, typename Tuple >
@@ -0,0 +1,147 @@
+#include <fc/crypto/elliptic.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* batch key recovery, common to all ecc implementations (recovery only reads shared library context) */
+
+namespace fc { namespace ecc {
+
+   namespace detail {
+
+   namespace {
+
+      /// worker threads that help calling thread with one batch at a time
+      class recovery_pool
+      {
+         public:
+            static recovery_pool& instance()
+            {
+               static recovery_pool pool;
+               return pool;
+            }
+
+            ~recovery_pool()
+            {
+               resize( 0 );
+            }
+
+            void resize( uint32_t count )
+            {
+               std::lock_guard< std::mutex > batch_guard( _batch_mutex );
+               {
+                  std::lock_guard< std::mutex > guard( _mutex );
+                  _must_exit = true;
+               }
+               _work.notify_all();
+               for( auto& t : _threads )
+                  t.join();
+               _threads.clear();
+
+               _must_exit = false;
+               // passed to workers, since they might start running only after next batch is announced
+               const uint64_t generation = _generation;
+               for( uint32_t i = 0; i < count; ++i )
+                  _threads.emplace_back( [this, generation]() { worker( generation ); } );
+            }
+
+            /// calls process( i ) for every i in [0, count) - in calling thread and in workers - and waits for all of them
+            void run( size_t count, const std::function< void( size_t ) >& process )
+            {
+               std::unique_lock< std::mutex > batch_guard( _batch_mutex, std::try_to_lock );
+               if( !batch_guard.owns_lock() || _threads.empty() || count < 2 )
+               {
+                  // when other caller occupies the workers it is faster to do the work than to wait for them
+                  for( size_t i = 0; i < count; ++i )
+                     process( i );
+                  return;
+               }
+
+               std::atomic< size_t > next{ 0 };
+               std::function< void() > job = [&]()
+               {
+                  for( size_t i = next++; i < count; i = next++ )
+                     process( i );
+               };
+
+               {
+                  std::lock_guard< std::mutex > guard( _mutex );
+                  _job = &job;
+                  _active = _threads.size();
+                  ++_generation;
+               }
+               _work.notify_all();
+
+               job();
+
+               std::unique_lock< std::mutex > lock( _mutex );
+               _done.wait( lock, [this]() { return _active == 0; } );
+               _job = nullptr;
+            }
+
+         private:
+            void worker( uint64_t seen_generation )
+            {
+               std::unique_lock< std::mutex > lock( _mutex );
+               while( true )
+               {
+                  _work.wait( lock, [&]() { return _must_exit || _generation != seen_generation; } );
+                  if( _must_exit )
+                     return;
+                  seen_generation = _generation;
+                  const std::function< void() >* job = _job;
+                  lock.unlock();
+
+                  ( *job )();
+
+                  lock.lock();
+                  if( --_active == 0 )
+                     _done.notify_one();
+               }
+            }
+
+            std::mutex                       _batch_mutex;  // held by caller for duration of whole batch
+            std::mutex                       _mutex;
+            std::condition_variable          _work;
+            std::condition_variable          _done;
+            const std::function< void() >*   _job = nullptr;
+            size_t                           _active = 0;   // workers still processing current batch
+            uint64_t                         _generation = 0;
+            bool                             _must_exit = false;
+            std::vector< std::thread >       _threads;
+      };
+
+   } // anonymous
+
+   } // detail
+
+    std::vector< fc::optional< public_key > > public_key::recover_many(
+       const std::vector< std::pair< fc::sha256, compact_signature > >& signatures,
+       canonical_signature_type canon_type )
+    {
+       std::vector< fc::optional< public_key > > result( signatures.size() );
+       detail::recovery_pool::instance().run( signatures.size(), [&]( size_t i )
+       {
+          try
+          {
+             result[i] = public_key( signatures[i].second, signatures[i].first, canon_type );
+          }
+          catch( const fc::exception& )
+          {
+             // left empty, caller decides how to report it
+          }
+       } );
+       return result;
+    }
+
+    void public_key::set_recovery_threads( uint32_t count )
+    {
+       detail::recovery_pool::instance().resize( count );
+    }
+
+} } // fc::ecc
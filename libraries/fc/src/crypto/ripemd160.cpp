@@ -56,6 +56,16 @@ ripemd160 ripemd160::hash( const string& s ) {
   return hash( s.c_str(), s.size() );
 }
 
+void ripemd160::hash_many( const char* const* data, const uint32_t* sizes, size_t count, ripemd160* out ) {
+  // no multi-buffer kernel (yet), but callers can already batch
+  RIPEMD160_CTX ctx;
+  for( size_t i = 0; i < count; ++i ) {
+    RIPEMD160_Init( &ctx );
+    RIPEMD160_Update( &ctx, data[i], sizes[i] );
+    RIPEMD160_Final( (uint8_t*)out[i].data(), &ctx );
+  }
+}
+
 void ripemd160::encoder::write( const char* d, uint32_t dlen ) {
   RIPEMD160_Update( &my->ctx, d, dlen); 
 }
@@ -0,0 +1,219 @@
+#include <fc/crypto/sha256_multi_buffer.hpp>
+
+#include <openssl/sha.h>
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef FC_SHA256_AVX2
+# include <cpuid.h>
+# include <immintrin.h>
+#endif
+
+namespace fc {
+
+namespace detail {
+
+#ifdef FC_SHA256_AVX2
+
+#define FC_AVX2 __attribute__((target("avx2")))
+
+namespace {
+
+   const uint32_t sha256_k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+   };
+
+   const uint32_t sha256_initial_state[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+   };
+
+   const size_t LANES = 8;
+
+   template< int N >
+   FC_AVX2 inline __m256i rotr( __m256i x )
+   {
+      return _mm256_or_si256( _mm256_srli_epi32( x, N ), _mm256_slli_epi32( x, 32 - N ) );
+   }
+
+   FC_AVX2 inline __m256i add( __m256i a, __m256i b ) { return _mm256_add_epi32( a, b ); }
+   FC_AVX2 inline __m256i xor3( __m256i a, __m256i b, __m256i c ) { return _mm256_xor_si256( _mm256_xor_si256( a, b ), c ); }
+
+   /// one 64 byte block of 8 independent messages; words[i][lane] is i-th (big endian) word of the lane's block
+   FC_AVX2 void compress( __m256i state[8], const uint32_t words[16][LANES] )
+   {
+      __m256i w[64];
+      for( int i = 0; i < 16; ++i )
+         w[i] = _mm256_load_si256( (const __m256i*)words[i] );
+      for( int i = 16; i < 64; ++i )
+      {
+         __m256i s0 = xor3( rotr<7>( w[i-15] ), rotr<18>( w[i-15] ), _mm256_srli_epi32( w[i-15], 3 ) );
+         __m256i s1 = xor3( rotr<17>( w[i-2] ), rotr<19>( w[i-2] ), _mm256_srli_epi32( w[i-2], 10 ) );
+         w[i] = add( add( w[i-16], s0 ), add( w[i-7], s1 ) );
+      }
+
+      __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+      __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+      for( int i = 0; i < 64; ++i )
+      {
+         __m256i big_s1 = xor3( rotr<6>( e ), rotr<11>( e ), rotr<25>( e ) );
+         __m256i ch = _mm256_xor_si256( _mm256_and_si256( e, f ), _mm256_andnot_si256( e, g ) );
+         __m256i t1 = add( add( h, big_s1 ), add( ch, add( _mm256_set1_epi32( sha256_k[i] ), w[i] ) ) );
+         __m256i big_s0 = xor3( rotr<2>( a ), rotr<13>( a ), rotr<22>( a ) );
+         __m256i maj = _mm256_or_si256( _mm256_and_si256( a, b ), _mm256_and_si256( c, _mm256_or_si256( a, b ) ) );
+         __m256i t2 = add( big_s0, maj );
+         h = g; g = f; f = e; e = add( d, t1 );
+         d = c; c = b; b = a; a = add( t1, t2 );
+      }
+
+      state[0] = add( state[0], a ); state[1] = add( state[1], b );
+      state[2] = add( state[2], c ); state[3] = add( state[3], d );
+      state[4] = add( state[4], e ); state[5] = add( state[5], f );
+      state[6] = add( state[6], g ); state[7] = add( state[7], h );
+   }
+
+   inline uint32_t block_count( uint32_t size )
+   {
+      // message, 0x80 terminator and 64 bit length, rounded up to whole blocks
+      return ( size + 9 + 63 ) / 64;
+   }
+
+   /// fills block number `block` of padded message
+   void get_padded_block( const char* data, uint32_t size, uint32_t block, uint8_t out[64] )
+   {
+      const uint64_t offset = uint64_t( block ) * 64;
+      if( offset + 64 <= size )
+      {
+         memcpy( out, data + offset, 64 );
+         return;
+      }
+      memset( out, 0, 64 );
+      if( offset < size )
+         memcpy( out, data + offset, size - offset );
+      if( size >= offset && size < offset + 64 )
+         out[ size - offset ] = 0x80;
+      if( block + 1 == block_count( size ) )
+      {
+         uint64_t bit_size = uint64_t( size ) * 8;
+         for( int i = 0; i < 8; ++i )
+            out[ 63 - i ] = uint8_t( bit_size >> ( 8 * i ) );
+      }
+   }
+
+   FC_AVX2 void hash_lanes( const char* const* data, const uint32_t* sizes, size_t lanes, sha256* out )
+   {
+      uint32_t blocks[LANES];
+      uint32_t max_blocks = 0;
+      for( size_t lane = 0; lane < LANES; ++lane )
+      {
+         // unused lanes hash an empty message
+         blocks[lane] = block_count( lane < lanes ? sizes[lane] : 0 );
+         max_blocks = std::max( max_blocks, blocks[lane] );
+      }
+
+      __m256i state[8];
+      for( int i = 0; i < 8; ++i )
+         state[i] = _mm256_set1_epi32( sha256_initial_state[i] );
+
+      alignas( 32 ) uint32_t words[16][LANES];
+      for( uint32_t block = 0; block < max_blocks; ++block )
+      {
+         bool any_finished = false;
+         for( size_t lane = 0; lane < LANES; ++lane )
+         {
+            uint8_t padded[64];
+            // lanes that are already finished process garbage, their result was taken before
+            if( lane < lanes )
+               get_padded_block( data[lane], sizes[lane], block, padded );
+            else
+               get_padded_block( nullptr, 0, block, padded );
+            for( int i = 0; i < 16; ++i )
+            {
+               uint32_t word;
+               memcpy( &word, padded + 4 * i, 4 );
+               words[i][lane] = __builtin_bswap32( word );
+            }
+            any_finished |= ( blocks[lane] == block + 1 );
+         }
+
+         compress( state, words );
+
+         if( any_finished )
+         {
+            alignas( 32 ) uint32_t result[8][LANES];
+            for( int i = 0; i < 8; ++i )
+               _mm256_store_si256( (__m256i*)result[i], state[i] );
+            for( size_t lane = 0; lane < lanes; ++lane )
+            {
+               if( blocks[lane] != block + 1 )
+                  continue;
+               uint8_t* digest = (uint8_t*)out[lane].data();
+               for( int i = 0; i < 8; ++i )
+               {
+                  uint32_t word = __builtin_bswap32( result[i][lane] );
+                  memcpy( digest + 4 * i, &word, 4 );
+               }
+            }
+         }
+      }
+   }
+
+   bool cpu_has_sha_extensions()
+   {
+      unsigned int eax, ebx, ecx, edx;
+      if( !__get_cpuid_count( 7, 0, &eax, &ebx, &ecx, &edx ) )
+         return false;
+      return ( ebx & ( 1u << 29 ) ) != 0;
+   }
+
+} // anonymous
+
+   void sha256_hash_many_avx2( const char* const* data, const uint32_t* sizes, size_t count, sha256* out )
+   {
+      for( size_t i = 0; i < count; i += LANES )
+         hash_lanes( data + i, sizes + i, std::min( LANES, count - i ), out + i );
+   }
+
+   bool sha256_avx2_supported()
+   {
+      return __builtin_cpu_supports( "avx2" );
+   }
+
+   /// multi-buffer AVX2 only pays off against plain scalar code - OpenSSL uses SHA extensions when CPU has them
+   bool sha256_use_avx2()
+   {
+      static const bool use = sha256_avx2_supported() && !cpu_has_sha_extensions();
+      return use;
+   }
+
+#endif // FC_SHA256_AVX2
+
+} // detail
+
+   void sha256::hash_many( const char* const* data, const uint32_t* sizes, size_t count, sha256* out )
+   {
+#ifdef FC_SHA256_AVX2
+      if( count >= 4 && detail::sha256_use_avx2() )
+      {
+         detail::sha256_hash_many_avx2( data, sizes, count, out );
+         return;
+      }
+#endif
+      // low level API, one-shot SHA256() is much slower in OpenSSL 3
+      SHA256_CTX ctx;
+      for( size_t i = 0; i < count; ++i )
+      {
+         SHA256_Init( &ctx );
+         SHA256_Update( &ctx, data[i], sizes[i] );
+         SHA256_Final( (uint8_t*)out[i].data(), &ctx );
+      }
+   }
+
+} // fc
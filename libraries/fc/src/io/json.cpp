@@ -1,4 +1,5 @@
 #include <fc/io/json.hpp>
+#include <fc/io/json_tape.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/io/iostream.hpp>
 #include <fc/io/buffered_iostream.hpp>
@@ -515,6 +516,8 @@ namespace fc
    { try {
       depth++;
       FC_ASSERT( depth <= JSON_MAX_RECURSION_DEPTH );
+      if( ptype == fast_parser )
+         return json_tape( utf8_str ).to_variant( depth ); // depth is checked on the fly
       check_string_depth( utf8_str );
 
       fc::stringstream in( utf8_str );
@@ -860,6 +863,12 @@ namespace fc
       //auto tmp = std::make_shared<fc::ifstream>( p, ifstream::binary );
       //auto tmp = std::make_shared<std::ifstream>( p.generic_string().c_str(), std::ios::binary );
       //buffered_istream bi( tmp );
+      if( ptype == fast_parser )
+      {
+         std::string content;
+         read_file_contents( p, content );
+         return json_tape( content ).to_variant( depth );
+      }
       boost::filesystem::ifstream bi( p, std::ios::binary );
       switch( ptype )
       {
@@ -889,6 +898,8 @@ namespace fc
               return json_relaxed::variant_from_stream<buffered_istream, true>( in, depth );
           case relaxed_parser:
               return json_relaxed::variant_from_stream<buffered_istream, false>( in, depth );
+          case fast_parser:
+              FC_ASSERT( false, "fast_parser needs whole input at once, use from_string" );
           default:
               FC_ASSERT( false, "Unknown JSON parser type {ptype}", ("ptype", ptype) );
       }
@@ -913,6 +924,11 @@ namespace fc
    bool json::is_valid( const std::string& utf8_str, parse_type ptype, uint32_t depth )
    {
       if( utf8_str.size() == 0 ) return false;
+      if( ptype == fast_parser )
+      {
+         json_tape( utf8_str ).to_variant( depth );
+         return true;
+      }
       fc::stringstream in( utf8_str );
       switch( ptype )
       {
@@ -0,0 +1,570 @@
+#include <fc/io/json_tape.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/string.hpp>
+
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FC_JSON_TAPE_SSE2
+#endif
+
+#if defined(__PCLMUL__)
+#include <wmmintrin.h>
+#endif
+
+namespace fc
+{
+   namespace
+   {
+      const size_t BLOCK_SIZE = 64;
+
+      /// per-block bitmasks, bit n corresponds to byte n of the block
+      struct block_masks
+      {
+         uint64_t quote     = 0;
+         uint64_t backslash = 0;
+         uint64_t op        = 0; // { } [ ] : ,
+         uint64_t ws        = 0; // space, \t, \n, \r
+      };
+
+#ifdef FC_JSON_TAPE_SSE2
+      inline uint64_t to_mask( __m128i m0, __m128i m1, __m128i m2, __m128i m3 )
+      {
+         return uint64_t( uint32_t( _mm_movemask_epi8( m0 ) ) ) |
+                ( uint64_t( uint32_t( _mm_movemask_epi8( m1 ) ) ) << 16 ) |
+                ( uint64_t( uint32_t( _mm_movemask_epi8( m2 ) ) ) << 32 ) |
+                ( uint64_t( uint32_t( _mm_movemask_epi8( m3 ) ) ) << 48 );
+      }
+
+      inline uint64_t eq_mask( const __m128i (&in)[4], char c )
+      {
+         const __m128i v = _mm_set1_epi8( c );
+         return to_mask( _mm_cmpeq_epi8( in[0], v ), _mm_cmpeq_epi8( in[1], v ),
+                         _mm_cmpeq_epi8( in[2], v ), _mm_cmpeq_epi8( in[3], v ) );
+      }
+
+      inline void classify( const char* block, block_masks& m )
+      {
+         const __m128i in[4] = {
+            _mm_loadu_si128( reinterpret_cast< const __m128i* >( block ) ),
+            _mm_loadu_si128( reinterpret_cast< const __m128i* >( block + 16 ) ),
+            _mm_loadu_si128( reinterpret_cast< const __m128i* >( block + 32 ) ),
+            _mm_loadu_si128( reinterpret_cast< const __m128i* >( block + 48 ) ) };
+         // '[' | 0x20 == '{' and ']' | 0x20 == '}', so both bracket kinds are caught with two compares
+         const __m128i case_bit = _mm_set1_epi8( 0x20 );
+         const __m128i folded[4] = {
+            _mm_or_si128( in[0], case_bit ), _mm_or_si128( in[1], case_bit ),
+            _mm_or_si128( in[2], case_bit ), _mm_or_si128( in[3], case_bit ) };
+
+         m.quote     = eq_mask( in, '"' );
+         m.backslash = eq_mask( in, '\\' );
+         m.op        = eq_mask( folded, '{' ) | eq_mask( folded, '}' ) | eq_mask( in, ':' ) | eq_mask( in, ',' );
+         m.ws        = eq_mask( in, ' ' ) | eq_mask( in, '\t' ) | eq_mask( in, '\n' ) | eq_mask( in, '\r' );
+      }
+
+      /// returns true when given 16 bytes contain only ASCII characters
+      inline bool is_ascii16( const char* p )
+      {
+         return _mm_movemask_epi8( _mm_loadu_si128( reinterpret_cast< const __m128i* >( p ) ) ) == 0;
+      }
+#else
+      inline void classify( const char* block, block_masks& m )
+      {
+         for( size_t i = 0; i < BLOCK_SIZE; ++i )
+         {
+            const uint64_t bit = uint64_t( 1 ) << i;
+            switch( block[i] )
+            {
+               case '"':  m.quote |= bit; break;
+               case '\\': m.backslash |= bit; break;
+               case '{':
+               case '}':
+               case '[':
+               case ']':
+               case ':':
+               case ',':  m.op |= bit; break;
+               case ' ':
+               case '\t':
+               case '\n':
+               case '\r': m.ws |= bit; break;
+               default: break;
+            }
+         }
+      }
+
+      inline bool is_ascii16( const char* p )
+      {
+         uint64_t a, b;
+         std::memcpy( &a, p, 8 );
+         std::memcpy( &b, p + 8, 8 );
+         return ( ( a | b ) & 0x8080808080808080ULL ) == 0;
+      }
+#endif
+
+      /// returns first '"' or '\\' in [p, end) or end when there is none
+      inline const char* find_quote_or_backslash( const char* p, const char* end )
+      {
+#ifdef FC_JSON_TAPE_SSE2
+         const __m128i quote = _mm_set1_epi8( '"' );
+         const __m128i backslash = _mm_set1_epi8( '\\' );
+         for( ; end - p >= 16; p += 16 )
+         {
+            const __m128i in = _mm_loadu_si128( reinterpret_cast< const __m128i* >( p ) );
+            const int mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( in, quote ), _mm_cmpeq_epi8( in, backslash ) ) );
+            if( mask != 0 )
+               return p + __builtin_ctz( mask );
+         }
+#endif
+         while( p < end && *p != '"' && *p != '\\' )
+            ++p;
+         return p;
+      }
+
+      /// bit n of result is xor of bits 0..n of x (marks bytes between opening and closing quote)
+      inline uint64_t prefix_xor( uint64_t x )
+      {
+#if defined(__PCLMUL__)
+         const __m128i all_ones = _mm_set1_epi8( '\xFF' );
+         return uint64_t( _mm_cvtsi128_si64( _mm_clmulepi64_si128( _mm_set_epi64x( 0, int64_t( x ) ), all_ones, 0 ) ) );
+#else
+         x ^= x << 1;
+         x ^= x << 2;
+         x ^= x << 4;
+         x ^= x << 8;
+         x ^= x << 16;
+         x ^= x << 32;
+         return x;
+#endif
+      }
+
+      /**
+       *  Returns mask of characters escaped by odd-length backslash runs. prev_escaped carries
+       *  information whether first character of next block is escaped.
+       */
+      inline uint64_t find_escaped( uint64_t backslash, uint64_t& prev_escaped )
+      {
+         const uint64_t even_bits = 0x5555555555555555ULL;
+         backslash &= ~prev_escaped;
+         const uint64_t follows_escape = ( backslash << 1 ) | prev_escaped;
+         const uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+         const uint64_t sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+         prev_escaped = sequences_starting_on_even_bits < backslash ? 1 : 0; // carry out of the block
+         const uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+         return ( even_bits ^ invert_mask ) & follows_escape;
+      }
+
+      /// validates UTF-8 encoding (rejects overlong forms, surrogates and code points above U+10FFFF)
+      bool validate_utf8( const char* data, size_t size )
+      {
+         const unsigned char* p = reinterpret_cast< const unsigned char* >( data );
+         const unsigned char* end = p + size;
+         while( p < end )
+         {
+            if( end - p >= 16 && is_ascii16( reinterpret_cast< const char* >( p ) ) )
+            {
+               p += 16;
+               continue;
+            }
+            const unsigned char c = *p;
+            if( c < 0x80 )
+            {
+               ++p;
+               continue;
+            }
+            size_t len;
+            unsigned char min2 = 0x80, max2 = 0xBF;
+            if( c >= 0xC2 && c <= 0xDF )
+               len = 2;
+            else if( c >= 0xE0 && c <= 0xEF )
+            {
+               len = 3;
+               if( c == 0xE0 ) min2 = 0xA0; // overlong
+               else if( c == 0xED ) max2 = 0x9F; // surrogates
+            }
+            else if( c >= 0xF0 && c <= 0xF4 )
+            {
+               len = 4;
+               if( c == 0xF0 ) min2 = 0x90; // overlong
+               else if( c == 0xF4 ) max2 = 0x8F; // above U+10FFFF
+            }
+            else
+               return false;
+            if( size_t( end - p ) < len )
+               return false;
+            if( p[1] < min2 || p[1] > max2 )
+               return false;
+            for( size_t k = 2; k < len; ++k )
+               if( ( p[k] & 0xC0 ) != 0x80 )
+                  return false;
+            p += len;
+         }
+         return true;
+      }
+
+      inline bool is_token_end( char c )
+      {
+         switch( c )
+         {
+            case ' ': case '\t': case '\n': case '\r':
+            case '{': case '}': case '[': case ']': case ':': case ',':
+            case '\0':
+               return true;
+            default:
+               return false;
+         }
+      }
+
+      inline uint32_t hex_value( char c )
+      {
+         if( c >= '0' && c <= '9' ) return c - '0';
+         if( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+         if( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+         FC_THROW_EXCEPTION( parse_error_exception, "Invalid hex digit '${c}' in \\u escape", ( "c", string( 1, c ) ) );
+      }
+
+      void append_utf8( string& out, uint32_t cp )
+      {
+         if( cp < 0x80 )
+            out.push_back( char( cp ) );
+         else if( cp < 0x800 )
+         {
+            out.push_back( char( 0xC0 | ( cp >> 6 ) ) );
+            out.push_back( char( 0x80 | ( cp & 0x3F ) ) );
+         }
+         else if( cp < 0x10000 )
+         {
+            out.push_back( char( 0xE0 | ( cp >> 12 ) ) );
+            out.push_back( char( 0x80 | ( ( cp >> 6 ) & 0x3F ) ) );
+            out.push_back( char( 0x80 | ( cp & 0x3F ) ) );
+         }
+         else
+         {
+            out.push_back( char( 0xF0 | ( cp >> 18 ) ) );
+            out.push_back( char( 0x80 | ( ( cp >> 12 ) & 0x3F ) ) );
+            out.push_back( char( 0x80 | ( ( cp >> 6 ) & 0x3F ) ) );
+            out.push_back( char( 0x80 | ( cp & 0x3F ) ) );
+         }
+      }
+   }
+
+   json_tape::json_tape( const char* data, size_t size )
+   : _data( data ), _size( size )
+   {
+      FC_ASSERT( size < std::numeric_limits< uint32_t >::max(), "JSON input too large" );
+      if( !validate_utf8( data, size ) )
+         FC_THROW_EXCEPTION( parse_error_exception, "Invalid UTF-8 in JSON input" );
+
+      // rough estimate, avoids most reallocations for typical API requests
+      _index.reserve( size / 4 + 2 );
+
+      uint64_t prev_escaped = 0;
+      uint64_t prev_in_string = 0;
+      uint64_t prev_scalar = 0;
+      char tail[ BLOCK_SIZE ];
+
+      for( size_t block_offset = 0; block_offset < size; block_offset += BLOCK_SIZE )
+      {
+         const char* block = data + block_offset;
+         if( size - block_offset < BLOCK_SIZE )
+         {
+            std::memset( tail, ' ', BLOCK_SIZE );
+            std::memcpy( tail, block, size - block_offset );
+            block = tail;
+         }
+
+         block_masks m;
+         classify( block, m );
+
+         const uint64_t escaped = find_escaped( m.backslash, prev_escaped );
+         const uint64_t quote = m.quote & ~escaped;
+         const uint64_t in_string = prefix_xor( quote ) ^ prev_in_string;
+         prev_in_string = uint64_t( int64_t( in_string ) >> 63 );
+         // string content and closing quote; opening quote stays as scalar start
+         const uint64_t string_tail = in_string ^ quote;
+
+         const uint64_t scalar = ~( m.op | m.ws );
+         const uint64_t nonquote_scalar = scalar & ~quote;
+         const uint64_t follows_nonquote_scalar = ( nonquote_scalar << 1 ) | prev_scalar;
+         prev_scalar = nonquote_scalar >> 63;
+
+         uint64_t structurals = ( m.op | ( scalar & ~follows_nonquote_scalar ) ) & ~string_tail;
+         while( structurals != 0 )
+         {
+            _index.push_back( uint32_t( block_offset + __builtin_ctzll( structurals ) ) );
+            structurals &= structurals - 1;
+         }
+      }
+
+      if( prev_in_string != 0 )
+         FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' of string" );
+      if( _index.empty() )
+         FC_THROW_EXCEPTION( eof_exception, "unexpected end of file" );
+      _index.push_back( uint32_t( size ) );
+   }
+
+   void json_tape::expect( size_t& i, char c )const
+   {
+      if( at( i ) != c )
+         FC_THROW_EXCEPTION( parse_error_exception, "Expected '${e}' at offset ${o}", ( "e", string( 1, c ) )( "o", offset( i ) ) );
+      ++i;
+   }
+
+   void json_tape::check_end( size_t i )const
+   {
+      if( i != _index.size() - 1 )
+         FC_THROW_EXCEPTION( parse_error_exception, "Unexpected data after JSON value at offset ${o}", ( "o", offset( i ) ) );
+   }
+
+   string json_tape::read_string( size_t& i )const
+   {
+      const char* p = _data + offset( i );
+      if( at( i ) != '"' )
+         FC_THROW_EXCEPTION( parse_error_exception, "Expected '\"' at offset ${o}", ( "o", offset( i ) ) );
+      ++p;
+      const char* end = _data + _size;
+      string result;
+
+      while( true )
+      {
+         // copy run of plain characters at once
+         const char* run = p;
+         p = find_quote_or_backslash( p, end );
+         result.append( run, p - run );
+         if( p >= end )
+            FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' in string '${token}'", ( "token", result ) );
+         if( *p == '"' )
+            break;
+
+         ++p; // backslash
+         if( p >= end )
+            FC_THROW_EXCEPTION( parse_error_exception, "Stream ended with '\\'" );
+         switch( *p++ )
+         {
+            case '"':  result.push_back( '"' ); break;
+            case '\\': result.push_back( '\\' ); break;
+            case '/':  result.push_back( '/' ); break;
+            case 'b':  result.push_back( '\b' ); _legacy_divergent = true; break;
+            case 'f':  result.push_back( '\f' ); _legacy_divergent = true; break;
+            case 'n':  result.push_back( '\n' ); break;
+            case 'r':  result.push_back( '\r' ); break;
+            case 't':  result.push_back( '\t' ); break;
+            case 'u':
+            {
+               _legacy_divergent = true;
+               auto read_hex4 = [&]() -> uint32_t
+               {
+                  if( end - p < 4 )
+                     FC_THROW_EXCEPTION( parse_error_exception, "Truncated \\u escape in string '${token}'", ( "token", result ) );
+                  uint32_t v = ( hex_value( p[0] ) << 12 ) | ( hex_value( p[1] ) << 8 ) | ( hex_value( p[2] ) << 4 ) | hex_value( p[3] );
+                  p += 4;
+                  return v;
+               };
+               uint32_t cp = read_hex4();
+               if( cp >= 0xD800 && cp <= 0xDBFF )
+               {
+                  if( end - p < 2 || p[0] != '\\' || p[1] != 'u' )
+                     FC_THROW_EXCEPTION( parse_error_exception, "Unpaired surrogate in string '${token}'", ( "token", result ) );
+                  p += 2;
+                  uint32_t low = read_hex4();
+                  if( low < 0xDC00 || low > 0xDFFF )
+                     FC_THROW_EXCEPTION( parse_error_exception, "Invalid low surrogate in string '${token}'", ( "token", result ) );
+                  cp = 0x10000 + ( ( cp - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+               }
+               else if( cp >= 0xDC00 && cp <= 0xDFFF )
+                  FC_THROW_EXCEPTION( parse_error_exception, "Unpaired surrogate in string '${token}'", ( "token", result ) );
+               append_utf8( result, cp );
+               break;
+            }
+            default:
+               FC_THROW_EXCEPTION( parse_error_exception, "Invalid escape sequence in string '${token}'", ( "token", result ) );
+         }
+      }
+
+      // closing quote is not part of the index - next entry must be past it
+      ++i;
+      if( _data + offset( i ) <= p && offset( i ) < _size )
+         FC_THROW_EXCEPTION( parse_error_exception, "Malformed string at offset ${o}", ( "o", offset( i - 1 ) ) );
+      if( !is_token_end( p + 1 < end ? p[1] : '\0' ) )
+         FC_THROW_EXCEPTION( parse_error_exception, "Unexpected character after string at offset ${o}", ( "o", size_t( p + 1 - _data ) ) );
+      return result;
+   }
+
+   string json_tape::read_key( size_t& i )const
+   {
+      string key = read_string( i );
+      expect( i, ':' );
+      return key;
+   }
+
+   variant json_tape::read_scalar( size_t& i )const
+   {
+      const char* start = _data + offset( i );
+      const char* end = _data + _size;
+      const char* p = start;
+      while( p < end && !is_token_end( *p ) )
+         ++p;
+      const size_t len = p - start;
+      ++i;
+      if( offset( i ) < size_t( p - _data ) )
+         FC_THROW_EXCEPTION( parse_error_exception, "Malformed token at offset ${o}", ( "o", offset( i - 1 ) ) );
+
+      switch( *start )
+      {
+         case 't':
+            if( len == 4 && std::memcmp( start, "true", 4 ) == 0 )
+               return variant( true );
+            break;
+         case 'f':
+            if( len == 5 && std::memcmp( start, "false", 5 ) == 0 )
+               return variant( false );
+            break;
+         case 'n':
+            if( len == 4 && std::memcmp( start, "null", 4 ) == 0 )
+               return variant();
+            break;
+         default:
+         {
+            // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+            const char* q = start;
+            const bool neg = ( *q == '-' );
+            if( neg )
+               ++q;
+            const char* int_start = q;
+            while( q < p && *q >= '0' && *q <= '9' )
+               ++q;
+            const size_t int_digits = q - int_start;
+            if( int_digits == 0 || ( int_digits > 1 && *int_start == '0' ) )
+               break;
+            bool is_double = false;
+            if( q < p && *q == '.' )
+            {
+               ++q;
+               const char* frac_start = q;
+               while( q < p && *q >= '0' && *q <= '9' )
+                  ++q;
+               if( q == frac_start )
+                  break;
+               is_double = true;
+            }
+            if( q < p && ( *q == 'e' || *q == 'E' ) )
+            {
+               ++q;
+               if( q < p && ( *q == '+' || *q == '-' ) )
+                  ++q;
+               const char* exp_start = q;
+               while( q < p && *q >= '0' && *q <= '9' )
+                  ++q;
+               if( q == exp_start )
+                  break;
+               is_double = true;
+               _legacy_divergent = true;
+            }
+            if( q != p )
+               break;
+
+            if( is_double )
+               return variant( to_double( string( start, len ) ) );
+
+            // overflow-checked accumulation instead of to_int64/to_uint64 which would need a string
+            uint64_t value = 0;
+            for( const char* d = int_start; d < p; ++d )
+            {
+               const uint64_t digit = uint64_t( *d - '0' );
+               if( value > ( std::numeric_limits< uint64_t >::max() - digit ) / 10 )
+                  FC_THROW_EXCEPTION( parse_error_exception, "Number ${n} is out of range", ( "n", string( start, len ) ) );
+               value = value * 10 + digit;
+            }
+            if( !neg )
+               return variant( value );
+            if( value > uint64_t( std::numeric_limits< int64_t >::max() ) + 1 )
+               FC_THROW_EXCEPTION( parse_error_exception, "Number ${n} is out of range", ( "n", string( start, len ) ) );
+            return variant( int64_t( 0 - value ) );
+         }
+      }
+      FC_THROW_EXCEPTION( parse_error_exception, "Can't parse token \"${token}\" as a JSON value", ( "token", string( start, len ) ) );
+   }
+
+   variant json_tape::read_value( size_t& i, uint32_t depth )const
+   {
+      depth++;
+      FC_ASSERT( depth <= JSON_MAX_RECURSION_DEPTH );
+      switch( at( i ) )
+      {
+         case '{':
+         {
+            mutable_variant_object obj;
+            ++i;
+            if( at( i ) == '}' )
+            {
+               ++i;
+               return obj;
+            }
+            while( true )
+            {
+               string key = read_key( i );
+               variant val = read_value( i, depth );
+               obj( std::move( key ), std::move( val ) );
+               char c = at( i++ );
+               if( c == '}' )
+                  return obj;
+               if( c != ',' )
+                  FC_THROW_EXCEPTION( parse_error_exception, "Expected ',' or '}' at offset ${o}", ( "o", offset( i - 1 ) ) );
+            }
+         }
+         case '[':
+         {
+            variants arr;
+            read_array( i, depth - 1, [&]( size_t& j, uint32_t d )
+            {
+               arr.push_back( read_value( j, d ) );
+            } );
+            return arr;
+         }
+         case '"':
+            return read_string( i );
+         case '\0':
+            if( offset( i ) >= _size )
+               FC_THROW_EXCEPTION( eof_exception, "unexpected end of file" );
+            break;
+         case '}':
+         case ']':
+         case ':':
+         case ',':
+            break;
+         default:
+            return read_scalar( i );
+      }
+      FC_THROW_EXCEPTION( parse_error_exception, "Unexpected char '${c}' at offset ${o}", ( "c", string( 1, at( i ) ) )( "o", offset( i ) ) );
+   }
+
+   void json_tape::skip_value( size_t& i, uint32_t depth )const
+   {
+      // values of unknown keys are still fully validated, just not kept
+      read_value( i, depth );
+   }
+
+   void json_tape::read( size_t& i, string& v, uint32_t depth )const
+   {
+      if( at( i ) == '"' )
+         v = read_string( i );
+      else
+         read_fallback( i, v, depth );
+   }
+
+   void json_tape::read( size_t& i, std::vector<char>& v, uint32_t depth )const
+   {
+      // hex encoded, conversion is defined by from_variant
+      read_fallback( i, v, depth );
+   }
+
+   variant json_tape::to_variant( uint32_t depth )const
+   {
+      size_t i = 0;
+      variant result = read_value( i, depth );
+      check_end( i );
+      return result;
+   }
+
+} // fc
@@ -0,0 +1,42 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(fc_crypto)
+
+BOOST_AUTO_TEST_CASE(recover_many_test)
+{
+   std::vector< std::pair< fc::sha256, fc::ecc::compact_signature > > signatures;
+   std::vector< fc::ecc::public_key > expected;
+   for( int i = 0; i < 50; ++i )
+   {
+      auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( "key" + std::to_string( i ) ) );
+      auto digest = fc::sha256::hash( "digest" + std::to_string( i ) );
+      signatures.emplace_back( digest, key.sign_compact( digest ) );
+      expected.push_back( key.get_public_key() );
+   }
+   signatures[7].second.data[0] = 1; // invalid recovery id
+
+   for( uint32_t threads : { 0, 3, 1 } )
+   {
+      fc::ecc::public_key::set_recovery_threads( threads );
+      auto keys = fc::ecc::public_key::recover_many( signatures );
+      BOOST_REQUIRE_EQUAL( keys.size(), signatures.size() );
+      for( size_t i = 0; i < keys.size(); ++i )
+      {
+         if( i == 7 )
+         {
+            BOOST_CHECK( !keys[i].valid() );
+            continue;
+         }
+         BOOST_REQUIRE( keys[i].valid() );
+         BOOST_CHECK( *keys[i] == expected[i] );
+      }
+   }
+   fc::ecc::public_key::set_recovery_threads( 0 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
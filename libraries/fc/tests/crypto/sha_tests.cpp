@@ -5,10 +5,12 @@
 #include <fc/crypto/sha1.hpp>
 #include <fc/crypto/sha224.hpp>
 #include <fc/crypto/sha256.hpp>
+#include <fc/crypto/sha256_multi_buffer.hpp>
 #include <fc/crypto/sha512.hpp>
 #include <fc/exception/exception.hpp>
 
 #include <iostream>
+#include <vector>
 
 // SHA test vectors taken from http://www.di-mgt.com.au/sha_testvectors.html
 static const std::string TEST1("abc");
@@ -175,4 +177,97 @@ BOOST_AUTO_TEST_CASE(sha512_test)
     test_stream<fc::sha512>();
 }
 
+BOOST_AUTO_TEST_CASE(hash_many_test)
+{
+    // sizes around padding (55/56 bytes) and block (64 bytes) boundaries, counts that do not fill all lanes
+    std::vector< std::string > inputs;
+    for( uint32_t size : { 0, 1, 3, 32, 55, 56, 63, 64, 65, 119, 120, 128, 200, 1000 } )
+    {
+        std::string s( size, ' ' );
+        for( uint32_t i = 0; i < size; ++i )
+            s[i] = char( i * 7 + size );
+        inputs.push_back( s );
+    }
+
+    for( size_t count = 0; count <= inputs.size(); ++count )
+    {
+        std::vector< const char* > data;
+        std::vector< uint32_t > sizes;
+        for( size_t i = 0; i < count; ++i )
+        {
+            data.push_back( inputs[i].data() );
+            sizes.push_back( inputs[i].size() );
+        }
+
+        std::vector< fc::sha256 > sha( count );
+        fc::sha256::hash_many( data.data(), sizes.data(), count, sha.data() );
+        std::vector< fc::ripemd160 > ripemd( count );
+        fc::ripemd160::hash_many( data.data(), sizes.data(), count, ripemd.data() );
+
+        for( size_t i = 0; i < count; ++i )
+        {
+            BOOST_CHECK_EQUAL( sha[i].str(), fc::sha256::hash( inputs[i] ).str() );
+            BOOST_CHECK_EQUAL( ripemd[i].str(), fc::ripemd160::hash( inputs[i] ).str() );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hash_many_avx2_test)
+{
+#ifdef FC_SHA256_AVX2
+    // hash_many picks AVX2 kernel only on CPUs without SHA extensions, so call it directly
+    if( !fc::detail::sha256_avx2_supported() )
+    {
+        BOOST_TEST_MESSAGE( "CPU does not support AVX2, skipping" );
+        return;
+    }
+
+    auto make_input = []( uint32_t size, uint32_t seed )
+    {
+        std::string s( size, ' ' );
+        for( uint32_t i = 0; i < size; ++i )
+            s[i] = char( i * 13 + seed );
+        return s;
+    };
+    auto check = []( const std::vector< std::string >& inputs )
+    {
+        std::vector< const char* > data;
+        std::vector< uint32_t > sizes;
+        for( const auto& s : inputs )
+        {
+            data.push_back( s.data() );
+            sizes.push_back( s.size() );
+        }
+        std::vector< fc::sha256 > sha( inputs.size() );
+        fc::detail::sha256_hash_many_avx2( data.data(), sizes.data(), inputs.size(), sha.data() );
+        for( size_t i = 0; i < inputs.size(); ++i )
+            BOOST_CHECK_EQUAL( sha[i].str(), fc::sha256::hash( inputs[i] ).str() );
+    };
+
+    // all lanes of the same length, around padding (55/56 bytes) and block (64 bytes) boundaries
+    for( uint32_t size : { 0, 55, 56, 63, 64, 65 } )
+    {
+        for( size_t count : { 1, 3, 7, 8, 9, 17 } )
+        {
+            std::vector< std::string > inputs;
+            for( size_t i = 0; i < count; ++i )
+                inputs.push_back( make_input( size, i ) );
+            check( inputs );
+        }
+    }
+
+    // mixed lengths within the same batch, so lanes finish after different number of blocks
+    const uint32_t mixed[] = { 0, 65, 55, 1000, 56, 63, 64, 1, 120, 119, 128, 3, 200 };
+    for( size_t count = 1; count <= sizeof( mixed ) / sizeof( mixed[0] ); ++count )
+    {
+        std::vector< std::string > inputs;
+        for( size_t i = 0; i < count; ++i )
+            inputs.push_back( make_input( mixed[i], i ) );
+        check( inputs );
+    }
+#else
+    BOOST_TEST_MESSAGE( "AVX2 kernel not built on this platform, skipping" );
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END()
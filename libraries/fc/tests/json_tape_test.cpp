@@ -0,0 +1,143 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/json_tape.hpp>
+#include <fc/container/flat.hpp>
+#include <fc/reflect/variant.hpp>
+
+namespace fc { namespace test {
+
+struct json_tape_inner
+{
+   std::string name;
+   uint32_t    value = 0;
+};
+
+struct json_tape_outer
+{
+   std::string                      id;
+   std::vector< json_tape_inner >   items;
+   fc::flat_set< std::string >      tags;
+   fc::optional< int64_t >          delta;
+   bool                             flag = false;
+};
+
+} }
+
+FC_REFLECT( fc::test::json_tape_inner, (name)(value) )
+FC_REFLECT( fc::test::json_tape_outer, (id)(items)(tags)(delta)(flag) )
+
+BOOST_AUTO_TEST_SUITE(fc)
+
+BOOST_AUTO_TEST_CASE(json_tape_matches_legacy_parser)
+{
+   const std::vector< std::string > inputs = {
+      "{\"a\":1,\"b\":[true,false,null],\"c\":{\"d\":\"e\"}}",
+      "  [ 1 , -2 , 18446744073709551615 , -9223372036854775808 ]  ",
+      "\"plain string\"",
+      "{\"jsonrpc\":\"2.0\",\"method\":\"condenser_api.get_block\",\"params\":[12345],\"id\":1}",
+      // long enough to cross several 64 byte blocks, with quotes and brackets inside strings
+      "{\"json\":\"[\\\"follow\\\",{\\\"follower\\\":\\\"alice\\\",\\\"following\\\":\\\"bob\\\",\\\"what\\\":[\\\"blog\\\"]}]\","
+      "\"required_auths\":[],\"required_posting_auths\":[\"alice\"],\"id\":\"follow\",\"memo\":\"{[,:]}\"}"
+   };
+
+   for( const auto& input : inputs )
+   {
+      BOOST_TEST_MESSAGE( input );
+      BOOST_CHECK_EQUAL( fc::json::to_string( fc::json::from_string( input, fc::json::fast_parser ) ),
+                         fc::json::to_string( fc::json::from_string( input ) ) );
+   }
+}
+
+BOOST_AUTO_TEST_CASE(json_tape_strings)
+{
+   BOOST_CHECK_EQUAL( fc::json::from_string( "\"a\\\"b\\\\c\\/d\\n\"", fc::json::fast_parser ).as_string(), "a\"b\\c/d\n" );
+   BOOST_CHECK_EQUAL( fc::json::from_string( "\"\\u0041\\u00e9\\ud83d\\ude00\"", fc::json::fast_parser ).as_string(), "A\xc3\xa9\xf0\x9f\x98\x80" );
+   // escaped backslash right before closing quote, placed across block boundary
+   std::string s = "\"" + std::string( 61, 'x' ) + "\\\\\"";
+   BOOST_CHECK_EQUAL( fc::json::from_string( s, fc::json::fast_parser ).as_string(), std::string( 61, 'x' ) + "\\" );
+   // odd number of backslashes escapes the quote
+   s = "[\"" + std::string( 60, 'x' ) + "\\\\\\\"\"]";
+   BOOST_CHECK_EQUAL( fc::json::from_string( s, fc::json::fast_parser ).get_array()[0].as_string(), std::string( 60, 'x' ) + "\\\"" );
+}
+
+BOOST_AUTO_TEST_CASE(json_tape_numbers)
+{
+   BOOST_CHECK( fc::json::from_string( "42", fc::json::fast_parser ).is_uint64() );
+   BOOST_CHECK( fc::json::from_string( "-42", fc::json::fast_parser ).is_int64() );
+   BOOST_CHECK( fc::json::from_string( "1.5", fc::json::fast_parser ).is_double() );
+   BOOST_CHECK_EQUAL( fc::json::from_string( "1e3", fc::json::fast_parser ).as_double(), 1000.0 );
+   BOOST_CHECK_THROW( fc::json::from_string( "18446744073709551616", fc::json::fast_parser ), fc::parse_error_exception );
+   BOOST_CHECK_THROW( fc::json::from_string( "01", fc::json::fast_parser ), fc::parse_error_exception );
+   BOOST_CHECK_THROW( fc::json::from_string( "1.", fc::json::fast_parser ), fc::parse_error_exception );
+}
+
+BOOST_AUTO_TEST_CASE(json_tape_legacy_compatibility)
+{
+   const std::vector< std::string > compatible = {
+      "{\"a\":\"b\\n\\\"c\\/\",\"n\":[1,-2,1.5]}",
+      "[\"\\\\\",\"\\t\\r\"]"
+   };
+   for( const auto& input : compatible )
+   {
+      BOOST_TEST_MESSAGE( input );
+      fc::json_tape tape( input );
+      BOOST_CHECK_EQUAL( fc::json::to_string( tape.to_variant() ), fc::json::to_string( fc::json::from_string( input ) ) );
+      BOOST_CHECK( tape.matches_legacy_parser() );
+   }
+
+   // legacy_parser reads these as plain characters or strings
+   const std::vector< std::string > divergent = { "\"\\u0041\"", "[\"\\b\"]", "{\"f\":\"\\f\"}", "[1e3]" };
+   for( const auto& input : divergent )
+   {
+      BOOST_TEST_MESSAGE( input );
+      fc::json_tape tape( input );
+      tape.to_variant();
+      BOOST_CHECK( !tape.matches_legacy_parser() );
+   }
+}
+
+BOOST_AUTO_TEST_CASE(json_tape_rejects_malformed_input)
+{
+   const std::vector< std::string > inputs = {
+      "{", "[1,2", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "\"unterminated", "nul", "truex",
+      "{} {}", "\"a\"b", "\"\\x\"", "\"\xc0\xaf\"", "\"\xed\xa0\x80\""
+   };
+   for( const auto& input : inputs )
+   {
+      BOOST_TEST_MESSAGE( input );
+      BOOST_CHECK_THROW( fc::json::from_string( input, fc::json::fast_parser ), fc::exception );
+   }
+
+   std::string deep( JSON_MAX_RECURSION_DEPTH + 1, '[' );
+   deep += std::string( JSON_MAX_RECURSION_DEPTH + 1, ']' );
+   BOOST_CHECK_THROW( fc::json::from_string( deep, fc::json::fast_parser ), fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE(json_tape_reflected_types)
+{
+   const std::string input =
+      "{\"id\":\"x\",\"unknown\":{\"nested\":[1,2,{}]},\"items\":[{\"name\":\"a\",\"value\":1},{\"name\":\"b\",\"value\":\"2\"}],"
+      "\"tags\":[\"z\",\"y\",\"z\"],\"delta\":-5,\"flag\":true}";
+
+   auto direct = fc::json::from_string_as< fc::test::json_tape_outer >( input );
+   auto legacy = fc::json::from_string( input ).as< fc::test::json_tape_outer >();
+
+   BOOST_CHECK_EQUAL( direct.id, legacy.id );
+   BOOST_REQUIRE_EQUAL( direct.items.size(), 2u );
+   BOOST_CHECK_EQUAL( direct.items[1].name, "b" );
+   BOOST_CHECK_EQUAL( direct.items[1].value, 2u );
+   BOOST_CHECK( direct.tags == legacy.tags );
+   BOOST_REQUIRE( direct.delta.valid() );
+   BOOST_CHECK_EQUAL( *direct.delta, -5 );
+   BOOST_CHECK( direct.flag );
+
+   BOOST_CHECK_THROW( fc::json::from_string_as< fc::test::json_tape_outer >( "{\"id\":\"x\"} 1" ), fc::exception );
+
+   // repeated keys resolve the same way as in conversion from variant
+   const std::string repeated = "{\"id\":\"first\",\"flag\":true,\"id\":\"second\",\"items\":[],\"id\":{}}";
+   BOOST_CHECK_EQUAL( fc::json::from_string_as< fc::test::json_tape_outer >( repeated ).id,
+                      fc::json::from_string( repeated ).as< fc::test::json_tape_outer >().id );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,109 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/io/datastream.hpp>
+
+#include <string>
+#include <vector>
+
+namespace fc { namespace test {
+   /// packs its content as blob made with pack_to_vector, like types that carry pre-serialized data
+   struct raw_pack_nested;
+} }
+
+namespace fc { namespace raw {
+   template< typename Stream >
+   inline void pack( Stream& s, const fc::test::raw_pack_nested& n );
+} }
+
+#include <fc/io/raw.hpp>
+
+namespace fc { namespace test {
+
+struct raw_pack_inner
+{
+   std::string             name;
+   std::vector< uint32_t > values;
+};
+
+struct raw_pack_outer
+{
+   uint64_t                        id = 0;
+   std::vector< raw_pack_inner >   items;
+   std::string                     memo;
+};
+
+struct raw_pack_nested
+{
+   raw_pack_outer content;
+};
+
+} }
+
+FC_REFLECT( fc::test::raw_pack_inner, (name)(values) )
+FC_REFLECT( fc::test::raw_pack_outer, (id)(items)(memo) )
+
+namespace fc { namespace raw {
+   template< typename Stream >
+   inline void pack( Stream& s, const fc::test::raw_pack_nested& n )
+   {
+      fc::raw::pack( s, fc::raw::pack_to_vector( n.content ) );
+   }
+} }
+
+namespace fc { namespace test {
+
+template< typename T >
+std::vector< char > two_pass_pack( const T& v )
+{
+   std::vector< char > result( fc::raw::pack_size( v ) );
+   fc::datastream< char* > ds( result.data(), result.size() );
+   fc::raw::pack( ds, v );
+   return result;
+}
+
+raw_pack_outer make_object( uint32_t items, size_t memo_size )
+{
+   raw_pack_outer v;
+   v.id = 0x1122334455667788ull + items;
+   for( uint32_t i = 0; i < items; ++i )
+      v.items.push_back( { std::string( i % 300, 'a' + i % 26 ), std::vector< uint32_t >( i % 17, i ) } );
+   v.memo = std::string( memo_size, 'm' );
+   return v;
+}
+
+} }
+
+BOOST_AUTO_TEST_SUITE(fc)
+
+BOOST_AUTO_TEST_CASE(single_pass_pack_matches_two_pass)
+{
+   // growing from empty buffer, then reusing bigger buffer for smaller objects
+   for( uint32_t items : { 0u, 1u, 7u, 300u, 2000u, 3u } )
+   {
+      const auto v = fc::test::make_object( items, items * 5 );
+      const auto expected = fc::test::two_pass_pack( v );
+
+      BOOST_CHECK( fc::raw::pack_to_vector( v ) == expected );
+
+      const auto view = fc::raw::pack_to_thread_buffer( v );
+      BOOST_REQUIRE_EQUAL( view.size(), expected.size() );
+      BOOST_CHECK( std::equal( view.begin(), view.end(), expected.begin() ) );
+   }
+}
+
+BOOST_AUTO_TEST_CASE(nested_pack_keeps_outer_buffer)
+{
+   const fc::test::raw_pack_nested n{ fc::test::make_object( 50, 1000 ) };
+   const std::vector< fc::test::raw_pack_nested > list( 3, n );
+
+   // every element calls pack_to_vector while outer pack_to_thread_buffer is in progress;
+   // result has to be the same as packing already serialized blobs
+   const auto blob = fc::test::two_pass_pack( n.content );
+   const auto expected = fc::test::two_pass_pack( std::vector< std::vector< char > >( 3, blob ) );
+
+   const auto view = fc::raw::pack_to_thread_buffer( list );
+   BOOST_REQUIRE_EQUAL( view.size(), expected.size() );
+   BOOST_CHECK( std::equal( view.begin(), view.end(), expected.begin() ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
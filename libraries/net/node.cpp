@@ -83,6 +83,7 @@
 
 #include <hive/protocol/config.hpp>
 #include <hive/plugins/statsd/utility.hpp>
+#include <hive/utilities/performance_trace.hpp>
 
 #include <fc/git_revision.hpp>
 
@@ -1851,6 +1852,7 @@ namespace graphene { namespace net {
       VERIFY_CORRECT_THREAD();
 
       activity_tracer aTracer(__FUNCTION__, *this);
+      HIVE_TRACE_SCOPE( "p2p", "on_message", received_message.msg_type );
 
       message_hash_type message_hash = received_message.id();
       send_message_timing_to_statsd( originating_peer, received_message, message_hash );
@@ -3691,6 +3693,7 @@ namespace graphene { namespace net {
                                           const message_hash_type& message_hash)
     {
       VERIFY_CORRECT_THREAD();
+      HIVE_TRACE_SCOPE( "p2p", "process_block_message" );
       // keep the peer from being deleted until we're done processing this message
       peer_connection_ptr peer = originating_peer->shared_from_this();
 
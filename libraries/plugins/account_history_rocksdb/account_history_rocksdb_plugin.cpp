@@ -4,6 +4,7 @@
 #include <hive/plugins/account_history_rocksdb/account_history_rocksdb_plugin.hpp>
 
 #include <hive/chain/database.hpp>
+#include <hive/chain/database_exceptions.hpp>
 #include <hive/chain/hive_objects.hpp>
 #include <hive/chain/index.hpp>
 #include <hive/chain/util/impacted.hpp>
@@ -74,6 +75,7 @@ using hive::protocol::signed_transaction;
 
 using hive::chain::operation_notification;
 using hive::chain::transaction_id_type;
+using hive::chain::plugin_exception;
 
 using hive::protocol::legacy_asset;
 using hive::utilities::benchmark_dumper;
@@ -462,6 +464,11 @@ public:
         on_post_reindex( note );
       }, _self, 0);
 
+    _mainDb.add_replay_checkpoint_handler([&]( const hive::chain::replay_checkpoint_notification& note ) -> void
+      {
+        on_replay_checkpoint( note );
+      }, _self, 0);
+
     _mainDb.add_snapshot_supplement_handler([&](const hive::chain::prepare_snapshot_supplement_notification& note) -> void
       {
         supplement_snapshot(note);
@@ -594,6 +601,7 @@ public:
   void printReport(uint32_t blockNo, const char* detailText) const;
   void on_pre_reindex( const hive::chain::reindex_notification& note );
   void on_post_reindex( const hive::chain::reindex_notification& note );
+  void on_replay_checkpoint( const hive::chain::replay_checkpoint_notification& note );
 
   /// Allows to start immediate data import (outside replay process).
   void importData(unsigned int blockLimit);
@@ -1824,9 +1832,23 @@ void account_history_rocksdb_plugin::impl::on_pre_reindex(const hive::chain::rei
 
   openDb( false );
 
-  ilog("Setting write limit to massive level");
+  // storage written past state (crash between our write at replay checkpoint and commit of state) would get
+  // the same operations again under new ids
+  HIVE_ASSERT( note.force_replay || _cached_reindex_point <= _mainDb.head_block_num(), plugin_exception,
+    "Account history storage holds data up to block ${r} while state is at block ${h}, replay has to be forced",
+    ( "r", _cached_reindex_point )( "h", _mainDb.head_block_num() ) );
 
-  _collectedOpsWriteLimit = WRITE_BUFFER_FLUSH_LIMIT;
+  if( note.args.replay_checkpoint_interval != 0 || note.args.replay_checkpoint_minutes != 0 )
+  {
+    // crash can rewind state to last checkpoint, so nothing can be written between checkpoints
+    ilog("Holding writes until replay checkpoint");
+    _collectedOpsWriteLimit = std::numeric_limits< unsigned int >::max();
+  }
+  else
+  {
+    ilog("Setting write limit to massive level");
+    _collectedOpsWriteLimit = WRITE_BUFFER_FLUSH_LIMIT;
+  }
 
   _lastTx = transaction_id_type();
   _txNo = 0;
@@ -1839,6 +1861,9 @@ void account_history_rocksdb_plugin::impl::on_pre_reindex(const hive::chain::rei
 
 void account_history_rocksdb_plugin::impl::on_post_reindex(const hive::chain::reindex_notification& note)
 {
+  if( !_reindexing )
+    return; // on_pre_reindex refused to continue, storage must stay untouched
+
   ilog("Reindex completed up to block: ${b}. Setting back write limit to non-massive level.",
     ("b", note.last_block_number));
 
@@ -1852,6 +1877,13 @@ void account_history_rocksdb_plugin::impl::on_post_reindex(const hive::chain::re
   printReport( note.last_block_number, "RocksDB data reindex finished." );
 }
 
+void account_history_rocksdb_plugin::impl::on_replay_checkpoint(const hive::chain::replay_checkpoint_notification& note)
+{
+  update_reindex_point( note.block_num );
+  flushStorage();
+  note.plugin_positions[ "account_history_rocksdb" ] = note.block_num;
+}
+
 std::string get_asset_amount(const asset& amount)
 {
   std::string asset_with_amount_string = legacy_asset::from_asset(amount).to_string();
@@ -6,6 +6,8 @@
 
 #include <hive/protocol/get_config.hpp>
 
+#include <fc/io/json.hpp>
+
 namespace hive { namespace plugins { namespace block_api {
 
 class block_api_impl
@@ -20,6 +22,11 @@ class block_api_impl
       (get_block_range)
     )
 
+    // result of get_block_range serialized directly to JSON, one block at a time
+    std::string get_block_range_json( const get_block_range_args& args );
+
+    void for_each_block_in_range( const get_block_range_args& args, const std::function< void( const signed_block&, const block_id_type& ) >& processor );
+
     chain::database& _db;
 };
 
@@ -33,6 +40,8 @@ block_api::block_api()
   : my( new block_api_impl() )
 {
   JSON_RPC_REGISTER_API( HIVE_BLOCK_API_PLUGIN_NAME );
+  appbase::app().get_plugin< hive::plugins::json_rpc::json_rpc_plugin >().add_serialized_api_method( HIVE_BLOCK_API_PLUGIN_NAME, "get_block_range",
+    [this]( const fc::variant& args ) { return my->get_block_range_json( args.as< get_block_range_args >() ); } );
 }
 
 block_api::~block_api() {}
@@ -66,9 +75,8 @@ DEFINE_API_IMPL( block_api_impl, get_block )
   return result;
 }
 
-DEFINE_API_IMPL( block_api_impl, get_block_range )
+void block_api_impl::for_each_block_in_range( const get_block_range_args& args, const std::function< void( const signed_block&, const block_id_type& ) >& processor )
 {
-  get_block_range_return result;
   auto count = args.count;
   auto head = _db.head_block_num_from_fork_db(fc::seconds(1));
   if( args.starting_block_num > head )
@@ -76,15 +84,35 @@ DEFINE_API_IMPL( block_api_impl, get_block_range )
   else if( args.starting_block_num + count - 1 > head )
     count = head - args.starting_block_num + 1;
   if( count )
+    _db.for_each_block_in_range(args.starting_block_num, count, processor, fc::seconds(1));
+}
+
+DEFINE_API_IMPL( block_api_impl, get_block_range )
+{
+  get_block_range_return result;
+  for_each_block_in_range( args, [&]( const signed_block& block, const block_id_type& id )
   {
-    vector<signed_block> blocks = _db.fetch_block_range(args.starting_block_num, count, fc::seconds(1));
-    result.blocks.reserve(blocks.size());
-    for (const signed_block& block : blocks)
-      result.blocks.push_back(block);
-  }
+    result.blocks.emplace_back( block, id );
+  } );
   return result;
 }
 
+std::string block_api_impl::get_block_range_json( const get_block_range_args& args )
+{
+  // same layout as serialized get_block_range_return
+  std::string json = "{\"blocks\":[";
+  bool first = true;
+  for_each_block_in_range( args, [&]( const signed_block& block, const block_id_type& id )
+  {
+    if( !first )
+      json += ',';
+    first = false;
+    json += fc::json::to_string( api_signed_block_object( block, id ) );
+  } );
+  json += "]}";
+  return json;
+}
+
 DEFINE_LOCKLESS_APIS( block_api,
   (get_block_header)
   (get_block)
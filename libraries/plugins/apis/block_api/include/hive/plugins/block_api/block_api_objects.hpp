@@ -26,13 +26,12 @@ struct api_signed_block : public signed_block_header
 
 struct api_signed_block_object : public api_signed_block
 {
-  api_signed_block_object( const signed_block& block ) : api_signed_block( block )
+  api_signed_block_object( const signed_block& block ) : api_signed_block_object( block, block.id() ) {}
+  api_signed_block_object( const signed_block& block, const block_id_type& known_block_id ) : api_signed_block( block )
   {
-    block_id = id();
+    block_id = known_block_id;
     signing_key = signee();
-    transaction_ids.reserve( transactions.size() );
-    for( const auto& tx : transactions )
-      transaction_ids.push_back( tx.id() );
+    transaction_ids = block.calculate_transaction_ids();
   }
   api_signed_block_object() {}
 
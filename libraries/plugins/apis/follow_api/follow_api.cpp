@@ -0,0 +1,67 @@
+#include <hive/plugins/follow_api/follow_api_plugin.hpp>
+#include <hive/plugins/follow_api/follow_api.hpp>
+
+#include <hive/chain/comment_object.hpp>
+
+namespace hive { namespace plugins { namespace follow {
+
+namespace detail {
+
+class follow_api_impl
+{
+  public:
+    follow_api_impl() :
+      _db( appbase::app().get_plugin< hive::plugins::chain::chain_plugin >().db() ),
+      _follow( appbase::app().get_plugin< hive::plugins::follow::follow_plugin >() ) {}
+
+    DECLARE_API_IMPL(
+      (get_feed)
+    )
+
+    chain::database& _db;
+    follow_plugin&   _follow;
+};
+
+DEFINE_API_IMPL( follow_api_impl, get_feed )
+{
+  FC_ASSERT( args.limit <= 1000, "Cannot retrieve more than 1000 feed entries at a time." );
+
+  get_feed_return result;
+  const auto entries = _follow.get_feed( args.account, args.limit );
+  result.feed.reserve( entries.size() );
+
+  for( const auto& entry : entries )
+  {
+    api_feed_entry e;
+    e.comment = entry.comment;
+    e.reblogged_by = entry.reblogged_by;
+    e.first_reblogged_by = entry.first_reblogged_by;
+    e.first_reblogged_on = entry.first_reblogged_on;
+
+    const chain::comment_cashout_object* cc = _db.find_comment_cashout( entry.comment );
+    if( cc != nullptr )
+    {
+      e.author = _db.get_account( cc->get_author_id() ).get_name();
+      e.permlink = chain::to_string( cc->get_permlink() );
+    }
+
+    result.feed.emplace_back( std::move( e ) );
+  }
+
+  return result;
+}
+
+} // detail
+
+follow_api::follow_api(): my( new detail::follow_api_impl() )
+{
+  JSON_RPC_REGISTER_API( HIVE_FOLLOW_API_PLUGIN_NAME );
+}
+
+follow_api::~follow_api() {}
+
+DEFINE_READ_APIS( follow_api,
+  (get_feed)
+)
+
+} } } // hive::plugins::follow
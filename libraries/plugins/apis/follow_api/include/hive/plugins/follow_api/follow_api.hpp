@@ -0,0 +1,63 @@
+#pragma once
+#include <hive/plugins/json_rpc/utility.hpp>
+#include <hive/plugins/follow/follow_plugin.hpp>
+
+#include <hive/protocol/types.hpp>
+
+#include <fc/optional.hpp>
+#include <fc/variant.hpp>
+#include <fc/vector.hpp>
+
+namespace hive { namespace plugins { namespace follow {
+
+namespace detail
+{
+  class follow_api_impl;
+}
+
+/// Feed position with author and permlink of the comment (known only until comment is paid out)
+struct api_feed_entry
+{
+  hive::chain::comment_id_type  comment;
+  account_name_type             author;
+  std::string                   permlink;
+  vector< account_name_type >   reblogged_by;
+  account_name_type             first_reblogged_by;
+  fc::time_point_sec            first_reblogged_on;
+};
+
+struct get_feed_args
+{
+  account_name_type account;
+  uint32_t          limit = 100;
+};
+
+struct get_feed_return
+{
+  vector< api_feed_entry > feed;
+};
+
+class follow_api
+{
+  public:
+    follow_api();
+    ~follow_api();
+
+    DECLARE_API(
+      (get_feed)
+    )
+
+  private:
+    std::unique_ptr< detail::follow_api_impl > my;
+};
+
+} } } // hive::plugins::follow
+
+FC_REFLECT( hive::plugins::follow::api_feed_entry,
+        (comment)(author)(permlink)(reblogged_by)(first_reblogged_by)(first_reblogged_on) );
+
+FC_REFLECT( hive::plugins::follow::get_feed_args,
+        (account)(limit) );
+
+FC_REFLECT( hive::plugins::follow::get_feed_return,
+        (feed) );
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <hive/plugins/json_rpc/utility.hpp>
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <string>
+#include <vector>
+
+namespace hive { namespace plugins { namespace node_metrics_api {
+
+/* get_api_metrics */
+
+struct get_api_metrics_args
+{
+  std::vector< std::string > methods; ///< api.method names to report, empty means all methods called so far
+};
+
+/// Summary of a histogram; percentiles are upper limits of power of 2 buckets
+struct histogram_summary
+{
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t p50 = 0;
+  uint64_t p90 = 0;
+  uint64_t p99 = 0;
+  uint64_t max = 0;
+};
+
+/// Times in microseconds, sizes in bytes
+struct api_method_metrics_summary
+{
+  std::string       method;
+  uint64_t          calls = 0;
+  uint64_t          errors = 0;
+  histogram_summary queue_delay;
+  histogram_summary lock_wait;
+  histogram_summary execution;
+  histogram_summary serialization;
+  histogram_summary response_size;
+};
+
+struct get_api_metrics_return
+{
+  fc::time_point                              collecting_since; ///< throughput is calls / ( now - collecting_since )
+  fc::time_point                              now;
+  std::vector< api_method_metrics_summary >   methods;
+};
+
+namespace detail { class node_metrics_api_impl; }
+
+class node_metrics_api
+{
+public:
+  node_metrics_api();
+  ~node_metrics_api();
+
+  DECLARE_API( (get_api_metrics) )
+private:
+  std::unique_ptr< detail::node_metrics_api_impl > my;
+};
+
+} } } // hive::plugins::node_metrics_api
+
+FC_REFLECT( hive::plugins::node_metrics_api::get_api_metrics_args, (methods) )
+FC_REFLECT( hive::plugins::node_metrics_api::histogram_summary, (count)(sum)(p50)(p90)(p99)(max) )
+FC_REFLECT( hive::plugins::node_metrics_api::api_method_metrics_summary,
+  (method)(calls)(errors)(queue_delay)(lock_wait)(execution)(serialization)(response_size) )
+FC_REFLECT( hive::plugins::node_metrics_api::get_api_metrics_return, (collecting_since)(now)(methods) )
@@ -0,0 +1,32 @@
+#pragma once
+#include <hive/plugins/json_rpc/json_rpc_plugin.hpp>
+
+#include <appbase/application.hpp>
+
+namespace hive { namespace plugins { namespace node_metrics_api {
+
+#define HIVE_NODE_METRICS_API_PLUGIN_NAME "node_metrics_api"
+
+class node_metrics_api_plugin : public appbase::plugin< node_metrics_api_plugin >
+{
+  public:
+    node_metrics_api_plugin();
+    virtual ~node_metrics_api_plugin();
+
+    APPBASE_PLUGIN_REQUIRES(
+      (hive::plugins::json_rpc::json_rpc_plugin)
+    )
+
+    static const std::string& name() { static std::string name = HIVE_NODE_METRICS_API_PLUGIN_NAME; return name; }
+
+    virtual void set_program_options(
+      boost::program_options::options_description& cli,
+      boost::program_options::options_description& cfg ) override;
+    virtual void plugin_initialize( const boost::program_options::variables_map& options ) override;
+    virtual void plugin_startup() override;
+    virtual void plugin_shutdown() override;
+
+    std::unique_ptr< class node_metrics_api > api;
+};
+
+} } } // hive::plugins::node_metrics_api
@@ -0,0 +1,92 @@
+#include <hive/plugins/node_metrics_api/node_metrics_api_plugin.hpp>
+#include <hive/plugins/node_metrics_api/node_metrics_api.hpp>
+
+#include <hive/plugins/json_rpc/api_metrics.hpp>
+
+namespace hive { namespace plugins { namespace node_metrics_api {
+
+namespace detail {
+
+using hive::plugins::json_rpc::api_method_metrics;
+using hive::plugins::json_rpc::log2_histogram;
+
+class node_metrics_api_impl
+{
+public:
+  node_metrics_api_impl() :
+    _json_rpc( appbase::app().get_plugin< hive::plugins::json_rpc::json_rpc_plugin >() ) {}
+
+  DECLARE_API_IMPL( (get_api_metrics) )
+
+  hive::plugins::json_rpc::json_rpc_plugin& _json_rpc;
+};
+
+histogram_summary summarize( const log2_histogram& histogram )
+{
+  const auto s = histogram.get_snapshot();
+  histogram_summary result;
+  result.count = s.count;
+  result.sum = s.sum;
+  result.p50 = s.percentile( 0.5 );
+  result.p90 = s.percentile( 0.9 );
+  result.p99 = s.percentile( 0.99 );
+  result.max = s.percentile( 1.0 );
+  return result;
+}
+
+api_method_metrics_summary summarize( const std::string& method, const api_method_metrics& metrics )
+{
+  api_method_metrics_summary result;
+  result.method = method;
+  result.errors = metrics.errors.load( std::memory_order_relaxed );
+  result.queue_delay = summarize( metrics.queue_delay );
+  result.lock_wait = summarize( metrics.lock_wait );
+  result.execution = summarize( metrics.execution );
+  result.serialization = summarize( metrics.serialization );
+  result.response_size = summarize( metrics.response_size );
+  result.calls = result.execution.count;
+  return result;
+}
+
+DEFINE_API_IMPL( node_metrics_api_impl, get_api_metrics )
+{
+  const auto& registry = _json_rpc.get_api_metrics();
+
+  get_api_metrics_return result;
+  result.collecting_since = registry.collecting_since();
+  result.now = fc::time_point::now();
+
+  if( args.methods.empty() )
+  {
+    registry.for_each_method( [&]( const std::string& method, const api_method_metrics& metrics )
+    {
+      auto summary = summarize( method, metrics );
+      if( summary.calls )
+        result.methods.emplace_back( std::move( summary ) );
+    } );
+  }
+  else
+  {
+    for( const auto& method : args.methods )
+    {
+      const api_method_metrics* metrics = registry.find( method );
+      FC_ASSERT( metrics != nullptr, "Method ${m} does not exist", ( "m", method ) );
+      result.methods.emplace_back( summarize( method, *metrics ) );
+    }
+  }
+
+  return result;
+}
+
+} // hive::plugins::node_metrics_api::detail
+
+node_metrics_api::node_metrics_api() : my( std::make_unique< detail::node_metrics_api_impl >() )
+{
+  JSON_RPC_REGISTER_API( HIVE_NODE_METRICS_API_PLUGIN_NAME );
+}
+
+node_metrics_api::~node_metrics_api() {}
+
+DEFINE_LOCKLESS_APIS( node_metrics_api, (get_api_metrics) )
+
+} } } // hive::plugins::node_metrics_api
@@ -0,0 +1,20 @@
+#include <hive/plugins/node_metrics_api/node_metrics_api_plugin.hpp>
+#include <hive/plugins/node_metrics_api/node_metrics_api.hpp>
+
+namespace hive { namespace plugins { namespace node_metrics_api {
+
+node_metrics_api_plugin::node_metrics_api_plugin() {}
+node_metrics_api_plugin::~node_metrics_api_plugin() {}
+
+void node_metrics_api_plugin::set_program_options( boost::program_options::options_description& cli, boost::program_options::options_description& cfg ) {}
+
+void node_metrics_api_plugin::plugin_initialize( const boost::program_options::variables_map& options )
+{
+  api = std::make_unique< node_metrics_api >();
+}
+
+void node_metrics_api_plugin::plugin_startup() {}
+
+void node_metrics_api_plugin::plugin_shutdown() {}
+
+} } } // hive::plugins::node_metrics_api
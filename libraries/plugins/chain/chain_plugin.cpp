@@ -1,4 +1,5 @@
 #include <hive/chain/database_exceptions.hpp>
+#include <hive/chain/block_compression_dictionaries.hpp>
 
 #include <hive/protocol/signed_transaction_transporter.hpp>
 
@@ -11,6 +12,7 @@
 #include <hive/utilities/notifications.hpp>
 #include <hive/utilities/benchmark_dumper.hpp>
 #include <hive/utilities/database_configuration.hpp>
+#include <hive/utilities/performance_trace.hpp>
 
 #include <fc/string.hpp>
 #include <fc/io/json.hpp>
@@ -107,12 +109,18 @@ class chain_plugin_impl
     void write_default_database_config( bfs::path& p );
     void setup_benchmark_dumper();
 
+    void start_performance_trace();
+    void wait_for_performance_trace_signal();
+    void dump_performance_trace();
+
     uint64_t                         shared_memory_size = 0;
+    uint64_t                         shared_memory_max_size = 0;
     uint16_t                         shared_file_full_threshold = 0;
     uint16_t                         shared_file_scale_rate = 0;
     uint32_t                         chainbase_flags = 0;
     bfs::path                        shared_memory_dir;
     bool                             replay = false;
+    bool                             replay_missing_blocks = false;
     bool                             resync   = false;
     bool                             readonly = false;
     bool                             check_locks = false;
@@ -125,13 +133,19 @@ class chain_plugin_impl
     bool                             exit_before_sync = false;
     bool                             force_replay = false;
     bool                             validate_during_replay = false;
+    uint32_t                         replay_checkpoint_interval = 0;
+    uint32_t                         replay_checkpoint_minutes = 0;
     uint32_t                         benchmark_interval = 0;
     uint32_t                         flush_interval = 0;
     bool                             replay_in_memory = false;
     std::vector< std::string >       replay_memory_indices{};
     bool                             enable_block_log_compression = true;
     int                              block_log_compression_level = 15;
+    uint32_t                         block_log_compression_threads = 0;
     flat_map<uint32_t,block_id_type> loaded_checkpoints;
+    uint32_t                         performance_trace_size = 0;
+    bfs::path                        performance_trace_file;
+    std::shared_ptr< boost::asio::signal_set > performance_trace_signal;
 
     uint32_t allow_future_time = 5;
 
@@ -144,6 +158,10 @@ class chain_plugin_impl
     bool                             running = true;
 
     int16_t                          write_lock_hold_time = HIVE_BLOCK_INTERVAL * 1000 / 6; // 1/6 of block time (millseconds)
+    uint32_t                         pending_tx_deferral_threshold = 0;
+    uint32_t                         postponed_tx_apply_time = 50; // milliseconds
+    /// postponed transactions are reapplied at least that often, even when there are no writes or write queue never drains
+    const fc::microseconds           postponed_tx_apply_interval = fc::milliseconds( 100 );
 
     vector< string >                 loaded_plugins;
     fc::mutable_variant_object       plugin_state_opts;
@@ -191,6 +209,7 @@ struct write_request_visitor
 
     try
     {
+      HIVE_TRACE_SCOPE( "write_queue", "push_block", block->block_num() );
       STATSD_START_TIMER( "chain", "write_time", "push_block", 1.0f )
       fc::time_point time_before_pushing_block = fc::time_point::now();
       result = db->push_block( *block, skip );
@@ -216,6 +235,7 @@ struct write_request_visitor
 
     auto _push_transaction = [this](const signed_transaction* trx, hive::protocol::pack_type pack )
     {
+      HIVE_TRACE_SCOPE( "write_queue", "push_transaction" );
       STATSD_START_TIMER( "chain", "write_time", "push_transaction", 1.0f )
       fc::time_point time_before_pushing_transaction = fc::time_point::now();
       db->push_transaction( signed_transaction_transporter( *trx, pack ) );
@@ -278,6 +298,7 @@ struct write_request_visitor
       if( !block_generator )
         FC_THROW_EXCEPTION( chain_exception, "Received a generate block request, but no block generator has been registered." );
 
+      HIVE_TRACE_SCOPE( "write_queue", "generate_block" );
       STATSD_START_TIMER( "chain", "write_time", "generate_block", 1.0f )
       req->block = block_generator->generate_block(
         req->when,
@@ -335,6 +356,7 @@ void chain_plugin_impl::start_write_processing()
       ilog("Write processing thread started.");
       fc::set_thread_name("write_queue");
       fc::thread::current().set_name("write_queue");
+      hive::utilities::performance_trace::instance().set_thread_name("write_queue");
       cumulative_times_last_reported_time = fc::time_point::now();
 
       const fc::microseconds block_wait_max_time = fc::seconds(10 * HIVE_BLOCK_INTERVAL);
@@ -370,6 +392,15 @@ void chain_plugin_impl::start_write_processing()
       fc::time_point last_msg_time = last_popped_item_time;
       fc::time_point wait_start_time = last_popped_item_time;
 
+      // only this thread changes pending state, so it can track postponed transactions without locking
+      size_t postponed_tx_remaining = 0;
+      fc::time_point last_postponed_tx_apply_time = last_popped_item_time;
+      auto apply_postponed_transactions = [&]( const fc::microseconds& time_limit )
+      {
+        postponed_tx_remaining = db.apply_postponed_transactions( time_limit );
+        last_postponed_tx_apply_time = fc::time_point::now();
+      };
+
       hive::notify_hived_status("syncing");
       while (true)
       {
@@ -390,11 +421,29 @@ void chain_plugin_impl::start_write_processing()
                                                                                                 : block_wait_max_time - time_since_last_popped_item;
           std::unique_lock<std::mutex> lock(queue_mutex);
           bool wait_timed_out = false;
-          while (running && write_queue.empty() && !wait_timed_out)
-            if (queue_condition_variable.wait_for(lock, std::chrono::microseconds(max_time_to_wait.count())) == std::cv_status::timeout)
+          bool apply_postponed = false;
+          while (running && write_queue.empty() && !wait_timed_out && !apply_postponed)
+          {
+            if (postponed_tx_remaining > 0)
+            {
+              // don't let postponed transactions wait for next write
+              if (queue_condition_variable.wait_for(lock, std::chrono::microseconds(postponed_tx_apply_interval.count())) == std::cv_status::timeout)
+                apply_postponed = true;
+            }
+            else if (queue_condition_variable.wait_for(lock, std::chrono::microseconds(max_time_to_wait.count())) == std::cv_status::timeout)
               wait_timed_out = true;
+          }
           if (!running) // we woke because the node is shutting down
             break;
+          if (apply_postponed && write_queue.empty())
+          {
+            lock.unlock();
+            db.with_write_lock([&]()
+            {
+              apply_postponed_transactions( fc::milliseconds( postponed_tx_apply_time ) );
+            });
+            continue;
+          }
           if (wait_timed_out) // we timed out, restart the while loop to print a "No P2P data" message
             continue;
           // otherwise, we woke because the write_queue is non-empty
@@ -406,11 +455,15 @@ void chain_plugin_impl::start_write_processing()
         last_popped_item_time = fc::time_point::now();
 
         fc::time_point write_lock_request_time = fc::time_point::now();
+        const int64_t trace_lock_request_time = hive::utilities::performance_trace::now();
         fc::time_point_sec head_block_time;
         db.with_write_lock([&]()
         {
           uint32_t write_queue_items_processed = 0;
           fc::time_point write_lock_acquired_time = fc::time_point::now();
+          hive::utilities::performance_trace::instance().record( "write_queue", "wait for write lock",
+            trace_lock_request_time, hive::utilities::performance_trace::now() );
+          HIVE_TRACE_SCOPE( "write_queue", "hold write lock" );
           fc::microseconds write_lock_acquisition_time = write_lock_acquired_time - write_lock_request_time;
           cumulative_time_waiting_for_locks += write_lock_acquisition_time;
 
@@ -446,6 +499,18 @@ void chain_plugin_impl::start_write_processing()
               std::unique_lock<std::mutex> lock(queue_mutex);
               if (!running || write_queue.empty())
               {
+                if (!is_syncing && running && !db._postponed_tx.empty())
+                {
+                  // queue is empty, use the rest of write lock time to reapply transactions postponed after last block
+                  fc::microseconds time_left = std::min( fc::milliseconds(postponed_tx_apply_time),
+                    fc::milliseconds(write_lock_hold_time) - ( fc::time_point::now() - write_lock_acquired_time ) );
+                  if (time_left.count() > 0)
+                  {
+                    lock.unlock();
+                    apply_postponed_transactions( time_left );
+                    lock.lock();
+                  }
+                }
                 fc::microseconds write_queue_processed_duration = fc::time_point::now() - write_lock_acquired_time;
                 //if (write_queue_processed_duration > fc::milliseconds(500))
                   fc_wlog(fc::logger::get("chainlock"), "Emptied write_queue of ${write_queue_items_processed} items after ${write_queue_processed_duration}µs (${per_block}µs/block)",
@@ -459,6 +524,12 @@ void chain_plugin_impl::start_write_processing()
 
             last_popped_item_time = fc::time_point::now();
           } // while items in write_queue and time limit not exceeded for live sync
+
+          // new block might have postponed some transactions; when writes keep coming, make sure postponed ones
+          // are not starved by them
+          postponed_tx_remaining = db._postponed_tx.size();
+          if (postponed_tx_remaining > 0 && fc::time_point::now() - last_postponed_tx_apply_time > postponed_tx_apply_interval)
+            apply_postponed_transactions( fc::milliseconds( postponed_tx_apply_time ) );
           head_block_time = db.head_block_time();
         }); // with_write_lock
 
@@ -583,6 +654,7 @@ void chain_plugin_impl::initial_settings()
   }
 
   db.set_flush_interval( flush_interval );
+  db.set_pending_tx_deferral_threshold( pending_tx_deferral_threshold );
   db.add_checkpoints( loaded_checkpoints );
   db.set_require_locking( check_locks );
 
@@ -606,6 +678,7 @@ void chain_plugin_impl::initial_settings()
   db_open_args.initial_supply = HIVE_INIT_SUPPLY;
   db_open_args.hbd_initial_supply = HIVE_HBD_INIT_SUPPLY;
   db_open_args.shared_file_size = shared_memory_size;
+  db_open_args.shared_file_max_size = shared_memory_max_size;
   db_open_args.shared_file_full_threshold = shared_file_full_threshold;
   db_open_args.shared_file_scale_rate = shared_file_scale_rate;
   db_open_args.chainbase_flags = chainbase_flags;
@@ -614,12 +687,15 @@ void chain_plugin_impl::initial_settings()
   db_open_args.exit_after_replay = exit_after_replay;
   db_open_args.force_replay = force_replay;
   db_open_args.validate_during_replay = validate_during_replay;
+  db_open_args.replay_checkpoint_interval = replay_checkpoint_interval;
+  db_open_args.replay_checkpoint_minutes = replay_checkpoint_minutes;
   db_open_args.benchmark_is_enabled = benchmark_is_enabled;
   db_open_args.database_cfg = database_config;
   db_open_args.replay_in_memory = replay_in_memory;
   db_open_args.replay_memory_indices = replay_memory_indices;
   db_open_args.enable_block_log_compression = enable_block_log_compression;
   db_open_args.block_log_compression_level = block_log_compression_level;
+  db_open_args.block_log_compression_threads = block_log_compression_threads;
 }
 
 bool chain_plugin_impl::check_data_consistency()
@@ -640,6 +716,13 @@ bool chain_plugin_impl::check_data_consistency()
     {
       wlog( "Replaying has to be forced, after snapshot's loading. { \"block_log-head\": ${b1}, \"state-head\": ${b2} }", ( "b1", head_block_num_origin )( "b2", head_block_num_state ) );
     }
+    else if( block_log_compression_threads > 0 )
+    {
+      // state only follows blocks already written by background threads, so after the node was killed
+      // it can be behind the block log; missing blocks are applied from the block log before synchronization
+      wlog( "State is behind block log written in background, applying missing blocks. { \"block_log-head\": ${b1}, \"state-head\": ${b2} }", ( "b1", head_block_num_origin )( "b2", head_block_num_state ) );
+      replay_missing_blocks = true;
+    }
     else
     {
       wlog( "Replaying is not finished. Synchronization is not allowed. { \"block_log-head\": ${b1}, \"state-head\": ${b2} }", ( "b1", head_block_num_origin )( "b2", head_block_num_state ) );
@@ -756,6 +839,43 @@ void chain_plugin_impl::setup_benchmark_dumper()
   }
 }
 
+void chain_plugin_impl::start_performance_trace()
+{
+  if( performance_trace_size == 0 )
+    return;
+
+  hive::utilities::performance_trace::instance().enable( performance_trace_size );
+  ilog( "Performance trace enabled for last ${n} spans, send SIGUSR2 to dump it to ${f}",
+    ( "n", performance_trace_size )( "f", performance_trace_file.string() ) );
+
+  performance_trace_signal = std::make_shared< boost::asio::signal_set >( app().get_io_service(), SIGUSR2 );
+  wait_for_performance_trace_signal();
+}
+
+void chain_plugin_impl::wait_for_performance_trace_signal()
+{
+  performance_trace_signal->async_wait( [ this ]( const boost::system::error_code& err, int signal_number )
+  {
+    if( err )
+      return; // signal set cancelled at shutdown
+    dump_performance_trace();
+    wait_for_performance_trace_signal();
+  } );
+}
+
+void chain_plugin_impl::dump_performance_trace()
+{
+  try
+  {
+    uint32_t spans = hive::utilities::performance_trace::instance().dump( performance_trace_file );
+    ilog( "Dumped ${n} performance trace spans to ${f}", ( "n", spans )( "f", performance_trace_file.string() ) );
+  }
+  catch( const fc::exception& e )
+  {
+    elog( "Cannot dump performance trace: ${e}", ( "e", e.to_detail_string() ) );
+  }
+}
+
 } // detail
 
 
@@ -786,21 +906,46 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
         "A 2 precision percentage (0-10000) that defines the threshold for when to autoscale the shared memory file. Setting this to 0 disables autoscaling. Recommended value for consensus node is 9500 (95%). Full node is 9900 (99%)" )
       ("shared-file-scale-rate", bpo::value<uint16_t>()->default_value(0),
         "A 2 precision percentage (0-10000) that defines how quickly to scale the shared memory file. When autoscaling occurs the file's size will be increased by this percent. Setting this to 0 disables autoscaling. Recommended value is between 1000-2000 (10-20%)" )
+      ("shared-file-max-size", bpo::value<string>()->default_value("0"),
+        "Size of address space reserved for the shared memory file. Autoscaling up to this size extends the file in place, without remapping it and stopping block processing. 0 disables the reservation" )
+      ("shared-file-huge-pages", bpo::value<bool>()->default_value(false),
+        "Ask kernel to back the shared memory file with transparent huge pages. Only effective when shared-file-dir is on tmpfs with huge pages allowed (shmem_enabled=advise)" )
+      ("shared-file-prefault", bpo::value<bool>()->default_value(false),
+        "Read the whole shared memory file in parallel right after opening, so block processing does not stall on page faults" )
       ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
       ("flush-state-interval", bpo::value<uint32_t>(),
         "flush shared memory changes to disk every N blocks")
       ("enable-block-log-compression", boost::program_options::value<bool>()->default_value(true), "Compress blocks using zstd as they're added to the block log" )
       ("block-log-compression-level", bpo::value<int>()->default_value(15), "Block log zstd compression level 0 (fast, low compression) - 22 (slow, high compression)" )
+      ("block-log-compression-threads", bpo::value<uint32_t>()->default_value(0),
+        "Number of background threads serializing and compressing irreversible blocks before they are written to the block log, so the write lock doesn't wait for it. 0 writes blocks while the lock is held. "
+        "State only treats blocks as irreversible once they are written, so if the node is killed, blocks that were still queued are applied again on restart" )
+      ("block-log-compression-dictionary", bpo::value<vector<string>>()->composing(),
+        "Pairs of NUMBER:FILE of additional zstd dictionaries (trained with `compress_block_log --train-dictionary`) used in the block log" )
+      ("block-log-compression-dictionary-for-new-blocks", bpo::value<uint32_t>(),
+        "Number of additional dictionary used to compress new blocks instead of the built-in one" )
+      ("signature-recovery-threads", bpo::value<uint32_t>()->default_value(0),
+        "Number of threads helping to recover public keys from signatures of transactions of incoming block that were not seen before. 0 (default) recovers them in the thread applying the block" )
+      ("defer-pending-transactions-above", bpo::value<uint32_t>()->default_value(0),
+        "When there are more pending transactions after new block, those unrelated to the block are reapplied later, in small portions between other writes. 0 (default) reapplies all of them right away" )
+      ("postponed-transactions-apply-time", bpo::value<uint32_t>()->default_value(50),
+        "Maximum time in milliseconds spent on reapplying postponed pending transactions in one portion" )
+      ("performance-trace-size", bpo::value<uint32_t>()->default_value(0),
+        "Number of most recent spans (block processing stages, write lock phases, p2p messages, API calls) kept in memory for performance tracing. 0 disables tracing" )
+      ("performance-trace-file", bpo::value<bfs::path>()->default_value("performance_trace.json"),
+        "File (absolute path or relative to application data dir) the performance trace is written to on SIGUSR2 and at shutdown, in Chrome trace event format" )
       ;
   cli.add_options()
       ("replay-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and replay all blocks" )
-      ("force-open", bpo::bool_switch()->default_value(false), "force open the database, skipping the environment check" )
+      ("force-open", bpo::bool_switch()->default_value(false), "force open the database, skipping the environment check (state made by node with different state version always has to be replayed)" )
       ("resync-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and block log" )
       ("stop-replay-at-block", bpo::value<uint32_t>(), "Stop after reaching given block number")
       ("exit-after-replay", bpo::bool_switch()->default_value(false), "[ DEPRECATED ] Exit after reaching given block number")
       ("exit-before-sync", bpo::bool_switch()->default_value(false), "Exits before starting sync, handy for dumping snapshot without starting replay")
       ("force-replay", bpo::bool_switch()->default_value(false), "Before replaying clean all old files. If specifed, `--replay-blockchain` flag is implied")
       ("validate-during-replay", bpo::bool_switch()->default_value(false), "Runs all validations that are normally turned off during replay")
+      ("replay-checkpoint-interval", bpo::value<uint32_t>()->default_value(0), "Save replay checkpoint every given number of blocks, so replay interrupted by crash can be resumed with `--replay-blockchain` (0 - disabled). Changes since last checkpoint are held in memory, so memory use grows with the interval")
+      ("replay-checkpoint-minutes", bpo::value<uint32_t>()->default_value(0), "Save replay checkpoint every given number of minutes (0 - disabled)")
       ("advanced-benchmark", "Make profiling for every plugin.")
       ("set-benchmark-interval", bpo::value<uint32_t>(), "Print time and memory usage every given number of blocks")
       ("dump-memory-details", bpo::bool_switch()->default_value(false), "Dump database objects memory usage info. Use set-benchmark-interval to set dump interval.")
@@ -827,6 +972,7 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
   }
 
   my->shared_memory_size = fc::parse_size( options.at( "shared-file-size" ).as< string >() );
+  my->shared_memory_max_size = fc::parse_size( options.at( "shared-file-max-size" ).as< string >() );
 
   if( options.count( "shared-file-full-threshold" ) )
     my->shared_file_full_threshold = options.at( "shared-file-full-threshold" ).as< uint16_t >();
@@ -835,10 +981,16 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
     my->shared_file_scale_rate = options.at( "shared-file-scale-rate" ).as< uint16_t >();
 
   my->chainbase_flags |= options.at( "force-open" ).as< bool >() ? chainbase::skip_env_check : chainbase::skip_nothing;
+  if( options.at( "shared-file-huge-pages" ).as< bool >() )
+    my->chainbase_flags |= chainbase::huge_pages;
+  if( options.at( "shared-file-prefault" ).as< bool >() )
+    my->chainbase_flags |= chainbase::prefault;
 
   my->force_replay        = options.count( "force-replay" ) ? options.at( "force-replay" ).as<bool>() : false;
   my->validate_during_replay =
     options.count( "validate-during-replay" ) ? options.at( "validate-during-replay" ).as<bool>() : false;
+  my->replay_checkpoint_interval = options.at( "replay-checkpoint-interval" ).as< uint32_t >();
+  my->replay_checkpoint_minutes = options.at( "replay-checkpoint-minutes" ).as< uint32_t >();
   my->replay              = options.at( "replay-blockchain").as<bool>() || my->force_replay;
   my->resync              = options.at( "resync-blockchain").as<bool>();
   my->stop_replay_at      = options.count( "stop-replay-at-block" ) ? options.at( "stop-replay-at-block" ).as<uint32_t>() : 0;
@@ -850,6 +1002,21 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
   my->dump_memory_details = options.at( "dump-memory-details" ).as<bool>();
   my->enable_block_log_compression = options.at( "enable-block-log-compression" ).as<bool>();
   my->block_log_compression_level = options.at( "block-log-compression-level" ).as<int>();
+  my->block_log_compression_threads = options.at( "block-log-compression-threads" ).as<uint32_t>();
+  if( options.count( "block-log-compression-dictionary" ) )
+  {
+    for( const string& entry : options.at( "block-log-compression-dictionary" ).as<vector<string>>() )
+    {
+      uint8_t number = hive::chain::register_zstd_compression_dictionary_from_file( entry );
+      ilog( "Loaded block log compression dictionary ${n}", ("n", number) );
+    }
+  }
+  if( options.count( "block-log-compression-dictionary-for-new-blocks" ) )
+  {
+    uint32_t number = options.at( "block-log-compression-dictionary-for-new-blocks" ).as<uint32_t>();
+    FC_ASSERT( number <= std::numeric_limits<uint8_t>::max(), "Dictionary number ${n} out of range", ("n", number) );
+    hive::chain::set_zstd_compression_dictionary_for_new_blocks( number );
+  }
   if( options.count( "flush-state-interval" ) )
     my->flush_interval = options.at( "flush-state-interval" ).as<uint32_t>();
   else
@@ -872,6 +1039,16 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
     }
   }
 
+  fc::ecc::public_key::set_recovery_threads( options.at( "signature-recovery-threads" ).as<uint32_t>() );
+
+  my->pending_tx_deferral_threshold = options.at( "defer-pending-transactions-above" ).as<uint32_t>();
+  my->postponed_tx_apply_time = options.at( "postponed-transactions-apply-time" ).as<uint32_t>();
+
+  my->performance_trace_size = options.at( "performance-trace-size" ).as<uint32_t>();
+  my->performance_trace_file = options.at( "performance-trace-file" ).as<bfs::path>();
+  if( my->performance_trace_file.is_relative() )
+    my->performance_trace_file = app().data_dir() / my->performance_trace_file;
+
   this->my->setup_benchmark_dumper();
   my->benchmark_is_enabled = (options.count( "advanced-benchmark" ) != 0);
 
@@ -936,6 +1113,7 @@ void chain_plugin::plugin_startup()
 {
   ilog("Chain plugin initialization...");
 
+  my->start_performance_trace();
   my->initial_settings();
 
   ilog("Database opening...");
@@ -959,10 +1137,10 @@ void chain_plugin::plugin_startup()
     ilog("Consistency data checking...");
     if( my->check_data_consistency() )
     {
-      if( my->db.get_snapshot_loaded() )
+      if( my->db.get_snapshot_loaded() || my->replay_missing_blocks )
       {
         ilog("Replaying...");
-        //Replaying is forced, because after snapshot loading, node should work in synchronization mode.
+        //Replaying is forced, because after snapshot loading (or when state is behind block log written in background), node should work in synchronization mode.
         if( !my->start_replay_processing() )
         {
           ilog("P2P enabling after replaying...");
@@ -984,6 +1162,12 @@ void chain_plugin::plugin_shutdown()
 {
   ilog("closing chain database");
   my->stop_write_processing();
+  if( my->performance_trace_signal )
+  {
+    boost::system::error_code ec;
+    my->performance_trace_signal->cancel( ec );
+    my->dump_performance_trace();
+  }
   my->db.close();
   ilog("database closed successfully");
   hive::notify_hived_status("finished syncing");
@@ -174,7 +174,7 @@ void reblog_evaluator::do_apply( const reblog_operation& o )
 
     performance_data pd;
 
-    if( _db.head_block_time() >= _plugin->start_feeds )
+    if( !_plugin->pull_feeds && _db.head_block_time() >= _plugin->start_feeds )
     {
       while( itr != idx.end() && itr->following == o.account )
       {
@@ -18,7 +18,10 @@
 #include <fc/smart_ref_impl.hpp>
 #include <fc/thread/thread.hpp>
 
+#include <list>
 #include <memory>
+#include <mutex>
+#include <queue>
 
 namespace hive { namespace plugins { namespace follow {
 
@@ -37,12 +40,115 @@ class follow_plugin_impl
     void pre_operation( const operation_notification& op_obj );
     void post_operation( const operation_notification& op_obj );
 
+    std::vector< feed_entry > read_feed( const account_name_type& account, uint32_t limit ) const;
+    std::vector< feed_entry > merge_feed( const account_name_type& account, uint32_t limit ) const;
+
     chain::database&              _db;
     follow_plugin&                _self;
     boost::signals2::connection   _pre_apply_operation_conn;
     boost::signals2::connection   _post_apply_operation_conn;
+
+    struct cached_feed
+    {
+      account_name_type         account;
+      block_id_type             head_block_id; // feed is only valid for state it was computed on
+      uint32_t                  limit = 0;
+      std::vector< feed_entry > entries;
+    };
+    typedef std::list< cached_feed > feed_cache_list;
+
+    /// LRU cache of feeds computed in pull mode (most recently used at front)
+    mutable std::mutex                                                     _feed_cache_mutex;
+    mutable feed_cache_list                                                _feed_cache;
+    mutable std::map< account_name_type, feed_cache_list::iterator >       _feed_cache_lookup;
+    size_t                                                                 _feed_cache_size = 10000;
 };
 
+std::vector< feed_entry > follow_plugin_impl::read_feed( const account_name_type& account, uint32_t limit ) const
+{
+  std::vector< feed_entry > result;
+
+  const auto& feed_idx = _db.get_index< feed_index >().indices().get< by_feed >();
+  for( auto itr = feed_idx.lower_bound( account ); itr != feed_idx.end() && itr->account == account && result.size() < limit; ++itr )
+  {
+    feed_entry entry;
+    entry.comment = itr->comment;
+    entry.reblogged_by.assign( itr->reblogged_by.begin(), itr->reblogged_by.end() );
+    entry.first_reblogged_by = itr->first_reblogged_by;
+    entry.first_reblogged_on = itr->first_reblogged_on;
+    result.emplace_back( std::move( entry ) );
+  }
+
+  return result;
+}
+
+std::vector< feed_entry > follow_plugin_impl::merge_feed( const account_name_type& account, uint32_t limit ) const
+{
+  typedef blog_index::index< by_blog >::type::const_iterator blog_iterator;
+  const auto& blog_idx = _db.get_index< blog_index >().indices().get< by_blog >();
+
+  // blog_object ids grow with creation, so merging blogs of followed accounts by descending id
+  // visits posts and reblogs newest first; entry takes position of the newest of them
+  auto older = [&]( const blog_iterator& a, const blog_iterator& b ) { return a->get_id() < b->get_id(); };
+  std::priority_queue< blog_iterator, std::vector< blog_iterator >, decltype( older ) > heads( older );
+
+  const auto& follow_idx = _db.get_index< follow_index >().indices().get< by_follower_following >();
+  for( auto itr = follow_idx.lower_bound( account ); itr != follow_idx.end() && itr->follower == account; ++itr )
+  {
+    if( ( itr->what & ( 1 << blog ) ) == 0 )
+      continue;
+    auto blog_itr = blog_idx.lower_bound( itr->following );
+    if( blog_itr != blog_idx.end() && blog_itr->account == itr->following )
+      heads.push( blog_itr );
+  }
+
+  std::vector< feed_entry > result;
+  std::map< comment_id_type, size_t > positions;
+
+  while( !heads.empty() )
+  {
+    blog_iterator current = heads.top();
+    heads.pop();
+
+    auto position = positions.find( current->comment );
+    if( position == positions.end() )
+    {
+      // feed is full and first entry that did not fit was reached - older ones won't fit either
+      // (older reblogs of entries already in the feed are not listed then)
+      if( result.size() >= limit )
+        break;
+      position = positions.emplace( current->comment, result.size() ).first;
+      result.emplace_back();
+      result.back().comment = current->comment;
+    }
+
+    // blog entries of a comment come oldest last, so first_reblogged_* ends up describing the oldest one,
+    // like in feed_object, which is empty there when feed entry was created by the post itself
+    feed_entry& entry = result[ position->second ];
+    if( current->reblogged_on != fc::time_point_sec() )
+    {
+      entry.reblogged_by.push_back( current->account );
+      entry.first_reblogged_by = current->account;
+      entry.first_reblogged_on = current->reblogged_on;
+    }
+    else
+    {
+      entry.first_reblogged_by = account_name_type();
+      entry.first_reblogged_on = fc::time_point_sec();
+    }
+
+    auto next = std::next( current );
+    if( next != blog_idx.end() && next->account == current->account )
+      heads.push( next );
+  }
+
+  // entries were collected newest first, feed_object keeps rebloggers in order of reblogs
+  for( auto& entry : result )
+    std::reverse( entry.reblogged_by.begin(), entry.reblogged_by.end() );
+
+  return result;
+}
+
 struct pre_operation_visitor
 {
   follow_plugin_impl& _plugin;
@@ -163,17 +269,15 @@ struct post_operation_visitor
 
         try
         {
-          fop = fc::json::from_string( op.json ).as< follow_operation >();
+          fop = hive::chain::custom_json_as< follow_operation >( op.json );
         }
         catch( const fc::exception& )
         {
           return;
         }
 
-        auto new_fop = follow_plugin_operation( fop );
-        new_cop.json = fc::json::to_string( new_fop );
-        std::shared_ptr< custom_operation_interpreter > eval = _plugin._db.get_custom_json_evaluator( op.id );
-        eval->apply( new_cop );
+        // apply directly, without serializing operation to JSON and parsing it back
+        _plugin._self._custom_operation_interpreter->apply_operations( { follow_plugin_operation( fop ) }, operation( new_cop ) );
       }
     }
     FC_CAPTURE_AND_RETHROW()
@@ -199,7 +303,7 @@ struct post_operation_visitor
 
       performance_data pd;
 
-      if( db.head_block_time() >= _plugin._self.start_feeds )
+      if( !_plugin._self.pull_feeds && db.head_block_time() >= _plugin._self.start_feeds )
       {
         while( itr != idx.end() && itr->following == op.author )
         {
@@ -326,6 +430,54 @@ follow_plugin::follow_plugin() {}
 
 follow_plugin::~follow_plugin() {}
 
+std::vector< feed_entry > follow_plugin::get_feed( const account_name_type& account, uint32_t limit ) const
+{
+  limit = std::min( limit, max_feed_size );
+
+  if( !pull_feeds )
+    return my->read_feed( account, limit );
+
+  const block_id_type head_block_id = my->_db.head_block_id();
+  {
+    std::lock_guard< std::mutex > guard( my->_feed_cache_mutex );
+    auto found = my->_feed_cache_lookup.find( account );
+    if( found != my->_feed_cache_lookup.end() )
+    {
+      auto cached = found->second;
+      // shorter feed than requested is also complete when there was nothing more to merge
+      if( cached->head_block_id == head_block_id &&
+        ( cached->limit >= limit || cached->entries.size() < cached->limit ) )
+      {
+        my->_feed_cache.splice( my->_feed_cache.begin(), my->_feed_cache, cached );
+        return std::vector< feed_entry >( cached->entries.begin(),
+          cached->entries.begin() + std::min< size_t >( limit, cached->entries.size() ) );
+      }
+    }
+  }
+
+  auto result = my->merge_feed( account, limit );
+
+  if( my->_feed_cache_size > 0 )
+  {
+    std::lock_guard< std::mutex > guard( my->_feed_cache_mutex );
+    auto found = my->_feed_cache_lookup.find( account );
+    if( found != my->_feed_cache_lookup.end() )
+    {
+      my->_feed_cache.erase( found->second );
+      my->_feed_cache_lookup.erase( found );
+    }
+    my->_feed_cache.push_front( { account, head_block_id, limit, result } );
+    my->_feed_cache_lookup[ account ] = my->_feed_cache.begin();
+    while( my->_feed_cache.size() > my->_feed_cache_size )
+    {
+      my->_feed_cache_lookup.erase( my->_feed_cache.back().account );
+      my->_feed_cache.pop_back();
+    }
+  }
+
+  return result;
+}
+
 void follow_plugin::set_program_options(
   boost::program_options::options_description& cli,
   boost::program_options::options_description& cfg
@@ -334,6 +486,8 @@ void follow_plugin::set_program_options(
   cfg.add_options()
     ("follow-max-feed-size", boost::program_options::value< uint32_t >()->default_value( 500 ), "Set the maximum size of cached feed for an account" )
     ("follow-start-feeds", boost::program_options::value< uint32_t >()->default_value( 0 ), "Block time (in epoch seconds) when to start calculating feeds" )
+    ("follow-feed-mode", boost::program_options::value< std::string >()->default_value( "push" ), "How feeds are maintained: 'push' (feed of every follower is updated when post is made) or 'pull' (only blogs are stored, follow_api.get_feed merges blogs of followed accounts on read)" )
+    ("follow-feed-cache-size", boost::program_options::value< uint32_t >()->default_value( 10000 ), "Number of feeds computed in pull mode kept in memory" )
     ;
 }
 
@@ -379,6 +533,19 @@ void follow_plugin::plugin_initialize( const boost::program_options::variables_m
       state_opts[ "follow-start-feeds" ] = start_feeds;
     }
 
+    if( options.count( "follow-feed-mode" ) )
+    {
+      const std::string feed_mode = options[ "follow-feed-mode" ].as< std::string >();
+      FC_ASSERT( feed_mode == "push" || feed_mode == "pull", "Unknown follow-feed-mode ${m}", ( "m", feed_mode ) );
+      pull_feeds = feed_mode == "pull";
+      // only pull mode is reported, so existing states made in push mode remain compatible
+      if( pull_feeds )
+        state_opts[ "follow-feed-mode" ] = feed_mode;
+    }
+
+    if( options.count( "follow-feed-cache-size" ) )
+      my->_feed_cache_size = options[ "follow-feed-cache-size" ].as< uint32_t >();
+
     appbase::app().get_plugin< chain::chain_plugin >().report_state_options( name(), state_opts );
   }
   FC_CAPTURE_AND_RETHROW()
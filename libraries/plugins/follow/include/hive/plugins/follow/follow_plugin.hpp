@@ -16,6 +16,19 @@ namespace detail { class follow_plugin_impl; }
 
 using namespace appbase;
 using hive::chain::generic_custom_operation_interpreter;
+using hive::protocol::account_name_type;
+
+/**
+  * Single position of account feed. In pull mode it is built from blog_objects, so unlike feed_object
+  * it also covers posts that were made before the account started following their author.
+  */
+struct feed_entry
+{
+  hive::chain::comment_id_type     comment;
+  std::vector< account_name_type > reblogged_by;
+  account_name_type                first_reblogged_by;
+  fc::time_point_sec               first_reblogged_on;
+};
 
 class follow_plugin : public appbase::plugin< follow_plugin >
 {
@@ -34,8 +47,17 @@ class follow_plugin : public appbase::plugin< follow_plugin >
     virtual void plugin_startup() override;
     virtual void plugin_shutdown() override;
 
+    /**
+      * Returns up to limit (but not more than max_feed_size) newest feed entries of given account.
+      * In push mode they are read from feed_index, in pull mode they are computed from blogs of
+      * followed accounts (and cached until head block changes). Caller must hold read lock.
+      */
+    std::vector< feed_entry > get_feed( const account_name_type& account, uint32_t limit ) const;
+
     uint32_t max_feed_size = 500;
     fc::time_point_sec start_feeds;
+    /// when set, feed_objects are not created - feeds are computed on read from blog_objects
+    bool pull_feeds = false;
 
     std::shared_ptr< generic_custom_operation_interpreter< follow_plugin_operation > > _custom_operation_interpreter;
 
@@ -44,3 +66,5 @@ class follow_plugin : public appbase::plugin< follow_plugin >
 };
 
 } } } //hive::follow
+
+FC_REFLECT( hive::plugins::follow::feed_entry, (comment)(reblogged_by)(first_reblogged_by)(first_reblogged_on) )
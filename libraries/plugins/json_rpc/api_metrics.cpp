@@ -0,0 +1,124 @@
+#include <hive/plugins/json_rpc/api_metrics.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace hive { namespace plugins { namespace json_rpc {
+
+uint64_t log2_histogram::snapshot::percentile( double fraction ) const
+{
+  if( count == 0 )
+    return 0;
+  const uint64_t rank = std::max< uint64_t >( 1, uint64_t( fraction * count + 0.5 ) );
+  uint64_t seen = 0;
+  for( uint32_t i = 0; i < BUCKET_COUNT; ++i )
+  {
+    seen += buckets[i];
+    if( seen >= rank )
+      return bucket_limit( i );
+  }
+  return bucket_limit( BUCKET_COUNT - 1 );
+}
+
+log2_histogram::snapshot log2_histogram::get_snapshot() const
+{
+  snapshot s;
+  for( uint32_t i = 0; i < BUCKET_COUNT; ++i )
+  {
+    s.buckets[i] = _buckets[i].load( std::memory_order_relaxed );
+    s.count += s.buckets[i]; // count derived from buckets, so they always agree
+  }
+  s.sum = _sum.load( std::memory_order_relaxed );
+  return s;
+}
+
+void api_metrics_registry::register_method( const std::string& method_name )
+{
+  auto& entry = _methods[ method_name ];
+  if( !entry )
+    entry.reset( new api_method_metrics() );
+}
+
+namespace {
+
+void append_histogram( std::string& out, const char* metric, const char* help, const std::string& method,
+  const log2_histogram::snapshot& s, double scale, bool print_header )
+{
+  char line[ 512 ];
+  if( print_header )
+  {
+    std::snprintf( line, sizeof( line ), "# HELP %s %s\n# TYPE %s histogram\n", metric, help, metric );
+    out += line;
+  }
+
+  uint32_t last = 0;
+  for( uint32_t i = 0; i < log2_histogram::BUCKET_COUNT; ++i )
+  {
+    if( s.buckets[i] )
+      last = i;
+  }
+
+  uint64_t cumulative = 0;
+  for( uint32_t i = 0; i <= last; ++i )
+  {
+    cumulative += s.buckets[i];
+    std::snprintf( line, sizeof( line ), "%s_bucket{method=\"%s\",le=\"%.9g\"} %llu\n", metric, method.c_str(),
+      log2_histogram::snapshot::bucket_limit( i ) * scale, static_cast< unsigned long long >( cumulative ) );
+    out += line;
+  }
+  std::snprintf( line, sizeof( line ), "%s_bucket{method=\"%s\",le=\"+Inf\"} %llu\n%s_sum{method=\"%s\"} %.9g\n%s_count{method=\"%s\"} %llu\n",
+    metric, method.c_str(), static_cast< unsigned long long >( s.count ),
+    metric, method.c_str(), s.sum * scale,
+    metric, method.c_str(), static_cast< unsigned long long >( s.count ) );
+  out += line;
+}
+
+} // anonymous
+
+std::string api_metrics_registry::to_prometheus() const
+{
+  struct family
+  {
+    const char* metric;
+    const char* help;
+    log2_histogram api_method_metrics::* histogram;
+    double scale;
+  };
+  static const family families[] = {
+    { "hived_api_queue_delay_seconds", "Time from arrival of API request to start of its execution.", &api_method_metrics::queue_delay, 1e-6 },
+    { "hived_api_lock_wait_seconds", "Time API call waited for chainbase read lock.", &api_method_metrics::lock_wait, 1e-6 },
+    { "hived_api_execution_seconds", "Execution time of API call without lock wait.", &api_method_metrics::execution, 1e-6 },
+    { "hived_api_serialization_seconds", "Time of converting API call result to JSON.", &api_method_metrics::serialization, 1e-6 },
+    { "hived_api_response_bytes", "Size of JSON response of API call.", &api_method_metrics::response_size, 1.0 }
+  };
+
+  std::string out;
+  char line[ 512 ];
+
+  out += "# HELP hived_api_errors_total API calls answered with error.\n# TYPE hived_api_errors_total counter\n";
+  for( const auto& item : _methods )
+  {
+    if( item.second->execution.get_snapshot().count == 0 )
+      continue;
+    std::snprintf( line, sizeof( line ), "hived_api_errors_total{method=\"%s\"} %llu\n", item.first.c_str(),
+      static_cast< unsigned long long >( item.second->errors.load( std::memory_order_relaxed ) ) );
+    out += line;
+  }
+
+  for( const auto& f : families )
+  {
+    bool first = true;
+    for( const auto& item : _methods )
+    {
+      const auto s = ( item.second.get()->*f.histogram ).get_snapshot();
+      if( s.count == 0 )
+        continue;
+      append_histogram( out, f.metric, f.help, item.first, s, f.scale, first );
+      first = false;
+    }
+  }
+
+  return out;
+}
+
+} } } // hive::plugins::json_rpc
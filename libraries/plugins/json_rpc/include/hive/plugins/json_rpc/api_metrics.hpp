@@ -0,0 +1,103 @@
+#pragma once
+
+#include <fc/time.hpp>
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace hive { namespace plugins { namespace json_rpc {
+
+/**
+  * Histogram of non-negative integer values with power of 2 buckets: bucket 0 counts zeros, bucket i
+  * counts values in [2^(i-1), 2^i). Recording is lock free (two relaxed atomic increments), reading
+  * gives consistent enough snapshot for monitoring purposes.
+  */
+class log2_histogram
+{
+  public:
+    static const uint32_t BUCKET_COUNT = 48;
+
+    struct snapshot
+    {
+      uint64_t                                count = 0;
+      uint64_t                                sum = 0;
+      std::array< uint64_t, BUCKET_COUNT >    buckets{};
+
+      /// Upper bound (inclusive) of values in given bucket
+      static uint64_t bucket_limit( uint32_t bucket ) { return bucket == 0 ? 0 : ( uint64_t( 1 ) << bucket ) - 1; }
+
+      /// Estimated value below which given fraction of recorded values lies (upper limit of its bucket)
+      uint64_t percentile( double fraction ) const;
+    };
+
+    void record( uint64_t value ) noexcept
+    {
+      uint32_t bucket = value == 0 ? 0 : 64 - __builtin_clzll( value );
+      if( bucket >= BUCKET_COUNT )
+        bucket = BUCKET_COUNT - 1;
+      _buckets[ bucket ].fetch_add( 1, std::memory_order_relaxed );
+      _sum.fetch_add( value, std::memory_order_relaxed );
+    }
+
+    void record( const fc::microseconds& value ) noexcept
+    {
+      record( value.count() > 0 ? uint64_t( value.count() ) : 0 );
+    }
+
+    snapshot get_snapshot() const;
+
+  private:
+    std::atomic< uint64_t > _buckets[ BUCKET_COUNT ] = {};
+    std::atomic< uint64_t > _sum{ 0 };
+};
+
+/// Measurements of one API method (times in microseconds)
+struct api_method_metrics
+{
+  std::atomic< uint64_t > errors{ 0 };    ///< calls answered with error
+  log2_histogram          queue_delay;    ///< from arrival of request to start of execution
+  log2_histogram          lock_wait;      ///< waiting for chainbase read lock
+  log2_histogram          execution;      ///< execution without lock wait (includes serialization of pre-serialized methods)
+  log2_histogram          serialization;  ///< conversion of result to JSON text
+  log2_histogram          response_size;  ///< bytes of JSON response
+};
+
+/**
+  * Per-method metrics of API calls. All entries are created during startup, before any request is
+  * processed, so lookups need no synchronization.
+  */
+class api_metrics_registry
+{
+  public:
+    api_metrics_registry() : _collecting_since( fc::time_point::now() ) {}
+
+    void register_method( const std::string& method_name );
+
+    /// Metrics of given api.method, nullptr when method is unknown
+    api_method_metrics* find( const std::string& method_name ) const
+    {
+      auto itr = _methods.find( method_name );
+      return itr == _methods.end() ? nullptr : itr->second.get();
+    }
+
+    template< typename Lambda >
+    void for_each_method( Lambda&& callback ) const
+    {
+      for( const auto& item : _methods )
+        callback( item.first, *item.second );
+    }
+
+    const fc::time_point& collecting_since() const { return _collecting_since; }
+
+    /// Metrics of all methods that were called at least once in Prometheus text exposition format
+    std::string to_prometheus() const;
+
+  private:
+    std::map< std::string, std::unique_ptr< api_method_metrics > > _methods;
+    fc::time_point                                                 _collecting_since;
+};
+
+} } } // hive::plugins::json_rpc
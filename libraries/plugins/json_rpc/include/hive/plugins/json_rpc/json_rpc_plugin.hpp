@@ -3,6 +3,7 @@
 #include <appbase/application.hpp>
 
 #include <hive/plugins/chain/chain_plugin.hpp>
+#include <hive/plugins/json_rpc/api_metrics.hpp>
 
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
@@ -54,6 +55,8 @@
 #define JSON_RPC_NO_PARAMS          (-32001)
 #define JSON_RPC_PARSE_PARAMS_ERROR (-32002)
 #define JSON_RPC_ERROR_DURING_CALL  (-32003)
+#define JSON_RPC_DEADLINE_EXCEEDED  (-32004)
+#define JSON_RPC_TOO_MANY_REQUESTS  (-32005)
 
 namespace hive { namespace plugins { namespace json_rpc {
 
@@ -67,6 +70,15 @@ using namespace appbase;
   */
 typedef std::function< fc::variant(const fc::variant&) > api_method;
 
+/**
+  * @brief Optional alternative implementation of registered api method that
+  * returns its result already serialized to JSON.
+  *
+  * Meant for methods with big results (like block ranges) that can be
+  * serialized piece by piece, without building whole result and its variant.
+  */
+typedef std::function< std::string(const fc::variant&) > serialized_api_method;
+
 /**
   * @brief An API, containing APIs and Methods
   *
@@ -105,8 +117,13 @@ class json_rpc_plugin : public appbase::plugin< json_rpc_plugin >
     virtual void plugin_finalize_startup() override;
 
     void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig );
+    /// Used instead of the method registered with add_api_method (which still defines its signature)
+    void add_serialized_api_method( const string& api_name, const string& method_name, const serialized_api_method& api );
     string call( const string& body );
 
+    /// Latency and size metrics of all registered API methods
+    const api_metrics_registry& get_api_metrics() const;
+
   private:
     std::unique_ptr< detail::json_rpc_plugin_impl > my;
 };
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <type_traits>
 
 #include <fc/reflect/reflect.hpp>
+#include <fc/exception/exception.hpp>
 #include <fc/macros.hpp>
+#include <fc/time.hpp>
 
 #include <boost/preprocessor/seq/for_each.hpp>
 #include <boost/preprocessor/cat.hpp>
@@ -47,7 +50,12 @@ BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _a
 {                                                                                                        \
   if( lock )                                                                                            \
   {                                                                                                     \
-    return my->_db.with_read_lock( [&args, this](){ return my->method( args ); }, fc::seconds(1));      \
+    const fc::time_point lock_requested = fc::time_point::now();                                        \
+    return my->_db.with_read_lock( [&args, &lock_requested, this]()                                     \
+      {                                                                                                  \
+        hive::plugins::json_rpc::record_read_lock_wait( lock_requested );                               \
+        return my->method( args );                                                                       \
+      }, hive::plugins::json_rpc::read_lock_wait_time() );                                               \
   }                                                                                                     \
   else                                                                                                  \
   {                                                                                                     \
@@ -105,3 +113,70 @@ struct void_type {};
 } } } // hive::plugins::json_rpc
 
 FC_REFLECT( hive::plugins::json_rpc::void_type, )
+
+namespace hive { namespace plugins { namespace json_rpc {
+
+/// API request processed by current thread
+struct request_context
+{
+  fc::time_point   arrival;                                  ///< when request was received (unset when unknown)
+  fc::time_point   deadline = fc::time_point::maximum();     ///< when request is abandoned
+  fc::microseconds lock_wait;                                ///< time spent waiting for chainbase read lock
+};
+
+inline request_context& current_request()
+{
+  static thread_local request_context context;
+  return context;
+}
+
+/// Sets arrival time and deadline of API requests processed by current thread for the lifetime of the object
+class request_scope
+{
+  public:
+    request_scope( const fc::time_point& arrival, const fc::time_point& deadline ) : _previous( current_request() )
+    {
+      current_request() = request_context{ arrival, deadline, fc::microseconds() };
+    }
+
+    ~request_scope()
+    {
+      current_request() = _previous;
+    }
+
+    request_scope( const request_scope& ) = delete;
+    request_scope& operator=( const request_scope& ) = delete;
+
+  private:
+    request_context _previous;
+};
+
+/// Throws fc::timeout_exception when deadline of current request has already passed
+inline void check_request_deadline()
+{
+  const fc::time_point& deadline = current_request().deadline;
+  if( deadline != fc::time_point::maximum() && fc::time_point::now() >= deadline )
+    FC_THROW_EXCEPTION( fc::timeout_exception, "API request deadline exceeded" );
+}
+
+/// Time API call waits for chainbase read lock - one second, but never past deadline of current request
+inline fc::microseconds read_lock_wait_time()
+{
+  const fc::microseconds default_wait = fc::seconds( 1 );
+  const fc::time_point deadline = current_request().deadline;
+  if( deadline == fc::time_point::maximum() )
+    return default_wait;
+
+  check_request_deadline();
+  const fc::microseconds remaining = deadline - fc::time_point::now();
+  // zero would mean waiting without limit
+  return std::max( std::min( default_wait, remaining ), fc::microseconds( 1 ) );
+}
+
+/// Adds time elapsed since lock_requested to lock wait of current request
+inline void record_read_lock_wait( const fc::time_point& lock_requested )
+{
+  current_request().lock_wait += fc::time_point::now() - lock_requested;
+}
+
+} } } // hive::plugins::json_rpc
@@ -3,6 +3,8 @@
 
 #include <hive/plugins/statsd/utility.hpp>
 
+#include <hive/utilities/performance_trace.hpp>
+
 #include <hive/protocol/misc_utilities.hpp>
 
 #include <boost/algorithm/string.hpp>
@@ -11,9 +13,15 @@
 #include <fc/exception/exception.hpp>
 #include <fc/macros.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/io/json_tape.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <hive/chain/fork_database.hpp>
+#include <hive/chain/util/signal.hpp>
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 #define ENABLE_JSON_RPC_LOG
 
@@ -42,6 +50,140 @@ namespace detail
     fc::optional< fc::variant >      result;
     fc::optional< json_rpc_error >   error;
     fc::variant                      id;
+
+    // already serialized result (used instead of result when set, not reflected)
+    std::shared_ptr< const std::string > serialized_result;
+    // metrics of called method (not reflected)
+    api_method_metrics*              metrics = nullptr;
+  };
+
+  std::string to_json( const json_rpc_response& response )
+  {
+    if( !response.serialized_result )
+      return fc::json::to_string( response );
+
+    // same layout as reflected response with result and without error
+    std::string json = "{\"jsonrpc\":";
+    json += fc::json::to_string( response.jsonrpc );
+    json += ",\"result\":";
+    json += *response.serialized_result;
+    json += ",\"id\":";
+    json += fc::json::to_string( response.id );
+    json += '}';
+    return json;
+  }
+
+  /// to_json that also records serialization time and response size in metrics of called method
+  std::string to_json_measured( const json_rpc_response& response )
+  {
+    if( response.metrics == nullptr )
+      return to_json( response );
+
+    const fc::time_point start = fc::time_point::now();
+    std::string json = to_json( response );
+    response.metrics->serialization.record( fc::time_point::now() - start );
+    response.metrics->response_size.record( json.size() );
+    return json;
+  }
+
+  /**
+    * Parses request with fast_parser. Input that is not strict JSON or that legacy_parser would read
+    * differently (\u, \b, \f escapes, exponents) is parsed again with legacy_parser, so requests
+    * keep their current meaning and malformed ones get the same errors as before.
+    */
+  fc::variant parse_request( const std::string& message )
+  {
+    try
+    {
+      fc::json_tape tape( message );
+      fc::variant v = tape.to_variant();
+      if( tape.matches_legacy_parser() )
+        return v;
+    }
+    catch( const fc::exception& ) {}
+    return fc::json::from_string( message );
+  }
+
+  /**
+    * Keeps serialized results of selected methods, whose answers depend only on arguments and state
+    * of the chain that changes once per block (global properties, feeds, witness schedule, config etc.).
+    * Repeated calls within the same block are answered without taking chainbase lock, converting
+    * the result to variant and serializing it again. All results are dropped after each applied block.
+    */
+  class api_response_cache
+  {
+    public:
+      typedef std::shared_ptr< const std::string > serialized_result;
+
+      void set_methods( const std::vector< std::string >& methods )
+      {
+        _methods.clear();
+        _methods.insert( methods.begin(), methods.end() );
+      }
+
+      bool is_cached_method( const std::string& method_name ) const { return _methods.count( method_name ) != 0; }
+
+      static std::string make_key( const std::string& method_name, const fc::variant& args )
+      {
+        return method_name + '\n' + fc::json::to_string( canonical( args ) );
+      }
+
+      /// Returns cached result (or null) and the generation the caller has to pass to store()
+      serialized_result find( const std::string& key, uint64_t* generation ) const
+      {
+        std::lock_guard< std::mutex > guard( _mutex );
+        *generation = _generation;
+        auto itr = _results.find( key );
+        return itr == _results.end() ? serialized_result() : itr->second;
+      }
+
+      /// Stores result, unless new block was applied since it was looked up (result might be stale)
+      void store( const std::string& key, const serialized_result& result, uint64_t generation )
+      {
+        std::lock_guard< std::mutex > guard( _mutex );
+        if( generation == _generation && _results.size() < MAX_CACHED_RESULTS )
+          _results.emplace( key, result );
+      }
+
+      void clear()
+      {
+        std::lock_guard< std::mutex > guard( _mutex );
+        ++_generation;
+        _results.clear();
+      }
+
+    private:
+      // limits memory used for methods with arguments (like get_reward_fund)
+      static const size_t MAX_CACHED_RESULTS = 1000;
+
+      // same arguments passed with differently ordered object members have to produce the same key
+      static fc::variant canonical( const fc::variant& v )
+      {
+        if( v.is_object() )
+        {
+          std::map< std::string, fc::variant > sorted;
+          for( const auto& entry : v.get_object() )
+            sorted[ entry.key() ] = canonical( entry.value() );
+          fc::mutable_variant_object result;
+          for( auto& entry : sorted )
+            result( entry.first, std::move( entry.second ) );
+          return fc::variant( std::move( result ) );
+        }
+        if( v.is_array() )
+        {
+          fc::variants result;
+          for( const auto& item : v.get_array() )
+            result.push_back( canonical( item ) );
+          return fc::variant( std::move( result ) );
+        }
+        return v;
+      }
+
+      std::set< std::string >                                  _methods;
+
+      mutable std::mutex                                       _mutex;
+      uint64_t                                                 _generation = 0;
+      std::unordered_map< std::string, serialized_result >     _results;
   };
 
   typedef void_type             get_methods_args;
@@ -149,6 +291,7 @@ namespace detail
       map< string, api_description >                     _registered_apis;
       vector< string >                                   _methods;
       map< string, map< string, api_method_signature > > _method_sigs;
+      map< string, serialized_api_method >               _serialized_methods; // by api.method
     } data, proxy_data;
 
     public:
@@ -156,10 +299,12 @@ namespace detail
       ~json_rpc_plugin_impl();
 
       void add_api_method( const string& api_name, const string& method_name, const api_method& api, const api_method_signature& sig );
+      void add_serialized_api_method( const string& api_name, const string& method_name, const serialized_api_method& api );
       void plugin_finalize_startup();
       void plugin_pre_shutdown();
 
       api_method* find_api_method( const std::string& api, const std::string& method );
+      const serialized_api_method* find_serialized_api_method( const std::string& method_name ) const;
       api_method* process_params( string method, const fc::variant_object& request, fc::variant& func_args, string* method_name );
       void rpc_id( const fc::variant_object& request, json_rpc_response& response );
       void rpc_jsonrpc( const fc::variant_object& request, json_rpc_response& response );
@@ -179,6 +324,10 @@ namespace detail
 
       std::unique_ptr< json_rpc_logger >                 _logger;
 
+      api_response_cache                                 _response_cache;
+      api_metrics_registry                               _metrics;
+      boost::signals2::connection                        _post_apply_block_conn;
+
       chain::database& _db;
   };
 
@@ -195,6 +344,11 @@ namespace detail
     proxy_data._methods.push_back( canonical_name.str() );
   }
 
+  void json_rpc_plugin_impl::add_serialized_api_method( const string& api_name, const string& method_name, const serialized_api_method& api )
+  {
+    proxy_data._serialized_methods[ api_name + '.' + method_name ] = api;
+  }
+
   void json_rpc_plugin_impl::plugin_finalize_startup()
   {
     std::sort( proxy_data._methods.begin(), proxy_data._methods.end() );
@@ -202,6 +356,11 @@ namespace detail
     data._registered_apis = std::move( proxy_data._registered_apis );
     data._methods         = std::move( proxy_data._methods );
     data._method_sigs     = std::move( proxy_data._method_sigs );
+    data._serialized_methods = std::move( proxy_data._serialized_methods );
+
+    // all entries are created before first request is processed, lookups are not synchronized
+    for( const auto& method_name : data._methods )
+      _metrics.register_method( method_name );
   }
 
   void json_rpc_plugin_impl::plugin_pre_shutdown()
@@ -209,6 +368,7 @@ namespace detail
     data._registered_apis.clear();
     data._methods.clear();
     data._method_sigs.clear();
+    data._serialized_methods.clear();
   }
 
   void json_rpc_plugin_impl::initialize()
@@ -250,6 +410,12 @@ namespace detail
     return &(method_itr->second);
   }
 
+  const serialized_api_method* json_rpc_plugin_impl::find_serialized_api_method( const std::string& method_name ) const
+  {
+    auto itr = data._serialized_methods.find( method_name );
+    return itr == data._serialized_methods.end() ? nullptr : &( itr->second );
+  }
+
   api_method* json_rpc_plugin_impl::process_params( string method, const fc::variant_object& request, fc::variant& func_args, string* method_name )
   {
     STATSD_START_TIMER( "jsonrpc", "overhead", "process_params", 1.0f );
@@ -340,40 +506,86 @@ namespace detail
               response.error = json_rpc_error( JSON_RPC_PARSE_PARAMS_ERROR, e.to_string(), fc::variant( *(e.dynamic_copy_exception()) ) );
             }
 
+            api_method_metrics* metrics = call ? _metrics.find( method_name ) : nullptr;
+            response.metrics = metrics;
+            request_context& context = current_request();
+            const fc::time_point start = fc::time_point::now();
+            context.lock_wait = fc::microseconds();
+            if( metrics != nullptr && context.arrival != fc::time_point() )
+              metrics->queue_delay.record( start - context.arrival );
+
             try
             {
               if( call )
               {
                 STATSD_START_TIMER( "jsonrpc", "api", method_name, 1.0f );
+                HIVE_TRACE_SCOPE( "api", method_name );
 
-                if( _db.has_hardfork( HIVE_HARDFORK_1_26 ) )
+                // request that waited in queue past its deadline is not executed at all
+                check_request_deadline();
+
+                std::string cache_key;
+                uint64_t cache_generation = 0;
+                if( _response_cache.is_cached_method( method_name ) && !_logger )
                 {
-                  try
+                  cache_key = api_response_cache::make_key( method_name, func_args );
+                  response.serialized_result = _response_cache.find( cache_key, &cache_generation );
+                  if( response.serialized_result )
                   {
-                    response.result = (*call)( func_args );
+                    STATSD_INCREMENT( "jsonrpc", "cache", "hit", 1.0f );
                   }
-                  catch( fc::bad_cast_exception& e )
+                  else
                   {
-                    if( method_name == "network_broadcast_api.broadcast_transaction" )
+                    STATSD_INCREMENT( "jsonrpc", "cache", "miss", 1.0f );
+                  }
+                }
+
+                if( !response.serialized_result )
+                {
+                  const serialized_api_method* serialized_call = _logger ? nullptr : find_serialized_api_method( method_name );
+                  if( serialized_call )
+                  {
+                    response.serialized_result = std::make_shared< const std::string >( (*serialized_call)( func_args ) );
+                  }
+                  else if( _db.has_hardfork( HIVE_HARDFORK_1_26 ) )
+                  {
+                    try
                     {
-                      mode_guard guard( hive::protocol::transaction_serialization_type::legacy );
-                      ilog("Change of serialization( `network_broadcast_api.broadcast_transaction' ) - a legacy format is enabled now" );
                       response.result = (*call)( func_args );
                     }
-                    else
+                    catch( fc::bad_cast_exception& e )
+                    {
+                      if( method_name == "network_broadcast_api.broadcast_transaction" )
+                      {
+                        mode_guard guard( hive::protocol::transaction_serialization_type::legacy );
+                        ilog("Change of serialization( `network_broadcast_api.broadcast_transaction' ) - a legacy format is enabled now" );
+                        response.result = (*call)( func_args );
+                      }
+                      else
+                      {
+                        throw e;
+                      }
+                    }
+                    catch(...)
                     {
-                      throw e;
+                      auto eptr = std::current_exception();
+                      std::rethrow_exception( eptr );
                     }
                   }
-                  catch(...)
+                  else
                   {
-                    auto eptr = std::current_exception();
-                    std::rethrow_exception( eptr );
+                    response.result = (*call)( func_args );
+                  }
+
+                  if( !cache_key.empty() )
+                  {
+                    if( !response.serialized_result )
+                    {
+                      response.serialized_result = std::make_shared< const std::string >( fc::json::to_string( *response.result ) );
+                      response.result.reset();
+                    }
+                    _response_cache.store( cache_key, response.serialized_result, cache_generation );
                   }
-                }
-                else
-                {
-                  response.result = (*call)( func_args );
                 }
               }
             }
@@ -381,6 +593,11 @@ namespace detail
             {
               response.error = json_rpc_error( JSON_RPC_ERROR_DURING_CALL, e.what() );
             }
+            catch( fc::timeout_exception& e )
+            {
+              STATSD_INCREMENT( "jsonrpc", "api", "deadline_exceeded", 1.0f );
+              response.error = json_rpc_error( JSON_RPC_DEADLINE_EXCEEDED, e.to_string() );
+            }
             catch( chain::forkdb_lock_exception& e )
             {
               response.error = json_rpc_error( JSON_RPC_ERROR_DURING_CALL, e.what() );
@@ -389,6 +606,15 @@ namespace detail
             {
               response.error = json_rpc_error( JSON_RPC_ERROR_DURING_CALL, e.to_string(), fc::variant( *(e.dynamic_copy_exception()) ) );
             }
+
+            if( metrics != nullptr )
+            {
+              const fc::microseconds lock_wait = context.lock_wait;
+              metrics->lock_wait.record( lock_wait );
+              metrics->execution.record( fc::time_point::now() - start - lock_wait );
+              if( response.error.valid() )
+                metrics->errors.fetch_add( 1, std::memory_order_relaxed );
+            }
           }
           else
           {
@@ -482,6 +708,15 @@ void json_rpc_plugin::set_program_options( options_description& , options_descri
 {
   cfg.add_options()
     ("log-json-rpc", bpo::value< string >(), "json-rpc log directory name.")
+    ("api-response-cache-method", bpo::value< vector< string > >()->composing()->default_value( {
+        "database_api.get_config", "database_api.get_version", "database_api.get_dynamic_global_properties",
+        "database_api.get_witness_schedule", "database_api.get_hardfork_properties", "database_api.get_reward_funds",
+        "database_api.get_current_price_feed", "database_api.get_feed_history", "database_api.get_active_witnesses",
+        "condenser_api.get_config", "condenser_api.get_version", "condenser_api.get_dynamic_global_properties",
+        "condenser_api.get_chain_properties", "condenser_api.get_current_median_history_price", "condenser_api.get_feed_history",
+        "condenser_api.get_witness_schedule", "condenser_api.get_hardfork_version", "condenser_api.get_next_scheduled_hardfork",
+        "condenser_api.get_reward_fund", "condenser_api.get_active_witnesses" }, "global state methods" ),
+      "API method (api.method) whose results are cached until next block is applied. Use 'none' to disable the cache.")
     ;
 }
 
@@ -502,12 +737,19 @@ void json_rpc_plugin::plugin_initialize( const variables_map& options )
     fc::create_directories(p);
     my->_logger.reset(new json_rpc_logger(dir_name));
   }
+
+  auto cached_methods = options.at( "api-response-cache-method" ).as< vector< string > >();
+  cached_methods.erase( std::remove( cached_methods.begin(), cached_methods.end(), "none" ), cached_methods.end() );
+  my->_response_cache.set_methods( cached_methods );
+  my->_post_apply_block_conn = my->_db.add_post_apply_block_handler(
+    [&]( const chain::block_notification& ) { my->_response_cache.clear(); }, *this, 0 );
 }
 
 void json_rpc_plugin::plugin_startup() {}
 
 void json_rpc_plugin::plugin_pre_shutdown()
 {
+  chain::util::disconnect_signal( my->_post_apply_block_conn );
   my->plugin_pre_shutdown();
 }
 
@@ -523,12 +765,22 @@ void json_rpc_plugin::add_api_method( const string& api_name, const string& meth
   my->add_api_method( api_name, method_name, api, sig );
 }
 
+const api_metrics_registry& json_rpc_plugin::get_api_metrics() const
+{
+  return my->_metrics;
+}
+
+void json_rpc_plugin::add_serialized_api_method( const string& api_name, const string& method_name, const serialized_api_method& api )
+{
+  my->add_serialized_api_method( api_name, method_name, api );
+}
+
 string json_rpc_plugin::call( const string& message )
 {
   STATSD_START_TIMER( "jsonrpc", "overhead", "call", 1.0f );
   try
   {
-    fc::variant v = fc::json::from_string( message );
+    fc::variant v = detail::parse_request( message );
 
     if( v.is_array() )
     {
@@ -542,7 +794,15 @@ string json_rpc_plugin::call( const string& message )
         for( auto& m : messages )
           responses.push_back( my->rpc( m ) );
 
-        return fc::json::to_string( responses );
+        std::string json = "[";
+        for( const auto& response : responses )
+        {
+          if( json.size() > 1 )
+            json += ',';
+          json += detail::to_json_measured( response );
+        }
+        json += ']';
+        return json;
       }
       else
       {
@@ -554,7 +814,7 @@ string json_rpc_plugin::call( const string& message )
     }
     else
     {
-      return fc::json::to_string( my->rpc( v ) );
+      return detail::to_json_measured( my->rpc( v ) );
     }
   }
   catch( fc::exception& e )
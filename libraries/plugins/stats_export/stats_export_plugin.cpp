@@ -52,12 +52,14 @@ class api_stats_export_data_object
     api_dynamic_global_property_object                    global_properties;
     std::vector< api_stats_transaction_data_object >      transaction_stats;
     uint64_t                                              free_memory = 0;
+    uint64_t                                              max_memory = 0;
+    uint64_t                                              reserved_memory = 0;
 };
 
 } } } }
 
 FC_REFLECT( hive::plugins::stats_export::detail::api_stats_transaction_data_object, (user)(size) )
-FC_REFLECT( hive::plugins::stats_export::detail::api_stats_export_data_object, (global_properties)(transaction_stats)(free_memory) )
+FC_REFLECT( hive::plugins::stats_export::detail::api_stats_export_data_object, (global_properties)(transaction_stats)(free_memory)(max_memory)(reserved_memory) )
 
 namespace hive { namespace plugins { namespace stats_export { namespace detail {
 
@@ -114,6 +116,8 @@ void stats_export_plugin_impl::on_post_apply_block( const block_notification& no
   }
 
   stats->free_memory = _db.get_free_memory();
+  stats->max_memory = _db.get_max_memory();
+  stats->reserved_memory = _db.get_reserved_memory();
 }
 
 } // detail
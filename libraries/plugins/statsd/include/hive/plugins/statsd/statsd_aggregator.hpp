@@ -0,0 +1,321 @@
+#pragma once
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hive { namespace plugins { namespace statsd { namespace detail {
+
+/**
+  * Non-blocking statsd emitter.
+  *
+  * Every producing thread gets its own fixed size single-producer/single-consumer ring of
+  * metric events, so recording a metric is a sampling decision, a key copy into a preallocated
+  * slot and one release store - no locks, no allocations, no syscalls. When the ring of a thread
+  * is full the event is dropped (and counted) instead of waiting for the sender.
+  *
+  * A dedicated sender thread drains all rings every flush interval and pre-aggregates events:
+  * - counters with the same key are summed (scaled by their sampling rates),
+  * - gauges keep the last value,
+  * - timings with the same key and value are merged into one sample with adjusted sampling rate
+  *   (40 samples of 3ms become "key:3|ms|@0.025"), which keeps the distribution seen by statsd intact.
+  * Resulting lines are packed into datagrams no bigger than configured packet size and handed
+  * to the packet sender (UDP in statsd_plugin).
+  */
+class statsd_aggregator
+{
+  public:
+    enum class metric_type : char
+    {
+      counter = 'c',
+      gauge   = 'g',
+      timing  = 'm'
+    };
+
+    typedef std::function< void( const std::string& packet ) > packet_sender;
+
+    statsd_aggregator( packet_sender sender, const std::string& prefix,
+      std::chrono::milliseconds flush_interval, uint32_t max_packet_size )
+      : _id( next_id() ), _prefix( prefix ), _flush_interval( flush_interval ), _max_packet_size( max_packet_size ),
+        _sender( std::move( sender ) )
+    {
+      _sender_thread = std::thread( [this]() { run(); } );
+    }
+
+    ~statsd_aggregator()
+    {
+      {
+        std::lock_guard< std::mutex > guard( _wakeup_mutex );
+        _must_exit = true;
+      }
+      _wakeup.notify_one();
+      _sender_thread.join();
+    }
+
+    /**
+      * Records metric event; never blocks, never allocates except once per thread when its buffer
+      * is registered. When that registration fails the event is dropped like on full buffer.
+      */
+    void record( const std::string& ns, const std::string& stat, const std::string& key,
+      metric_type type, int64_t value, float frequency ) noexcept
+    {
+      if( !is_frequency_one( frequency ) && frequency < sampling_dice() )
+        return;
+
+      thread_buffer* registered = get_thread_buffer();
+      if( registered == nullptr )
+      {
+        _dropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+      }
+      thread_buffer& buffer = *registered;
+      const uint32_t tail = buffer.tail.load( std::memory_order_relaxed );
+      if( tail - buffer.head.load( std::memory_order_acquire ) >= BUFFER_CAPACITY )
+      {
+        _dropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+      }
+
+      metric_event& e = buffer.events[ tail & ( BUFFER_CAPACITY - 1 ) ];
+      e.key_size = compose_key( e.key, ns, stat, key );
+      e.type = type;
+      e.value = value;
+      e.frequency = frequency;
+      buffer.tail.store( tail + 1, std::memory_order_release );
+    }
+
+    /// Sends everything recorded so far; called by sender thread every flush interval (and by tests)
+    void flush()
+    {
+      std::lock_guard< std::mutex > guard( _flush_mutex );
+
+      std::map< std::string, aggregate > aggregates;
+      drain( aggregates );
+
+      const uint64_t dropped = _dropped.exchange( 0, std::memory_order_relaxed );
+      if( dropped )
+      {
+        aggregate& a = aggregates[ "statsd.sender.dropped" ];
+        a.count += dropped;
+        a.has_count = true;
+      }
+
+      std::string packet;
+      packet.reserve( _max_packet_size );
+      char line[ 256 ];
+
+      auto emit = [&]( int len )
+      {
+        if( len <= 0 )
+          return;
+        len = std::min< int >( len, sizeof( line ) - 1 );
+        if( !packet.empty() && packet.size() + 1 + len > _max_packet_size )
+        {
+          _sender( packet );
+          packet.clear();
+        }
+        if( !packet.empty() )
+          packet.push_back( '\n' );
+        packet.append( line, len );
+      };
+
+      for( const auto& item : aggregates )
+      {
+        const char* key = item.first.c_str();
+        const aggregate& a = item.second;
+        if( a.has_count )
+          emit( std::snprintf( line, sizeof( line ), "%s%s:%lld|c", _prefix.c_str(), key, static_cast< long long >( std::llround( a.count ) ) ) );
+        if( a.has_gauge )
+          emit( std::snprintf( line, sizeof( line ), "%s%s:%lld|g", _prefix.c_str(), key, static_cast< long long >( a.gauge ) ) );
+        for( const auto& t : a.timings )
+        {
+          if( t.second > 0.9999 && t.second < 1.0001 )
+            emit( std::snprintf( line, sizeof( line ), "%s%s:%lld|ms", _prefix.c_str(), key, static_cast< long long >( t.first ) ) );
+          else
+            emit( std::snprintf( line, sizeof( line ), "%s%s:%lld|ms|@%.6g", _prefix.c_str(), key, static_cast< long long >( t.first ), 1.0 / t.second ) );
+        }
+      }
+
+      if( !packet.empty() )
+        _sender( packet );
+    }
+
+    static const uint32_t BUFFER_CAPACITY = 1024; // must be power of 2, events kept per thread between flushes
+    static const size_t   MAX_KEY_SIZE = 112;
+
+  private:
+
+    struct metric_event
+    {
+      char        key[ MAX_KEY_SIZE ];
+      uint8_t     key_size = 0;
+      metric_type type = metric_type::counter;
+      int64_t     value = 0;
+      float       frequency = 1.0f;
+    };
+
+    struct thread_buffer
+    {
+      std::atomic< uint32_t > head{ 0 }; // written by sender thread only
+      std::atomic< uint32_t > tail{ 0 }; // written by owning thread only
+      metric_event            events[ BUFFER_CAPACITY ];
+    };
+
+    struct aggregate
+    {
+      double                      count = 0;    // sum of counter deltas scaled by sampling rate
+      bool                        has_count = false;
+      int64_t                     gauge = 0;
+      bool                        has_gauge = false;
+      std::map< int64_t, double > timings;      // value -> number of represented samples
+    };
+
+    static uint64_t next_id()
+    {
+      static std::atomic< uint64_t > counter{ 0 };
+      return ++counter;
+    }
+
+    static bool is_frequency_one( float frequency )
+    {
+      constexpr float epsilon{ 0.0001f };
+      return std::fabs( frequency - 1.0f ) < epsilon;
+    }
+
+    static float sampling_dice()
+    {
+      thread_local std::minstd_rand generator( std::random_device{}() );
+      return std::uniform_real_distribution< float >( 0.0f, 1.0f )( generator );
+    }
+
+    static uint8_t compose_key( char* out, const std::string& ns, const std::string& stat, const std::string& key )
+    {
+      // ns.stat.key, truncated when too long
+      size_t size = 0;
+      auto append = [&]( const char* data, size_t len )
+      {
+        len = std::min( len, MAX_KEY_SIZE - size );
+        std::memcpy( out + size, data, len );
+        size += len;
+      };
+      append( ns.data(), ns.size() );
+      append( ".", 1 );
+      append( stat.data(), stat.size() );
+      append( ".", 1 );
+      append( key.data(), key.size() );
+      return static_cast< uint8_t >( size );
+    }
+
+    /// Returns buffer of calling thread, registering it on first use (null when that fails)
+    thread_buffer* get_thread_buffer() noexcept
+    {
+      struct cached_buffer
+      {
+        uint64_t       owner_id = 0;
+        thread_buffer* buffer = nullptr;
+      };
+      thread_local cached_buffer cached;
+
+      if( cached.owner_id != _id )
+      {
+        try
+        {
+          std::unique_ptr< thread_buffer > buffer( new thread_buffer() );
+          std::lock_guard< std::mutex > guard( _buffers_mutex );
+          _buffers.emplace_back( std::move( buffer ) );
+          cached.buffer = _buffers.back().get();
+          cached.owner_id = _id;
+        }
+        catch( ... )
+        {
+          // bad_alloc or failed lock - next call will try again
+          return nullptr;
+        }
+      }
+      return cached.buffer;
+    }
+
+    void run()
+    {
+      std::unique_lock< std::mutex > lock( _wakeup_mutex );
+      while( !_must_exit )
+      {
+        _wakeup.wait_for( lock, _flush_interval, [this]() { return _must_exit; } );
+        lock.unlock();
+        flush();
+        lock.lock();
+      }
+    }
+
+    void drain( std::map< std::string, aggregate >& aggregates )
+    {
+      std::vector< thread_buffer* > buffers;
+      {
+        std::lock_guard< std::mutex > guard( _buffers_mutex );
+        buffers.reserve( _buffers.size() );
+        for( const auto& b : _buffers )
+          buffers.push_back( b.get() );
+      }
+
+      for( thread_buffer* buffer : buffers )
+      {
+        const uint32_t tail = buffer->tail.load( std::memory_order_acquire );
+        uint32_t head = buffer->head.load( std::memory_order_relaxed );
+        for( ; head != tail; ++head )
+        {
+          const metric_event& e = buffer->events[ head & ( BUFFER_CAPACITY - 1 ) ];
+          aggregate& a = aggregates[ std::string( e.key, e.key_size ) ];
+          const double weight = is_frequency_one( e.frequency ) ? 1.0 : 1.0 / e.frequency;
+          switch( e.type )
+          {
+            case metric_type::counter:
+              a.count += e.value * weight;
+              a.has_count = true;
+              break;
+            case metric_type::gauge:
+              a.gauge = e.value;
+              a.has_gauge = true;
+              break;
+            case metric_type::timing:
+              a.timings[ e.value ] += weight;
+              break;
+          }
+        }
+        buffer->head.store( head, std::memory_order_release );
+      }
+    }
+
+    const uint64_t                                  _id;               // distinguishes thread local buffer caches of subsequent instances
+    const std::string                               _prefix;
+    const std::chrono::milliseconds                 _flush_interval;
+    const uint32_t                                  _max_packet_size;
+
+    const packet_sender                             _sender;           // called under _flush_mutex only
+    std::mutex                                      _flush_mutex;
+
+    std::mutex                                      _buffers_mutex;
+    std::vector< std::unique_ptr< thread_buffer > > _buffers;          // buffers of all threads that ever recorded a metric
+
+    std::atomic< uint64_t >                         _dropped{ 0 };
+
+    std::mutex                                      _wakeup_mutex;
+    std::condition_variable                         _wakeup;
+    bool                                            _must_exit = false;
+    std::thread                                     _sender_thread;
+};
+
+} } } } // hive::plugins::statsd::detail
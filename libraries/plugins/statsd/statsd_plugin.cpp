@@ -1,27 +1,17 @@
 #include <hive/plugins/statsd/statsd_plugin.hpp>
+#include <hive/plugins/statsd/statsd_aggregator.hpp>
 
 #include <fc/network/resolve.hpp>
 #include <fc/thread/thread.hpp>
 
 #include <boost/algorithm/string.hpp>
 
-#include <sstream>
-
-#include "StatsdClient.hpp"
+#include "UDPSender.hpp"
 
 namespace hive { namespace plugins { namespace statsd {
 
-using namespace Statsd;
-
 namespace detail
 {
-  inline std::string compose_key( const std::string& ns, const std::string& stat, const std::string& key )
-  {
-    std::stringstream ss;
-    ss << ns << '.' << stat << '.' << key;
-    return ss.str();
-  }
-
   class statsd_plugin_impl
   {
     public:
@@ -56,9 +46,10 @@ namespace detail
       std::map< std::string, std::set< std::string > >   _stat_list;
 
       fc::optional< fc::ip::endpoint >                   _statsd_endpoint;
-      uint32_t                                           _statsd_batchsize = 1;
+      uint32_t                                           _statsd_flush_interval_ms = 1000;
+      uint32_t                                           _statsd_packet_size = 1432;
 
-      std::unique_ptr< StatsdClient >                    _statsd;
+      std::unique_ptr< statsd_aggregator >               _statsd;
   };
 
   void statsd_plugin_impl::start()
@@ -79,7 +70,9 @@ namespace detail
       port = _statsd_endpoint->port();
     }
 
-    _statsd.reset( new StatsdClient( host, port, "hived.", _statsd_batchsize ) );
+    auto sender = std::make_shared< Statsd::UDPSender >( host, port );
+    _statsd.reset( new statsd_aggregator( [sender]( const std::string& packet ) { sender->send( packet ); },
+      "hived.", std::chrono::milliseconds( _statsd_flush_interval_ms ), _statsd_packet_size ) );
     _started = true;
   }
 
@@ -142,27 +135,27 @@ namespace detail
 
   void statsd_plugin_impl::increment( const std::string& ns, const std::string& stat, const std::string& key, const float frequency ) const noexcept
   {
-    execute_operation( ns, stat, [ &, this ](){ _statsd->increment( compose_key( ns, stat, key ), frequency ); } );
+    execute_operation( ns, stat, [ &, this ](){ _statsd->record( ns, stat, key, statsd_aggregator::metric_type::counter, 1, frequency ); } );
   }
 
   void statsd_plugin_impl::decrement( const std::string& ns, const std::string& stat, const std::string& key, const float frequency ) const noexcept
   {
-    execute_operation( ns, stat, [ &, this ](){ _statsd->decrement( compose_key( ns, stat, key ), frequency ); } );
+    execute_operation( ns, stat, [ &, this ](){ _statsd->record( ns, stat, key, statsd_aggregator::metric_type::counter, -1, frequency ); } );
   }
 
   void statsd_plugin_impl::count( const std::string& ns, const std::string& stat, const std::string& key, const int64_t delta, const float frequency ) const noexcept
   {
-    execute_operation( ns, stat, [ &, this ](){ _statsd->count( compose_key( ns, stat, key ), delta, frequency ); } );
+    execute_operation( ns, stat, [ &, this ](){ _statsd->record( ns, stat, key, statsd_aggregator::metric_type::counter, delta, frequency ); } );
   }
 
   void statsd_plugin_impl::gauge( const std::string& ns, const std::string& stat, const std::string& key, const uint64_t value, const float frequency ) const noexcept
   {
-    execute_operation( ns, stat, [ &, this ](){ _statsd->gauge( compose_key( ns, stat, key ), value, frequency ); } );
+    execute_operation( ns, stat, [ &, this ](){ _statsd->record( ns, stat, key, statsd_aggregator::metric_type::gauge, value, frequency ); } );
   }
 
   void statsd_plugin_impl::timing( const std::string& ns, const std::string& stat, const std::string& key, const uint32_t ms, const float frequency ) const noexcept
   {
-    execute_operation( ns, stat, [ &, this ](){ _statsd->timing( compose_key( ns, stat, key ), ms, frequency ); } );
+    execute_operation( ns, stat, [ &, this ](){ _statsd->record( ns, stat, key, statsd_aggregator::metric_type::timing, ms, frequency ); } );
   }
 }
 
@@ -176,7 +169,9 @@ void statsd_plugin::set_program_options( options_description& cli, options_descr
 
   cfg.add_options()
     ("statsd-endpoint", bpo::value< std::string >(), "Endpoint to send statsd messages to.")
-    ("statsd-batchsize", bpo::value< uint32_t >()->default_value( 1 ), "Size to batch statsd messages." )
+    ("statsd-batchsize", bpo::value< uint32_t >()->default_value( 1 ), "Ignored, kept for compatibility (metrics are always aggregated and batched, see statsd-flush-interval)." )
+    ("statsd-flush-interval", bpo::value< uint32_t >()->default_value( 1000 ), "Interval in milliseconds in which aggregated statsd metrics are sent.")
+    ("statsd-packet-size", bpo::value< uint32_t >()->default_value( 1432 ), "Maximum size of single statsd UDP datagram (should fit in network MTU).")
     ("statsd-whitelist", bpo::value< vector< std::string > >()->composing(), "Whitelist of statistics to capture.")
     ("statsd-blacklist", bpo::value< vector< std::string > >()->composing(), "Blacklist of statistics to capture.");
 }
@@ -192,6 +187,11 @@ void statsd_plugin::plugin_initialize( const boost::program_options::variables_m
     ilog( "Configured statsd to send to ${ep}", ("ep", endpoints[0]) );
   }
 
+  my->_statsd_flush_interval_ms = options.at( "statsd-flush-interval" ).as< uint32_t >();
+  FC_ASSERT( my->_statsd_flush_interval_ms > 0, "statsd-flush-interval has to be positive" );
+  my->_statsd_packet_size = options.at( "statsd-packet-size" ).as< uint32_t >();
+  FC_ASSERT( my->_statsd_packet_size >= 512, "statsd-packet-size has to be at least 512 bytes" );
+
   if( options.count( "statsd-whitelist" ) )
   {
     my->_filter_stats = true;
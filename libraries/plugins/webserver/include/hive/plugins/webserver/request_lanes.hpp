@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace hive { namespace plugins { namespace webserver {
+
+/**
+  * Requests are executed in one of two thread pools (lanes). Methods known to be expensive (history,
+  * long lists, block ranges) and batches go to the slow lane, everything else to the fast lane, so
+  * a burst of heavy calls cannot occupy all the threads that serve cheap ones.
+  * Each lane has its own deadline measured from arrival of the request. Request that waited past its
+  * deadline is answered with an error instead of being executed and waiting for chainbase lock never
+  * extends past the deadline.
+  */
+class request_lanes
+{
+  public:
+    /// only that many first bytes of request are looked at (method is normally near the start)
+    static const size_t MAX_SCANNED_SIZE = 4096;
+
+    void set_slow_methods( const std::vector< std::string >& methods )
+    {
+      for( const auto& m : methods )
+      {
+        if( !m.empty() && m.back() == '*' )
+          _slow_prefixes.push_back( m.substr( 0, m.size() - 1 ) );
+        else
+          _slow_methods.insert( m );
+      }
+    }
+
+    bool is_slow( const std::string& body ) const
+    {
+      size_t pos = skip_whitespace( body, 0 );
+      if( pos < scanned_size( body ) && body[ pos ] == '[' )
+        return true; // batch
+
+      const std::string method = peek_method_name( body );
+      if( method.empty() )
+        return false; // malformed requests are rejected quickly
+      if( _slow_methods.count( method ) )
+        return true;
+      for( const auto& prefix : _slow_prefixes )
+      {
+        if( method.compare( 0, prefix.size(), prefix ) == 0 )
+          return true;
+      }
+      return false;
+    }
+
+    /**
+      * Finds api.method of JSON-RPC request without parsing it (for "call" requests api and method are
+      * taken from "params"); returns empty string when not found. Scan is naive - a key named "method"
+      * inside params could be taken instead - but the result only decides the lane.
+      */
+    static std::string peek_method_name( const std::string& body )
+    {
+      std::string method;
+      size_t pos = find_value( body, "\"method\"" );
+      if( pos == std::string::npos || !read_string( body, pos, method ) )
+        return std::string();
+      if( method != "call" )
+        return method;
+
+      std::string api;
+      pos = find_value( body, "\"params\"" );
+      if( pos == std::string::npos || pos >= scanned_size( body ) || body[ pos ] != '[' )
+        return std::string();
+      ++pos;
+      if( !read_string( body, pos, api ) )
+        return std::string();
+      pos = skip_whitespace( body, pos );
+      if( pos >= scanned_size( body ) || body[ pos ] != ',' )
+        return std::string();
+      ++pos;
+      if( !read_string( body, pos, method ) )
+        return std::string();
+      return api + '.' + method;
+    }
+
+  private:
+    static size_t scanned_size( const std::string& body )
+    {
+      return body.size() < MAX_SCANNED_SIZE ? body.size() : size_t( MAX_SCANNED_SIZE );
+    }
+
+    static size_t skip_whitespace( const std::string& body, size_t pos )
+    {
+      const size_t end = scanned_size( body );
+      while( pos < end && isspace( static_cast< unsigned char >( body[ pos ] ) ) )
+        ++pos;
+      return pos;
+    }
+
+    /// position of value of given (quoted) key, npos when not found
+    static size_t find_value( const std::string& body, const char* key )
+    {
+      const char* begin = body.data();
+      const char* end = begin + scanned_size( body );
+      const char* found = std::search( begin, end, key, key + strlen( key ) );
+      if( found == end )
+        return std::string::npos;
+      size_t pos = skip_whitespace( body, ( found - begin ) + strlen( key ) );
+      if( pos >= scanned_size( body ) || body[ pos ] != ':' )
+        return std::string::npos;
+      return skip_whitespace( body, pos + 1 );
+    }
+
+    /// reads string starting at pos (after optional whitespace), moves pos past it; names have no escapes
+    static bool read_string( const std::string& body, size_t& pos, std::string& out )
+    {
+      const size_t end = scanned_size( body );
+      pos = skip_whitespace( body, pos );
+      if( pos >= end || body[ pos ] != '"' )
+        return false;
+      const void* quote = memchr( body.data() + pos + 1, '"', end - pos - 1 );
+      if( quote == nullptr )
+        return false;
+      const size_t close = static_cast< const char* >( quote ) - body.data();
+      out.assign( body, pos + 1, close - pos - 1 );
+      pos = close + 1;
+      return true;
+    }
+
+    std::set< std::string >     _slow_methods;
+    std::vector< std::string >  _slow_prefixes;
+};
+
+} } } // hive::plugins::webserver
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hive { namespace plugins { namespace webserver {
+
+/**
+  * Builds error response to request that is not going to be executed, with id(s) copied from the request
+  * (array of errors for a batch). Ids are found by a scan that only follows strings and nesting of the
+  * request, it is not parsed.
+  */
+class ws_error_response
+{
+  public:
+    static std::string build( const std::string& body, int64_t code, const std::string& message )
+    {
+      const std::string error = fc::json::to_string( fc::mutable_variant_object()( "code", code )( "message", message ) );
+      auto single = [&]( const std::string& id )
+      {
+        return "{\"jsonrpc\":\"2.0\",\"error\":" + error + ",\"id\":" + id + "}";
+      };
+
+      bool batch = false;
+      const std::vector< std::string > ids = peek_ids( body, &batch );
+      if( !batch || ids.empty() )
+        return single( ids.empty() ? std::string( "null" ) : ids.front() );
+
+      std::string response = "[";
+      for( const auto& id : ids )
+      {
+        if( response.size() > 1 )
+          response += ',';
+        response += single( id );
+      }
+      return response + "]";
+    }
+
+    /**
+      * JSON text of "id" of request, or of each element of batch (batch is set then); "null" when request
+      * has no id or is malformed, empty vector for empty or malformed batch.
+      */
+    static std::vector< std::string > peek_ids( const std::string& body, bool* batch )
+    {
+      std::vector< std::string > ids;
+      size_t pos = skip_whitespace( body, 0 );
+      *batch = pos < body.size() && body[ pos ] == '[';
+      if( !*batch )
+      {
+        std::string id = "null";
+        ids.push_back( pos < body.size() && body[ pos ] == '{' && read_id( body, pos, id ) ? id : std::string( "null" ) );
+        return ids;
+      }
+
+      ++pos;
+      for( ;; )
+      {
+        pos = skip_whitespace( body, pos );
+        if( pos >= body.size() || body[ pos ] == ']' )
+          return ids;
+        std::string id = "null";
+        if( body[ pos ] == '{' ? !read_id( body, pos, id ) : !skip_value( body, pos ) )
+          return std::vector< std::string >();
+        ids.push_back( id );
+        pos = skip_whitespace( body, pos );
+        if( pos < body.size() && body[ pos ] == ',' )
+          ++pos;
+      }
+    }
+
+  private:
+    static size_t skip_whitespace( const std::string& body, size_t pos )
+    {
+      while( pos < body.size() && isspace( static_cast< unsigned char >( body[ pos ] ) ) )
+        ++pos;
+      return pos;
+    }
+
+    /// moves pos past string starting at pos
+    static bool skip_string( const std::string& body, size_t& pos )
+    {
+      for( ++pos; pos < body.size(); ++pos )
+      {
+        if( body[ pos ] == '\\' )
+          ++pos;
+        else if( body[ pos ] == '"' )
+        {
+          ++pos;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// moves pos past value starting at pos
+    static bool skip_value( const std::string& body, size_t& pos )
+    {
+      if( pos >= body.size() )
+        return false;
+      if( body[ pos ] == '"' )
+        return skip_string( body, pos );
+      if( body[ pos ] != '{' && body[ pos ] != '[' )
+      {
+        const size_t start = pos;
+        while( pos < body.size() && !isspace( static_cast< unsigned char >( body[ pos ] ) ) &&
+               body[ pos ] != ',' && body[ pos ] != '}' && body[ pos ] != ']' )
+          ++pos;
+        return pos > start;
+      }
+
+      uint32_t depth = 0;
+      while( pos < body.size() )
+      {
+        const char c = body[ pos ];
+        if( c == '"' )
+        {
+          if( !skip_string( body, pos ) )
+            return false;
+          continue;
+        }
+        if( c == '{' || c == '[' )
+          ++depth;
+        else if( ( c == '}' || c == ']' ) && --depth == 0 )
+        {
+          ++pos;
+          return true;
+        }
+        ++pos;
+      }
+      return false;
+    }
+
+    /// moves pos past object starting at pos, id receives value of its top level "id" key (if any)
+    static bool read_id( const std::string& body, size_t& pos, std::string& id )
+    {
+      ++pos;
+      for( ;; )
+      {
+        pos = skip_whitespace( body, pos );
+        if( pos < body.size() && body[ pos ] == '}' )
+        {
+          ++pos;
+          return true;
+        }
+        const size_t key = pos;
+        if( pos >= body.size() || body[ pos ] != '"' || !skip_string( body, pos ) )
+          return false;
+        const bool is_id = body.compare( key, pos - key, "\"id\"" ) == 0;
+        pos = skip_whitespace( body, pos );
+        if( pos >= body.size() || body[ pos ] != ':' )
+          return false;
+        pos = skip_whitespace( body, pos + 1 );
+        const size_t value = pos;
+        if( !skip_value( body, pos ) )
+          return false;
+        if( is_id )
+          id.assign( body, value, pos - value );
+        pos = skip_whitespace( body, pos );
+        if( pos < body.size() && body[ pos ] == ',' )
+          ++pos;
+        else if( pos >= body.size() || body[ pos ] != '}' )
+          return false;
+      }
+    }
+};
+
+/**
+  * Requests of one WebSocket connection. Only limited number of them is executed at the same time,
+  * the rest waits here (not in shared lanes), so single client cannot flood the thread pools.
+  * Request is a copyable type with uint64_t sequence member, which is set to position of request on
+  * its connection.
+  */
+template< typename Request >
+class ws_connection_state : public std::enable_shared_from_this< ws_connection_state< Request > >
+{
+  public:
+    /// posts request for execution (called with state locked); complete() has to be called from other thread when it is done,
+    /// also when state was closed in the meantime
+    typedef std::function< void( const std::shared_ptr< ws_connection_state >&, const Request& ) > dispatcher_type;
+    /// sends response to the client
+    typedef std::function< void( const std::string& ) > sender_type;
+
+    /// max_in_flight 0 means no limit
+    ws_connection_state( uint32_t max_in_flight, uint32_t max_queued, bool ordered_responses,
+      dispatcher_type dispatch, sender_type send )
+      : _max_in_flight( max_in_flight ), _max_queued( max_queued ), _ordered_responses( ordered_responses ),
+        _dispatch( std::move( dispatch ) ), _send( std::move( send ) ) {}
+
+    /**
+      * New request of the connection (body is its text). It is executed right away when there is free slot,
+      * otherwise it waits; when too many requests are waiting it is answered with given error.
+      */
+    void push( Request request, const std::string& body, int64_t error_code, const std::string& error_message )
+    {
+      std::lock_guard< std::mutex > guard( _mutex );
+      if( _closed )
+        return;
+      request.sequence = _next_sequence++;
+      if( _max_in_flight == 0 || _in_flight < _max_in_flight )
+      {
+        ++_in_flight;
+        _dispatch( this->shared_from_this(), request );
+      }
+      else if( _waiting.size() < _max_queued )
+      {
+        _waiting.push_back( std::move( request ) );
+      }
+      else
+      {
+        deliver( request.sequence, ws_error_response::build( body, error_code, error_message ) );
+      }
+    }
+
+    /// Request finished with given response; slot it occupied goes to next waiting request
+    void complete( uint64_t sequence, std::string response )
+    {
+      std::lock_guard< std::mutex > guard( _mutex );
+      if( _closed )
+      {
+        // client is gone - neither the response nor the rest of its queue is processed
+        --_in_flight;
+        return;
+      }
+      deliver( sequence, std::move( response ) );
+      if( _waiting.empty() )
+      {
+        --_in_flight;
+      }
+      else
+      {
+        // requests of other connections are already in the lane queue, so the lanes serve connections in turns
+        _dispatch( this->shared_from_this(), _waiting.front() );
+        _waiting.pop_front();
+      }
+    }
+
+    /// Connection is gone; requests already dispatched just finish, nothing waiting is executed anymore
+    void close()
+    {
+      std::lock_guard< std::mutex > guard( _mutex );
+      _closed = true;
+      _waiting.clear();
+      _finished.clear();
+    }
+
+    bool is_closed() const
+    {
+      std::lock_guard< std::mutex > guard( _mutex );
+      return _closed;
+    }
+
+    uint32_t get_in_flight() const
+    {
+      std::lock_guard< std::mutex > guard( _mutex );
+      return _in_flight;
+    }
+
+    size_t get_waiting() const
+    {
+      std::lock_guard< std::mutex > guard( _mutex );
+      return _waiting.size();
+    }
+
+  private:
+    /// sends response (or keeps it until responses to earlier requests are sent); called with mutex held
+    void deliver( uint64_t sequence, std::string response )
+    {
+      if( !_ordered_responses )
+      {
+        _send( response );
+        return;
+      }
+
+      _finished.emplace( sequence, std::move( response ) );
+      for( auto itr = _finished.begin(); itr != _finished.end() && itr->first == _next_to_send;
+           itr = _finished.erase( itr ) )
+      {
+        _send( itr->second );
+        ++_next_to_send;
+      }
+    }
+
+    const uint32_t                      _max_in_flight;
+    const uint32_t                      _max_queued;
+    const bool                          _ordered_responses;
+    const dispatcher_type               _dispatch;
+    const sender_type                   _send;
+
+    mutable std::mutex                  _mutex;
+    uint32_t                            _in_flight = 0;
+    std::deque< Request >               _waiting;
+    uint64_t                            _next_sequence = 0;
+    uint64_t                            _next_to_send = 0;  // used when responses are delivered in order
+    std::map< uint64_t, std::string >   _finished;          // responses waiting for responses to earlier requests
+    bool                                _closed = false;
+};
+
+} } } // hive::plugins::webserver
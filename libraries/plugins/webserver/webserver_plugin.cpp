@@ -1,5 +1,7 @@
 #include <hive/plugins/webserver/webserver_plugin.hpp>
 #include <hive/plugins/webserver/local_endpoint.hpp>
+#include <hive/plugins/webserver/request_lanes.hpp>
+#include <hive/plugins/webserver/ws_connection_state.hpp>
 
 #include <hive/plugins/json_rpc/utility.hpp>
 
@@ -8,6 +10,7 @@
 #include <fc/network/ip.hpp>
 #include <fc/log/logger_config.hpp>
 #include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
 #include <fc/network/resolve.hpp>
 
 #include <boost/asio.hpp>
@@ -26,8 +29,11 @@
 #include <websocketpp/logger/stub.hpp>
 #include <websocketpp/logger/syslog.hpp>
 
+#include <deque>
 #include <thread>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <iostream>
 
 using namespace boost::placeholders;
@@ -131,11 +137,21 @@ namespace detail {
 using websocket_server_type = websocketpp::server< detail::asio_with_stub_log_and_permessage_deflate >;
 using websocket_local_server_type = websocketpp::server<detail::asio_local_with_stub_log_and_permessage_deflate>;
 
+/// WebSocket request waiting for or undergoing execution
+struct ws_request
+{
+  websocket_server_type::message_ptr  msg;
+  fc::time_point                      arrival_time;
+  uint64_t                            sequence;     // position of request on its connection
+};
+
+typedef ws_connection_state< ws_request > ws_connection_state_type;
+
 class webserver_plugin_impl
 {
   public:
-    webserver_plugin_impl( thread_pool_size_t _thread_pool_size, plugins::chain::chain_plugin& c ) :
-      thread_pool_size( _thread_pool_size ), chain( c )
+    webserver_plugin_impl( thread_pool_size_t _thread_pool_size, thread_pool_size_t _slow_thread_pool_size, plugins::chain::chain_plugin& c ) :
+      thread_pool_size( _thread_pool_size ), slow_thread_pool_size( _slow_thread_pool_size ), chain( c )
     {
     }
 
@@ -145,10 +161,23 @@ class webserver_plugin_impl
     void stop_webserver();
 
     void handle_ws_message( websocket_server_type*, connection_hdl, const detail::websocket_server_type::message_ptr& );
+    void handle_ws_close( connection_hdl );
     void handle_http_message( websocket_server_type*, connection_hdl );
     void handle_http_request( websocket_local_server_type*, connection_hdl );
 
+    /// Answers GET /metrics with API metrics in Prometheus text format (when enabled); false for other requests
+    template< typename Connection >
+    bool handle_metrics_request( const Connection& con );
+
+    /// Posts request to its lane; called with state mutex held
+    void dispatch_ws_request( const std::shared_ptr< ws_connection_state_type >& state, const ws_request& request );
+    std::string process_ws_request( const ws_request& request, const fc::time_point& deadline );
+
+    /// Chooses thread pool for the request and computes its deadline
+    asio::io_service& select_lane( const std::string& body, const fc::time_point& arrival_time, fc::time_point* deadline );
+
     thread_pool_size_t         thread_pool_size;
+    thread_pool_size_t         slow_thread_pool_size;
 
     shared_ptr< std::thread >  http_thread;
     asio::io_service           http_ios;
@@ -169,6 +198,21 @@ class webserver_plugin_impl
     asio::io_service           thread_pool_ios;
     std::unique_ptr< asio::io_service::work > thread_pool_work;
 
+    boost::thread_group        slow_thread_pool;
+    asio::io_service           slow_thread_pool_ios;
+    std::unique_ptr< asio::io_service::work > slow_thread_pool_work;
+
+    request_lanes              lanes;
+    fc::microseconds           fast_deadline;           // 0 means no deadline
+    fc::microseconds           slow_deadline;
+    bool                       expose_metrics = false;
+
+    uint32_t                   ws_max_in_flight = 0;    // 0 means no limit
+    uint32_t                   ws_max_queued = 0;
+    bool                       ws_ordered_responses = false;
+    // accessed only by ws thread (message and close handlers)
+    std::map< connection_hdl, std::shared_ptr< ws_connection_state_type >, std::owner_less< connection_hdl > > ws_connections;
+
     plugins::json_rpc::json_rpc_plugin* api = nullptr;
     boost::signals2::connection         chain_sync_con;
 
@@ -185,6 +229,34 @@ void webserver_plugin_impl::prepare_threads()
 
   for( uint32_t i = 0; i < thread_pool_size; ++i )
     thread_pool.create_thread( boost::bind( &asio::io_service::run, &thread_pool_ios ) );
+
+  if( slow_thread_pool_size > 0 )
+  {
+    slow_thread_pool_work.reset( new asio::io_service::work( this->slow_thread_pool_ios ) );
+
+    for( uint32_t i = 0; i < slow_thread_pool_size; ++i )
+      slow_thread_pool.create_thread( boost::bind( &asio::io_service::run, &slow_thread_pool_ios ) );
+  }
+}
+
+template< typename Connection >
+bool webserver_plugin_impl::handle_metrics_request( const Connection& con )
+{
+  if( !expose_metrics || con->get_request().get_method() != "GET" || con->get_resource() != "/metrics" )
+    return false;
+
+  con->set_body( api->get_api_metrics().to_prometheus() );
+  con->append_header( "Content-Type", "text/plain; version=0.0.4" );
+  con->set_status( websocketpp::http::status_code::ok );
+  return true;
+}
+
+asio::io_service& webserver_plugin_impl::select_lane( const std::string& body, const fc::time_point& arrival_time, fc::time_point* deadline )
+{
+  const bool slow = slow_thread_pool_size > 0 && lanes.is_slow( body );
+  const fc::microseconds& timeout = slow ? slow_deadline : fast_deadline;
+  *deadline = timeout.count() > 0 ? arrival_time + timeout : fc::time_point::maximum();
+  return slow ? slow_thread_pool_ios : thread_pool_ios;
 }
 
 void webserver_plugin_impl::start_webserver()
@@ -206,6 +278,8 @@ void webserver_plugin_impl::start_webserver()
         ws_server.set_reuse_addr( true );
 
         ws_server.set_message_handler( boost::bind( &webserver_plugin_impl::handle_ws_message, this, &ws_server, _1, _2 ) );
+        ws_server.set_close_handler( boost::bind( &webserver_plugin_impl::handle_ws_close, this, _1 ) );
+        ws_server.set_fail_handler( boost::bind( &webserver_plugin_impl::handle_ws_close, this, _1 ) );
 
         if( ws_and_http_uses_same_endpoint )
         {
@@ -344,6 +418,9 @@ void webserver_plugin_impl::stop_webserver()
   thread_pool_ios.stop();
   thread_pool.join_all();
 
+  slow_thread_pool_ios.stop();
+  slow_thread_pool.join_all();
+
   if( ws_thread )
   {
     ws_ios.stop();
@@ -368,62 +445,103 @@ void webserver_plugin_impl::stop_webserver()
 
 void webserver_plugin_impl::handle_ws_message( websocket_server_type* server, connection_hdl hdl, const detail::websocket_server_type::message_ptr& msg )
 {
-  auto con = server->get_con_from_hdl( std::move( hdl ) );
+  auto& state = ws_connections[ hdl ];
+  if( !state )
+  {
+    auto con = server->get_con_from_hdl( std::move( hdl ) );
+    state = std::make_shared< ws_connection_state_type >( ws_max_in_flight, ws_max_queued, ws_ordered_responses,
+      boost::bind( &webserver_plugin_impl::dispatch_ws_request, this, _1, _2 ),
+      [con]( const std::string& response ) { con->send( response ); } );
+  }
 
-  fc::time_point arrival_time = fc::time_point::now();
-  thread_pool_ios.post( [con, msg, this, arrival_time]()
+  state->push( ws_request{ msg, fc::time_point::now(), 0 }, msg->get_payload(),
+    JSON_RPC_TOO_MANY_REQUESTS, "Too many requests pending on this connection" );
+}
+
+void webserver_plugin_impl::handle_ws_close( connection_hdl hdl )
+{
+  auto itr = ws_connections.find( hdl );
+  if( itr == ws_connections.end() )
+    return;
+
+  // requests already dispatched keep the state alive until they are finished
+  itr->second->close();
+  ws_connections.erase( itr );
+}
+
+void webserver_plugin_impl::dispatch_ws_request( const std::shared_ptr< ws_connection_state_type >& state, const ws_request& request )
+{
+  fc::time_point deadline;
+  asio::io_service& lane = select_lane( request.msg->get_payload(), request.arrival_time, &deadline );
+  lane.post( [state, request, deadline, this]()
   {
-    LOG_DELAY(arrival_time, fc::seconds(2), "Excessive delay to begin processing ws API call");
+    std::string response = state->is_closed() ? std::string() : process_ws_request( request, deadline );
+    state->complete( request.sequence, std::move( response ) );
+  });
+}
 
-    try
-    {
-      if( msg->get_opcode() == websocketpp::frame::opcode::text )
-      {
-        auto body = msg->get_payload();
-        LOG_DELAY(arrival_time, fc::seconds(4), "Excessive delay to get ws payload");
+std::string webserver_plugin_impl::process_ws_request( const ws_request& request, const fc::time_point& deadline )
+{
+  const auto& msg = request.msg;
+  const fc::time_point& arrival_time = request.arrival_time;
+  LOG_DELAY(arrival_time, fc::seconds(2), "Excessive delay to begin processing ws API call");
 
-        auto response =  api->call( body );
-        LOG_DELAY(arrival_time, fc::seconds(10), "Excessive delay to process ws API call");
+  try
+  {
+    if( msg->get_opcode() == websocketpp::frame::opcode::text )
+    {
+      auto body = msg->get_payload();
+      LOG_DELAY(arrival_time, fc::seconds(4), "Excessive delay to get ws payload");
 
-        con->send( response );
+      std::string response;
+      {
+        json_rpc::request_scope scope( arrival_time, deadline );
+        response = api->call( body );
       }
-      else
-        con->send( "error: string payload expected" );
+      LOG_DELAY(arrival_time, fc::seconds(10), "Excessive delay to process ws API call");
+
+      return response;
     }
-    catch( fc::exception& e )
+    else
+      return "error: string payload expected";
+  }
+  catch( fc::exception& e )
+  {
+    ulog("${e}",("e",e.to_string()));
+    return "error calling API " + e.to_string();
+  }
+  catch( ... )
+  {
+    auto eptr = std::current_exception();
+
+    try
     {
-      con->send( "error calling API " + e.to_string() );
-      ulog("${e}",("e",e.to_string()));
+      if( eptr )
+        std::rethrow_exception( eptr );
+
+      return "unknown error occurred";
     }
-    catch( ... )
+    catch( const std::exception& e )
     {
-      auto eptr = std::current_exception();
-
-      try
-      {
-        if( eptr )
-          std::rethrow_exception( eptr );
-
-        con->send( "unknown error occurred" );
-      }
-      catch( const std::exception& e )
-      {
-        std::stringstream s;
-        s << "unknown exception: " << e.what();
-        con->send( s.str() );
-        ulog("${e}", ("e", s.str()) );
-      }
+      std::stringstream s;
+      s << "unknown exception: " << e.what();
+      ulog("${e}", ("e", s.str()) );
+      return s.str();
     }
-  });
+  }
 }
 
 void webserver_plugin_impl::handle_http_message( websocket_server_type* server, connection_hdl hdl )
 {
   auto con = server->get_con_from_hdl( std::move( hdl ) );
+  if( handle_metrics_request( con ) )
+    return;
   con->defer_http_response();
 
   fc::time_point arrival_time = fc::time_point::now();
-  thread_pool_ios.post( [con, this, arrival_time]()
+  fc::time_point deadline;
+  asio::io_service& lane = select_lane( con->get_request_body(), arrival_time, &deadline );
+  lane.post( [con, this, arrival_time, deadline]()
   {
     LOG_DELAY(arrival_time, fc::seconds(2), "Excessive delay to begin processing API call");
 
@@ -432,6 +550,7 @@ void webserver_plugin_impl::handle_http_message( websocket_server_type* server,
 
     try
     {
+      json_rpc::request_scope request( arrival_time, deadline );
       con->set_body( api->call( body ) );
       con->append_header( "Content-Type", "application/json" );
       con->set_status( websocketpp::http::status_code::ok );
@@ -472,14 +591,20 @@ void webserver_plugin_impl::handle_http_message( websocket_server_type* server,
 
 void webserver_plugin_impl::handle_http_request(websocket_local_server_type* server, connection_hdl hdl ) {
   auto con = server->get_con_from_hdl( std::move( hdl ) );
+  if( handle_metrics_request( con ) )
+    return;
   con->defer_http_response();
 
-  thread_pool_ios.post( [con, this]()
+  fc::time_point arrival_time = fc::time_point::now();
+  fc::time_point deadline;
+  asio::io_service& lane = select_lane( con->get_request_body(), arrival_time, &deadline );
+  lane.post( [con, this, arrival_time, deadline]()
   {
     auto body = con->get_request_body();
 
     try
     {
+      json_rpc::request_scope request( arrival_time, deadline );
       con->set_body( api->call( body ) );
       con->append_header( "Content-Type", "application/json" );
       con->set_status( websocketpp::http::status_code::ok );
@@ -531,6 +656,26 @@ void webserver_plugin::set_program_options( options_description&, options_descri
     ("rpc-endpoint", bpo::value< string >(), "Local http and websocket endpoint for webserver requests. Deprecated in favor of webserver-http-endpoint and webserver-ws-endpoint" )
     ("webserver-thread-pool-size", bpo::value<thread_pool_size_t>()->default_value(32),
       "Number of threads used to handle queries. Default: 32.")
+    ("webserver-slow-thread-pool-size", bpo::value<thread_pool_size_t>()->default_value(0),
+      "Number of threads used to handle expensive queries (see webserver-slow-api-method); 0 handles all queries in one pool. Default: 0.")
+    ("webserver-slow-api-method", bpo::value< std::vector< string > >()->composing()->default_value( {
+        "account_history_api.*", "block_api.get_block_range", "database_api.list_*",
+        "condenser_api.get_account_history", "condenser_api.get_ops_in_block", "condenser_api.get_transaction",
+        "condenser_api.list_*", "condenser_api.get_blog*", "condenser_api.get_followers",
+        "condenser_api.get_following", "condenser_api.get_reblogged_by" }, "history, block range and list methods" ),
+      "API method (api.method, trailing * matches any suffix) handled by slow thread pool. Batch requests are always handled there.")
+    ("webserver-fast-deadline-ms", bpo::value< uint32_t >()->default_value( 0 ),
+      "Time (ms) after arrival when query handled by the main thread pool is abandoned; 0 (default) means no deadline.")
+    ("webserver-slow-deadline-ms", bpo::value< uint32_t >()->default_value( 0 ),
+      "Time (ms) after arrival when query handled by slow thread pool is abandoned; 0 (default) means no deadline.")
+    ("webserver-ws-max-in-flight", bpo::value< uint32_t >()->default_value( 0 ),
+      "Maximum number of requests of single WebSocket connection executed at the same time; 0 (default) means no limit.")
+    ("webserver-ws-max-queued", bpo::value< uint32_t >()->default_value( 1024 ),
+      "Maximum number of requests of single WebSocket connection waiting for execution; further ones are rejected.")
+    ("webserver-ws-ordered-responses", bpo::value< bool >()->default_value( false ),
+      "Send responses on WebSocket connection in the order requests were received.")
+    ("webserver-expose-metrics", bpo::value< bool >()->default_value( false ),
+      "Answer HTTP GET /metrics with per-method API latency metrics in Prometheus text format. Use on local (unix or localhost) endpoints.")
     ;
 }
 
@@ -539,7 +684,16 @@ void webserver_plugin::plugin_initialize( const variables_map& options )
   auto thread_pool_size = options.at("webserver-thread-pool-size").as<thread_pool_size_t>();
   FC_ASSERT(thread_pool_size > 0, "webserver-thread-pool-size must be greater than 0");
   ilog("configured with ${tps} thread pool size", ("tps", thread_pool_size));
-  my.reset( new detail::webserver_plugin_impl( thread_pool_size, appbase::app().get_plugin< plugins::chain::chain_plugin >() ) );
+  auto slow_thread_pool_size = options.at("webserver-slow-thread-pool-size").as<thread_pool_size_t>();
+  ilog("configured with ${tps} slow query thread pool size", ("tps", slow_thread_pool_size));
+  my.reset( new detail::webserver_plugin_impl( thread_pool_size, slow_thread_pool_size, appbase::app().get_plugin< plugins::chain::chain_plugin >() ) );
+  my->lanes.set_slow_methods( options.at( "webserver-slow-api-method" ).as< std::vector< string > >() );
+  my->fast_deadline = fc::milliseconds( options.at( "webserver-fast-deadline-ms" ).as< uint32_t >() );
+  my->slow_deadline = fc::milliseconds( options.at( "webserver-slow-deadline-ms" ).as< uint32_t >() );
+  my->expose_metrics = options.at( "webserver-expose-metrics" ).as< bool >();
+  my->ws_max_in_flight = options.at( "webserver-ws-max-in-flight" ).as< uint32_t >();
+  my->ws_max_queued = options.at( "webserver-ws-max-queued" ).as< uint32_t >();
+  my->ws_ordered_responses = options.at( "webserver-ws-ordered-responses" ).as< bool >();
 
   if( options.count( "webserver-http-endpoint" ) )
   {
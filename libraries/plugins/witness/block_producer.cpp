@@ -10,11 +10,60 @@
 #include <hive/chain/pending_required_action_object.hpp>
 #include <hive/chain/pending_optional_action_object.hpp>
 #include <hive/chain/witness_objects.hpp>
+#include <hive/chain/util/impacted.hpp>
 
 #include <fc/macros.hpp>
 
+#include <boost/algorithm/cxx11/any_of.hpp>
+
 namespace hive { namespace plugins { namespace witness {
 
+namespace {
+
+/// size of transaction counted toward block size limit, taken from already packed form when available
+size_t packed_size( const chain::signed_transaction_transporter& tx )
+{
+  const auto& packed = tx.get_packed_trx();
+  return packed.empty() ? fc::raw::pack_size( tx ) : packed.size();
+}
+
+/**
+  * Collects accounts of custom operations, that are subject of custom op limit of witness plugin.
+  * That limit is only checked for new transactions, so transactions reapplied to pending state
+  * did not count toward it.
+  */
+struct custom_op_accounts_visitor
+{
+  custom_op_accounts_visitor( flat_set< chain::account_name_type >& accounts ) : _accounts( accounts ) {}
+
+  flat_set< chain::account_name_type >& _accounts;
+
+  typedef void result_type;
+
+  template< typename T >
+  void operator()( const T& )const {}
+
+  void collect( const protocol::operation& op )const
+  {
+    app::operation_get_impacted_accounts( op, _accounts );
+  }
+
+  void operator()( const protocol::custom_operation& o )const { collect( o ); }
+  void operator()( const protocol::custom_json_operation& o )const { collect( o ); }
+  void operator()( const protocol::custom_binary_operation& o )const { collect( o ); }
+};
+
+flat_set< chain::account_name_type > get_custom_op_accounts( const chain::signed_transaction& tx )
+{
+  flat_set< chain::account_name_type > accounts;
+  custom_op_accounts_visitor v( accounts );
+  for( const auto& op : tx.operations )
+    op.visit( v );
+  return accounts;
+}
+
+} // anonymous namespace
+
 chain::signed_block block_producer::generate_block(fc::time_point_sec when, const chain::account_name_type& witness_owner, const fc::ecc::private_key& block_signing_private_key, uint32_t skip)
 {
   chain::signed_block result;
@@ -25,14 +74,14 @@ chain::signed_block block_producer::generate_block(fc::time_point_sec when, cons
     {
       try
       {
-        result = _generate_block( when, witness_owner, block_signing_private_key );
+        result = _generate_block( when, witness_owner, block_signing_private_key, true );
       }
       FC_CAPTURE_AND_RETHROW( (witness_owner) )
     });
   return result;
 }
 
-chain::signed_block block_producer::_generate_block(fc::time_point_sec when, const chain::account_name_type& witness_owner, const fc::ecc::private_key& block_signing_private_key)
+chain::signed_block block_producer::_generate_block(fc::time_point_sec when, const chain::account_name_type& witness_owner, const fc::ecc::private_key& block_signing_private_key, bool allow_reuse)
 {
   uint32_t skip = _db.get_node_properties().skip_flags;
   uint32_t slot_num = _db.get_slot_at_time( when );
@@ -53,7 +102,7 @@ chain::signed_block block_producer::_generate_block(fc::time_point_sec when, con
 
   adjust_hardfork_version_vote( _db.get_witness( witness_owner ), pending_block );
 
-  apply_pending_transactions( witness_owner, when, pending_block );
+  const bool reused_validation = apply_pending_transactions( witness_owner, when, pending_block, allow_reuse );
 
   // We have temporarily broken the invariant that
   // _pending_tx_session is the result of applying _pending_tx, as
@@ -70,7 +119,28 @@ chain::signed_block block_producer::_generate_block(fc::time_point_sec when, con
     FC_ASSERT( fc::raw::pack_size(pending_block) <= HIVE_MAX_BLOCK_SIZE );
   }
 
-  _db.push_block( pending_block, skip );
+  if( !reused_validation )
+  {
+    _db.push_block( pending_block, skip );
+    return pending_block;
+  }
+
+  std::shared_ptr< fc::exception > delayed_exception_to_avoid_yield_in_catch;
+  try
+  {
+    _db.push_block( pending_block, skip );
+  }
+  catch( const fc::exception& e )
+  {
+    delayed_exception_to_avoid_yield_in_catch = e.dynamic_copy_exception();
+  }
+  if( delayed_exception_to_avoid_yield_in_catch )
+  {
+    // should not happen, but it is better to spend time building block again than miss it
+    wlog( "Block built from already validated pending transactions was rejected, building it again: ${e}",
+      ( "e", delayed_exception_to_avoid_yield_in_catch->to_detail_string() ) );
+    return _generate_block( when, witness_owner, block_signing_private_key, false );
+  }
 
   return pending_block;
 }
@@ -99,10 +169,11 @@ void block_producer::adjust_hardfork_version_vote(const chain::witness_object& w
   }
 }
 
-void block_producer::apply_pending_transactions(
+bool block_producer::apply_pending_transactions(
       const chain::account_name_type& witness_owner,
       fc::time_point_sec when,
-      chain::signed_block& pending_block)
+      chain::signed_block& pending_block,
+      bool allow_reuse)
 {
   // The 4 is for the max size of the transaction vector length
   size_t total_block_size = fc::raw::pack_size( pending_block ) + 4;
@@ -140,28 +211,85 @@ void block_producer::apply_pending_transactions(
   // the flag also covers time of processing of required and optional actions
   _db.set_tx_status( chain::database::TX_STATUS_NEW_BLOCK );
 
+  const auto& pending_required_action_idx = _db.get_index< chain::pending_required_action_index, chain::by_execution >();
+  const auto& pending_optional_action_idx = _db.get_index< chain::pending_optional_action_index, chain::by_execution >();
+
+  //
+  // Transactions at the end of _pending_tx that were validated as new transactions on top of pending
+  // state don't need to be applied again, as long as all transactions before them (reapplied with less
+  // checks when pending state was rebuilt) apply the same way now and none of the transactions is left
+  // out, so the state they were validated against is the same. Such transactions are also not applied
+  // to the state below, so automated actions (applied on top of all transactions) have to be absent.
+  //
+  const size_t validated_begin = _db._pending_tx.size() - _db._pending_tx_validated_tail;
+  bool reuse_validation = allow_reuse && _db._pending_tx_validated_tail > 0
+    && _db.has_hardfork( HIVE_HARDFORK_0_20 ) // before that current_witness set above could change outcome
+    && ( _db._pending_tx_validated_skip & ~_db.get_node_properties().skip_flags ) == 0
+    && ( pending_required_action_idx.empty() || pending_required_action_idx.begin()->execution_time > when )
+    && ( pending_optional_action_idx.empty() || pending_optional_action_idx.begin()->execution_time > when );
+  bool reused_validation = false;
+  flat_set< chain::account_name_type > reapplied_custom_op_accounts;
+
+  // transactions postponed after last block go after pending ones - pending transactions that share
+  // accounts with them are all older (see database::_postponed_tx), so that is their proper order;
+  // they were not validated on top of pending state, so if some pending transactions were not applied,
+  // they can't be included
+  const size_t pending_tx_count = _db._pending_tx.size();
+  const size_t all_tx_count = pending_tx_count + _db._postponed_tx.size();
+
   uint64_t postponed_tx_count = 0;
   // pop pending state (reset to head block state)
-  for( const auto& tx : _db._pending_tx )
+  for( size_t i = 0; i < all_tx_count; ++i )
   {
+    if( i == pending_tx_count )
+    {
+      if( reused_validation )
+        break;
+      reuse_validation = false;
+    }
+    const auto& tx = i < pending_tx_count ? _db._pending_tx[i] : _db._postponed_tx[ i - pending_tx_count ];
+
     // Only include transactions that have not expired yet for currently generating block,
     // this should clear problem transactions and allow block production to continue
 
     if( postponed_tx_count > HIVE_BLOCK_GENERATION_POSTPONED_TX_LIMIT )
       break;
 
-    if( tx.trx.expiration < when )
-      continue;
-
-    uint64_t new_total_size = total_block_size + fc::raw::pack_size( tx );
-
     // postpone transaction if it would make block too big
-    if( new_total_size >= maximum_transaction_partition_size )
+    uint64_t new_total_size = total_block_size + packed_size( tx );
+    bool include = tx.trx.expiration >= when;
+    if( include && new_total_size >= maximum_transaction_partition_size )
     {
       postponed_tx_count++;
+      include = false;
+    }
+
+    if( !include )
+    {
+      // transactions after reused ones can't be validated against different state
+      if( reused_validation )
+        break;
+      reuse_validation = false;
       continue;
     }
 
+    if( reuse_validation && i >= validated_begin )
+    {
+      if( reapplied_custom_op_accounts.empty() ||
+        !boost::algorithm::any_of( get_custom_op_accounts( tx.trx ), [&]( const chain::account_name_type& a )
+          { return reapplied_custom_op_accounts.count( a ) != 0; } ) )
+      {
+        total_block_size = new_total_size;
+        pending_block.transactions.push_back( tx );
+        reused_validation = true;
+        continue;
+      }
+      // custom ops of reapplied transactions were not counted toward limit when transaction was validated
+      if( reused_validation )
+        break;
+      reuse_validation = false;
+    }
+
     try
     {
       auto temp_session = _db.start_undo_session();
@@ -170,6 +298,12 @@ void block_producer::apply_pending_transactions(
 
       total_block_size = new_total_size;
       pending_block.transactions.push_back( tx );
+
+      if( reuse_validation )
+      {
+        auto accounts = get_custom_op_accounts( tx.trx );
+        reapplied_custom_op_accounts.insert( accounts.begin(), accounts.end() );
+      }
     }
     catch ( const fc::exception& e )
     {
@@ -177,14 +311,14 @@ void block_producer::apply_pending_transactions(
       // after processing further blocks) until it expires or repeats the exception during that time
       //wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
       //wlog( "The transaction was ${t}", ("t", tx) );
+      reuse_validation = false;
     }
   }
   if( postponed_tx_count > 0 )
   {
-    wlog( "Postponed ${n} transactions due to block size limit", ("n", _db._pending_tx.size() - pending_block.transactions.size()) );
+    wlog( "Postponed ${n} transactions due to block size limit", ("n", all_tx_count - pending_block.transactions.size()) );
   }
 
-  const auto& pending_required_action_idx = _db.get_index< chain::pending_required_action_index, chain::by_execution >();
   auto pending_required_itr = pending_required_action_idx.begin();
   chain::required_automated_actions required_actions;
 
@@ -220,7 +354,6 @@ FC_TODO( "Remove ifdef when required actions are added" )
   }
 #endif
 
-  const auto& pending_optional_action_idx = _db.get_index< chain::pending_optional_action_index, chain::by_execution >();
   auto pending_optional_itr = pending_optional_action_idx.begin();
   chain::optional_automated_actions optional_actions;
 
@@ -254,6 +387,8 @@ FC_TODO( "Remove ifdef when optional actions are added" )
   _db.pending_transaction_session().reset();
 
   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+
+  return reused_validation;
 }
 
 } } } // hive::plugins::witness
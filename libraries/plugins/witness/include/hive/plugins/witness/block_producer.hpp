@@ -30,14 +30,21 @@ private:
   chain::signed_block _generate_block(
     fc::time_point_sec when,
     const chain::account_name_type& witness_owner,
-    const fc::ecc::private_key& block_signing_private_key);
+    const fc::ecc::private_key& block_signing_private_key,
+    bool allow_reuse);
 
   void adjust_hardfork_version_vote( const chain::witness_object& witness, chain::signed_block& pending_block );
 
-  void apply_pending_transactions(
+  /**
+    * Fills block with pending transactions and automated actions. When allowed, transactions
+    * already validated on top of the same state are included without applying them again;
+    * returns true if that happened.
+    */
+  bool apply_pending_transactions(
     const chain::account_name_type& witness_owner,
     fc::time_point_sec when,
-    chain::signed_block& pending_block);
+    chain::signed_block& pending_block,
+    bool allow_reuse);
 };
 
 } } } // hive::plugins::witness
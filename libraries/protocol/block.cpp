@@ -2,6 +2,7 @@
 #include <fc/io/raw.hpp>
 #include <fc/bitutil.hpp>
 #include <algorithm>
+#include <numeric>
 
 namespace hive { namespace protocol {
   digest_type block_header::digest()const
@@ -41,33 +42,78 @@ namespace hive { namespace protocol {
     return signee( canon_type ) == expected_signee;
   }
 
+  namespace {
+
+    /// hashes legacy serialization of every transaction in one batch
+    template< typename Projection >
+    void hash_transactions( const vector<signed_transaction_transporter>& transactions, Projection projection, vector<digest_type>& out )
+    {
+      hive::protocol::serialization_mode_controller::pack_guard guard( hive::protocol::pack_type::legacy );
+
+      vector<uint32_t> sizes;
+      sizes.reserve( transactions.size() );
+      for( const auto& trx : transactions )
+        sizes.push_back( fc::raw::pack_size( projection( trx.trx ) ) );
+
+      vector<char> buffer( std::accumulate( sizes.begin(), sizes.end(), size_t( 0 ) ) );
+      vector<const char*> data;
+      data.reserve( transactions.size() );
+      fc::datastream<char*> ds( buffer.data(), buffer.size() );
+      for( const auto& trx : transactions )
+      {
+        data.push_back( ds.pos() );
+        fc::raw::pack( ds, projection( trx.trx ) );
+      }
+
+      out.resize( transactions.size() );
+      digest_type::hash_many( data.data(), sizes.data(), data.size(), out.data() );
+    }
+
+  } // anonymous
+
   checksum_type signed_block::calculate_merkle_root()const
   {
     if( transactions.size() == 0 )
       return checksum_type();
 
     vector<digest_type> ids;
-    ids.resize( transactions.size() );
-    for( uint32_t i = 0; i < transactions.size(); ++i )
-      ids[i] = transactions[i].trx.merkle_digest();
-
-    hive::protocol::serialization_mode_controller::pack_guard guard( hive::protocol::pack_type::legacy );
+    hash_transactions( transactions, []( const signed_transaction& trx ) -> const signed_transaction& { return trx; }, ids );
 
-    vector<digest_type>::size_type current_number_of_hashes = ids.size();
-    while( current_number_of_hashes > 1 )
+    // each level hashes concatenated pairs of digests from previous one, all pairs of a level in one batch
+    static_assert( sizeof( digest_type ) == 32, "pair of digests has to be packed as their plain concatenation" );
+    vector<digest_type> next_ids;
+    vector<const char*> pairs;
+    vector<uint32_t> sizes;
+    while( ids.size() > 1 )
     {
-      // hash ID's in pairs
-      uint32_t i_max = current_number_of_hashes - (current_number_of_hashes&1);
-      uint32_t k = 0;
-
-      for( uint32_t i = 0; i < i_max; i += 2 )
-        ids[k++] = digest_type::hash( std::make_pair( ids[i], ids[i+1] ) );
+      const size_t pair_count = ids.size() / 2;
+      pairs.clear();
+      for( size_t i = 0; i < pair_count; ++i )
+        pairs.push_back( (const char*)&ids[ 2 * i ] );
+      sizes.assign( pair_count, 2 * sizeof( digest_type ) );
+      next_ids.resize( pair_count );
+      digest_type::hash_many( pairs.data(), sizes.data(), pair_count, next_ids.data() );
 
-      if( current_number_of_hashes&1 )
-        ids[k++] = ids[i_max];
-      current_number_of_hashes = k;
+      // odd one out is promoted to next level unchanged
+      if( ids.size() & 1 )
+        next_ids.push_back( ids.back() );
+      ids.swap( next_ids );
     }
+
+    hive::protocol::serialization_mode_controller::pack_guard guard( hive::protocol::pack_type::legacy );
     return checksum_type::hash( ids[0] );
   }
 
+  vector<transaction_id_type> signed_block::calculate_transaction_ids()const
+  {
+    vector<digest_type> digests;
+    hash_transactions( transactions, []( const signed_transaction& trx ) -> const transaction& { return trx; }, digests );
+
+    // same truncation as in transaction::id()
+    vector<transaction_id_type> result( digests.size() );
+    for( size_t i = 0; i < digests.size(); ++i )
+      memcpy( result[i]._hash, digests[i]._hash, std::min( sizeof( result[i] ), sizeof( digests[i] ) ) );
+    return result;
+  }
+
 } } // hive::protocol
@@ -8,6 +8,8 @@ namespace hive { namespace protocol {
   struct signed_block : public signed_block_header
   {
     checksum_type calculate_merkle_root()const;
+    /// ids of all transactions in the block, calculated in one batch (same as calling id() on each transaction)
+    vector<transaction_id_type> calculate_transaction_ids()const;
     vector<signed_transaction_transporter> transactions;
   };
 
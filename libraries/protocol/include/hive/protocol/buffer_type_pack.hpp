@@ -3,14 +3,16 @@
 #include <fc/io/datastream.hpp>
 #include <fc/io/raw.hpp>
 
+#include <cstring>
+
 namespace fc { namespace raw {
 
 template< typename T, typename B > inline void pack_to_buffer( B& raw, const T& v )
 {
-  auto size = pack_size( v );
-  raw.resize( size );
-  datastream< char* > ds( raw.data(), size );
-  pack( ds, v );
+  const packed_view packed = pack_to_thread_buffer( v );
+  raw.resize( packed.size() );
+  if( packed.size() )
+    memcpy( raw.data(), packed.data(), packed.size() );
 }
 
 template< typename T, typename B > inline void unpack_from_buffer( const B& raw, T& v )
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <fc/filesystem.hpp>
+
+#include <boost/preprocessor/cat.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace hive { namespace utilities {
+
+/**
+  * Span recorder used to find out after the fact where a single slow block (or API call, or p2p
+  * message) spent its time.
+  *
+  * When enabled, every finished span (category, name, thread, begin, duration, optional numeric
+  * argument) is written into a fixed size ring buffer, overwriting the oldest entries. Recording is
+  * lock free and does not allocate. Content of the buffer can be dumped at any time as Chrome trace
+  * event JSON, which can be opened with chrome://tracing or https://ui.perfetto.dev
+  *
+  * When disabled (default) the only cost of a span is one relaxed atomic load.
+  *
+  * Independently of the ring buffer, spans can also be summed up per category and name (used by
+  * benchmarks that need totals over many blocks rather than individual spans).
+  */
+class performance_trace
+{
+  public:
+    struct span_total
+    {
+      uint64_t count = 0;
+      int64_t  time = 0; // microseconds
+    };
+    /// Totals keyed by category and name of span
+    typedef std::map< std::pair< std::string, std::string >, span_total > totals_t;
+
+    static performance_trace& instance();
+
+    /// Allocates ring buffer for given number of spans and starts recording (0 disables recording)
+    void enable( uint32_t capacity );
+    void disable();
+
+    /// Starts/stops summing up spans per category and name (does not need ring buffer)
+    void enable_totals( bool enable );
+    /// Returns totals collected since last reset
+    totals_t get_totals() const;
+    void reset_totals();
+
+    bool is_enabled() const { return _enabled.load( std::memory_order_relaxed ); }
+
+    /// Time source for spans (microseconds, steady clock)
+    static int64_t now()
+    {
+      return std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    /// Records finished span; category and name are copied (and truncated when too long)
+    void record( const char* category, const char* name, int64_t begin, int64_t end, int64_t arg = -1 ) noexcept;
+
+    /// Gives a name to current thread in dumped trace (e.g. "write_queue")
+    void set_thread_name( const std::string& name );
+
+    /// Writes spans currently held in the buffer to given file; returns number of spans written
+    uint32_t dump( const fc::path& file ) const;
+
+  private:
+    performance_trace();
+    ~performance_trace();
+
+    struct span;
+    struct impl;
+
+    void update_enabled();
+
+    std::atomic< bool >      _enabled; // true when spans are recorded in ring buffer or summed up
+    std::unique_ptr< impl >  _impl;
+};
+
+/// Records span covering lifetime of the object (when tracing is enabled at construction time)
+class trace_scope
+{
+  public:
+    trace_scope( const char* category, const char* name, int64_t arg = -1 )
+    {
+      if( performance_trace::instance().is_enabled() )
+      {
+        _category = category;
+        _name = name;
+        _arg = arg;
+        _begin = performance_trace::now();
+      }
+    }
+
+    trace_scope( const char* category, const std::string& name, int64_t arg = -1 )
+      : trace_scope( category, name.c_str(), arg ) {}
+
+    ~trace_scope()
+    {
+      if( _category != nullptr )
+        performance_trace::instance().record( _category, _name, _begin, performance_trace::now(), _arg );
+    }
+
+    trace_scope( const trace_scope& ) = delete;
+    trace_scope& operator=( const trace_scope& ) = delete;
+
+  private:
+    const char* _category = nullptr;
+    const char* _name = nullptr;
+    int64_t     _begin = 0;
+    int64_t     _arg = -1;
+};
+
+} } // hive::utilities
+
+/// Traces rest of current scope; NAME has to stay valid until the end of the scope
+#define HIVE_TRACE_SCOPE( CATEGORY, NAME, ... ) \
+  hive::utilities::trace_scope BOOST_PP_CAT( _hive_trace_scope_, __LINE__ )( CATEGORY, NAME, ##__VA_ARGS__ )
+
+/// Traces single call, span is named after called expression
+#define HIVE_TRACE_CALL( CATEGORY, CALL )                                   \
+  do {                                                                      \
+    hive::utilities::trace_scope _hive_trace_call_scope( CATEGORY, #CALL ); \
+    CALL;                                                                   \
+  } while( false )
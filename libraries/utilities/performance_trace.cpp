@@ -0,0 +1,228 @@
+#include <hive/utilities/performance_trace.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace hive { namespace utilities {
+
+struct performance_trace::span
+{
+  std::atomic< uint64_t > sequence{ 0 }; // odd while span is being written, 0 when never written
+  int64_t                 begin = 0;
+  int64_t                 duration = 0;
+  int64_t                 arg = -1;
+  uint32_t                thread_id = 0;
+  char                    category[ 16 ];
+  char                    name[ 80 ];
+};
+
+struct performance_trace::impl
+{
+  std::unique_ptr< span[] >          spans;
+  uint32_t                           capacity = 0;
+  std::atomic< uint64_t >            next{ 0 };
+  std::atomic< bool >                ring_enabled{ false };
+
+  std::atomic< bool >                totals_enabled{ false };
+  mutable std::mutex                 totals_mutex;
+  totals_t                           totals;
+
+  mutable std::mutex                 thread_names_mutex;
+  std::map< uint32_t, std::string >  thread_names;
+};
+
+namespace {
+
+uint32_t current_thread_id()
+{
+  static std::atomic< uint32_t > next_id{ 0 };
+  thread_local uint32_t id = ++next_id;
+  return id;
+}
+
+template< size_t N >
+void copy_truncated( char (&dst)[N], const char* src )
+{
+  size_t len = strnlen( src, N - 1 );
+  memcpy( dst, src, len );
+  dst[ len ] = '\0';
+}
+
+} // anonymous
+
+performance_trace& performance_trace::instance()
+{
+  static performance_trace trace;
+  return trace;
+}
+
+performance_trace::performance_trace() : _enabled( false ), _impl( new impl() ) {}
+performance_trace::~performance_trace() {}
+
+void performance_trace::enable( uint32_t capacity )
+{
+  if( capacity == 0 )
+  {
+    disable();
+    return;
+  }
+
+  // buffer is never released nor resized, so threads that saw it enabled can always write safely
+  if( _impl->capacity == 0 )
+  {
+    _impl->spans.reset( new span[ capacity ] );
+    _impl->capacity = capacity;
+  }
+  else if( _impl->capacity != capacity )
+  {
+    wlog( "Performance trace buffer already allocated for ${c} spans, requested size ${r} ignored",
+      ( "c", _impl->capacity )( "r", capacity ) );
+  }
+
+  _impl->ring_enabled.store( true, std::memory_order_release );
+  update_enabled();
+}
+
+void performance_trace::disable()
+{
+  _impl->ring_enabled.store( false, std::memory_order_relaxed );
+  update_enabled();
+}
+
+void performance_trace::enable_totals( bool enable )
+{
+  _impl->totals_enabled.store( enable, std::memory_order_relaxed );
+  update_enabled();
+}
+
+performance_trace::totals_t performance_trace::get_totals() const
+{
+  std::lock_guard< std::mutex > guard( _impl->totals_mutex );
+  return _impl->totals;
+}
+
+void performance_trace::reset_totals()
+{
+  std::lock_guard< std::mutex > guard( _impl->totals_mutex );
+  _impl->totals.clear();
+}
+
+void performance_trace::update_enabled()
+{
+  _enabled.store( _impl->ring_enabled.load( std::memory_order_relaxed ) || _impl->totals_enabled.load( std::memory_order_relaxed ),
+    std::memory_order_release );
+}
+
+void performance_trace::record( const char* category, const char* name, int64_t begin, int64_t end, int64_t arg ) noexcept
+{
+  if( !is_enabled() )
+    return;
+
+  if( _impl->totals_enabled.load( std::memory_order_relaxed ) )
+  {
+    try
+    {
+      std::lock_guard< std::mutex > guard( _impl->totals_mutex );
+      span_total& total = _impl->totals[ std::make_pair( std::string( category ), std::string( name ) ) ];
+      ++total.count;
+      total.time += end - begin;
+    }
+    catch( ... ) {} // allocation failure only loses the measurement
+  }
+
+  if( !_impl->ring_enabled.load( std::memory_order_acquire ) )
+    return;
+
+  const uint64_t n = _impl->next.fetch_add( 1, std::memory_order_relaxed );
+  span& s = _impl->spans[ n % _impl->capacity ];
+
+  s.sequence.store( 2 * n + 1, std::memory_order_relaxed );
+  std::atomic_thread_fence( std::memory_order_release );
+  s.begin = begin;
+  s.duration = end - begin;
+  s.arg = arg;
+  s.thread_id = current_thread_id();
+  copy_truncated( s.category, category );
+  copy_truncated( s.name, name );
+  s.sequence.store( 2 * n + 2, std::memory_order_release );
+}
+
+void performance_trace::set_thread_name( const std::string& name )
+{
+  std::lock_guard< std::mutex > guard( _impl->thread_names_mutex );
+  _impl->thread_names[ current_thread_id() ] = name;
+}
+
+uint32_t performance_trace::dump( const fc::path& file ) const
+{
+  struct span_copy
+  {
+    int64_t     begin;
+    int64_t     duration;
+    int64_t     arg;
+    uint32_t    thread_id;
+    std::string category;
+    std::string name;
+  };
+
+  std::vector< span_copy > spans;
+  spans.reserve( _impl->capacity );
+  for( uint32_t i = 0; i < _impl->capacity; ++i )
+  {
+    const span& s = _impl->spans[i];
+    const uint64_t seq = s.sequence.load( std::memory_order_acquire );
+    if( seq == 0 || ( seq & 1 ) )
+      continue;
+    span_copy c{ s.begin, s.duration, s.arg, s.thread_id, std::string( s.category ), std::string( s.name ) };
+    std::atomic_thread_fence( std::memory_order_acquire );
+    if( s.sequence.load( std::memory_order_relaxed ) != seq )
+      continue; // overwritten while copying
+    spans.emplace_back( std::move( c ) );
+  }
+
+  std::sort( spans.begin(), spans.end(), []( const span_copy& a, const span_copy& b ) { return a.begin < b.begin; } );
+
+  std::ofstream out( file.string(), std::ios::out | std::ios::trunc );
+  FC_ASSERT( out, "Cannot open performance trace file ${f}", ( "f", file ) );
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  auto separator = [&]() -> std::ostream&
+  {
+    if( !first )
+      out << ",\n";
+    first = false;
+    return out;
+  };
+
+  {
+    std::lock_guard< std::mutex > guard( _impl->thread_names_mutex );
+    for( const auto& tn : _impl->thread_names )
+    {
+      separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tn.first
+        << ",\"args\":{\"name\":" << fc::json::to_string( tn.second ) << "}}";
+    }
+  }
+
+  for( const auto& s : spans )
+  {
+    separator() << "{\"name\":" << fc::json::to_string( s.name ) << ",\"cat\":" << fc::json::to_string( s.category )
+      << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << s.thread_id << ",\"ts\":" << s.begin << ",\"dur\":" << s.duration;
+    if( s.arg >= 0 )
+      out << ",\"args\":{\"n\":" << s.arg << "}";
+    out << "}";
+  }
+  out << "]}\n";
+
+  return spans.size();
+}
+
+} } // hive::utilities
@@ -1,6 +1,7 @@
 #include <fc/log/logger.hpp>
 #include <fc/crypto/hex.hpp>
 #include <fc/filesystem.hpp>
+#include <fc/io/fstream.hpp>
 #include <hive/chain/block_log.hpp>
 #include <hive/chain/block_compression_dictionaries.hpp>
 
@@ -30,6 +31,8 @@ struct block_to_compress
   uint32_t block_number;
   size_t uncompressed_block_size = 0;
   std::unique_ptr<char[]> uncompressed_block_data;
+  // set for blocks outside of the recompressed segment, they are copied as they are
+  fc::optional<hive::chain::block_log::block_attributes_t> original_attributes;
 };
 
 struct compressed_block
@@ -49,6 +52,9 @@ uint32_t starting_block_number = 1;
 fc::optional<uint32_t> blocks_to_compress;
 fc::optional<fc::path> raw_block_output_path;
 bool benchmark_decompression = false;
+fc::optional<uint8_t> dictionary_to_use;
+fc::optional<uint32_t> segment_start;
+fc::optional<uint32_t> segment_end;
 
 std::mutex queue_mutex;
 std::condition_variable queue_condition_variable;
@@ -100,6 +106,24 @@ void compress_blocks()
 
     dlog("compression worker beginning work on block ${block_number}", ("block_number", uncompressed->block_number));
 
+    if (uncompressed->original_attributes)
+    {
+      // outside of the recompressed segment, keep the block as it was stored
+      compressed->attributes = *uncompressed->original_attributes;
+      compressed->compressed_block_size = uncompressed->uncompressed_block_size;
+      compressed->compressed_block_data = std::move(uncompressed->uncompressed_block_data);
+      {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        ++total_count_by_method[compressed->attributes.flags];
+        total_compressed_size += compressed->compressed_block_size;
+        total_uncompressed_size += compressed->compressed_block_size;
+        size_of_start_positions += sizeof(uint64_t);
+      }
+      delete uncompressed;
+      compressed->compression_complete_promise.set_value();
+      continue;
+    }
+
     // we'll compress using every available method, then choose the best
     struct compressed_data
     {
@@ -110,7 +134,7 @@ void compress_blocks()
     };
     std::vector<compressed_data> compressed_versions;
 
-    fc::optional<uint8_t> dictionary_number_to_use = hive::chain::get_best_available_zstd_compression_dictionary_number_for_block(uncompressed->block_number);
+    fc::optional<uint8_t> dictionary_number_to_use = dictionary_to_use ? dictionary_to_use : hive::chain::get_best_available_zstd_compression_dictionary_number_for_block(uncompressed->block_number);
 
     // zstd
     if (enable_zstd)
@@ -306,6 +330,11 @@ void fill_pending_queue(const fc::path& block_log)
       uncompressed_block->block_number = current_block_number;
 
       std::tuple<std::unique_ptr<char[]>, size_t, hive::chain::block_log::block_attributes_t> raw_compressed_block_data = current_block_number == head_block_num ? log.read_raw_head_block() : log.read_raw_block_data_by_num(current_block_number);
+      if ((segment_start && current_block_number < *segment_start) || (segment_end && current_block_number > *segment_end))
+      {
+        uncompressed_block->original_attributes = std::get<2>(raw_compressed_block_data);
+        raw_compressed_block_data = std::make_tuple(std::get<0>(std::move(raw_compressed_block_data)), std::get<1>(raw_compressed_block_data), hive::chain::block_log::block_attributes_t());
+      }
       std::tuple<std::unique_ptr<char[]>, size_t> raw_block_data = hive::chain::block_log::decompress_raw_block(std::move(raw_compressed_block_data));
 
       uncompressed_block->uncompressed_block_size = std::get<1>(raw_block_data);
@@ -344,6 +373,64 @@ void fill_pending_queue(const fc::path& block_log)
   FC_LOG_AND_RETHROW()
 }
 
+// trains a zstd dictionary on blocks from the given range of the block log (the same blocks the compression
+// would process), sampling evenly when there are more blocks than max_samples
+void train_dictionary(const fc::path& block_log, const fc::path& dictionary_file, size_t dictionary_size, uint32_t max_samples, unsigned jobs)
+{
+  try
+  {
+    hive::chain::block_log log;
+    log.open(block_log, true);
+    if (!log.head())
+    {
+      elog("Error: input block log is empty");
+      exit(1);
+    }
+    uint32_t head_block_num = log.head()->block_num();
+    uint32_t stop_at_block = blocks_to_compress ? std::min(starting_block_number + *blocks_to_compress - 1, head_block_num) : head_block_num;
+    uint32_t block_count = stop_at_block - starting_block_number + 1;
+    uint32_t sample_step = std::max<uint32_t>(1, block_count / max_samples);
+    ilog("Training dictionary of ${dictionary_size} bytes on every ${sample_step}. block from ${starting_block_number} to ${stop_at_block}",
+         (dictionary_size)(sample_step)(starting_block_number)(stop_at_block));
+
+    std::vector<char> samples;
+    std::vector<size_t> sample_sizes;
+    for (uint32_t block_number = starting_block_number; block_number <= stop_at_block; block_number += sample_step)
+    {
+      std::tuple<std::unique_ptr<char[]>, size_t> raw_block_data = hive::chain::block_log::decompress_raw_block(
+        block_number == head_block_num ? log.read_raw_head_block() : log.read_raw_block_data_by_num(block_number));
+      samples.insert(samples.end(), std::get<0>(raw_block_data).get(), std::get<0>(raw_block_data).get() + std::get<1>(raw_block_data));
+      sample_sizes.push_back(std::get<1>(raw_block_data));
+    }
+    log.close();
+
+    fc::time_point before = fc::time_point::now();
+    std::string dictionary;
+    try
+    {
+      dictionary = hive::chain::train_zstd_compression_dictionary(samples, sample_sizes, dictionary_size, zstd_level.value_or(ZSTD_CLEVEL_DEFAULT), jobs);
+    }
+    catch (const fc::exception& e)
+    {
+      elog("${error}", ("error", e.to_string()));
+      exit(1);
+    }
+    size_t trained_size = dictionary.size();
+
+    std::ofstream dictionary_stream(dictionary_file.generic_string(), std::ios::binary | std::ios::trunc);
+    dictionary_stream.write(dictionary.data(), trained_size);
+    FC_ASSERT(dictionary_stream.good(), "Error writing dictionary to ${dictionary_file}", (dictionary_file));
+    ilog("Trained ${trained_size} byte dictionary on ${count} blocks (${total} bytes) in ${time}ms, saved to ${dictionary_file}",
+         (trained_size)("count", sample_sizes.size())("total", samples.size())("time", (fc::time_point::now() - before).count() / 1000)(dictionary_file));
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+void load_dictionary(const std::string& entry)
+{
+  hive::chain::register_zstd_compression_dictionary_from_file(entry);
+}
+
 int main(int argc, char** argv)
 {
   try
@@ -359,11 +446,18 @@ int main(int argc, char** argv)
     options.add_options()("zstd-level", boost::program_options::value<int>()->default_value(15), zstd_levels_description.c_str());
     options.add_options()("benchmark-decompression", "decompress each block and report the decompression times at the end");
     options.add_options()("jobs,j", boost::program_options::value<int>()->default_value(1), "The number of threads to use for compression");
-    options.add_options()("input-block-log,i", boost::program_options::value<std::string>()->required(), "The directory containing the input block log");
+    options.add_options()("input-block-log,i", boost::program_options::value<std::string>(), "The directory containing the input block log");
     options.add_options()("output-block-log,o", boost::program_options::value<std::string>()->required(), "The directory to contain the compressed block log");
     options.add_options()("dump-raw-blocks", boost::program_options::value<std::string>(), "A directory in which to dump raw, uncompressed blocks (one block per file)");
     options.add_options()("starting-block-number,s", boost::program_options::value<uint32_t>()->default_value(1), "Start at the given block number (for benchmarking only, values > 1 will generate an unusable block log)");
     options.add_options()("block-count,n", boost::program_options::value<uint32_t>(), "Stop after this many blocks");
+    options.add_options()("dictionary", boost::program_options::value<std::vector<std::string>>()->composing(), "NUMBER:FILE of an additional dictionary, needed to read blocks compressed with it or to compress with it (see --use-dictionary)");
+    options.add_options()("train-dictionary", boost::program_options::value<std::string>(), "Instead of compressing, train a dictionary on blocks selected by --starting-block-number and --block-count and save it to the given file");
+    options.add_options()("dictionary-size", boost::program_options::value<uint32_t>()->default_value(220 * 1024), "Size of the trained dictionary");
+    options.add_options()("max-samples", boost::program_options::value<uint32_t>()->default_value(100000), "Maximum number of blocks used for training; blocks are sampled evenly from the range");
+    options.add_options()("use-dictionary", boost::program_options::value<uint32_t>(), "Compress blocks with this additional dictionary instead of the built-in one for their block number");
+    options.add_options()("segment-start", boost::program_options::value<uint32_t>(), "Recompress only blocks starting at this number, earlier blocks are copied unchanged");
+    options.add_options()("segment-end", boost::program_options::value<uint32_t>(), "Recompress only blocks up to this number, later blocks are copied unchanged");
     options.add_options()("help,h", "Print usage instructions");
 
     boost::program_options::positional_options_description positional_options;
@@ -392,6 +486,32 @@ int main(int argc, char** argv)
       return 0;
     }
 
+    if (options_map.count("dictionary"))
+      for (const std::string& entry : options_map["dictionary"].as<std::vector<std::string>>())
+        load_dictionary(entry);
+    if (options_map.count("use-dictionary"))
+    {
+      dictionary_to_use = options_map["use-dictionary"].as<uint32_t>();
+      // make sure it's available before the worker threads need it
+      hive::chain::get_zstd_compression_dictionary(*dictionary_to_use, *zstd_level);
+    }
+    if (options_map.count("segment-start"))
+      segment_start = options_map["segment-start"].as<uint32_t>();
+    if (options_map.count("segment-end"))
+      segment_end = options_map["segment-end"].as<uint32_t>();
+
+    if (options_map.count("train-dictionary"))
+    {
+      if (!options_map.count("input-block-log"))
+      {
+        std::cerr << "Error: missing parameter for input-block-log\n";
+        return 1;
+      }
+      train_dictionary(fc::path(options_map["input-block-log"].as<std::string>()) / "block_log", options_map["train-dictionary"].as<std::string>(),
+                       options_map["dictionary-size"].as<uint32_t>(), options_map["max-samples"].as<uint32_t>(), jobs);
+      return 0;
+    }
+
     if (!options_map.count("input-block-log") || !options_map.count("output-block-log"))
     {
       std::cerr << "Error: missing parameter for input-block-log or output-block-log\n";
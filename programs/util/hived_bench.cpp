@@ -0,0 +1,425 @@
+#include <hive/chain/database.hpp>
+#include <hive/chain/hardfork_property_object.hpp>
+
+#include <hive/utilities/git_revision.hpp>
+#include <hive/utilities/performance_trace.hpp>
+#include <hive/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/string.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+  Deterministic replay benchmark. Replays blocks from existing block_log into fresh state (no plugins)
+  and measures selected block ranges; blocks before (and between) measured ranges are replayed without
+  measurements. Result is written as JSON and optionally compared with previous result (baseline).
+*/
+
+namespace {
+
+// every heap allocation of the process is counted (shared memory allocations are measured separately)
+std::atomic< uint64_t > heap_allocations{ 0 };
+std::atomic< uint64_t > heap_allocated_bytes{ 0 };
+
+} // anonymous
+
+void* operator new( std::size_t size )
+{
+  heap_allocations.fetch_add( 1, std::memory_order_relaxed );
+  heap_allocated_bytes.fetch_add( size, std::memory_order_relaxed );
+  if( void* ptr = std::malloc( size ? size : 1 ) )
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  std::free( ptr );
+}
+
+void operator delete( void* ptr, std::size_t ) noexcept
+{
+  std::free( ptr );
+}
+
+struct bench_item
+{
+  std::string context;
+  std::string name;
+  uint64_t    count = 0;
+  uint64_t    time_us = 0;
+};
+
+struct range_report
+{
+  uint32_t    first_block = 0;
+  uint32_t    last_block = 0;
+  uint32_t    hardfork = 0; // last hardfork applied at the end of range
+  uint64_t    blocks = 0;
+  int64_t     real_ms = 0;
+  int64_t     cpu_ms = 0;
+  double      blocks_per_second = 0;
+  uint64_t    heap_allocations = 0;
+  uint64_t    heap_allocated_bytes = 0;
+  int64_t     shared_memory_used = 0; // change of used shared memory during range
+  uint64_t    peak_rss_kb = 0; // peak resident set of the process so far
+
+  std::vector< bench_item > stages; // spans of block processing, in particular process_* calls
+  std::vector< bench_item > operations; // evaluator time per operation type
+  std::vector< bench_item > details; // remaining measurements of --advanced-benchmark
+};
+
+struct regression
+{
+  std::string range;
+  std::string metric;
+  double      baseline = 0;
+  double      current = 0;
+  double      change_percent = 0;
+};
+
+struct bench_report
+{
+  std::string                 hive_git_revision;
+  std::string                 block_log;
+  std::vector< range_report > ranges;
+  std::vector< regression >   regressions;
+};
+
+FC_REFLECT( bench_item, (context)(name)(count)(time_us) )
+FC_REFLECT( range_report, (first_block)(last_block)(hardfork)(blocks)(real_ms)(cpu_ms)(blocks_per_second)
+  (heap_allocations)(heap_allocated_bytes)(shared_memory_used)(peak_rss_kb)(stages)(operations)(details) )
+FC_REFLECT( regression, (range)(metric)(baseline)(current)(change_percent) )
+FC_REFLECT( bench_report, (hive_git_revision)(block_log)(ranges)(regressions) )
+
+namespace {
+
+struct block_range
+{
+  uint32_t first = 0;
+  uint32_t last = 0;
+};
+
+block_range parse_range( const std::string& text )
+{
+  std::vector< std::string > parts;
+  boost::split( parts, text, boost::is_any_of( "-:" ) );
+  FC_ASSERT( parts.size() == 2, "Block range has to be given as FIRST-LAST, got ${t}", ( "t", text ) );
+  block_range result{ uint32_t( std::stoul( parts[0] ) ), uint32_t( std::stoul( parts[1] ) ) };
+  FC_ASSERT( result.first > 0 && result.first <= result.last, "Invalid block range ${t}", ( "t", text ) );
+  return result;
+}
+
+std::string range_name( uint32_t first, uint32_t last )
+{
+  return std::to_string( first ) + "-" + std::to_string( last );
+}
+
+int64_t cpu_time_ms()
+{
+  rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+  return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000 +
+    ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1000;
+}
+
+uint64_t peak_rss_kb()
+{
+  rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+  return usage.ru_maxrss;
+}
+
+class replay_bench
+{
+  public:
+    replay_bench( const hive::chain::open_args& args, bool operation_times )
+      : _args( args ), _operation_times( operation_times ) {}
+
+    void open()
+    {
+      _db.set_flush_interval( 0 );
+      // measurements are read directly; periodic dumps to working directory would also add file writes to measured time
+      _db.get_benchmark_dumper().set_dump_to_file( false );
+      // every run replays from genesis - only state files are removed, not the rest of the directory
+      _db.wipe( _args.data_dir, _args.shared_mem_dir, false );
+      _db.open( _args );
+    }
+
+    void close()
+    {
+      _db.close();
+    }
+
+    uint32_t block_log_head() const
+    {
+      uint64_t head = 0;
+      _db.is_reindex_complete( &head, nullptr );
+      return head;
+    }
+
+    range_report run( const block_range& range )
+    {
+      FC_ASSERT( _db.head_block_num() < range.first, "Block ranges have to be sorted and cannot overlap" );
+
+      if( _db.head_block_num() + 1 < range.first )
+      {
+        ilog( "Replaying blocks up to ${b} without measurements", ( "b", range.first - 1 ) );
+        replay_to( range.first - 1 );
+      }
+
+      auto& trace = hive::utilities::performance_trace::instance();
+      auto& dumper = _db.get_benchmark_dumper();
+
+      ilog( "Measuring blocks ${f}-${l}", ( "f", range.first )( "l", range.last ) );
+      trace.reset_totals();
+      trace.enable_totals( true );
+      dumper.reset();
+      dumper.set_enabled( _operation_times );
+
+      const uint64_t allocations_begin = heap_allocations.load( std::memory_order_relaxed );
+      const uint64_t allocated_bytes_begin = heap_allocated_bytes.load( std::memory_order_relaxed );
+      const int64_t free_memory_begin = _db.get_free_memory();
+      const int64_t cpu_begin = cpu_time_ms();
+      const fc::time_point real_begin = fc::time_point::now();
+
+      const uint32_t last_applied = replay_to( range.last );
+
+      range_report report;
+      report.real_ms = ( fc::time_point::now() - real_begin ).count() / 1000;
+      report.cpu_ms = cpu_time_ms() - cpu_begin;
+      report.heap_allocations = heap_allocations.load( std::memory_order_relaxed ) - allocations_begin;
+      report.heap_allocated_bytes = heap_allocated_bytes.load( std::memory_order_relaxed ) - allocated_bytes_begin;
+      report.shared_memory_used = free_memory_begin - int64_t( _db.get_free_memory() );
+      report.peak_rss_kb = peak_rss_kb();
+
+      trace.enable_totals( false );
+      dumper.set_enabled( false );
+
+      FC_ASSERT( last_applied == range.last, "Replay stopped at block ${b} instead of ${l}", ( "b", last_applied )( "l", range.last ) );
+
+      report.first_block = range.first;
+      report.last_block = range.last;
+      report.hardfork = _db.get_hardfork_property_object().last_hardfork;
+      report.blocks = range.last - range.first + 1;
+      report.blocks_per_second = report.real_ms > 0 ? report.blocks * 1000.0 / report.real_ms : 0;
+
+      for( const auto& total : trace.get_totals() )
+        report.stages.push_back( bench_item{ total.first.first, total.first.second, total.second.count, uint64_t( total.second.time ) } );
+
+      for( const auto& item : dumper.get_info().items )
+      {
+        bench_item converted{ item.context, item.op_name, item.count, item.time / 1000 };
+        if( item.context.empty() )
+          report.operations.push_back( converted );
+        else
+          report.details.push_back( converted );
+      }
+
+      auto by_time = []( const bench_item& a, const bench_item& b ) { return a.time_us > b.time_us; };
+      std::sort( report.stages.begin(), report.stages.end(), by_time );
+      std::sort( report.operations.begin(), report.operations.end(), by_time );
+      std::sort( report.details.begin(), report.details.end(), by_time );
+
+      ilog( "Blocks ${f}-${l}: ${bps} blocks/s, ${rt} ms (real), ${ct} ms (cpu), ${a} heap allocations, peak RSS ${rss} kB",
+        ( "f", range.first )( "l", range.last )( "bps", report.blocks_per_second )( "rt", report.real_ms )
+        ( "ct", report.cpu_ms )( "a", report.heap_allocations )( "rss", report.peak_rss_kb ) );
+      return report;
+    }
+
+  private:
+    uint32_t replay_to( uint32_t block_num )
+    {
+      _args.stop_replay_at = block_num;
+      _args.force_replay = false; // first call replays from genesis anyway, since state is fresh
+      return _db.reindex( _args );
+    }
+
+    hive::chain::database  _db;
+    hive::chain::open_args _args;
+    bool                   _operation_times = true;
+};
+
+/// Items that take at least given share of the range real time, keyed by context and name
+std::map< std::string, const bench_item* > significant_items( const std::vector< bench_item >& items, const range_report& range, double min_share )
+{
+  std::map< std::string, const bench_item* > result;
+  for( const auto& item : items )
+  {
+    if( item.time_us >= range.real_ms * 1000 * min_share / 100 )
+      result.emplace( item.context + "/" + item.name, &item );
+  }
+  return result;
+}
+
+void compare_with_baseline( bench_report& report, const bench_report& baseline, double max_regression, double min_share )
+{
+  auto check = [&]( const std::string& range, const std::string& metric, double base, double current, bool higher_is_better )
+  {
+    if( base <= 0 )
+      return;
+    double change = ( current - base ) * 100 / base;
+    if( higher_is_better ? ( -change > max_regression ) : ( change > max_regression ) )
+      report.regressions.push_back( regression{ range, metric, base, current, change } );
+  };
+
+  auto per_block = []( const bench_item& item, const range_report& range ) { return double( item.time_us ) / range.blocks; };
+  auto per_count = []( const bench_item& item ) { return item.count ? double( item.time_us ) / item.count : 0.0; };
+
+  for( const auto& current : report.ranges )
+  {
+    auto base_itr = std::find_if( baseline.ranges.begin(), baseline.ranges.end(), [&]( const range_report& r )
+      { return r.first_block == current.first_block && r.last_block == current.last_block; } );
+    const std::string name = range_name( current.first_block, current.last_block );
+    if( base_itr == baseline.ranges.end() )
+    {
+      wlog( "Range ${r} is missing in baseline", ( "r", name ) );
+      continue;
+    }
+    const range_report& base = *base_itr;
+
+    check( name, "blocks_per_second", base.blocks_per_second, current.blocks_per_second, true );
+    check( name, "heap_allocations_per_block", double( base.heap_allocations ) / base.blocks,
+      double( current.heap_allocations ) / current.blocks, false );
+    check( name, "peak_rss_kb", base.peak_rss_kb, current.peak_rss_kb, false );
+
+    const auto current_stages = significant_items( current.stages, current, 0 );
+    for( const auto& base_stage : significant_items( base.stages, base, min_share ) )
+    {
+      auto itr = current_stages.find( base_stage.first );
+      if( itr != current_stages.end() )
+        check( name, "stage_us_per_block:" + base_stage.first, per_block( *base_stage.second, base ), per_block( *itr->second, current ), false );
+    }
+
+    const auto current_operations = significant_items( current.operations, current, 0 );
+    for( const auto& base_op : significant_items( base.operations, base, min_share ) )
+    {
+      auto itr = current_operations.find( base_op.first );
+      if( itr != current_operations.end() )
+        check( name, "operation_us:" + base_op.second->name, per_count( *base_op.second ), per_count( *itr->second ), false );
+    }
+  }
+}
+
+} // anonymous
+
+int main( int argc, char** argv )
+{
+  try
+  {
+    namespace po = boost::program_options;
+
+    po::options_description options( "Allowed options" );
+    options.add_options()
+      ( "block-log-dir,i", po::value< std::string >()->required(), "The directory containing block_log (it is only read)" )
+      ( "range,r", po::value< std::vector< std::string > >()->composing(), "FIRST-LAST block range to measure, can be given multiple times (e.g. once per hardfork era); blocks outside of ranges are replayed without measurements. Default: all blocks up to --stop-at" )
+      ( "stop-at,s", po::value< uint32_t >()->default_value( 0 ), "Last block to replay when no --range is given (0 - block_log head)" )
+      ( "shared-file-dir", po::value< std::string >(), "Directory for the state (state file there is removed before start, other files are left alone). Default: temporary directory" )
+      ( "shared-file-size", po::value< std::string >()->default_value( "24G" ), "Size of the state file" )
+      ( "validate-during-replay", po::bool_switch()->default_value( false ), "Check signatures and authorities of replayed transactions" )
+      ( "no-operation-times", po::bool_switch()->default_value( false ), "Do not measure evaluator time per operation (removes its overhead from blocks/s)" )
+      ( "output,o", po::value< std::string >(), "File to write JSON report to. Default: standard output" )
+      ( "baseline,b", po::value< std::string >(), "JSON report of previous run to compare with" )
+      ( "max-regression", po::value< double >()->default_value( 10 ), "Allowed slowdown in percent before metric is reported as regression" )
+      ( "min-share", po::value< double >()->default_value( 1 ), "Stages and operations below this percent of range time are not compared with baseline" )
+      ( "help,h", "Print usage instructions" );
+
+    po::variables_map options_map;
+    po::store( po::parse_command_line( argc, argv, options ), options_map );
+
+    if( options_map.count( "help" ) )
+    {
+      std::cout << options << "\n";
+      return 0;
+    }
+    po::notify( options_map );
+
+    fc::optional< fc::temp_directory > temp_state_dir;
+    fc::path state_dir;
+    if( options_map.count( "shared-file-dir" ) )
+    {
+      state_dir = fc::path( options_map[ "shared-file-dir" ].as< std::string >() );
+      fc::create_directories( state_dir );
+    }
+    else
+    {
+      fc::create_directories( hive::utilities::temp_directory_path() );
+      temp_state_dir = fc::temp_directory( hive::utilities::temp_directory_path() );
+      state_dir = temp_state_dir->path();
+    }
+
+    hive::chain::open_args args;
+    args.data_dir = fc::path( options_map[ "block-log-dir" ].as< std::string >() );
+    args.shared_mem_dir = state_dir;
+    args.shared_file_size = fc::parse_size( options_map[ "shared-file-size" ].as< std::string >() );
+    args.validate_during_replay = options_map[ "validate-during-replay" ].as< bool >();
+    args.force_replay = true;
+
+    FC_ASSERT( fc::exists( args.data_dir / "block_log" ), "There is no block_log in ${d}", ( "d", args.data_dir ) );
+
+    replay_bench bench( args, !options_map[ "no-operation-times" ].as< bool >() );
+    bench.open();
+
+    std::vector< block_range > ranges;
+    if( options_map.count( "range" ) )
+    {
+      for( const auto& text : options_map[ "range" ].as< std::vector< std::string > >() )
+        ranges.push_back( parse_range( text ) );
+      std::sort( ranges.begin(), ranges.end(), []( const block_range& a, const block_range& b ) { return a.first < b.first; } );
+    }
+    else
+    {
+      uint32_t stop_at = options_map[ "stop-at" ].as< uint32_t >();
+      ranges.push_back( block_range{ 1, stop_at ? stop_at : bench.block_log_head() } );
+    }
+    FC_ASSERT( ranges.back().last <= bench.block_log_head(), "block_log ends at block ${h}, cannot measure up to ${l}",
+      ( "h", bench.block_log_head() )( "l", ranges.back().last ) );
+
+    bench_report report;
+    report.hive_git_revision = hive::utilities::git_revision_sha;
+    report.block_log = ( args.data_dir / "block_log" ).generic_string();
+    for( const auto& range : ranges )
+      report.ranges.push_back( bench.run( range ) );
+
+    bench.close();
+
+    if( options_map.count( "baseline" ) )
+    {
+      const auto baseline = fc::json::from_file( options_map[ "baseline" ].as< std::string >() ).as< bench_report >();
+      compare_with_baseline( report, baseline, options_map[ "max-regression" ].as< double >(), options_map[ "min-share" ].as< double >() );
+      for( const auto& r : report.regressions )
+        elog( "Regression in ${r}: ${m} ${b} -> ${c} (${p}%)",
+          ( "r", r.range )( "m", r.metric )( "b", r.baseline )( "c", r.current )( "p", r.change_percent ) );
+    }
+
+    if( options_map.count( "output" ) )
+      fc::json::save_to_file( report, fc::path( options_map[ "output" ].as< std::string >() ) );
+    else
+      std::cout << fc::json::to_pretty_string( report ) << "\n";
+
+    return report.regressions.empty() ? 0 : 2;
+  }
+  catch( const fc::exception& e )
+  {
+    std::cerr << e.to_detail_string() << "\n";
+  }
+  catch( const std::exception& e )
+  {
+    std::cerr << e.what() << "\n";
+  }
+  return 1;
+}
@@ -194,6 +194,46 @@ BOOST_AUTO_TEST_CASE( delegate_rc_operation_apply_single )
   FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( delegate_rc_operation_json_too_deep )
+{
+  try
+  {
+    BOOST_TEST_MESSAGE( "Testing:  custom_json rejected by depth check of legacy parser is not applied" );
+    ACTORS( (alice)(bob) )
+    vest( HIVE_INIT_MINER_NAME, "alice", ASSET( "10.000 TESTS" ) );
+    generate_block();
+
+    custom_json_operation custom_op;
+    custom_op.required_posting_auths.insert( "alice" );
+    custom_op.id = HIVE_RC_PLUGIN_NAME;
+    const string prefix = "[\"delegate_rc\",{\"from\":\"alice\",\"delegatees\":[\"bob\"],\"max_rc\":10,\"extra\":";
+
+    // brackets inside string count for the legacy check
+    custom_op.json = prefix + "\"" + string( 120, '[' ) + "\"}]";
+    BOOST_CHECK_THROW( fc::json::from_string( custom_op.json ), fc::exception );
+    BOOST_CHECK_THROW( push_transaction( custom_op, alice_private_key ), fc::exception );
+
+    // deeply nested value under key that is not part of the operation
+    custom_op.json = prefix + string( 150, '[' ) + string( 150, ']' ) + "}]";
+    BOOST_CHECK_THROW( fc::json::from_string( custom_op.json ), fc::exception );
+    BOOST_CHECK_THROW( push_transaction( custom_op, alice_private_key ), fc::exception );
+
+    generate_block();
+    const rc_direct_delegation_object* delegation = db->find< rc_direct_delegation_object, by_from_to >( boost::make_tuple( alice_id, bob_id ) );
+    BOOST_REQUIRE( delegation == nullptr );
+
+    // the same operation within depth limit is accepted
+    custom_op.json = prefix + string( 10, '[' ) + string( 10, ']' ) + "}]";
+    push_transaction( custom_op, alice_private_key );
+    generate_block();
+    delegation = db->find< rc_direct_delegation_object, by_from_to >( boost::make_tuple( alice_id, bob_id ) );
+    BOOST_REQUIRE( delegation != nullptr );
+
+    validate_database();
+  }
+  FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( delegate_rc_operation_apply_many )
 {
   try
@@ -0,0 +1,226 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+
+#include <hive/chain/account_object.hpp>
+#include <hive/chain/comment_object.hpp>
+#include <hive/protocol/hive_operations.hpp>
+
+#include <hive/plugins/follow/follow_plugin.hpp>
+#include <hive/plugins/follow/follow_objects.hpp>
+#include <hive/plugins/follow/follow_operations.hpp>
+#include <hive/plugins/follow_api/follow_api_plugin.hpp>
+#include <hive/plugins/follow_api/follow_api.hpp>
+
+#include "../db_fixture/database_fixture.hpp"
+
+using namespace hive::chain;
+using namespace hive::protocol;
+using namespace hive::plugins::follow;
+
+struct follow_database_fixture : public database_fixture
+{
+  /// Starts node with follow plugin, extra_args are added to command line
+  void init( const std::vector< std::string >& extra_args )
+  {
+    auto _data_dir = common_init( [&]( appbase::application& app, int argc, char** argv )
+    {
+      std::vector< char* > args( argv, argv + argc );
+      for( const auto& arg : extra_args )
+        args.push_back( const_cast< char* >( arg.c_str() ) );
+      args.push_back( nullptr );
+
+      app.register_plugin< follow_plugin >();
+      app.register_plugin< follow_api_plugin >();
+      db_plugin = &app.register_plugin< hive::plugins::debug_node::debug_node_plugin >();
+
+      db_plugin->logging = false;
+      app.initialize<
+        follow_api_plugin,
+        hive::plugins::debug_node::debug_node_plugin
+      >( args.size() - 1, args.data() );
+
+      db = &app.get_plugin< hive::plugins::chain::chain_plugin >().db();
+      BOOST_REQUIRE( db );
+
+      api = app.get_plugin< follow_api_plugin >().api.get();
+      BOOST_REQUIRE( api );
+    } );
+
+    init_account_pub_key = init_account_priv_key.get_public_key();
+
+    open_database( _data_dir );
+
+    generate_block();
+    db->set_hardfork( HIVE_NUM_HARDFORKS );
+    generate_block();
+
+    vest( "initminer", 10000 );
+    validate_database();
+  }
+
+  void push_follow_operation( const follow_plugin_operation& op, const std::string& account, const fc::ecc::private_key& key )
+  {
+    custom_json_operation custom_op;
+    custom_op.required_posting_auths.insert( account );
+    custom_op.id = HIVE_FOLLOW_PLUGIN_NAME;
+    custom_op.json = fc::json::to_string( op );
+    push_transaction( custom_op, key );
+  }
+
+  void follow( const std::string& follower, const std::string& following, const fc::ecc::private_key& key )
+  {
+    follow_operation op;
+    op.follower = follower;
+    op.following = following;
+    op.what = { "blog" };
+    push_follow_operation( op, follower, key );
+  }
+
+  void reblog( const std::string& account, const std::string& author, const std::string& permlink, const fc::ecc::private_key& key )
+  {
+    reblog_operation op;
+    op.account = account;
+    op.author = author;
+    op.permlink = permlink;
+    push_follow_operation( op, account, key );
+  }
+
+  size_t count_feeds( const std::string& account )
+  {
+    const auto& idx = db->get_index< feed_index >().indices().get< by_feed >();
+    size_t count = 0;
+    for( auto itr = idx.lower_bound( account ); itr != idx.end() && itr->account == account; ++itr )
+      ++count;
+    return count;
+  }
+
+  size_t count_blogs( const std::string& account )
+  {
+    const auto& idx = db->get_index< blog_index >().indices().get< by_blog >();
+    size_t count = 0;
+    for( auto itr = idx.lower_bound( account ); itr != idx.end() && itr->account == account; ++itr )
+      ++count;
+    return count;
+  }
+
+  std::vector< api_feed_entry > get_feed( const std::string& account, uint32_t limit )
+  {
+    return api->get_feed( { account, limit } ).feed;
+  }
+
+  /**
+    * bob follows alice and sam; alice posts lorem, carol (not followed) posts ipsum, sam reblogs both
+    * and posts dolor - bob's feed is dolor, ipsum (reblogged by sam) and lorem (posted by alice, reblogged by sam)
+    */
+  void post_and_reblog()
+  {
+    ACTORS( (alice)(bob)(carol)(sam) );
+    generate_block();
+
+    follow( "bob", "alice", bob_private_key );
+    follow( "bob", "sam", bob_private_key );
+    generate_block();
+
+    post_comment( "alice", "lorem", "title", "body", "test", alice_private_key );
+    post_comment( "carol", "ipsum", "title", "body", "test", carol_private_key );
+    generate_block();
+    reblog( "sam", "alice", "lorem", sam_private_key );
+    generate_block();
+    ipsum_reblogged_on = db->head_block_time();
+    reblog( "sam", "carol", "ipsum", sam_private_key );
+    generate_block();
+    post_comment( "sam", "dolor", "title", "body", "test", sam_private_key );
+    generate_block();
+
+    BOOST_REQUIRE_EQUAL( count_blogs( "alice" ), 1u );
+    BOOST_REQUIRE_EQUAL( count_blogs( "sam" ), 3u );
+    BOOST_REQUIRE_EQUAL( db->get_index< follow_index >().indices().size(), 2u );
+    validate_database();
+  }
+
+  /// checks feed of bob made by post_and_reblog (limited to given number of entries)
+  void check_feed( uint32_t limit )
+  {
+    const auto feed = get_feed( "bob", limit );
+    BOOST_REQUIRE_EQUAL( feed.size(), std::min( limit, 3u ) );
+
+    BOOST_CHECK_EQUAL( feed[0].author, "sam" );
+    BOOST_CHECK_EQUAL( feed[0].permlink, "dolor" );
+    BOOST_CHECK( feed[0].reblogged_by.empty() );
+    BOOST_CHECK( feed[0].first_reblogged_by == account_name_type() );
+    if( limit < 2 )
+      return;
+
+    BOOST_CHECK_EQUAL( feed[1].author, "carol" );
+    BOOST_CHECK_EQUAL( feed[1].permlink, "ipsum" );
+    BOOST_REQUIRE_EQUAL( feed[1].reblogged_by.size(), 1u );
+    BOOST_CHECK( feed[1].reblogged_by[0] == "sam" );
+    BOOST_CHECK( feed[1].first_reblogged_by == "sam" );
+    BOOST_CHECK( feed[1].first_reblogged_on == ipsum_reblogged_on );
+    if( limit < 3 )
+      return;
+
+    // entry was made by alice's post, reblog only adds to rebloggers
+    BOOST_CHECK_EQUAL( feed[2].author, "alice" );
+    BOOST_CHECK_EQUAL( feed[2].permlink, "lorem" );
+    BOOST_REQUIRE_EQUAL( feed[2].reblogged_by.size(), 1u );
+    BOOST_CHECK( feed[2].reblogged_by[0] == "sam" );
+    BOOST_CHECK( feed[2].first_reblogged_by == account_name_type() );
+    BOOST_CHECK( feed[2].first_reblogged_on == fc::time_point_sec() );
+  }
+
+  follow_api*         api = nullptr;
+  fc::time_point_sec  ipsum_reblogged_on;
+};
+
+BOOST_FIXTURE_TEST_SUITE( follow, follow_database_fixture )
+
+BOOST_AUTO_TEST_CASE( feed_push_mode )
+{
+  try
+  {
+    init( {} );
+    post_and_reblog();
+
+    BOOST_REQUIRE_EQUAL( count_feeds( "bob" ), 3u );
+    check_feed( 10 );
+    check_feed( 2 );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( feed_pull_mode )
+{
+  try
+  {
+    init( { "--follow-feed-mode", "pull" } );
+    post_and_reblog();
+
+    // no feed_objects, the same feed is merged from blogs
+    BOOST_REQUIRE( db->get_index< feed_index >().indices().empty() );
+    check_feed( 1 );
+
+    // longer feed than cached one is merged again, shorter one is cut from cache
+    check_feed( 3 );
+    check_feed( 2 );
+    check_feed( 10 );
+
+    // unlike feed_object, merged feed also has posts made before the follow
+    ACTOR( dave );
+    post_comment( "dave", "amet", "title", "body", "test", dave_private_key );
+    generate_block();
+    follow( "bob", "dave", bob_private_key );
+    generate_block();
+
+    // cached feed is not used after head block changes
+    const auto feed = get_feed( "bob", 10 );
+    BOOST_REQUIRE_EQUAL( feed.size(), 4u );
+    BOOST_CHECK_EQUAL( feed[0].author, "dave" );
+    BOOST_CHECK_EQUAL( feed[0].permlink, "amet" );
+    BOOST_CHECK_EQUAL( feed[1].permlink, "dolor" );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
@@ -5,6 +5,9 @@
 #include <hive/chain/comment_object.hpp>
 #include <hive/protocol/hive_operations.hpp>
 #include <hive/plugins/json_rpc/json_rpc_plugin.hpp>
+#include <hive/plugins/json_rpc/utility.hpp>
+#include <hive/plugins/json_rpc/api_metrics.hpp>
+#include <hive/plugins/webserver/request_lanes.hpp>
 
 #include "../db_fixture/database_fixture.hpp"
 
@@ -312,5 +315,179 @@ BOOST_AUTO_TEST_CASE( semantics_validation )
   FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( cached_response_validation )
+{
+  try
+  {
+    std::string request = "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":1}";
+    fc::variant first = make_request( request, 0, false, false );
+
+    // second call within the same block is answered from cache, with its own id
+    request = "{\"jsonrpc\":\"2.0\", \"method\":\"call\", \"params\":[\"database_api\", \"get_dynamic_global_properties\", {}], \"id\":\"two\"}";
+    fc::variant second = make_request( request, 0, false, false );
+    BOOST_REQUIRE_EQUAL( fc::json::to_string( first[ "result" ] ), fc::json::to_string( second[ "result" ] ) );
+
+    // applied block invalidates cached results
+    uint32_t head_block_number = first[ "result" ][ "head_block_number" ].as< uint32_t >();
+    generate_block();
+    request = "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":3}";
+    fc::variant third = make_request( request, 0, false, false );
+    BOOST_REQUIRE_EQUAL( third[ "result" ][ "head_block_number" ].as< uint32_t >(), head_block_number + 1 );
+
+    // cached and not cached results in one batch
+    request = "[{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":4},"
+              "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.find_accounts\", \"params\":{\"accounts\":[\"initminer\"]}, \"id\":5}]";
+    make_array_request( request, 0, false, false );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( serialized_block_range_validation )
+{
+  try
+  {
+    generate_blocks( 5 );
+    const uint32_t head = db->head_block_num();
+
+    std::string request = "{\"jsonrpc\":\"2.0\", \"method\":\"block_api.get_block_range\", \"params\":{\"starting_block_num\":1, \"count\":1000}, \"id\":1}";
+    fc::variant range = make_request( request, 0, false, false );
+    const fc::variants& blocks = range[ "result" ][ "blocks" ].get_array();
+    BOOST_REQUIRE_EQUAL( blocks.size(), head );
+
+    // must be the same as blocks (with ids) returned one by one
+    for( uint32_t block_num = 1; block_num <= head; ++block_num )
+    {
+      request = "{\"jsonrpc\":\"2.0\", \"method\":\"block_api.get_block\", \"params\":{\"block_num\":" + std::to_string( block_num ) + "}, \"id\":2}";
+      fc::variant block = make_request( request, 0, false, false );
+      BOOST_REQUIRE_EQUAL( fc::json::to_string( blocks[ block_num - 1 ] ), fc::json::to_string( block[ "result" ][ "block" ] ) );
+    }
+
+    request = "{\"jsonrpc\":\"2.0\", \"method\":\"call\", \"params\":[\"block_api\", \"get_block_range\", {\"starting_block_num\":" + std::to_string( head + 1 ) + ", \"count\":10}], \"id\":3}";
+    range = make_request( request, 0, false, false );
+    BOOST_REQUIRE( range[ "result" ][ "blocks" ].get_array().empty() );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( request_lanes_validation )
+{
+  try
+  {
+    using hive::plugins::webserver::request_lanes;
+
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.find_accounts\", \"id\":1}" ), "database_api.find_accounts" );
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "{\"method\" : \"call\", \"params\" : [ \"condenser_api\" , \"get_account_history\", [\"a\", -1, 10]]}" ), "condenser_api.get_account_history" );
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "{\"method\":\"call\", \"params\":{}}" ), "" );
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "{\"method\":5}" ), "" );
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "{\"method\":\"unterminated" ), "" );
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "" ), "" );
+
+    // only the beginning of request is scanned
+    const std::string padding( request_lanes::MAX_SCANNED_SIZE, ' ' );
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "{" + padding + "\"method\":\"block_api.get_block_range\"}" ), "" );
+    BOOST_REQUIRE_EQUAL( request_lanes::peek_method_name( "{\"method\":\"block_api.get_block_range" + padding + "\"}" ), "" );
+
+    request_lanes lanes;
+    lanes.set_slow_methods( { "block_api.get_block_range", "account_history_api.*" } );
+    BOOST_REQUIRE( lanes.is_slow( "{\"method\":\"block_api.get_block_range\"}" ) );
+    BOOST_REQUIRE( lanes.is_slow( "{\"method\":\"account_history_api.get_ops_in_block\"}" ) );
+    BOOST_REQUIRE( lanes.is_slow( "{\"method\":\"call\", \"params\":[\"account_history_api\", \"get_transaction\", {}]}" ) );
+    BOOST_REQUIRE( lanes.is_slow( "  [{\"method\":\"database_api.get_dynamic_global_properties\"}]" ) );
+    BOOST_REQUIRE( !lanes.is_slow( "{\"method\":\"block_api.get_block\"}" ) );
+    BOOST_REQUIRE( !lanes.is_slow( "{\"method\":\"account_history_ap\"}" ) );
+    BOOST_REQUIRE( !lanes.is_slow( "{\"id\":1}" ) );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( deadline_validation )
+{
+  try
+  {
+    using namespace hive::plugins::json_rpc;
+
+    BOOST_REQUIRE( read_lock_wait_time() == fc::seconds( 1 ) );
+
+    std::string request = "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":1}";
+    {
+      // request that waited past its deadline is not executed, not even from cache
+      request_scope scope( fc::time_point::now() - fc::seconds( 2 ), fc::time_point::now() - fc::seconds( 1 ) );
+      make_request( request, JSON_RPC_DEADLINE_EXCEEDED );
+      BOOST_REQUIRE_THROW( read_lock_wait_time(), fc::timeout_exception );
+
+      request = "[{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":2},"
+                "{\"jsonrpc\":\"2.0\", \"method\":\"block_api.get_block\", \"params\":{\"block_num\":1}, \"id\":3}]";
+      make_array_request( request, JSON_RPC_DEADLINE_EXCEEDED );
+    }
+
+    {
+      // waiting for lock never extends past deadline
+      request_scope scope( fc::time_point::now(), fc::time_point::now() + fc::milliseconds( 200 ) );
+      BOOST_REQUIRE( read_lock_wait_time() <= fc::milliseconds( 200 ) );
+      request = "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":4}";
+      make_positive_request( request );
+    }
+
+    // deadline ends with the scope
+    BOOST_REQUIRE( current_request().deadline == fc::time_point::maximum() );
+    request = "{\"jsonrpc\":\"2.0\", \"method\":\"database_api.get_dynamic_global_properties\", \"id\":5}";
+    make_positive_request( request );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( api_metrics_validation )
+{
+  try
+  {
+    using namespace hive::plugins::json_rpc;
+
+    log2_histogram histogram;
+    BOOST_REQUIRE_EQUAL( histogram.get_snapshot().percentile( 0.5 ), 0u );
+
+    for( uint64_t value : { 0, 1, 2, 3, 100 } )
+      histogram.record( value );
+    log2_histogram::snapshot s = histogram.get_snapshot();
+    BOOST_REQUIRE_EQUAL( s.count, 5u );
+    BOOST_REQUIRE_EQUAL( s.sum, 106u );
+    BOOST_REQUIRE_EQUAL( s.percentile( 0.0 ), 0u );
+    BOOST_REQUIRE_EQUAL( s.percentile( 0.2 ), 0u );
+    BOOST_REQUIRE_EQUAL( s.percentile( 0.4 ), 1u );
+    BOOST_REQUIRE_EQUAL( s.percentile( 0.5 ), 3u );
+    BOOST_REQUIRE_EQUAL( s.percentile( 0.99 ), 127u );
+    BOOST_REQUIRE_EQUAL( s.percentile( 1.0 ), 127u );
+
+    // values past last bucket end up in it
+    histogram.record( uint64_t( 1 ) << 60 );
+    BOOST_REQUIRE_EQUAL( histogram.get_snapshot().percentile( 1.0 ), log2_histogram::snapshot::bucket_limit( log2_histogram::BUCKET_COUNT - 1 ) );
+    histogram.record( fc::microseconds( -5 ) );
+    BOOST_REQUIRE_EQUAL( histogram.get_snapshot().buckets[0], 2u );
+
+    api_metrics_registry registry;
+    registry.register_method( "a_api.called" );
+    registry.register_method( "a_api.not_called" );
+    BOOST_REQUIRE( registry.find( "a_api.unknown" ) == nullptr );
+    api_method_metrics* metrics = registry.find( "a_api.called" );
+    BOOST_REQUIRE( metrics != nullptr );
+    metrics->execution.record( fc::microseconds( 3 ) );
+    metrics->errors.fetch_add( 1 );
+
+    const std::string text = registry.to_prometheus();
+    BOOST_TEST_MESSAGE( text );
+    BOOST_REQUIRE( text.find( "a_api.not_called" ) == std::string::npos );
+    BOOST_REQUIRE( text.find( "hived_api_queue_delay_seconds" ) == std::string::npos );
+    BOOST_REQUIRE( text.find( "hived_api_errors_total{method=\"a_api.called\"} 1\n" ) != std::string::npos );
+    BOOST_REQUIRE( text.find(
+      "# TYPE hived_api_execution_seconds histogram\n"
+      "hived_api_execution_seconds_bucket{method=\"a_api.called\",le=\"0\"} 0\n"
+      "hived_api_execution_seconds_bucket{method=\"a_api.called\",le=\"1e-06\"} 0\n"
+      "hived_api_execution_seconds_bucket{method=\"a_api.called\",le=\"3e-06\"} 1\n"
+      "hived_api_execution_seconds_bucket{method=\"a_api.called\",le=\"+Inf\"} 1\n"
+      "hived_api_execution_seconds_sum{method=\"a_api.called\"} 3e-06\n"
+      "hived_api_execution_seconds_count{method=\"a_api.called\"} 1\n" ) != std::string::npos );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 #endif
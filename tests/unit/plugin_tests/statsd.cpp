@@ -0,0 +1,117 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+
+#include <hive/plugins/statsd/statsd_aggregator.hpp>
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+
+using hive::plugins::statsd::detail::statsd_aggregator;
+
+namespace
+{
+  // sender thread never flushes on its own during the test, flush() is called explicitly
+  const std::chrono::milliseconds NO_AUTO_FLUSH = std::chrono::hours( 1 );
+
+  std::vector< std::string > split_lines( const std::vector< std::string >& packets )
+  {
+    std::vector< std::string > lines;
+    for( const auto& packet : packets )
+    {
+      std::vector< std::string > packet_lines;
+      boost::split( packet_lines, packet, boost::is_any_of( "\n" ) );
+      lines.insert( lines.end(), packet_lines.begin(), packet_lines.end() );
+    }
+    return lines;
+  }
+
+  bool contains( const std::vector< std::string >& lines, const std::string& line )
+  {
+    return std::find( lines.begin(), lines.end(), line ) != lines.end();
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( statsd )
+
+BOOST_AUTO_TEST_CASE( aggregation_per_key )
+{
+  std::vector< std::string > packets;
+  statsd_aggregator aggregator( [&]( const std::string& p ) { packets.push_back( p ); }, "hived.", NO_AUTO_FLUSH, 1432 );
+
+  aggregator.record( "ns", "stat", "count", statsd_aggregator::metric_type::counter, 1, 1.0f );
+  aggregator.record( "ns", "stat", "count", statsd_aggregator::metric_type::counter, 2, 1.0f );
+  aggregator.record( "ns", "stat", "count", statsd_aggregator::metric_type::counter, -4, 1.0f );
+  aggregator.record( "ns", "stat", "other", statsd_aggregator::metric_type::counter, 5, 1.0f );
+  aggregator.record( "ns", "stat", "gauge", statsd_aggregator::metric_type::gauge, 5, 1.0f );
+  aggregator.record( "ns", "stat", "gauge", statsd_aggregator::metric_type::gauge, 7, 1.0f );
+  for( int i = 0; i < 4; ++i )
+    aggregator.record( "ns", "stat", "time", statsd_aggregator::metric_type::timing, 3, 1.0f );
+  aggregator.record( "ns", "stat", "time", statsd_aggregator::metric_type::timing, 10, 1.0f );
+
+  aggregator.flush();
+  BOOST_REQUIRE_EQUAL( packets.size(), 1u );
+  auto lines = split_lines( packets );
+  BOOST_CHECK_EQUAL( lines.size(), 5u );
+  BOOST_CHECK( contains( lines, "hived.ns.stat.count:-1|c" ) );
+  BOOST_CHECK( contains( lines, "hived.ns.stat.other:5|c" ) );
+  BOOST_CHECK( contains( lines, "hived.ns.stat.gauge:7|g" ) );
+  BOOST_CHECK( contains( lines, "hived.ns.stat.time:3|ms|@0.25" ) );
+  BOOST_CHECK( contains( lines, "hived.ns.stat.time:10|ms" ) );
+
+  // everything was drained - nothing is sent again
+  packets.clear();
+  aggregator.flush();
+  BOOST_CHECK( packets.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( ring_overflow_is_counted )
+{
+  std::vector< std::string > packets;
+  statsd_aggregator aggregator( [&]( const std::string& p ) { packets.push_back( p ); }, "", NO_AUTO_FLUSH, 1432 );
+
+  const uint32_t capacity = statsd_aggregator::BUFFER_CAPACITY;
+  for( uint32_t i = 0; i < capacity + 10; ++i )
+    aggregator.record( "ns", "stat", "key", statsd_aggregator::metric_type::counter, 1, 1.0f );
+
+  aggregator.flush();
+  auto lines = split_lines( packets );
+  BOOST_CHECK_EQUAL( lines.size(), 2u );
+  BOOST_CHECK( contains( lines, "ns.stat.key:" + std::to_string( capacity ) + "|c" ) );
+  BOOST_CHECK( contains( lines, "statsd.sender.dropped:10|c" ) );
+
+  // ring is usable again after it was drained
+  packets.clear();
+  aggregator.record( "ns", "stat", "key", statsd_aggregator::metric_type::counter, 1, 1.0f );
+  aggregator.flush();
+  BOOST_REQUIRE_EQUAL( packets.size(), 1u );
+  BOOST_CHECK_EQUAL( packets[0], "ns.stat.key:1|c" );
+}
+
+BOOST_AUTO_TEST_CASE( lines_packed_into_packets )
+{
+  const uint32_t max_packet_size = 64;
+  std::vector< std::string > packets;
+  statsd_aggregator aggregator( [&]( const std::string& p ) { packets.push_back( p ); }, "hived.", NO_AUTO_FLUSH, max_packet_size );
+
+  const size_t key_count = 20;
+  for( size_t i = 0; i < key_count; ++i )
+    aggregator.record( "ns", "stat", "key" + std::to_string( 10 + i ), statsd_aggregator::metric_type::counter, 1, 1.0f );
+
+  aggregator.flush();
+  // each line is 23 characters, so two lines fit in a packet and a third one does not
+  BOOST_CHECK_EQUAL( packets.size(), key_count / 2 );
+  for( const auto& packet : packets )
+  {
+    BOOST_CHECK_LE( packet.size(), max_packet_size );
+    BOOST_CHECK( packet.back() != '\n' );
+  }
+
+  auto lines = split_lines( packets );
+  BOOST_CHECK_EQUAL( lines.size(), key_count );
+  for( size_t i = 0; i < key_count; ++i )
+    BOOST_CHECK( contains( lines, "hived.ns.stat.key" + std::to_string( 10 + i ) + ":1|c" ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
@@ -0,0 +1,190 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+
+#include <hive/plugins/webserver/ws_connection_state.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <algorithm>
+
+using hive::plugins::webserver::ws_connection_state;
+using hive::plugins::webserver::ws_error_response;
+
+namespace
+{
+  const int64_t TOO_MANY = -32005;
+
+  struct test_request
+  {
+    std::string body;
+    uint64_t    sequence = 0;
+  };
+
+  /// Connection whose dispatched requests wait in a list until test completes them
+  struct test_connection
+  {
+    typedef ws_connection_state< test_request > state_type;
+
+    test_connection( uint32_t max_in_flight, uint32_t max_queued, bool ordered_responses )
+    {
+      state = std::make_shared< state_type >( max_in_flight, max_queued, ordered_responses,
+        [this]( const std::shared_ptr< state_type >&, const test_request& request ) { dispatched.push_back( request ); },
+        [this]( const std::string& response ) { sent.push_back( response ); } );
+    }
+
+    void push( const std::string& body )
+    {
+      state->push( test_request{ body }, body, TOO_MANY, "Too many requests" );
+    }
+
+    /// completes dispatched request with given body, response is the body prefixed with "re:"
+    void complete( const std::string& body )
+    {
+      auto itr = std::find_if( dispatched.begin(), dispatched.end(), [&]( const test_request& r ) { return r.body == body; } );
+      BOOST_REQUIRE( itr != dispatched.end() );
+      const test_request request = *itr;
+      dispatched.erase( itr );
+      state->complete( request.sequence, "re:" + request.body );
+    }
+
+    std::shared_ptr< state_type >  state;
+    std::vector< test_request >    dispatched;
+    std::vector< std::string >     sent;
+  };
+
+  std::string request( const std::string& id )
+  {
+    return "{\"jsonrpc\":\"2.0\",\"method\":\"database_api.get_dynamic_global_properties\",\"id\":" + id + "}";
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( webserver )
+
+BOOST_AUTO_TEST_CASE( ws_response_ordering )
+{
+  {
+    test_connection con( 0, 0, true );
+    for( const char* body : { "a", "b", "c", "d" } )
+      con.push( body );
+    BOOST_REQUIRE_EQUAL( con.dispatched.size(), 4u );
+
+    // responses wait for responses to earlier requests
+    con.complete( "c" );
+    con.complete( "b" );
+    BOOST_CHECK( con.sent.empty() );
+    con.complete( "a" );
+    BOOST_CHECK( con.sent == std::vector< std::string >( { "re:a", "re:b", "re:c" } ) );
+    con.complete( "d" );
+    BOOST_CHECK_EQUAL( con.sent.back(), "re:d" );
+    BOOST_CHECK_EQUAL( con.state->get_in_flight(), 0u );
+  }
+  {
+    // without ordering responses go out as soon as they are ready
+    test_connection con( 0, 0, false );
+    for( const char* body : { "a", "b", "c" } )
+      con.push( body );
+    con.complete( "c" );
+    con.complete( "a" );
+    con.complete( "b" );
+    BOOST_CHECK( con.sent == std::vector< std::string >( { "re:c", "re:a", "re:b" } ) );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( ws_in_flight_limit )
+{
+  test_connection con( 2, 2, true );
+  con.push( request( "1" ) );
+  con.push( request( "2" ) );
+  con.push( request( "3" ) );
+  con.push( request( "4" ) );
+  BOOST_CHECK_EQUAL( con.dispatched.size(), 2u );
+  BOOST_CHECK_EQUAL( con.state->get_in_flight(), 2u );
+  BOOST_CHECK_EQUAL( con.state->get_waiting(), 2u );
+
+  // queue is full - request is answered with error right away (after earlier responses, as ordering is on)
+  con.push( request( "\"five\"" ) );
+  BOOST_CHECK_EQUAL( con.state->get_waiting(), 2u );
+  BOOST_CHECK( con.sent.empty() );
+
+  // finished request passes its slot to the oldest waiting one
+  con.complete( request( "1" ) );
+  BOOST_REQUIRE_EQUAL( con.dispatched.size(), 2u );
+  BOOST_CHECK_EQUAL( con.dispatched.back().body, request( "3" ) );
+  BOOST_CHECK_EQUAL( con.state->get_in_flight(), 2u );
+  BOOST_CHECK_EQUAL( con.state->get_waiting(), 1u );
+
+  con.complete( request( "2" ) );
+  con.complete( request( "3" ) );
+  con.complete( request( "4" ) );
+  BOOST_CHECK( con.dispatched.empty() );
+  BOOST_CHECK_EQUAL( con.state->get_in_flight(), 0u );
+  BOOST_REQUIRE_EQUAL( con.sent.size(), 5u );
+  BOOST_CHECK_EQUAL( con.sent[3], "re:" + request( "4" ) );
+
+  const fc::variant rejection = fc::json::from_string( con.sent[4] );
+  BOOST_CHECK_EQUAL( rejection[ "id" ].as_string(), "five" );
+  BOOST_CHECK_EQUAL( rejection[ "error" ][ "code" ].as_int64(), TOO_MANY );
+  BOOST_CHECK_EQUAL( rejection[ "jsonrpc" ].as_string(), "2.0" );
+}
+
+BOOST_AUTO_TEST_CASE( ws_close_while_pending )
+{
+  test_connection con( 1, 10, false );
+  con.push( "a" );
+  con.push( "b" );
+  con.push( "c" );
+  BOOST_CHECK_EQUAL( con.dispatched.size(), 1u );
+
+  con.state->close();
+  BOOST_CHECK( con.state->is_closed() );
+  BOOST_CHECK_EQUAL( con.state->get_waiting(), 0u );
+
+  // request in flight finishes, but neither its response is sent nor waiting requests are started
+  con.complete( "a" );
+  BOOST_CHECK( con.sent.empty() );
+  BOOST_CHECK( con.dispatched.empty() );
+  BOOST_CHECK_EQUAL( con.state->get_in_flight(), 0u );
+
+  con.push( "d" );
+  BOOST_CHECK( con.dispatched.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( ws_error_response_ids )
+{
+  auto ids = []( const std::string& body, bool expected_batch )
+  {
+    bool batch = !expected_batch;
+    auto result = ws_error_response::peek_ids( body, &batch );
+    BOOST_CHECK_EQUAL( batch, expected_batch );
+    return result;
+  };
+  typedef std::vector< std::string > strings;
+
+  BOOST_CHECK( ids( request( "7" ), false ) == strings( { "7" } ) );
+  BOOST_CHECK( ids( " { \"id\" : \"a\\\"}b\" , \"method\":\"x\"}", false ) == strings( { "\"a\\\"}b\"" } ) );
+  // only top level id counts, also when it comes after params
+  BOOST_CHECK( ids( "{\"params\":{\"id\":1,\"x\":[\"]\",{}]},\"id\":2}", false ) == strings( { "2" } ) );
+  BOOST_CHECK( ids( "{\"method\":\"x\"}", false ) == strings( { "null" } ) );
+  BOOST_CHECK( ids( "{\"id\":1", false ) == strings( { "null" } ) );
+  BOOST_CHECK( ids( "not json", false ) == strings( { "null" } ) );
+  BOOST_CHECK( ids( "", false ) == strings( { "null" } ) );
+
+  BOOST_CHECK( ids( "[" + request( "1" ) + ", {\"method\":\"x\"}, 5, " + request( "\"z\"" ) + "]", true ) == strings( { "1", "null", "null", "\"z\"" } ) );
+  BOOST_CHECK( ids( "[ ]", true ).empty() );
+  BOOST_CHECK( ids( "[{\"id\":1", true ).empty() );
+
+  // batch is answered with array of errors, empty batch with single one
+  fc::variant response = fc::json::from_string( ws_error_response::build( "[" + request( "1" ) + "," + request( "\"two\"" ) + "]", TOO_MANY, "busy" ) );
+  BOOST_REQUIRE( response.is_array() );
+  BOOST_REQUIRE_EQUAL( response.get_array().size(), 2u );
+  BOOST_CHECK_EQUAL( response.get_array()[0][ "id" ].as_int64(), 1 );
+  BOOST_CHECK_EQUAL( response.get_array()[1][ "id" ].as_string(), "two" );
+  BOOST_CHECK_EQUAL( response.get_array()[1][ "error" ][ "message" ].as_string(), "busy" );
+
+  response = fc::json::from_string( ws_error_response::build( "[]", TOO_MANY, "busy" ) );
+  BOOST_REQUIRE( response.is_object() );
+  BOOST_CHECK( response[ "id" ].is_null() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
@@ -522,4 +522,25 @@ BOOST_AUTO_TEST_CASE( chain_object_size )
 }
 #endif
 
+BOOST_AUTO_TEST_CASE( account_object_hot_members )
+{
+  // members touched by transfers, votes and mana claims have to stay within first 2 cache lines
+  // (plus few bytes), see comment in account_object.hpp
+  const auto& a = db->get_account( HIVE_INIT_MINER_NAME );
+  auto offset = [&]( const void* member ) { return size_t( (const char*)member - (const char*)&a ); };
+  const size_t hot_limit = 2 * 64 + 8;
+
+  BOOST_CHECK_LT( offset( &a.name ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.balance ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.hbd_balance ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.vesting_shares ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.delegated_vesting_shares ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.received_vesting_shares ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.voting_manabar ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.downvote_manabar ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.sum_delayed_votes ), hot_limit );
+  BOOST_CHECK_LT( offset( &a.last_vote_time ), hot_limit );
+  BOOST_CHECK_LE( offset( &a.can_vote ), hot_limit );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,373 @@
+#include <boost/test/unit_test.hpp>
+
+#include <hive/chain/block_log.hpp>
+#include <hive/chain/block_compression_dictionaries.hpp>
+
+#include <hive/protocol/hive_operations.hpp>
+#include <hive/protocol/misc_utilities.hpp>
+
+#include <hive/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace hive::chain;
+using namespace hive::protocol;
+
+namespace
+{
+  typedef std::vector< boost::shared_ptr< signed_block > > block_vector;
+
+  boost::shared_ptr< signed_block > make_block( const block_id_type& previous, uint32_t i, const std::string& memo )
+  {
+    auto block = boost::make_shared< signed_block >();
+    block->previous = previous;
+    block->timestamp = fc::time_point_sec( 1600000000 + 3 * i );
+    block->witness = "initminer";
+
+    transfer_operation transfer;
+    transfer.from = "alice";
+    transfer.to = "bob";
+    transfer.amount = asset( i + 1, HIVE_SYMBOL );
+    transfer.memo = memo;
+    signed_transaction tx;
+    tx.ref_block_num = i & 0xffff;
+    tx.expiration = block->timestamp + 60;
+    tx.operations.push_back( transfer );
+    block->transactions.push_back( signed_transaction_transporter( tx, serialization_mode_controller::get_current_pack() ) );
+    block->transaction_merkle_root = block->calculate_merkle_root();
+    return block;
+  }
+
+  /// Creates chain of blocks with a transfer in each, so their contents differ but compress well together
+  block_vector make_blocks( uint32_t count )
+  {
+    block_vector blocks;
+    block_id_type previous;
+    for( uint32_t i = 0; i < count; ++i )
+    {
+      blocks.push_back( make_block( previous, i, "payment number " + std::to_string( i ) ) );
+      previous = blocks.back()->id();
+    }
+    return blocks;
+  }
+
+  /// Creates blocks to be stored uncompressed, with memos made of 8-byte values that look like positions stored
+  /// after each block: every value points to the previous one and the first one to the real start of its block,
+  /// so (almost) any 8-byte aligned offset inside a memo passes as a block boundary
+  block_vector make_blocks_with_false_boundaries( uint32_t count, uint32_t memo_slots )
+  {
+    const std::string placeholder( memo_slots * sizeof( uint64_t ), 'Z' );
+    block_vector blocks;
+    block_id_type previous;
+    uint64_t block_start = 0;
+    for( uint32_t i = 0; i < count; ++i )
+    {
+      // memo content does not change the layout, so its position in the log is known from placeholder
+      const auto serialized = fc::raw::pack_to_vector( *make_block( previous, i, placeholder ) );
+      const auto memo_itr = std::search( serialized.begin(), serialized.end(), placeholder.begin(), placeholder.end() );
+      BOOST_REQUIRE( memo_itr != serialized.end() );
+      const uint64_t memo_start = block_start + ( memo_itr - serialized.begin() );
+
+      std::string memo( placeholder.size(), '\0' );
+      for( uint32_t slot = 0; slot < memo_slots; ++slot )
+      {
+        const uint64_t value = slot == 0 ? block_start : memo_start + sizeof( uint64_t ) * ( slot - 1 );
+        memcpy( &memo[ sizeof( uint64_t ) * slot ], &value, sizeof( value ) );
+      }
+      blocks.push_back( make_block( previous, i, memo ) );
+      previous = blocks.back()->id();
+      block_start += serialized.size() + sizeof( uint64_t );
+    }
+    return blocks;
+  }
+
+  void check_blocks( const block_log& log, const block_vector& blocks )
+  {
+    BOOST_REQUIRE( log.head() );
+    BOOST_REQUIRE_EQUAL( log.head()->block_num(), blocks.size() );
+    BOOST_CHECK( log.head()->id() == blocks.back()->id() );
+    for( const auto& block : blocks )
+    {
+      auto read = log.read_block_by_num( block->block_num() );
+      BOOST_REQUIRE( read.valid() );
+      BOOST_CHECK( read->id() == block->id() );
+      BOOST_CHECK_EQUAL( read->transactions.size(), 1u );
+    }
+    BOOST_CHECK( !log.read_block_by_num( blocks.size() + 1 ).valid() );
+
+    auto range = log.read_block_range_by_num( 1, blocks.size() + 10 );
+    BOOST_REQUIRE_EQUAL( range.size(), blocks.size() );
+    for( size_t i = 0; i < range.size(); ++i )
+      BOOST_CHECK( range[i].id() == blocks[i]->id() );
+  }
+
+  std::string read_index( const fc::path& file )
+  {
+    std::string index;
+    fc::read_file_contents( fc::path( file.generic_string() + ".index" ), index );
+    return index;
+  }
+
+  /// Removes (or cuts down to given number of blocks, as left by interrupted reconstruction) the index and lets
+  /// block log reconstruct it with given number of threads
+  std::string reconstruct_index( const fc::path& file, const block_vector& blocks, uint32_t threads, uint32_t indexed_blocks = 0 )
+  {
+    const fc::path index_file( file.generic_string() + ".index" );
+    if( indexed_blocks == 0 )
+      fc::remove( index_file );
+    else
+      boost::filesystem::resize_file( index_file.generic_string(), indexed_blocks * sizeof( uint64_t ) );
+
+    block_log log;
+    log.set_index_reconstruction_threads( threads, 1024 );
+    log.open( file );
+    check_blocks( log, blocks );
+    log.close();
+    return read_index( file );
+  }
+
+  std::vector< char > serialize_samples( const block_vector& blocks, std::vector< size_t >& sample_sizes )
+  {
+    std::vector< char > samples;
+    for( const auto& block : blocks )
+    {
+      auto serialized = fc::raw::pack_to_vector( *block );
+      samples.insert( samples.end(), serialized.begin(), serialized.end() );
+      sample_sizes.push_back( serialized.size() );
+    }
+    return samples;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( block_log_tests )
+
+BOOST_AUTO_TEST_CASE( append_and_reopen )
+{
+  fc::temp_directory dir( hive::utilities::temp_directory_path() );
+  const fc::path file = dir.path() / "block_log";
+  const auto blocks = make_blocks( 100 );
+
+  block_log log;
+  log.open( file );
+  BOOST_CHECK( !log.head() );
+  BOOST_CHECK_EQUAL( log.get_durable_head_block_num(), 0u );
+  uint64_t last_position = 0;
+  for( const auto& block : blocks )
+  {
+    const uint64_t position = log.append( *block );
+    BOOST_CHECK( block->block_num() == 1 ? position == 0 : position > last_position );
+    last_position = position;
+    // written synchronously
+    BOOST_CHECK_EQUAL( log.get_durable_head_block_num(), block->block_num() );
+  }
+  BOOST_CHECK( log.wait_for_durable_head( blocks.size(), fc::milliseconds( 1 ) ) );
+  BOOST_CHECK( !log.wait_for_durable_head( blocks.size() + 1, fc::milliseconds( 1 ) ) );
+  check_blocks( log, blocks );
+  log.close();
+
+  log.open( file );
+  BOOST_CHECK_EQUAL( log.get_durable_head_block_num(), blocks.size() );
+  check_blocks( log, blocks );
+  log.close();
+}
+
+BOOST_AUTO_TEST_CASE( background_compression_reads_queued_and_flushed_blocks )
+{
+  fc::temp_directory dir( hive::utilities::temp_directory_path() );
+  const fc::path file = dir.path() / "block_log";
+  const auto blocks = make_blocks( 200 );
+
+  block_log log;
+  log.set_compression_threads( 3 );
+  log.open( file );
+  for( const auto& block : blocks )
+  {
+    BOOST_CHECK_EQUAL( log.append( block ), 0u );
+    BOOST_CHECK_LE( log.get_durable_head_block_num(), block->block_num() );
+    // block and all its predecessors are readable regardless of whether they are queued, being written or in the file
+    BOOST_REQUIRE( log.head() );
+    BOOST_CHECK( log.head()->id() == block->id() );
+    for( uint32_t n = block->block_num() > 10 ? block->block_num() - 10 : 1; n <= block->block_num(); ++n )
+    {
+      auto read = log.read_block_by_num( n );
+      BOOST_REQUIRE( read.valid() );
+      BOOST_CHECK( read->id() == blocks[n-1]->id() );
+    }
+  }
+  // everything queued so far, some of it probably still in memory
+  check_blocks( log, blocks );
+
+  BOOST_CHECK( log.wait_for_durable_head( blocks.size(), fc::seconds( 30 ) ) );
+  BOOST_CHECK_EQUAL( log.get_durable_head_block_num(), blocks.size() );
+  BOOST_CHECK( !log.wait_for_durable_head( blocks.size() + 1, fc::milliseconds( 10 ) ) );
+  check_blocks( log, blocks );
+
+  uint32_t visited = 0;
+  log.for_each_block_in_range( 1, blocks.size(), [&]( signed_block&& block )
+  {
+    BOOST_CHECK( block.id() == blocks[visited]->id() );
+    ++visited;
+  } );
+  BOOST_CHECK_EQUAL( visited, blocks.size() );
+  log.close();
+
+  // flushed blocks are read back from the file without background threads
+  block_log reopened;
+  reopened.open( file );
+  BOOST_CHECK_EQUAL( reopened.get_durable_head_block_num(), blocks.size() );
+  check_blocks( reopened, blocks );
+  reopened.close();
+}
+
+BOOST_AUTO_TEST_CASE( close_writes_queued_blocks )
+{
+  fc::temp_directory dir( hive::utilities::temp_directory_path() );
+  const fc::path file = dir.path() / "block_log";
+  const auto blocks = make_blocks( 150 );
+
+  block_log log;
+  log.set_compression_threads( 2 );
+  log.open( file );
+  for( const auto& block : blocks )
+    log.append( block );
+  log.close();
+  BOOST_CHECK_EQUAL( log.get_durable_head_block_num(), 0u );
+
+  // switching to synchronous mode keeps appending to the same file
+  const auto more_blocks = make_blocks( 160 );
+  log.set_compression_threads( 0 );
+  log.open( file );
+  BOOST_CHECK_EQUAL( log.get_durable_head_block_num(), blocks.size() );
+  for( size_t i = blocks.size(); i < more_blocks.size(); ++i )
+    log.append( *more_blocks[i] );
+  check_blocks( log, more_blocks );
+  log.close();
+}
+
+BOOST_AUTO_TEST_CASE( parallel_index_reconstruction )
+{
+  fc::temp_directory dir( hive::utilities::temp_directory_path() );
+  const fc::path file = dir.path() / "block_log";
+  const auto blocks = make_blocks( 3000 );
+
+  block_log log;
+  log.open( file );
+  for( const auto& block : blocks )
+    log.append( *block );
+  log.close();
+  const std::string index = read_index( file );
+  BOOST_REQUIRE_EQUAL( index.size(), blocks.size() * sizeof( uint64_t ) );
+
+  // single walk through the whole log
+  BOOST_CHECK( reconstruct_index( file, blocks, 1 ) == index );
+  // log split into segments walked in parallel
+  for( uint32_t threads : { 2, 3, 4, 7, 16 } )
+    BOOST_CHECK_MESSAGE( reconstruct_index( file, blocks, threads ) == index, "threads: " << threads );
+  // resumed from partial index
+  for( uint32_t indexed_blocks : { 1, 1000, 1777, 2999 } )
+  {
+    BOOST_CHECK_MESSAGE( reconstruct_index( file, blocks, 1, indexed_blocks ) == index, "resumed at: " << indexed_blocks );
+    BOOST_CHECK_MESSAGE( reconstruct_index( file, blocks, 4, indexed_blocks ) == index, "resumed at: " << indexed_blocks );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( index_reconstruction_with_false_block_boundaries )
+{
+  fc::temp_directory dir( hive::utilities::temp_directory_path() );
+  const fc::path file = dir.path() / "block_log";
+  const auto blocks = make_blocks_with_false_boundaries( 300, 64 );
+
+  block_log log;
+  log.set_compression( false );
+  log.open( file );
+  for( const auto& block : blocks )
+    log.append( *block );
+  log.close();
+  const std::string index = read_index( file );
+  BOOST_REQUIRE_EQUAL( index.size(), blocks.size() * sizeof( uint64_t ) );
+
+  // segment bounds are very likely found inside memos, chains walked from them don't join and the single walk takes over
+  BOOST_CHECK( reconstruct_index( file, blocks, 1 ) == index );
+  for( uint32_t threads : { 2, 3, 4, 5, 8, 16, 32 } )
+    BOOST_CHECK_MESSAGE( reconstruct_index( file, blocks, threads ) == index, "threads: " << threads );
+  for( uint32_t indexed_blocks : { 1, 100, 150, 299 } )
+    BOOST_CHECK_MESSAGE( reconstruct_index( file, blocks, 8, indexed_blocks ) == index, "resumed at: " << indexed_blocks );
+}
+
+BOOST_AUTO_TEST_CASE( trained_dictionary )
+{
+  fc::temp_directory dir( hive::utilities::temp_directory_path() );
+  const fc::path file = dir.path() / "block_log";
+  const fc::path dictionary_file = dir.path() / "dictionary";
+  const auto blocks = make_blocks( 2000 );
+  const uint8_t dictionary_number = 250;
+
+  std::vector< size_t > sample_sizes;
+  const std::vector< char > samples = serialize_samples( blocks, sample_sizes );
+  const std::string dictionary = train_zstd_compression_dictionary( samples, sample_sizes, 4096, 15, 2 );
+  BOOST_REQUIRE_GT( dictionary.size(), 0u );
+  BOOST_CHECK_LE( dictionary.size(), 4096u );
+  BOOST_CHECK_THROW( train_zstd_compression_dictionary( std::vector< char >( 10 ), { 10 }, 4096, 15, 1 ), fc::exception );
+  {
+    fc::ofstream out( dictionary_file );
+    out.write( dictionary.data(), dictionary.size() );
+  }
+
+  // malformed option values are reported as fc exceptions
+  const std::string path = dictionary_file.generic_string();
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( path ), fc::exception );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( ":" + path ), fc::exception );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( "250:" ), fc::exception );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( "x250:" + path ), fc::exception );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( "-1:" + path ), fc::exception );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( "256:" + path ), fc::exception );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( "99999999999999999999:" + path ), fc::exception );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary_from_file( "250:" + path + ".missing" ), fc::exception );
+  BOOST_CHECK_THROW( set_zstd_compression_dictionary_for_new_blocks( dictionary_number ), fc::exception );
+
+  BOOST_CHECK_EQUAL( register_zstd_compression_dictionary_from_file( "250:" + path ), dictionary_number );
+  // registering the same dictionary again is harmless, different content under the same number is not
+  BOOST_CHECK_EQUAL( register_zstd_compression_dictionary_from_file( "250:" + path ), dictionary_number );
+  const std::string other = dictionary.substr( 0, dictionary.size() / 2 );
+  BOOST_CHECK_THROW( register_zstd_compression_dictionary( dictionary_number, other.data(), other.size() ), fc::exception );
+
+  set_zstd_compression_dictionary_for_new_blocks( dictionary_number );
+  block_log log;
+  log.set_compression_threads( 2 );
+  log.open( file );
+  for( size_t i = 0; i < 100; ++i )
+    log.append( blocks[i] );
+  BOOST_CHECK( log.wait_for_durable_head( 100, fc::seconds( 30 ) ) );
+  log.close();
+  set_zstd_compression_dictionary_for_new_blocks( fc::optional< uint8_t >() );
+
+  log.set_compression_threads( 0 );
+  log.open( file );
+  const block_vector written( blocks.begin(), blocks.begin() + 100 );
+  check_blocks( log, written );
+  for( uint32_t n = 1; n < 100; ++n )
+  {
+    auto raw_block = log.read_raw_block_data_by_num( n );
+    const auto attributes = std::get<2>( raw_block );
+    BOOST_CHECK( attributes.flags == block_log::block_flags::zstd );
+    BOOST_REQUIRE( attributes.dictionary_number.valid() );
+    BOOST_CHECK_EQUAL( *attributes.dictionary_number, dictionary_number );
+    auto serialized = block_log::decompress_raw_block( std::move( raw_block ) );
+    signed_block block;
+    fc::raw::unpack_from_char_array( std::get<0>( serialized ).get(), std::get<1>( serialized ), block );
+    BOOST_CHECK( block.id() == blocks[n-1]->id() );
+  }
+  log.close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -50,7 +50,7 @@ using namespace hive::plugins;
 
 BOOST_AUTO_TEST_SUITE(block_tests)
 
-void open_test_database( database& db, const fc::path& dir )
+void open_test_database( database& db, const fc::path& dir, uint32_t block_log_compression_threads = 0 )
 {
   hive::chain::open_args args;
   args.data_dir = dir;
@@ -59,9 +59,59 @@ void open_test_database( database& db, const fc::path& dir )
   args.hbd_initial_supply = HBD_INITIAL_TEST_SUPPLY;
   args.shared_file_size = TEST_SHARED_MEM_SIZE;
   args.database_cfg = hive::utilities::default_database_configuration();
+  args.block_log_compression_threads = block_log_compression_threads;
   db.open( args );
 }
 
+// emulates plugin with external storage (like account_history_rocksdb) that holds its writes until replay checkpoint
+struct replay_storage_emulator : appbase::plugin< replay_storage_emulator >
+{
+  database& _db;
+  std::vector< boost::signals2::connection > connections;
+  std::vector< uint32_t > stored_blocks;
+  std::vector< uint32_t > pending_blocks;
+  std::function< void( uint32_t ) > on_block;
+  std::function< void( uint32_t ) > on_checkpoint;
+
+  replay_storage_emulator( database& db ) : _db( db )
+  {
+    connections.emplace_back( _db.add_post_apply_block_handler( [this]( const block_notification& note )
+    {
+      pending_blocks.push_back( note.block_num );
+      if( on_block )
+        on_block( note.block_num );
+    }, *this, 0 ) );
+    connections.emplace_back( _db.add_replay_checkpoint_handler( [this]( const replay_checkpoint_notification& note )
+    {
+      flush();
+      note.plugin_positions[ name() ] = note.block_num;
+      if( on_checkpoint )
+        on_checkpoint( note.block_num );
+    }, *this, 0 ) );
+    connections.emplace_back( _db.add_post_reindex_handler(
+      [this]( const reindex_notification& ) { flush(); }, *this, 0 ) );
+  }
+  virtual ~replay_storage_emulator()
+  {
+    for( auto& connection : connections )
+      hive::chain::util::disconnect_signal( connection );
+  }
+
+  void flush()
+  {
+    stored_blocks.insert( stored_blocks.end(), pending_blocks.begin(), pending_blocks.end() );
+    pending_blocks.clear();
+  }
+
+  static const std::string& name() { static std::string name = "replay_storage_emulator"; return name; }
+private: //just because it is (almost unused) part of signal registration
+  virtual void set_program_options( appbase::options_description& cli, appbase::options_description& cfg ) override {}
+  virtual void plugin_for_each_dependency( plugin_processor&& processor ) override {}
+  virtual void plugin_initialize( const appbase::variables_map& options ) override {}
+  virtual void plugin_startup() override {}
+  virtual void plugin_shutdown() override {}
+};
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
   try {
@@ -910,6 +960,152 @@ BOOST_FIXTURE_TEST_CASE( generate_block_size, clean_database_fixture )
   FC_LOG_AND_RETHROW()
 }
 
+BOOST_FIXTURE_TEST_CASE( generate_block_reuses_validated_transactions, clean_database_fixture )
+{
+  try
+  {
+    generate_block();
+    BOOST_REQUIRE( db->_pending_tx.empty() );
+    BOOST_REQUIRE_EQUAL( db->_pending_tx_validated_tail, 0u );
+
+    signed_transaction tx;
+    tx.set_expiration( db->head_block_time() + HIVE_MAX_TIME_UNTIL_EXPIRATION );
+
+    transfer_operation op;
+    op.from = HIVE_INIT_MINER_NAME;
+    op.to = HIVE_TEMP_ACCOUNT;
+    op.amount = asset( 1000, HIVE_SYMBOL );
+    tx.operations.push_back( op );
+    sign( tx, init_account_priv_key );
+    push_transaction( tx, 0 );
+
+    op.amount = asset( 2000, HIVE_SYMBOL );
+    tx.clear();
+    tx.operations.push_back( op );
+    sign( tx, init_account_priv_key );
+    push_transaction( tx, 0 );
+
+    // both transactions were validated as new ones, so producer does not need to apply them again
+    BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 2u );
+    BOOST_REQUIRE_EQUAL( db->_pending_tx_validated_tail, 2u );
+    const auto pending_balance = db->get_balance( HIVE_TEMP_ACCOUNT, HIVE_SYMBOL );
+
+    generate_block();
+
+    auto head_block = db->fetch_block_by_number( db->head_block_num() );
+    BOOST_REQUIRE_EQUAL( head_block->transactions.size(), 2u );
+    BOOST_REQUIRE( db->_pending_tx.empty() );
+    BOOST_REQUIRE_EQUAL( db->_pending_tx_validated_tail, 0u );
+    BOOST_REQUIRE( db->get_balance( HIVE_TEMP_ACCOUNT, HIVE_SYMBOL ) == pending_balance );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( apply_postponed_transactions, clean_database_fixture )
+{
+  try
+  {
+    generate_block();
+
+    signed_transaction tx;
+    tx.set_expiration( db->head_block_time() + HIVE_MAX_TIME_UNTIL_EXPIRATION );
+    transfer_operation op;
+    op.from = HIVE_INIT_MINER_NAME;
+    op.to = HIVE_TEMP_ACCOUNT;
+    op.amount = asset( 1000, HIVE_SYMBOL );
+    tx.operations.push_back( op );
+    sign( tx, init_account_priv_key );
+    db->postpone_transaction( signed_transaction_transporter( tx, serialization_mode_controller::get_current_pack() ) );
+
+    signed_transaction expired_tx;
+    expired_tx.set_expiration( db->head_block_time() - HIVE_BLOCK_INTERVAL );
+    op.amount = asset( 2000, HIVE_SYMBOL );
+    expired_tx.operations.push_back( op );
+    sign( expired_tx, init_account_priv_key );
+    db->postpone_transaction( signed_transaction_transporter( expired_tx, serialization_mode_controller::get_current_pack() ) );
+
+    const auto balance = db->get_balance( HIVE_TEMP_ACCOUNT, HIVE_SYMBOL );
+
+    // postponed transactions are not part of pending state until reapplied, expired ones are dropped
+    BOOST_REQUIRE_EQUAL( db->apply_postponed_transactions( fc::seconds( 10 ) ), 0u );
+    BOOST_REQUIRE( db->_postponed_tx.empty() );
+    BOOST_REQUIRE( db->_postponed_tx_accounts.empty() );
+    BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 1u );
+    BOOST_REQUIRE( db->get_balance( HIVE_TEMP_ACCOUNT, HIVE_SYMBOL ) == balance + asset( 1000, HIVE_SYMBOL ) );
+
+    generate_block();
+    BOOST_REQUIRE_EQUAL( db->fetch_block_by_number( db->head_block_num() )->transactions.size(), 1u );
+    BOOST_REQUIRE( db->_pending_tx.empty() );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( postponed_transactions_keep_order, clean_database_fixture )
+{
+  try
+  {
+    ACTORS( (bob) )
+    fund( "bob", ASSET( "10.000 TESTS" ) );
+    generate_block();
+
+    // creation of alice and unrelated transfer from bob wait as postponed
+    signed_transaction create_tx;
+    account_create_operation create;
+    create.new_account_name = "alice";
+    create.creator = HIVE_INIT_MINER_NAME;
+    create.fee = db->get_witness_schedule_object().median_props.account_creation_fee;
+    create.owner = authority( 1, init_account_pub_key, 1 );
+    create.active = create.owner;
+    create.posting = create.owner;
+    create.memo_key = init_account_pub_key;
+    create_tx.operations.push_back( create );
+    create_tx.set_expiration( db->head_block_time() + HIVE_MAX_TIME_UNTIL_EXPIRATION );
+    sign( create_tx, init_account_priv_key );
+    db->postpone_transaction( signed_transaction_transporter( create_tx, serialization_mode_controller::get_current_pack() ) );
+
+    signed_transaction unrelated_tx;
+    transfer_operation unrelated;
+    unrelated.from = "bob";
+    unrelated.to = HIVE_TEMP_ACCOUNT;
+    unrelated.amount = ASSET( "1.000 TESTS" );
+    unrelated_tx.operations.push_back( unrelated );
+    unrelated_tx.set_expiration( db->head_block_time() + HIVE_MAX_TIME_UNTIL_EXPIRATION );
+    sign( unrelated_tx, bob_private_key );
+    db->postpone_transaction( signed_transaction_transporter( unrelated_tx, serialization_mode_controller::get_current_pack() ) );
+    BOOST_REQUIRE( db->find_account( "alice" ) == nullptr );
+
+    // new transfer to alice needs her account - its creation is applied first, unrelated transfer stays postponed
+    signed_transaction transfer_tx;
+    transfer_operation transfer;
+    transfer.from = HIVE_INIT_MINER_NAME;
+    transfer.to = "alice";
+    transfer.amount = ASSET( "1.000 TESTS" );
+    transfer_tx.operations.push_back( transfer );
+    transfer_tx.set_expiration( db->head_block_time() + HIVE_MAX_TIME_UNTIL_EXPIRATION );
+    sign( transfer_tx, init_account_priv_key );
+    push_transaction( transfer_tx, 0 );
+
+    BOOST_REQUIRE( db->find_account( "alice" ) != nullptr );
+    BOOST_REQUIRE_EQUAL( db->_pending_tx.size(), 2u );
+    BOOST_REQUIRE( db->_pending_tx[0].trx.id() == create_tx.id() );
+    BOOST_REQUIRE( db->_pending_tx[1].trx.id() == transfer_tx.id() );
+    BOOST_REQUIRE_EQUAL( db->_postponed_tx.size(), 1u );
+    BOOST_REQUIRE( db->_postponed_tx_accounts.count( "alice" ) == 0 );
+    BOOST_REQUIRE( db->_postponed_tx_accounts.count( "bob" ) == 1 );
+
+    // block has all of them, postponed one last
+    generate_block();
+    const auto block = db->fetch_block_by_number( db->head_block_num() );
+    BOOST_REQUIRE_EQUAL( block->transactions.size(), 3u );
+    BOOST_REQUIRE( block->transactions[0].trx.id() == create_tx.id() );
+    BOOST_REQUIRE( block->transactions[1].trx.id() == transfer_tx.id() );
+    BOOST_REQUIRE( block->transactions[2].trx.id() == unrelated_tx.id() );
+    BOOST_REQUIRE( db->_postponed_tx.empty() );
+    BOOST_REQUIRE( db->get_balance( "alice", HIVE_SYMBOL ) == ASSET( "1.000 TESTS" ) );
+  }
+  FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( set_lower_lib_then_current )
 {
   try {
@@ -954,6 +1150,189 @@ BOOST_AUTO_TEST_CASE( set_lower_lib_then_current )
   FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( replay_checkpoint_crash_resume )
+{
+  try {
+    fc::temp_directory data_dir( hive::utilities::temp_directory_path() );
+    fc::temp_directory state_dir( hive::utilities::temp_directory_path() );
+    fc::temp_directory crash_dir( hive::utilities::temp_directory_path() );
+    fc::temp_directory late_crash_dir( hive::utilities::temp_directory_path() );
+    auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+
+    BOOST_TEST_MESSAGE( "Producing blocks for block log" );
+    {
+      database db;
+      witness::block_producer bp( db );
+      db._log_hardforks = false;
+      open_test_database( db, data_dir.path() );
+      while( db.get_last_irreversible_block_num() < 45 )
+        bp.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+      db.close();
+    }
+
+    auto replay_args = [&]( const fc::path& state_path )
+    {
+      hive::chain::open_args args;
+      args.data_dir = data_dir.path();
+      args.shared_mem_dir = state_path;
+      args.initial_supply = INITIAL_TEST_SUPPLY;
+      args.hbd_initial_supply = HBD_INITIAL_TEST_SUPPLY;
+      args.shared_file_size = TEST_SHARED_MEM_SIZE;
+      args.database_cfg = hive::utilities::default_database_configuration();
+      args.replay_checkpoint_interval = 10;
+      return args;
+    };
+    // copy of state files taken between blocks is exactly what crash of the process leaves behind
+    auto save_crashed_state = [&]( const fc::path& crash_path )
+    {
+      for( fc::directory_iterator itr( state_dir.path() ); itr != fc::directory_iterator(); ++itr )
+        fc::copy( *itr, crash_path / ( *itr ).filename() );
+    };
+
+    BOOST_TEST_MESSAGE( "Replaying with checkpoints, saving state as if crashed in the middle" );
+    std::vector< uint32_t > stored_at_crash;
+    std::vector< uint32_t > stored_at_late_crash;
+    block_id_type head_id;
+    std::vector< char > dgpo_data;
+    {
+      database db;
+      db._log_hardforks = false;
+      replay_storage_emulator storage( db );
+      storage.on_block = [&]( uint32_t block_num )
+      {
+        if( block_num == 25 )
+        {
+          save_crashed_state( crash_dir.path() );
+          stored_at_crash = storage.stored_blocks;
+        }
+      };
+      storage.on_checkpoint = [&]( uint32_t block_num )
+      {
+        // external storage is already written, but state at checkpoint is not committed yet
+        if( block_num == 30 )
+        {
+          save_crashed_state( late_crash_dir.path() );
+          stored_at_late_crash = storage.stored_blocks;
+        }
+      };
+      auto args = replay_args( state_dir.path() );
+      db.open( args );
+      db.reindex( args );
+      BOOST_REQUIRE_GT( db.head_block_num(), 40u );
+      head_id = db.head_block_id();
+      dgpo_data = fc::raw::pack_to_vector( db.get_dynamic_global_properties() );
+      db.close();
+    }
+
+    BOOST_TEST_MESSAGE( "Resuming replay after crash between checkpoints" );
+    {
+      database db;
+      db._log_hardforks = false;
+      replay_storage_emulator storage( db );
+      storage.stored_blocks = stored_at_crash;
+      auto args = replay_args( crash_dir.path() );
+      db.open( args );
+      BOOST_REQUIRE_EQUAL( db.head_block_num(), 20u );
+      BOOST_REQUIRE_EQUAL( storage.stored_blocks.size(), 20u );
+
+      db.reindex( args );
+      BOOST_REQUIRE( db.head_block_id() == head_id );
+      BOOST_REQUIRE( fc::raw::pack_to_vector( db.get_dynamic_global_properties() ) == dgpo_data );
+      // no block reached external storage twice
+      BOOST_REQUIRE_EQUAL( storage.stored_blocks.size(), db.head_block_num() );
+      for( uint32_t i = 0; i < storage.stored_blocks.size(); ++i )
+        BOOST_REQUIRE_EQUAL( storage.stored_blocks[i], i + 1 );
+      BOOST_REQUIRE( !fc::exists( crash_dir.path() / "replay_checkpoint.json" ) );
+      db.close();
+    }
+
+    BOOST_TEST_MESSAGE( "Crash inside checkpoint leaves external storage ahead of state, never behind" );
+    {
+      database db;
+      db._log_hardforks = false;
+      db.open( replay_args( late_crash_dir.path() ) );
+      BOOST_REQUIRE_EQUAL( db.head_block_num(), 20u );
+      BOOST_REQUIRE_EQUAL( stored_at_late_crash.back(), 30u );
+      db.close();
+    }
+  }
+  FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( block_log_background_writer_crash )
+{
+  try {
+    fc::temp_directory data_dir( hive::utilities::temp_directory_path() );
+    fc::temp_directory crash_dir( hive::utilities::temp_directory_path() );
+    auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+    const uint32_t compression_threads = 2;
+
+    BOOST_TEST_MESSAGE( "Producing blocks with background block log writer, saving state as if crashed" );
+    std::vector< signed_block > blocks;
+    uint32_t crash_lib = 0;
+    {
+      database db;
+      witness::block_producer bp( db );
+      db._log_hardforks = false;
+      open_test_database( db, data_dir.path(), compression_threads );
+      while( db.get_last_irreversible_block_num() < 60 )
+      {
+        blocks.push_back( bp.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing ) );
+        // state never treats a block as irreversible before it is written to the file
+        BOOST_REQUIRE_LE( db.get_last_irreversible_block_num(), db.get_durable_block_log_head_num() );
+
+        if( crash_lib == 0 && db.get_last_irreversible_block_num() >= 30 )
+        {
+          // copy of state taken between blocks is exactly what crash of the process leaves behind; of the block log
+          // only blocks required by the state are kept, everything else is dropped as if lost with the writer queue
+          crash_lib = db.get_last_irreversible_block_num();
+          for( fc::directory_iterator itr( data_dir.path() ); itr != fc::directory_iterator(); ++itr )
+          {
+            if( ( *itr ).filename().generic_string().find( "block_log" ) != 0 )
+              fc::copy( *itr, crash_dir.path() / ( *itr ).filename() );
+          }
+          block_log crashed_log;
+          crashed_log.open( crash_dir.path() / "block_log" );
+          for( uint32_t i = 1; i <= crash_lib; ++i )
+            crashed_log.append( *db.fetch_block_by_number( i ) );
+          crashed_log.close();
+        }
+      }
+      db.close();
+    }
+
+    BOOST_TEST_MESSAGE( "Reopening crashed state and applying dropped blocks again" );
+    {
+      database db;
+      db._log_hardforks = false;
+      open_test_database( db, crash_dir.path(), compression_threads );
+      BOOST_REQUIRE_EQUAL( db.head_block_num(), crash_lib );
+      BOOST_REQUIRE_EQUAL( db.get_last_irreversible_block_num(), crash_lib );
+
+      for( uint32_t i = crash_lib; i < blocks.size(); ++i )
+      {
+        db.push_block( blocks[i] );
+        BOOST_REQUIRE_LE( db.get_last_irreversible_block_num(), db.get_durable_block_log_head_num() );
+      }
+      BOOST_REQUIRE( db.head_block_id() == blocks.back().id() );
+      db.close();
+    }
+
+    BOOST_TEST_MESSAGE( "Clean close writes queued blocks and lets state follow them" );
+    {
+      database db;
+      db._log_hardforks = false;
+      open_test_database( db, crash_dir.path(), compression_threads );
+      BOOST_REQUIRE_GE( db.get_last_irreversible_block_num(), 60u );
+      BOOST_REQUIRE_EQUAL( db.head_block_num(), db.get_last_irreversible_block_num() );
+      BOOST_REQUIRE_EQUAL( db.get_durable_block_log_head_num(), db.head_block_num() );
+      BOOST_REQUIRE( db.head_block_id() == blocks[ db.head_block_num() - 1 ].id() );
+      db.close();
+    }
+  }
+  FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( safe_closing_database )
 {
   try {
@@ -0,0 +1,161 @@
+#include <boost/test/unit_test.hpp>
+
+#include <hive/utilities/performance_trace.hpp>
+#include <hive/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using hive::utilities::performance_trace;
+
+namespace
+{
+  // ring buffer is allocated once per process, so every test uses the same size
+  const uint32_t TRACE_CAPACITY = 8;
+
+  /// Dumps trace and returns its events of given category (all metadata events when category is empty)
+  std::vector< fc::variant_object > dump_events( const std::string& category, uint32_t* dumped = nullptr )
+  {
+    fc::temp_directory dir( hive::utilities::temp_directory_path() );
+    const fc::path file = dir.path() / "trace.json";
+    const uint32_t count = performance_trace::instance().dump( file );
+    if( dumped != nullptr )
+      *dumped = count;
+
+    const fc::variant trace = fc::json::from_file( file );
+    BOOST_REQUIRE( trace.is_object() );
+    BOOST_CHECK_EQUAL( trace.get_object()[ "displayTimeUnit" ].as_string(), "ms" );
+
+    std::vector< fc::variant_object > events;
+    for( const auto& e : trace.get_object()[ "traceEvents" ].get_array() )
+    {
+      const auto& event = e.get_object();
+      if( category.empty() ? event[ "ph" ].as_string() == "M" : ( event.contains( "cat" ) && event[ "cat" ].as_string() == category ) )
+        events.push_back( event );
+    }
+    return events;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( performance_trace_tests )
+
+BOOST_AUTO_TEST_CASE( ring_wraparound )
+{
+  auto& trace = performance_trace::instance();
+  trace.enable( TRACE_CAPACITY );
+
+  const uint32_t span_count = 2 * TRACE_CAPACITY + 4;
+  for( uint32_t i = 0; i < span_count; ++i )
+    trace.record( "wrap", ( "span" + std::to_string( i ) ).c_str(), 1000 + 10 * i, 1005 + 10 * i, i );
+
+  uint32_t dumped = 0;
+  auto events = dump_events( "wrap", &dumped );
+  trace.disable();
+
+  // only the newest spans survive, oldest first
+  BOOST_CHECK_EQUAL( dumped, TRACE_CAPACITY );
+  BOOST_REQUIRE_EQUAL( events.size(), TRACE_CAPACITY );
+  for( uint32_t i = 0; i < TRACE_CAPACITY; ++i )
+  {
+    const uint32_t n = span_count - TRACE_CAPACITY + i;
+    BOOST_CHECK_EQUAL( events[i][ "name" ].as_string(), "span" + std::to_string( n ) );
+    BOOST_CHECK_EQUAL( events[i][ "ph" ].as_string(), "X" );
+    BOOST_CHECK_EQUAL( events[i][ "ts" ].as_int64(), 1000 + 10 * n );
+    BOOST_CHECK_EQUAL( events[i][ "dur" ].as_int64(), 5 );
+    BOOST_CHECK_EQUAL( events[i][ "args" ].get_object()[ "n" ].as_int64(), n );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( scope_nesting_and_thread_names )
+{
+  auto& trace = performance_trace::instance();
+  trace.enable( TRACE_CAPACITY );
+  trace.set_thread_name( "trace \"test\" thread" );
+
+  {
+    HIVE_TRACE_SCOPE( "nest", "outer" );
+    {
+      HIVE_TRACE_SCOPE( "nest", "inner", 42 );
+      HIVE_TRACE_CALL( "nest", std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) ) );
+    }
+  }
+
+  auto events = dump_events( "nest" );
+  auto metadata = dump_events( "" );
+  trace.disable();
+
+  // inner spans finish first but are dumped in order of begin time (equal when within the same microsecond)
+  BOOST_REQUIRE_EQUAL( events.size(), 3u );
+  for( size_t i = 1; i < events.size(); ++i )
+    BOOST_CHECK_LE( events[i-1][ "ts" ].as_int64(), events[i][ "ts" ].as_int64() );
+  auto find = [&]( const std::string& name ) -> const fc::variant_object&
+  {
+    auto itr = std::find_if( events.begin(), events.end(), [&]( const fc::variant_object& e ) { return e[ "name" ].as_string() == name; } );
+    BOOST_REQUIRE( itr != events.end() );
+    return *itr;
+  };
+  const auto& outer = find( "outer" );
+  const auto& inner = find( "inner" );
+  const auto& call = find( "std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) )" );
+
+  auto end = []( const fc::variant_object& e ) { return e[ "ts" ].as_int64() + e[ "dur" ].as_int64(); };
+  BOOST_CHECK_LE( outer[ "ts" ].as_int64(), inner[ "ts" ].as_int64() );
+  BOOST_CHECK_LE( end( inner ), end( outer ) );
+  BOOST_CHECK_LE( inner[ "ts" ].as_int64(), call[ "ts" ].as_int64() );
+  BOOST_CHECK_LE( end( call ), end( inner ) );
+  BOOST_CHECK_GE( call[ "dur" ].as_int64(), 1000 );
+
+  BOOST_CHECK( !outer.contains( "args" ) );
+  BOOST_CHECK_EQUAL( inner[ "args" ].get_object()[ "n" ].as_int64(), 42 );
+  BOOST_CHECK_EQUAL( outer[ "tid" ].as_uint64(), inner[ "tid" ].as_uint64() );
+
+  bool thread_named = false;
+  for( const auto& m : metadata )
+  {
+    if( m[ "tid" ].as_uint64() == outer[ "tid" ].as_uint64() )
+    {
+      BOOST_CHECK_EQUAL( m[ "name" ].as_string(), "thread_name" );
+      BOOST_CHECK_EQUAL( m[ "args" ].get_object()[ "name" ].as_string(), "trace \"test\" thread" );
+      thread_named = true;
+    }
+  }
+  BOOST_CHECK( thread_named );
+}
+
+BOOST_AUTO_TEST_CASE( disabled_and_totals )
+{
+  auto& trace = performance_trace::instance();
+  trace.enable( TRACE_CAPACITY );
+  trace.disable();
+  BOOST_CHECK( !trace.is_enabled() );
+  {
+    HIVE_TRACE_SCOPE( "off", "not recorded" );
+  }
+  BOOST_CHECK( dump_events( "off" ).empty() );
+
+  // totals work without ring buffer
+  trace.reset_totals();
+  trace.enable_totals( true );
+  BOOST_CHECK( trace.is_enabled() );
+  trace.record( "sum", "a", 100, 110 );
+  trace.record( "sum", "a", 200, 205 );
+  trace.record( "sum", "b", 300, 301 );
+  trace.enable_totals( false );
+  trace.record( "sum", "a", 400, 500 );
+
+  auto totals = trace.get_totals();
+  BOOST_REQUIRE_EQUAL( totals.size(), 2u );
+  BOOST_CHECK_EQUAL( totals[ std::make_pair( std::string( "sum" ), std::string( "a" ) ) ].count, 2u );
+  BOOST_CHECK_EQUAL( totals[ std::make_pair( std::string( "sum" ), std::string( "a" ) ) ].time, 15 );
+  BOOST_CHECK_EQUAL( totals[ std::make_pair( std::string( "sum" ), std::string( "b" ) ) ].time, 1 );
+  BOOST_CHECK( dump_events( "sum" ).empty() );
+  trace.reset_totals();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,159 @@
+#include <boost/test/unit_test.hpp>
+
+#include <hive/chain/util/signature_key_cache.hpp>
+
+#include <hive/protocol/exceptions.hpp>
+#include <hive/protocol/hive_operations.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace hive::chain;
+using namespace hive::protocol;
+using hive::chain::util::signature_key_cache;
+
+namespace
+{
+  const canonical_signature_type CANON = fc::ecc::fc_canonical;
+
+  fc::ecc::private_key make_key( const std::string& seed )
+  {
+    return fc::ecc::private_key::regenerate( fc::sha256::hash( seed ) );
+  }
+
+  chain_id_type make_chain_id( const std::string& seed )
+  {
+    return fc::sha256::hash( seed );
+  }
+
+  /// Transaction with a transfer, different for every n, signed with given keys
+  signed_transaction_transporter make_transaction( uint32_t n, const std::vector< fc::ecc::private_key >& keys,
+    const chain_id_type& chain_id )
+  {
+    transfer_operation transfer;
+    transfer.from = "alice";
+    transfer.to = "bob";
+    transfer.amount = asset( n + 1, HIVE_SYMBOL );
+    signed_transaction tx;
+    tx.ref_block_num = n & 0xffff;
+    tx.expiration = fc::time_point_sec( 1600000000 + n );
+    tx.operations.push_back( transfer );
+    const auto pack = serialization_mode_controller::get_current_pack();
+    for( const auto& key : keys )
+      tx.sign( key, chain_id, CANON );
+    return signed_transaction_transporter( tx, pack );
+  }
+
+  flat_set< public_key_type > expected_keys( const signed_transaction_transporter& trx, const chain_id_type& chain_id )
+  {
+    return trx.trx.get_signature_keys( chain_id, CANON, trx.get_pack() );
+  }
+}
+
+BOOST_AUTO_TEST_SUITE( signature_key_cache_tests )
+
+BOOST_AUTO_TEST_CASE( hit_and_miss )
+{
+  const auto chain_id = make_chain_id( "chain" );
+  const auto alice = make_key( "alice" );
+  const auto bob = make_key( "bob" );
+  signature_key_cache cache;
+
+  const auto trx = make_transaction( 1, { alice, bob }, chain_id );
+  auto keys = cache.get_signature_keys( trx, chain_id, CANON );
+  BOOST_REQUIRE_EQUAL( keys.size(), 2u );
+  BOOST_CHECK( keys.count( alice.get_public_key() ) );
+  BOOST_CHECK( keys.count( bob.get_public_key() ) );
+  BOOST_CHECK( keys == expected_keys( trx, chain_id ) );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 2u );
+  BOOST_CHECK_EQUAL( cache.get_hit_count(), 0u );
+
+  // second validation (when transaction is included in block) is a lookup
+  BOOST_CHECK( cache.get_signature_keys( trx, chain_id, CANON ) == keys );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 2u );
+  BOOST_CHECK_EQUAL( cache.get_hit_count(), 2u );
+
+  // prefetch recovers only signatures not seen before
+  const auto other = make_transaction( 2, { bob }, chain_id );
+  cache.prefetch( { trx, other }, chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 3u );
+  BOOST_CHECK_EQUAL( cache.get_hit_count(), 4u );
+  BOOST_CHECK( cache.get_signature_keys( other, chain_id, CANON ) == expected_keys( other, chain_id ) );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 3u );
+  BOOST_CHECK_EQUAL( cache.get_hit_count(), 5u );
+
+  // duplicate signature is detected also when keys come from the cache
+  signed_transaction duplicated = trx.trx;
+  duplicated.signatures.push_back( duplicated.signatures.front() );
+  BOOST_REQUIRE_THROW( cache.get_signature_keys( signed_transaction_transporter( duplicated, trx.get_pack() ), chain_id, CANON ),
+    tx_duplicate_sig );
+
+  cache.clear();
+  cache.get_signature_keys( trx, chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 5u );
+}
+
+BOOST_AUTO_TEST_CASE( eviction )
+{
+  const auto chain_id = make_chain_id( "chain" );
+  const auto alice = make_key( "alice" );
+  signature_key_cache cache( 2 );
+
+  std::vector< signed_transaction_transporter > trxs;
+  for( uint32_t i = 0; i < 5; ++i )
+    trxs.push_back( make_transaction( i, { alice }, chain_id ) );
+
+  // third entry does not fit - first two become previous generation, still visible
+  for( uint32_t i = 0; i < 3; ++i )
+    cache.get_signature_keys( trxs[i], chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 3u );
+  cache.get_signature_keys( trxs[0], chain_id, CANON );
+  cache.get_signature_keys( trxs[1], chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_hit_count(), 2u );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 3u );
+
+  // filling current generation again drops the previous one
+  cache.get_signature_keys( trxs[3], chain_id, CANON );
+  cache.get_signature_keys( trxs[4], chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 5u );
+  BOOST_CHECK( cache.get_signature_keys( trxs[0], chain_id, CANON ) == expected_keys( trxs[0], chain_id ) );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 6u );
+  cache.get_signature_keys( trxs[3], chain_id, CANON );
+  cache.get_signature_keys( trxs[4], chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_hit_count(), 4u );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 6u );
+}
+
+BOOST_AUTO_TEST_CASE( key_includes_digest )
+{
+  const auto chain_id = make_chain_id( "chain" );
+  const auto other_chain_id = make_chain_id( "other chain" );
+  const auto alice = make_key( "alice" );
+  signature_key_cache cache;
+
+  const auto trx = make_transaction( 1, { alice }, chain_id );
+  BOOST_CHECK( *cache.get_signature_keys( trx, chain_id, CANON ).begin() == public_key_type( alice.get_public_key() ) );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 1u );
+
+  // the same signature checked against different chain id is recovered again and gives different key
+  auto keys = cache.get_signature_keys( trx, other_chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 2u );
+  BOOST_CHECK( keys == expected_keys( trx, other_chain_id ) );
+  BOOST_CHECK( *keys.begin() != public_key_type( alice.get_public_key() ) );
+
+  // the same with signature moved to modified transaction
+  signed_transaction modified = trx.trx;
+  modified.expiration += 1;
+  const signed_transaction_transporter modified_trx( modified, trx.get_pack() );
+  keys = cache.get_signature_keys( modified_trx, chain_id, CANON );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 3u );
+  BOOST_CHECK( keys == expected_keys( modified_trx, chain_id ) );
+  BOOST_CHECK( *keys.begin() != public_key_type( alice.get_public_key() ) );
+
+  // original entry was not overwritten
+  BOOST_CHECK( *cache.get_signature_keys( trx, chain_id, CANON ).begin() == public_key_type( alice.get_public_key() ) );
+  BOOST_CHECK_EQUAL( cache.get_hit_count(), 1u );
+  BOOST_CHECK_EQUAL( cache.get_miss_count(), 3u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()